@@ -0,0 +1,667 @@
+#include "aStarRouter.h"
+#include "baseRequests.h"
+#include "dijkstraRouter.h"
+#include "firstHopRouter.h"
+#include "graph.h"
+#include "hubLabelingRouter.h"
+#include "json.h"
+#include "mappedFile.h"
+#include "minPlusKernels.h"
+#include "profiler.h"
+#include "router.h"
+#include "transportCatalog.h"
+#include "utils.h"
+
+#include "transport_catalog.pb.h"
+
+#include <google/protobuf/arena.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+constexpr auto WrongParametrsMsg("Usage: transport_catalog_benchmarks <make_base input file>\n");
+
+using RoutesGraph = Graph::DirectedWeightedGraph<double>;
+using AStarRouter = Graph::AStarRouter<double>;
+using HubLabelingRouter = Graph::HubLabelingRouter<double>;
+
+// The catalog is built with A* routing, it keeps the points of the vertexes and nothing else
+TCProto::TransportCatalog makeCatalogProto(const Json::Map& makeBaseInput)
+{
+    auto routingSettings = makeBaseInput.at("routing_settings").asMap();
+    routingSettings["routing_algorithm"] = Json::Node("a_star"s);
+    const TransportCatalog catalog(
+        BaseRequests::parseRequests(makeBaseInput.at("base_requests").asArray()), routingSettings);
+
+    TCProto::TransportCatalog proto;
+    ASSERT_WITH_MESSAGE(proto.ParseFromString(catalog.serialize()), "can't parse the catalog");
+    return proto;
+}
+
+struct RoutesMatrix
+{
+    vector<double> weights;
+    vector<Graph::CompactEdgeId> prevEdges;
+};
+
+RoutesMatrix makeInitialRoutes(const RoutesGraph& graph)
+{
+    const size_t vertexCount = graph.getVertexCount();
+    const size_t cellCount = vertexCount * vertexCount;
+    RoutesMatrix routes{vector<double>(cellCount, numeric_limits<double>::infinity()),
+                        vector<Graph::CompactEdgeId>(cellCount, Graph::NoEdge)};
+    for (Graph::VertexId vertex = 0; vertex < vertexCount; ++vertex)
+    {
+        routes.weights[vertex * vertexCount + vertex] = 0;
+        for (const auto& edge : graph.getEdgesWhichStartFrom(vertex))
+        {
+            const size_t index = vertex * vertexCount + edge.to;
+            if (routes.weights[index] > edge.weight)
+            {
+                routes.weights[index] = edge.weight;
+                routes.prevEdges[index] = static_cast<Graph::CompactEdgeId>(edge.id);
+            }
+        }
+    }
+    return routes;
+}
+
+void runFloydWarshall(Graph::MinPlus::Kernel kernel, size_t vertexCount, RoutesMatrix& routes)
+{
+    for (Graph::VertexId through = 0; through < vertexCount; ++through)
+    {
+        const size_t throughRowIndex = through * vertexCount;
+        for (Graph::VertexId from = 0; from < vertexCount; ++from)
+        {
+            const size_t fromIndex = from * vertexCount + through;
+            if (routes.weights[fromIndex] < numeric_limits<double>::infinity())
+            {
+                Graph::MinPlus::relaxRow(kernel,
+                                         routes.weights[fromIndex],
+                                         routes.prevEdges[fromIndex],
+                                         &routes.weights[throughRowIndex],
+                                         &routes.prevEdges[throughRowIndex],
+                                         &routes.weights[from * vertexCount],
+                                         &routes.prevEdges[from * vertexCount],
+                                         vertexCount);
+            }
+        }
+    }
+}
+
+// Runs the whole Floyd-Warshall algorithm on the graph several times with the kernel
+RoutesMatrix benchmarkKernel(Graph::MinPlus::Kernel kernel, const RoutesGraph& graph)
+{
+    constexpr size_t IterationCount = 200;
+
+    const auto initialRoutes = makeInitialRoutes(graph);
+    RoutesMatrix routes;
+    {
+        LOG_DURATION("min-plus kernel "s + Graph::MinPlus::getKernelName(kernel) + ", " +
+                     to_string(IterationCount) + " runs of Floyd-Warshall algorithm");
+        for (size_t iteration = 0; iteration < IterationCount; ++iteration)
+        {
+            routes = initialRoutes;
+            runFloydWarshall(kernel, graph.getVertexCount(), routes);
+        }
+    }
+    return routes;
+}
+
+bool areEqual(const RoutesMatrix& lhs, const RoutesMatrix& rhs)
+{
+    for (size_t i = 0; i < lhs.weights.size(); ++i)
+    {
+        if (lhs.weights[i] < rhs.weights[i] || rhs.weights[i] < lhs.weights[i])
+        {
+            return false;
+        }
+    }
+    return lhs.prevEdges == rhs.prevEdges;
+}
+// Searches the routes between the same random pairs of vertexes, reports the average
+// count of the settled vertexes
+void benchmarkPointToPointRouter(const string& name, const AStarRouter& router, size_t vertexCount)
+{
+    constexpr size_t RouteCount = 2000;
+
+    mt19937 generator(42);
+    uniform_int_distribution<Graph::VertexId> vertexDistribution(0, vertexCount - 1);
+    size_t settledVertexCount = 0;
+    {
+        LOG_DURATION(name + ", " + to_string(RouteCount) + " routes");
+        for (size_t routeIndex = 0; routeIndex < RouteCount; ++routeIndex)
+        {
+            router.buildRoute(vertexDistribution(generator), vertexDistribution(generator));
+            settledVertexCount += router.getSettledVertexCount();
+        }
+    }
+    cerr << name << ": " << settledVertexCount / RouteCount << " settled vertexes per route"
+         << endl;
+}
+
+void benchmarkPointToPointRouters(const RoutesGraph& graph,
+                                  const GraphProto::AStarRouter& aStarRouterProto)
+{
+    const auto aStarRouter = AStarRouter::deserialize(aStarRouterProto, graph);
+
+    auto bidirectionalProto = aStarRouterProto;
+    bidirectionalProto.set_is_bidirectional(true);
+    const auto bidirectionalRouter = AStarRouter::deserialize(bidirectionalProto, graph);
+
+    // With the same point for all the vertexes the bound is zero, that is plain Dijkstra's search
+    auto dijkstraProto = aStarRouterProto;
+    dijkstraProto.set_is_bidirectional(false);
+    for (int index = 0; index < dijkstraProto.latitudes_size(); ++index)
+    {
+        dijkstraProto.set_latitudes(index, 0);
+        dijkstraProto.set_longitudes(index, 0);
+    }
+    const auto dijkstraRouter = AStarRouter::deserialize(dijkstraProto, graph);
+
+    benchmarkPointToPointRouter("Dijkstra", *dijkstraRouter, graph.getVertexCount());
+    benchmarkPointToPointRouter("A*", *aStarRouter, graph.getVertexCount());
+    benchmarkPointToPointRouter("bidirectional A*", *bidirectionalRouter, graph.getVertexCount());
+}
+
+// Compares the precalculation of all the routes with the updates after a weight of a random edge
+// has decreased or increased, prints the cells of the routes matrices of the components
+void benchmarkRouterUpdates(RoutesGraph graph)
+{
+    constexpr size_t UpdateCount = 20;
+    using Router = Graph::Router<double>;
+
+    unique_ptr<Router> router;
+    {
+        LOG_DURATION("all pairs precalculation");
+        router = make_unique<Router>(graph);
+    }
+    const size_t vertexCount = graph.getVertexCount();
+    cerr << "all pairs routes: " << router->getComponentCount() << " components, "
+         << router->getCellCount() << " cells instead of " << vertexCount * vertexCount << endl;
+
+    mt19937 generator(42);
+    uniform_int_distribution<Graph::EdgeId> edgeDistribution(0, graph.getEdgeCount() - 1);
+    for (const auto& [name, factor] : {pair{"decreased", 0.5}, pair{"increased", 2.0}})
+    {
+        LOG_DURATION("all pairs update, "s + to_string(UpdateCount) + " edges " + name);
+        for (size_t updateIndex = 0; updateIndex < UpdateCount; ++updateIndex)
+        {
+            const Graph::EdgeId edgeId = edgeDistribution(generator);
+            const double oldWeight = graph.getEdge(edgeId).weight;
+            graph.setEdgeWeight(edgeId, oldWeight * factor);
+            router->update({{edgeId, oldWeight}});
+        }
+    }
+}
+
+// Precalculation of all the routes with the routes matrix of narrower weights, its memory and the
+// greatest relative difference of the route weights from the double ones
+template <typename Weight>
+void benchmarkNarrowerWeights(const string& name, const RoutesGraph& graph)
+{
+    const Graph::Router<double> expectedRouter(graph);
+
+    unique_ptr<Graph::Router<Weight, double>> router;
+    {
+        LOG_DURATION("all pairs precalculation, "s + name + " weights");
+        router = make_unique<Graph::Router<Weight, double>>(graph);
+    }
+
+    const size_t vertexCount = graph.getVertexCount();
+    vector<Graph::VertexId> vertexes(vertexCount);
+    for (Graph::VertexId vertex = 0; vertex < vertexCount; ++vertex)
+    {
+        vertexes[vertex] = vertex;
+    }
+    const auto expectedWeights = expectedRouter.findRouteWeights(vertexes, vertexes);
+    const auto weights = router->findRouteWeights(vertexes, vertexes);
+    double maxRelativeDiff = 0;
+    for (size_t index = 0; index < weights.size(); ++index)
+    {
+        const double expectedWeight = expectedWeights[index];
+        if (expectedWeight > 0 && expectedWeight < numeric_limits<double>::infinity())
+        {
+            const double weight = static_cast<double>(weights[index]);
+            maxRelativeDiff = max(maxRelativeDiff, abs(weight - expectedWeight) / expectedWeight);
+        }
+    }
+    const size_t cellSize = sizeof(Weight) + sizeof(Graph::CompactEdgeId);
+    cerr << name << " weights: " << router->getCellCount() * cellSize
+         << " bytes of the routes matrix, max relative difference " << maxRelativeDiff << endl;
+}
+
+// Sizes of the serialized hub labels and routes matrix, and the time of the same random routes
+// found by both of them
+void benchmarkHubLabeling(const RoutesGraph& graph)
+{
+    constexpr size_t RouteCount = 100000;
+
+    unique_ptr<HubLabelingRouter> hubLabelingRouter;
+    {
+        LOG_DURATION("hub labels precalculation");
+        hubLabelingRouter = make_unique<HubLabelingRouter>(graph);
+    }
+    Graph::Router<double> router(graph);
+
+    GraphProto::HubLabelingRouter hubLabelingProto;
+    hubLabelingRouter->serialize(hubLabelingProto);
+    GraphProto::Router routerProto;
+    router.serialize(routerProto);
+    cerr << "hub labels: " << hubLabelingRouter->getLabelEntryCount() << " entries, "
+         << hubLabelingProto.ByteSizeLong() << " bytes serialized, all pairs routes "
+         << routerProto.ByteSizeLong() << " bytes serialized" << endl;
+
+    const auto findRoutes = [&graph](const string& name, auto findRoute) {
+        mt19937 generator(42);
+        uniform_int_distribution<Graph::VertexId> vertexDistribution(0,
+                                                                    graph.getVertexCount() - 1);
+        LOG_DURATION(name + ", " + to_string(RouteCount) + " routes with their edges");
+        for (size_t routeIndex = 0; routeIndex < RouteCount; ++routeIndex)
+        {
+            const Graph::VertexId from = vertexDistribution(generator);
+            const Graph::VertexId to = vertexDistribution(generator);
+            findRoute(from, to);
+        }
+    };
+    findRoutes("all pairs", [&router](auto from, auto to) {
+        if (const auto route = router.buildRoute(from, to))
+        {
+            for (size_t edgeIndex = 0; edgeIndex < route->edgeCount; ++edgeIndex)
+            {
+                router.getRouteEdge(route->id, edgeIndex);
+            }
+            router.releaseRoute(route->id);
+        }
+    });
+    findRoutes("hub labeling", [&hubLabelingRouter](auto from, auto to) {
+        hubLabelingRouter->forEachRouteEdge(from, to, [](Graph::EdgeId) {});
+    });
+}
+// Random routes with their edges from the routes matrix of the previous edges, expanded into the
+// router or walked backwards, and from the first hop routes walked forwards. Sizes of both
+// serialized
+void benchmarkFirstHops(const RoutesGraph& graph)
+{
+    constexpr size_t RouteCount = 100000;
+
+    Graph::Router<double> router(graph);
+    unique_ptr<Graph::FirstHopRouter<double>> firstHopRouter;
+    {
+        LOG_DURATION("first hops from the previous edges");
+        firstHopRouter = make_unique<Graph::FirstHopRouter<double>>(graph, router);
+    }
+
+    GraphProto::Router routerProto;
+    router.serialize(routerProto);
+    GraphProto::FirstHopRouter firstHopProto;
+    firstHopRouter->serialize(firstHopProto);
+    cerr << "first hops: " << firstHopRouter->getFirstHopSize() * 8 << "-bit edge ids, "
+         << firstHopProto.ByteSizeLong() << " bytes serialized, previous edges "
+         << routerProto.ByteSizeLong() << " bytes serialized" << endl;
+
+    const auto findRoutes = [&graph](const string& name, auto findRoute) {
+        mt19937 generator(42);
+        uniform_int_distribution<Graph::VertexId> vertexDistribution(0,
+                                                                    graph.getVertexCount() - 1);
+        double weightSum = 0;
+        {
+            LOG_DURATION(name + ", " + to_string(RouteCount) + " routes with their edges");
+            for (size_t routeIndex = 0; routeIndex < RouteCount; ++routeIndex)
+            {
+                const Graph::VertexId from = vertexDistribution(generator);
+                const Graph::VertexId to = vertexDistribution(generator);
+                weightSum += findRoute(from, to);
+            }
+        }
+        cerr << name << ": " << weightSum << " total weight" << endl;
+    };
+    findRoutes("previous edges, expanded", [&graph, &router](auto from, auto to) {
+        double weight = 0;
+        if (const auto route = router.buildRoute(from, to))
+        {
+            for (size_t edgeIndex = 0; edgeIndex < route->edgeCount; ++edgeIndex)
+            {
+                weight += graph.getEdge(router.getRouteEdge(route->id, edgeIndex)).weight;
+            }
+            router.releaseRoute(route->id);
+        }
+        return weight;
+    });
+    findRoutes("previous edges, backwards", [&graph, &router](auto from, auto to) {
+        double weight = 0;
+        if (const auto route = router.getRoute(from, to))
+        {
+            for (const Graph::EdgeId edgeId : *route)
+            {
+                weight += graph.getEdge(edgeId).weight;
+            }
+        }
+        return weight;
+    });
+    findRoutes("first hops, forwards", [&graph, &firstHopRouter](auto from, auto to) {
+        double weight = 0;
+        firstHopRouter->forEachRouteEdge(from, to, [&graph, &weight](Graph::EdgeId edgeId) {
+            weight += graph.getEdge(edgeId).weight;
+        });
+        return weight;
+    });
+}
+
+// Grid of the side count of vertexes with edges both ways between the neighbours, the ids of the
+// vertexes are shuffled, as the ids of stops given in the order of the buses are
+RoutesGraph makeShuffledGridGraph(size_t side)
+{
+    vector<Graph::VertexId> vertexes(side * side);
+    for (Graph::VertexId vertex = 0; vertex < vertexes.size(); ++vertex)
+    {
+        vertexes[vertex] = vertex;
+    }
+    mt19937 generator(42);
+    shuffle(begin(vertexes), end(vertexes), generator);
+    uniform_int_distribution<int> weightDistribution(1, 20);
+
+    RoutesGraph graph(vertexes.size());
+    for (size_t row = 0; row < side; ++row)
+    {
+        for (size_t column = 0; column < side; ++column)
+        {
+            const Graph::VertexId vertex = vertexes[row * side + column];
+            for (const auto& neighbour : {pair{row + 1, column}, pair{row, column + 1}})
+            {
+                if (neighbour.first < side && neighbour.second < side)
+                {
+                    const Graph::VertexId neighbourVertex =
+                        vertexes[neighbour.first * side + neighbour.second];
+                    graph.addEdge({vertex, neighbourVertex, weightDistribution(generator) / 4.0});
+                    graph.addEdge({neighbourVertex, vertex, weightDistribution(generator) / 4.0});
+                }
+            }
+        }
+    }
+    graph.freeze();
+    return graph;
+}
+
+// Sizes of the routes matrix serialized with a message for every cell and in shards, and the time
+// to parse them and make the router out of them. The shards are encoded and read on one thread and
+// on all of them
+void benchmarkRouterEncoding(const RoutesGraph& graph)
+{
+    constexpr size_t RepeatCount = 100;
+    using Router = Graph::Router<double>;
+
+    Router router(graph);
+    GraphProto::Router shardedProto;
+    router.serialize(shardedProto);
+
+    GraphProto::Router perCellProto;
+    for (const auto& componentProto : shardedProto.components())
+    {
+        auto& perCellComponentProto = *perCellProto.add_components();
+        *perCellComponentProto.mutable_vertexes() = componentProto.vertexes();
+        for (const auto from : componentProto.vertexes())
+        {
+            auto& routesDataProto = *perCellComponentProto.add_routes_data();
+            for (const auto to : componentProto.vertexes())
+            {
+                auto& routeDataProto = *routesDataProto.add_routes_data_for_one_vertex();
+                if (const auto route = router.getRoute(from, to))
+                {
+                    routeDataProto.set_exists(true);
+                    routeDataProto.set_weight(route->getWeight());
+                    if (route->begin() != route->end())
+                    {
+                        routeDataProto.set_has_prev_edge(true);
+                        routeDataProto.set_prev_edge(*route->begin());
+                    }
+                }
+            }
+        }
+    }
+
+    const auto parseRoutes = [&graph](const string& data, size_t threadCount) {
+        GraphProto::Router parsedProto;
+        ASSERT_WITH_MESSAGE(parsedProto.ParseFromString(data), "can't parse the routes");
+        Router::deserialize(parsedProto, graph, threadCount);
+    };
+    const string perCellData = perCellProto.SerializeAsString();
+    cerr << "routes matrix per cell: " << perCellData.size() << " bytes serialized" << endl;
+    {
+        LOG_DURATION("routes matrix per cell, parsed and read " + to_string(RepeatCount) +
+                     " times");
+        for (size_t repeatIndex = 0; repeatIndex < RepeatCount; ++repeatIndex)
+        {
+            parseRoutes(perCellData, 1);
+        }
+    }
+
+    const string shardedData = shardedProto.SerializeAsString();
+    cerr << "routes matrix sharded: " << shardedData.size() << " bytes serialized" << endl;
+    for (const size_t threadCount : {size_t{1}, getHardwareThreadCount()})
+    {
+        const string threads = to_string(threadCount) + " threads";
+        {
+            LOG_DURATION("routes matrix sharded, encoded " + to_string(RepeatCount) +
+                         " times on " + threads);
+            for (size_t repeatIndex = 0; repeatIndex < RepeatCount; ++repeatIndex)
+            {
+                GraphProto::Router proto;
+                router.serialize(proto, threadCount);
+                ASSERT_WITH_MESSAGE(proto.SerializeAsString() == shardedData,
+                                    "routes depend on the count of threads");
+            }
+        }
+        {
+            LOG_DURATION("routes matrix sharded, parsed and read " + to_string(RepeatCount) +
+                         " times on " + threads);
+            for (size_t repeatIndex = 0; repeatIndex < RepeatCount; ++repeatIndex)
+            {
+                parseRoutes(shardedData, threadCount);
+            }
+        }
+    }
+}
+
+// Precalculation of all the routes and searches of random routes by Dijkstra's algorithm in the
+// graph as it is and with the vertexes in reverse Cuthill-McKee order. The average distance between
+// the ids of the ends of the edges shows how close the neighbours are
+void benchmarkVertexOrder(const string& name, const RoutesGraph& graph)
+{
+    constexpr size_t RouteCount = 2000;
+
+    auto reorderedGraph = graph;
+    const auto newVertexIds = Graph::findReverseCuthillMcKeeOrder(graph);
+    reorderedGraph.renumberVertexes(newVertexIds);
+    reorderedGraph.freeze();
+
+    const auto getMeanEdgeSpan = [](const RoutesGraph& anyGraph) {
+        double spanSum = 0;
+        for (Graph::EdgeId edgeId = 0; edgeId < anyGraph.getEdgeCount(); ++edgeId)
+        {
+            const auto& edge = anyGraph.getEdge(edgeId);
+            spanSum += abs(static_cast<double>(edge.from) - static_cast<double>(edge.to));
+        }
+        return anyGraph.getEdgeCount() > 0
+                   ? spanSum / static_cast<double>(anyGraph.getEdgeCount())
+                   : 0;
+    };
+
+    const auto run = [&name, &newVertexIds](const string& orderName,
+                                            const RoutesGraph& anyGraph,
+                                            bool isReordered,
+                                            double meanEdgeSpan) {
+        cerr << name << ", " << orderName << " order: " << meanEdgeSpan << " mean edge span"
+             << endl;
+        {
+            LOG_DURATION(name + ", " + orderName + " order, all pairs precalculation");
+            Graph::Router<double> router(anyGraph);
+        }
+
+        Graph::DijkstraRouter<double> router(anyGraph, 1);
+        mt19937 generator(42);
+        uniform_int_distribution<Graph::VertexId> vertexDistribution(
+            0, anyGraph.getVertexCount() - 1);
+        LOG_DURATION(name + ", " + orderName + " order, " + to_string(RouteCount) +
+                     " Dijkstra routes");
+        for (size_t routeIndex = 0; routeIndex < RouteCount; ++routeIndex)
+        {
+            Graph::VertexId from = vertexDistribution(generator);
+            Graph::VertexId to = vertexDistribution(generator);
+            if (isReordered)
+            {
+                from = newVertexIds[from];
+                to = newVertexIds[to];
+            }
+            if (const auto route = router.buildRoute(from, to))
+            {
+                router.releaseRoute(route->id);
+            }
+        }
+    };
+    run("given", graph, false, getMeanEdgeSpan(graph));
+    run("Cuthill-McKee", reorderedGraph, true, getMeanEdgeSpan(reorderedGraph));
+}
+
+// Time to parse the base message with all its parts on the heap and on an arena, and to load the
+// catalog, which takes the arena for the routes of the encoding version 0 only
+void benchmarkBaseLoading(const Json::Map& makeBaseInput)
+{
+    constexpr size_t RepeatCount = 20;
+
+    const auto fileName = (filesystem::temp_directory_path() / "benchmarkBase.bin").string();
+    TransportCatalog(BaseRequests::parseRequests(makeBaseInput.at("base_requests").asArray()),
+                     makeBaseInput.at("routing_settings").asMap())
+        .save(fileName);
+    const MappedFile file(fileName);
+    cerr << "base: " << file.getSize() << " bytes" << endl;
+
+    const auto parse = [&file](TCProto::TransportCatalog& proto) {
+        ASSERT_WITH_MESSAGE(proto.ParseFromArray(file.getData(), static_cast<int>(file.getSize())),
+                            "can't parse the base");
+    };
+    {
+        LOG_DURATION("base parsed on the heap " + to_string(RepeatCount) + " times");
+        for (size_t repeatIndex = 0; repeatIndex < RepeatCount; ++repeatIndex)
+        {
+            TCProto::TransportCatalog proto;
+            parse(proto);
+        }
+    }
+    {
+        LOG_DURATION("base parsed on an arena " + to_string(RepeatCount) + " times");
+        for (size_t repeatIndex = 0; repeatIndex < RepeatCount; ++repeatIndex)
+        {
+            google::protobuf::ArenaOptions options;
+            options.start_block_size = max(options.start_block_size, file.getSize());
+            options.max_block_size = max(options.max_block_size, options.start_block_size);
+            google::protobuf::Arena arena(options);
+            parse(*google::protobuf::Arena::CreateMessage<TCProto::TransportCatalog>(&arena));
+        }
+    }
+    {
+        LOG_DURATION("base loaded " + to_string(RepeatCount) + " times");
+        for (size_t repeatIndex = 0; repeatIndex < RepeatCount; ++repeatIndex)
+        {
+            TransportCatalog::load(fileName);
+        }
+    }
+    filesystem::remove(fileName);
+}
+
+// Time and heap memory it takes to read every section of the mapped base, when a bus, a stop and a
+// route are requested one after another
+void benchmarkLazyLoading(const Json::Map& makeBaseInput)
+{
+    const auto requests = BaseRequests::parseRequests(makeBaseInput.at("base_requests").asArray());
+    ASSERT_WITH_MESSAGE(!requests.buses.empty() && !requests.buses.front().stops.empty(),
+                        "the base has no buses");
+    const auto& bus = requests.buses.front();
+
+    const auto fileName = (filesystem::temp_directory_path() / "benchmarkMappedBase.bin").string();
+    TransportCatalog(requests, makeBaseInput.at("routing_settings").asMap()).saveMapped(fileName);
+    const auto catalog = TransportCatalog::load(fileName);
+    filesystem::remove(fileName);
+
+    // Every section is printed once after the request which made it read
+    vector<bool> arePrinted(catalog.getSectionStats().size());
+    const auto printStats = [&catalog, &arePrinted](const string& stage) {
+        const auto sectionStats = catalog.getSectionStats();
+        for (size_t index = 0; index < sectionStats.size(); ++index)
+        {
+            const auto& stats = sectionStats[index];
+            if (stats.isLoaded && !arePrinted[index])
+            {
+                arePrinted[index] = true;
+                cerr << "mapped base, " << stats.name << " section read on " << stage << ": "
+                     << stats.fileSize << " bytes in the file, "
+                     << chrono::duration_cast<chrono::microseconds>(stats.loadTime).count()
+                     << " us, " << stats.heapSize << " bytes of the heap" << endl;
+            }
+        }
+    };
+    printStats("load");
+    catalog.getBus(bus.name);
+    printStats("bus request");
+    catalog.getStop(bus.stops.front());
+    printStats("stop request");
+    catalog.findRoute(bus.stops.front(), bus.stops.back());
+    printStats("route request");
+}
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    if (argc != 2)
+    {
+        cerr << WrongParametrsMsg;
+        return 5;
+    }
+
+    ifstream input(argv[1]);
+    ASSERT_WITH_MESSAGE(input, "can't open the file "s + argv[1]);
+    const auto inputJsonTree = Json::load(input);
+    benchmarkBaseLoading(inputJsonTree.getRoot().asMap());
+    benchmarkLazyLoading(inputJsonTree.getRoot().asMap());
+    const auto catalogProto = makeCatalogProto(inputJsonTree.getRoot().asMap());
+    const auto graph = RoutesGraph::deserialize(catalogProto.router().graph());
+    cerr << "graph: " << graph.getVertexCount() << " vertexes, " << graph.getEdgeCount()
+         << " edges, " << catalogProto.router().dropped_edge_count() << " parallel edges dropped"
+         << endl;
+
+    const auto scalarRoutes = benchmarkKernel(Graph::MinPlus::Kernel::Scalar, graph);
+
+    const auto bestKernel = Graph::MinPlus::getBestSupportedKernel();
+    if (bestKernel != Graph::MinPlus::Kernel::Scalar)
+    {
+        const auto routes = benchmarkKernel(bestKernel, graph);
+        ASSERT_WITH_MESSAGE(areEqual(routes, scalarRoutes),
+                            Graph::MinPlus::getKernelName(bestKernel)
+                                << " kernel result differs from the scalar one");
+    }
+
+    benchmarkPointToPointRouters(graph, catalogProto.router().a_star_router());
+    benchmarkRouterUpdates(graph);
+    benchmarkNarrowerWeights<double>("double", graph);
+    benchmarkNarrowerWeights<float>("float", graph);
+    benchmarkNarrowerWeights<Graph::FixedPointWeight>("fixed-point", graph);
+    benchmarkHubLabeling(graph);
+    benchmarkFirstHops(graph);
+    benchmarkRouterEncoding(graph);
+    benchmarkVertexOrder("catalog graph", graph);
+    benchmarkVertexOrder("shuffled grid", makeShuffledGridGraph(40));
+
+    return 0;
+}
@@ -0,0 +1,508 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+#include "sphere.h"
+#include "utils.h"
+
+#include "graph.pb.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+namespace Graph
+{
+// Router which searches every route on demand, guided by the great-circle distance to the target.
+// Every vertex has a point on the Earth. Weight of any edge is at least the distance between its
+// ends multiplied by the least such ratio over the graph, so the distance multiplied by it is
+// a consistent lower bound of the route weight. The bidirectional search runs from both ends with
+// the average of the two bounds, it settles the least vertexes on long routes
+template <typename Weight>
+class AStarRouter
+{
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+    using ExpandedRoute = std::vector<EdgeId>;
+
+    static constexpr Weight NoRoute = std::numeric_limits<Weight>::infinity();
+
+    // The least ratio of edge weight to distance is decreased by that part, so rounding errors of
+    // the distances can't make the bound exceed the real weight
+    static constexpr double BoundMargin = 1e-9;
+
+    // State of one direction of the route search. The weights of the untouched vertexes are NoRoute,
+    // potentials are the bounds calculated when the vertex is touched
+    struct SearchSpace
+    {
+        std::vector<Weight> weights;
+        std::vector<Weight> potentials;
+        std::vector<CompactEdgeId> prevEdges;
+        std::vector<bool> isSettled;
+        std::vector<VertexId> touchedVertexes;
+    };
+
+    using QueueItem = std::pair<Weight, VertexId>;
+    using Queue = std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>>;
+
+public:
+    using RouteId = uint64_t;
+    using RouteInfo = typename Router<Weight>::RouteInfo;
+
+    AStarRouter(const Graph& graph, std::vector<Sphere::Point> vertexPoints, bool isBidirectional);
+
+    void serialize(GraphProto::AStarRouter& proto) const;
+    static std::unique_ptr<AStarRouter> deserialize(const GraphProto::AStarRouter& proto,
+                                                    const Graph& graph);
+
+    std::optional<RouteInfo> buildRoute(VertexId from, VertexId to) const;
+    // Weights of the routes from every source to every target row by row, infinity where there is
+    // no route. A bound to several targets is weak, so every source is searched by plain Dijkstra's
+    // algorithm until all the targets are settled
+    std::vector<Weight> findRouteWeights(const std::vector<VertexId>& sources,
+                                         const std::vector<VertexId>& targets) const;
+    EdgeId getRouteEdge(RouteId routeId, size_t edgeIndex) const;
+    void releaseRoute(RouteId routeId);
+
+    // Count of the vertexes settled by the latest route search or all the searches of the latest
+    // findRouteWeights
+    size_t getSettledVertexCount() const;
+
+private:
+    void initialize();
+
+    Weight estimateWeight(VertexId from, VertexId to) const;
+    // The potential is calculated only when the vertex is touched for the first time
+    template <typename GetPotential>
+    void touchVertex(SearchSpace& searchSpace,
+                     VertexId vertex,
+                     const GetPotential& getPotential) const;
+    static void resetSearchSpace(SearchSpace& searchSpace);
+
+    std::optional<Weight> searchForward(VertexId from, VertexId to, ExpandedRoute& edges) const;
+    std::optional<Weight> searchBidirectional(VertexId from, VertexId to, ExpandedRoute& edges) const;
+
+private:
+    const Graph& graph_;
+    std::vector<Sphere::Point> vertexPoints_;
+    bool isBidirectional_ = false;
+    double weightPerDistance_ = 0;
+
+    // Edges coming into the vertex v are inEdges_[inOffsets_[v]] ... inEdges_[inOffsets_[v + 1] - 1]
+    std::vector<size_t> inOffsets_;
+    std::vector<EdgeId> inEdges_;
+
+    mutable SearchSpace forwardSearchSpace_;
+    mutable SearchSpace backwardSearchSpace_;
+    mutable size_t settledVertexCount_ = 0;
+
+    mutable RouteId nextRouteId_ = 0;
+    mutable std::unordered_map<RouteId, ExpandedRoute> expandedRoutesCache_;
+};
+
+template <typename Weight>
+AStarRouter<Weight>::AStarRouter(const Graph& graph,
+                                 std::vector<Sphere::Point> vertexPoints,
+                                 bool isBidirectional)
+    : graph_(graph)
+    , vertexPoints_(std::move(vertexPoints))
+    , isBidirectional_(isBidirectional)
+{
+    initialize();
+}
+
+template <typename Weight>
+void AStarRouter<Weight>::initialize()
+{
+    const size_t vertexCount = graph_.getVertexCount();
+    ASSERT_WITH_MESSAGE(vertexPoints_.size() == vertexCount,
+                        "every vertex has to have a point for the router");
+    ASSERT_WITH_MESSAGE(graph_.isFrozen(), "The graph has to be frozen for the router");
+    ASSERT_WITH_MESSAGE(graph_.getEdgeCount() < NoEdge, "Too many edges for the router");
+
+    // Edges between vertexes at the same point don't limit the ratio
+    std::optional<double> leastWeightPerDistance;
+    for (EdgeId edgeId = 0; edgeId < graph_.getEdgeCount(); ++edgeId)
+    {
+        const auto& edge = graph_.getEdge(edgeId);
+        ASSERT_WITH_MESSAGE(edge.weight >= 0,
+                            "Router works only with edges with non-negative weight");
+        const double distance = Sphere::distance(vertexPoints_[edge.from], vertexPoints_[edge.to]);
+        if (distance > 0)
+        {
+            const double weightPerDistance = static_cast<double>(edge.weight) / distance;
+            leastWeightPerDistance = std::min(leastWeightPerDistance.value_or(weightPerDistance),
+                                              weightPerDistance);
+        }
+    }
+    weightPerDistance_ = leastWeightPerDistance.value_or(0) * (1 - BoundMargin);
+
+    if (isBidirectional_)
+    {
+        inOffsets_.assign(vertexCount + 1, 0);
+        for (EdgeId edgeId = 0; edgeId < graph_.getEdgeCount(); ++edgeId)
+        {
+            inOffsets_[graph_.getEdge(edgeId).to + 1]++;
+        }
+        for (VertexId vertex = 0; vertex < vertexCount; ++vertex)
+        {
+            inOffsets_[vertex + 1] += inOffsets_[vertex];
+        }
+        inEdges_.resize(graph_.getEdgeCount());
+        auto nextIndexes = inOffsets_;
+        for (EdgeId edgeId = 0; edgeId < graph_.getEdgeCount(); ++edgeId)
+        {
+            inEdges_[nextIndexes[graph_.getEdge(edgeId).to]++] = edgeId;
+        }
+    }
+
+    for (auto* searchSpace : {&forwardSearchSpace_, &backwardSearchSpace_})
+    {
+        searchSpace->weights.assign(vertexCount, NoRoute);
+        searchSpace->potentials.assign(vertexCount, 0);
+        searchSpace->prevEdges.assign(vertexCount, NoEdge);
+        searchSpace->isSettled.assign(vertexCount, false);
+        searchSpace->touchedVertexes.clear();
+    }
+}
+
+template <typename Weight>
+Weight AStarRouter<Weight>::estimateWeight(VertexId from, VertexId to) const
+{
+    const double distance = Sphere::distance(vertexPoints_[from], vertexPoints_[to]);
+    // Rounding may take the cosine of a zero distance out of its range
+    return std::isnan(distance) ? 0 : static_cast<Weight>(distance * weightPerDistance_);
+}
+
+template <typename Weight>
+template <typename GetPotential>
+void AStarRouter<Weight>::touchVertex(SearchSpace& searchSpace,
+                                      VertexId vertex,
+                                      const GetPotential& getPotential) const
+{
+    if (!(searchSpace.weights[vertex] < NoRoute))
+    {
+        searchSpace.touchedVertexes.push_back(vertex);
+        searchSpace.potentials[vertex] = getPotential(vertex);
+    }
+}
+
+template <typename Weight>
+void AStarRouter<Weight>::resetSearchSpace(SearchSpace& searchSpace)
+{
+    for (const VertexId vertex : searchSpace.touchedVertexes)
+    {
+        searchSpace.weights[vertex] = NoRoute;
+        searchSpace.prevEdges[vertex] = NoEdge;
+        searchSpace.isSettled[vertex] = false;
+    }
+    searchSpace.touchedVertexes.clear();
+}
+
+template <typename Weight>
+std::optional<Weight> AStarRouter<Weight>::searchForward(VertexId from,
+                                                         VertexId to,
+                                                         ExpandedRoute& edges) const
+{
+    const auto getPotential = [this, to](VertexId vertex) { return estimateWeight(vertex, to); };
+
+    auto& searchSpace = forwardSearchSpace_;
+    Queue queue;
+    touchVertex(searchSpace, from, getPotential);
+    searchSpace.weights[from] = 0;
+    queue.push({searchSpace.potentials[from], from});
+    while (!queue.empty())
+    {
+        const VertexId vertex = queue.top().second;
+        queue.pop();
+        if (searchSpace.isSettled[vertex])
+        {
+            continue;
+        }
+        searchSpace.isSettled[vertex] = true;
+        ++settledVertexCount_;
+        if (vertex == to)
+        {
+            break;
+        }
+
+        for (const auto& edge : graph_.getEdgesWhichStartFrom(vertex))
+        {
+            const Weight candidateWeight = searchSpace.weights[vertex] + edge.weight;
+            if (candidateWeight < searchSpace.weights[edge.to])
+            {
+                touchVertex(searchSpace, edge.to, getPotential);
+                searchSpace.weights[edge.to] = candidateWeight;
+                searchSpace.prevEdges[edge.to] = static_cast<CompactEdgeId>(edge.id);
+                queue.push({candidateWeight + searchSpace.potentials[edge.to], edge.to});
+            }
+        }
+    }
+
+    const Weight weight = searchSpace.weights[to];
+    if (!(weight < NoRoute))
+    {
+        return std::nullopt;
+    }
+    for (CompactEdgeId edgeId = searchSpace.prevEdges[to]; edgeId != NoEdge;
+         edgeId = searchSpace.prevEdges[graph_.getEdge(edgeId).from])
+    {
+        edges.push_back(edgeId);
+    }
+    std::reverse(std::begin(edges), std::end(edges));
+    return weight;
+}
+
+// The forward search goes with the potential (bound to the target - bound from the source) / 2,
+// the backward one with the opposite potential, so the reduced weights of the edges are the same for
+// both of them. The search stops when the sum of the least keys of both queues reaches the weight of
+// the best route found
+template <typename Weight>
+std::optional<Weight> AStarRouter<Weight>::searchBidirectional(VertexId from,
+                                                               VertexId to,
+                                                               ExpandedRoute& edges) const
+{
+    const auto getForwardPotential = [this, from, to](VertexId vertex) {
+        return (estimateWeight(vertex, to) - estimateWeight(from, vertex)) / 2;
+    };
+    const auto getBackwardPotential = [&getForwardPotential](VertexId vertex) {
+        return -getForwardPotential(vertex);
+    };
+
+    auto& forward = forwardSearchSpace_;
+    auto& backward = backwardSearchSpace_;
+    Queue forwardQueue;
+    Queue backwardQueue;
+    touchVertex(forward, from, getForwardPotential);
+    forward.weights[from] = 0;
+    forwardQueue.push({forward.potentials[from], from});
+    touchVertex(backward, to, getBackwardPotential);
+    backward.weights[to] = 0;
+    backwardQueue.push({backward.potentials[to], to});
+
+    Weight bestWeight = NoRoute;
+    VertexId meetingVertex = from;
+    while (true)
+    {
+        const Weight forwardKey = forwardQueue.empty() ? NoRoute : forwardQueue.top().first;
+        const Weight backwardKey = backwardQueue.empty() ? NoRoute : backwardQueue.top().first;
+        if (!(forwardKey + backwardKey < bestWeight))
+        {
+            break;
+        }
+
+        const bool isForward = !(backwardKey < forwardKey);
+        auto& queue = isForward ? forwardQueue : backwardQueue;
+        auto& searchSpace = isForward ? forward : backward;
+        const auto& otherSearchSpace = isForward ? backward : forward;
+
+        const VertexId vertex = queue.top().second;
+        queue.pop();
+        if (searchSpace.isSettled[vertex])
+        {
+            continue;
+        }
+        searchSpace.isSettled[vertex] = true;
+        ++settledVertexCount_;
+
+        const auto relax = [&](EdgeId edgeId, VertexId next) {
+            const Weight candidateWeight =
+                searchSpace.weights[vertex] + graph_.getEdge(edgeId).weight;
+            if (!(candidateWeight < searchSpace.weights[next]))
+            {
+                return;
+            }
+            if (isForward)
+            {
+                touchVertex(searchSpace, next, getForwardPotential);
+            }
+            else
+            {
+                touchVertex(searchSpace, next, getBackwardPotential);
+            }
+            searchSpace.weights[next] = candidateWeight;
+            searchSpace.prevEdges[next] = static_cast<CompactEdgeId>(edgeId);
+            queue.push({candidateWeight + searchSpace.potentials[next], next});
+
+            if (const Weight weight = candidateWeight + otherSearchSpace.weights[next];
+                weight < bestWeight)
+            {
+                bestWeight = weight;
+                meetingVertex = next;
+            }
+        };
+
+        if (isForward)
+        {
+            for (const auto& edge : graph_.getEdgesWhichStartFrom(vertex))
+            {
+                relax(edge.id, edge.to);
+            }
+        }
+        else
+        {
+            for (size_t index = inOffsets_[vertex]; index < inOffsets_[vertex + 1]; ++index)
+            {
+                relax(inEdges_[index], graph_.getEdge(inEdges_[index]).from);
+            }
+        }
+    }
+
+    if (!(bestWeight < NoRoute))
+    {
+        return std::nullopt;
+    }
+
+    for (CompactEdgeId edgeId = forward.prevEdges[meetingVertex]; edgeId != NoEdge;
+         edgeId = forward.prevEdges[graph_.getEdge(edgeId).from])
+    {
+        edges.push_back(edgeId);
+    }
+    std::reverse(std::begin(edges), std::end(edges));
+    for (CompactEdgeId edgeId = backward.prevEdges[meetingVertex]; edgeId != NoEdge;
+         edgeId = backward.prevEdges[graph_.getEdge(edgeId).to])
+    {
+        edges.push_back(edgeId);
+    }
+    return bestWeight;
+}
+
+template <typename Weight>
+std::optional<typename AStarRouter<Weight>::RouteInfo> AStarRouter<Weight>::buildRoute(
+    VertexId from, VertexId to) const
+{
+    settledVertexCount_ = 0;
+    std::vector<EdgeId> edges;
+    const auto weight = from == to         ? std::optional<Weight>(0)
+                        : isBidirectional_ ? searchBidirectional(from, to, edges)
+                                           : searchForward(from, to, edges);
+    resetSearchSpace(forwardSearchSpace_);
+    resetSearchSpace(backwardSearchSpace_);
+    if (!weight)
+    {
+        return std::nullopt;
+    }
+
+    const RouteId routeId = nextRouteId_++;
+    const size_t routeEdgeCount = edges.size();
+
+    expandedRoutesCache_[routeId] = std::move(edges);
+
+    return RouteInfo{routeId, *weight, routeEdgeCount};
+}
+
+template <typename Weight>
+std::vector<Weight> AStarRouter<Weight>::findRouteWeights(
+    const std::vector<VertexId>& sources, const std::vector<VertexId>& targets) const
+{
+    const auto getZeroPotential = [](VertexId) { return Weight(0); };
+
+    std::vector<bool> isTarget(graph_.getVertexCount(), false);
+    for (const VertexId to : targets)
+    {
+        isTarget[to] = true;
+    }
+    const auto targetCount =
+        static_cast<size_t>(std::count(isTarget.begin(), isTarget.end(), true));
+
+    settledVertexCount_ = 0;
+    std::vector<Weight> weights;
+    weights.reserve(sources.size() * targets.size());
+    auto& searchSpace = forwardSearchSpace_;
+    for (const VertexId from : sources)
+    {
+        Queue queue;
+        touchVertex(searchSpace, from, getZeroPotential);
+        searchSpace.weights[from] = 0;
+        queue.push({0, from});
+        size_t settledTargetCount = 0;
+        while (!queue.empty() && settledTargetCount < targetCount)
+        {
+            const VertexId vertex = queue.top().second;
+            queue.pop();
+            if (searchSpace.isSettled[vertex])
+            {
+                continue;
+            }
+            searchSpace.isSettled[vertex] = true;
+            ++settledVertexCount_;
+            if (isTarget[vertex])
+            {
+                ++settledTargetCount;
+            }
+
+            for (const auto& edge : graph_.getEdgesWhichStartFrom(vertex))
+            {
+                const Weight candidateWeight = searchSpace.weights[vertex] + edge.weight;
+                if (candidateWeight < searchSpace.weights[edge.to])
+                {
+                    touchVertex(searchSpace, edge.to, getZeroPotential);
+                    searchSpace.weights[edge.to] = candidateWeight;
+                    searchSpace.prevEdges[edge.to] = static_cast<CompactEdgeId>(edge.id);
+                    queue.push({candidateWeight, edge.to});
+                }
+            }
+        }
+
+        for (const VertexId to : targets)
+        {
+            weights.push_back(searchSpace.weights[to]);
+        }
+        resetSearchSpace(searchSpace);
+    }
+    return weights;
+}
+
+template <typename Weight>
+EdgeId AStarRouter<Weight>::getRouteEdge(RouteId routeId, size_t edgeIndex) const
+{
+    return expandedRoutesCache_.at(routeId)[edgeIndex];
+}
+
+template <typename Weight>
+void AStarRouter<Weight>::releaseRoute(RouteId routeId)
+{
+    expandedRoutesCache_.erase(routeId);
+}
+
+template <typename Weight>
+size_t AStarRouter<Weight>::getSettledVertexCount() const
+{
+    return settledVertexCount_;
+}
+
+template <typename Weight>
+void AStarRouter<Weight>::serialize(GraphProto::AStarRouter& proto) const
+{
+    proto.set_is_bidirectional(isBidirectional_);
+    proto.mutable_latitudes()->Reserve(static_cast<int>(vertexPoints_.size()));
+    proto.mutable_longitudes()->Reserve(static_cast<int>(vertexPoints_.size()));
+    for (const auto& point : vertexPoints_)
+    {
+        proto.add_latitudes(point.latitude);
+        proto.add_longitudes(point.longitude);
+    }
+}
+
+template <typename Weight>
+std::unique_ptr<AStarRouter<Weight>> AStarRouter<Weight>::deserialize(
+    const GraphProto::AStarRouter& proto, const Graph& graph)
+{
+    ASSERT_WITH_MESSAGE(proto.latitudes_size() == proto.longitudes_size(),
+                        "wrong points of the vertexes");
+    std::vector<Sphere::Point> vertexPoints;
+    vertexPoints.reserve(static_cast<size_t>(proto.latitudes_size()));
+    for (int index = 0; index < proto.latitudes_size(); ++index)
+    {
+        vertexPoints.push_back({proto.latitudes(index), proto.longitudes(index)});
+    }
+    return std::make_unique<AStarRouter>(graph, std::move(vertexPoints), proto.is_bidirectional());
+}
+
+} // namespace Graph
@@ -0,0 +1,595 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+#include "utils.h"
+
+#include "graph.pb.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+namespace Graph
+{
+// Router based on contraction hierarchies. Vertexes are contracted one by one in the order of their
+// ids, the same order Router relaxes the routes through them in, and shortcuts keep the routes
+// through the contracted vertexes. A route is searched from both of its ends going only to the
+// vertexes of greater ids, its last edge is unpacked from the shortcuts where the searches meet,
+// and the rest of it is the route to the start of that edge, the way Router keeps its routes. The
+// weights are summed and the routes of equal weight are chosen the same way as Router does, so the
+// routes are the same as its ones. The order of the vertexes decides how many shortcuts there are,
+// a vertex order which keeps the neighbours close makes less of them
+template <typename Weight>
+class ContractionHierarchyRouter
+{
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+    using ExpandedRoute = std::vector<EdgeId>;
+    // Arcs with ids less than the edge count of the graph are its edges, the others are shortcuts
+    using ArcId = size_t;
+
+    static constexpr Weight NoRoute = std::numeric_limits<Weight>::infinity();
+    static constexpr ArcId NoArc = std::numeric_limits<ArcId>::max();
+
+    // Route from arc.from to arc.to which goes through the first and then the second arc
+    struct Shortcut
+    {
+        Edge<Weight> arc;
+        ArcId firstArc;
+        ArcId secondArc;
+    };
+
+    // Arcs of the vertex v are arcIds[offsets[v]] ... arcIds[offsets[v + 1] - 1]
+    struct UpwardGraph
+    {
+        std::vector<size_t> offsets;
+        std::vector<ArcId> arcIds;
+    };
+
+    // State of one direction of the route search. The weights of the untouched vertexes are NoRoute
+    struct SearchSpace
+    {
+        std::vector<Weight> weights;
+        std::vector<ArcId> prevArcs;
+        std::vector<VertexId> touchedVertexes;
+    };
+
+    class Contraction;
+
+public:
+    using RouteId = uint64_t;
+    using RouteInfo = typename Router<Weight>::RouteInfo;
+
+    explicit ContractionHierarchyRouter(const Graph& graph);
+
+    void serialize(GraphProto::ContractionHierarchyRouter& proto) const;
+    static std::unique_ptr<ContractionHierarchyRouter> deserialize(
+        const GraphProto::ContractionHierarchyRouter& proto, const Graph& graph);
+
+    std::optional<RouteInfo> buildRoute(VertexId from, VertexId to) const;
+    // Weights of the routes from every source to every target row by row, infinity where there is
+    // no route. Every target is searched upward once, the vertexes it reaches keep its weight in
+    // their buckets. Then every source is searched upward once, and the routes meet in the buckets
+    std::vector<Weight> findRouteWeights(const std::vector<VertexId>& sources,
+                                         const std::vector<VertexId>& targets) const;
+    EdgeId getRouteEdge(RouteId routeId, size_t edgeIndex) const;
+    void releaseRoute(RouteId routeId);
+
+    size_t getShortcutCount() const;
+
+private:
+    ContractionHierarchyRouter(const Graph& graph,
+                               const GraphProto::ContractionHierarchyRouter& proto);
+
+    const Edge<Weight>& getArc(ArcId arcId) const;
+    void buildUpwardGraphs(const std::vector<std::vector<ArcId>>& outArcIds,
+                           const std::vector<std::vector<ArcId>>& inArcIds);
+
+    static void resetSearchSpace(SearchSpace& searchSpace);
+    // Vertex where the upward searches from both ends of the route meet, after the search from its
+    // start is done
+    std::optional<VertexId> findMeetingVertex(VertexId from, VertexId to) const;
+    // Settles all the vertexes which can be reached from the vertex in the upward graph
+    void searchUpward(const UpwardGraph& upwardGraph,
+                      VertexId Edge<Weight>::*arcEnd,
+                      VertexId from,
+                      SearchSpace& searchSpace) const;
+
+    // Arcs of the route found by the search between its start and the vertex, in the route order
+    std::vector<ArcId> getSearchRoute(const SearchSpace& searchSpace,
+                                      bool isForward,
+                                      VertexId vertex) const;
+
+private:
+    const Graph& graph_;
+    std::vector<Shortcut> shortcuts_;
+
+    // Arcs going out of a vertex and coming into it from the more important vertexes
+    UpwardGraph forwardGraph_;
+    UpwardGraph backwardGraph_;
+
+    mutable SearchSpace forwardSearchSpace_;
+    mutable SearchSpace backwardSearchSpace_;
+
+    mutable RouteId nextRouteId_ = 0;
+    mutable std::unordered_map<RouteId, ExpandedRoute> expandedRoutesCache_;
+};
+
+// Graph of the not yet contracted vertexes, it has one arc at most from a vertex to another one.
+// Its arc from u to w after the vertexes before v are contracted is the route from u to w through
+// those vertexes which Router has after relaxing the routes through them: a new arc takes the place
+// of the existing one only if it's lighter, the edge of the least id is kept among the edges
+template <typename Weight>
+class ContractionHierarchyRouter<Weight>::Contraction
+{
+public:
+    explicit Contraction(ContractionHierarchyRouter& router);
+
+    // Contracts all the vertexes, fills arcs to the more important vertexes of every vertex
+    void run(std::vector<std::vector<ArcId>>& outArcIds, std::vector<std::vector<ArcId>>& inArcIds);
+
+private:
+    using Neighbours = std::unordered_map<VertexId, ArcId>;
+
+    bool isLighterThanExistingArc(const Edge<Weight>& arc) const;
+    void addArc(ArcId arcId);
+    void contract(VertexId vertex,
+                  std::vector<ArcId>& vertexOutArcIds,
+                  std::vector<ArcId>& vertexInArcIds);
+
+private:
+    ContractionHierarchyRouter& router_;
+
+    std::vector<Neighbours> outNeighbours_;
+    std::vector<Neighbours> inNeighbours_;
+};
+
+template <typename Weight>
+ContractionHierarchyRouter<Weight>::Contraction::Contraction(ContractionHierarchyRouter& router)
+    : router_(router)
+    , outNeighbours_(router.graph_.getVertexCount())
+    , inNeighbours_(router.graph_.getVertexCount())
+{
+    for (EdgeId edgeId = 0; edgeId < router.graph_.getEdgeCount(); ++edgeId)
+    {
+        const auto& edge = router.graph_.getEdge(edgeId);
+        ASSERT_WITH_MESSAGE(edge.weight >= 0,
+                            "Router works only with edges with non-negative weight");
+        // Loops are never a part of the shortest routes
+        if (edge.from != edge.to && isLighterThanExistingArc(edge))
+        {
+            addArc(edgeId);
+        }
+    }
+}
+
+template <typename Weight>
+void ContractionHierarchyRouter<Weight>::Contraction::run(
+    std::vector<std::vector<ArcId>>& outArcIds, std::vector<std::vector<ArcId>>& inArcIds)
+{
+    const size_t vertexCount = router_.graph_.getVertexCount();
+    outArcIds.assign(vertexCount, {});
+    inArcIds.assign(vertexCount, {});
+    for (VertexId vertex = 0; vertex < vertexCount; ++vertex)
+    {
+        contract(vertex, outArcIds[vertex], inArcIds[vertex]);
+    }
+}
+
+template <typename Weight>
+bool ContractionHierarchyRouter<Weight>::Contraction::isLighterThanExistingArc(
+    const Edge<Weight>& arc) const
+{
+    const auto it = outNeighbours_[arc.from].find(arc.to);
+    return it == outNeighbours_[arc.from].end() || arc.weight < router_.getArc(it->second).weight;
+}
+
+template <typename Weight>
+void ContractionHierarchyRouter<Weight>::Contraction::addArc(ArcId arcId)
+{
+    const auto& arc = router_.getArc(arcId);
+    outNeighbours_[arc.from][arc.to] = arcId;
+    inNeighbours_[arc.to][arc.from] = arcId;
+}
+
+// Every route through the vertex between its neighbours which is lighter than the arc between them
+// becomes a shortcut, the same way as Router relaxes the routes through the vertex
+template <typename Weight>
+void ContractionHierarchyRouter<Weight>::Contraction::contract(VertexId vertex,
+                                                               std::vector<ArcId>& vertexOutArcIds,
+                                                               std::vector<ArcId>& vertexInArcIds)
+{
+    // All the neighbours are more important than the vertex, so its arcs go to the upward graphs
+    for (const auto& [to, arcId] : outNeighbours_[vertex])
+    {
+        vertexOutArcIds.push_back(arcId);
+        inNeighbours_[to].erase(vertex);
+    }
+    for (const auto& [from, arcId] : inNeighbours_[vertex])
+    {
+        vertexInArcIds.push_back(arcId);
+        outNeighbours_[from].erase(vertex);
+    }
+    // Hash map order is not specified, the order of arcs makes the shortcuts reproducible
+    std::sort(std::begin(vertexOutArcIds), std::end(vertexOutArcIds));
+    std::sort(std::begin(vertexInArcIds), std::end(vertexInArcIds));
+    outNeighbours_[vertex].clear();
+    inNeighbours_[vertex].clear();
+
+    for (const ArcId firstArcId : vertexInArcIds)
+    {
+        for (const ArcId secondArcId : vertexOutArcIds)
+        {
+            const auto& firstArc = router_.getArc(firstArcId);
+            const auto& secondArc = router_.getArc(secondArcId);
+            const Shortcut shortcut{
+                {firstArc.from, secondArc.to, firstArc.weight + secondArc.weight},
+                firstArcId,
+                secondArcId};
+            if (shortcut.arc.from != shortcut.arc.to && isLighterThanExistingArc(shortcut.arc))
+            {
+                router_.shortcuts_.push_back(shortcut);
+                addArc(router_.graph_.getEdgeCount() + router_.shortcuts_.size() - 1);
+            }
+        }
+    }
+}
+
+template <typename Weight>
+ContractionHierarchyRouter<Weight>::ContractionHierarchyRouter(const Graph& graph)
+    : graph_(graph)
+{
+    std::vector<std::vector<ArcId>> outArcIds;
+    std::vector<std::vector<ArcId>> inArcIds;
+    Contraction(*this).run(outArcIds, inArcIds);
+    buildUpwardGraphs(outArcIds, inArcIds);
+}
+
+template <typename Weight>
+void ContractionHierarchyRouter<Weight>::buildUpwardGraphs(
+    const std::vector<std::vector<ArcId>>& outArcIds,
+    const std::vector<std::vector<ArcId>>& inArcIds)
+{
+    const auto build = [](const std::vector<std::vector<ArcId>>& arcIds, UpwardGraph& upwardGraph) {
+        upwardGraph.offsets.assign(1, 0);
+        upwardGraph.arcIds.clear();
+        for (const auto& vertexArcIds : arcIds)
+        {
+            upwardGraph.arcIds.insert(
+                std::end(upwardGraph.arcIds), std::begin(vertexArcIds), std::end(vertexArcIds));
+            upwardGraph.offsets.push_back(upwardGraph.arcIds.size());
+        }
+    };
+    build(outArcIds, forwardGraph_);
+    build(inArcIds, backwardGraph_);
+
+    const size_t vertexCount = graph_.getVertexCount();
+    for (auto* searchSpace : {&forwardSearchSpace_, &backwardSearchSpace_})
+    {
+        searchSpace->weights.assign(vertexCount, NoRoute);
+        searchSpace->prevArcs.assign(vertexCount, NoArc);
+        searchSpace->touchedVertexes.clear();
+    }
+}
+
+template <typename Weight>
+const Edge<Weight>& ContractionHierarchyRouter<Weight>::getArc(ArcId arcId) const
+{
+    const size_t edgeCount = graph_.getEdgeCount();
+    return arcId < edgeCount ? graph_.getEdge(arcId) : shortcuts_[arcId - edgeCount].arc;
+}
+
+template <typename Weight>
+size_t ContractionHierarchyRouter<Weight>::getShortcutCount() const
+{
+    return shortcuts_.size();
+}
+
+template <typename Weight>
+void ContractionHierarchyRouter<Weight>::resetSearchSpace(SearchSpace& searchSpace)
+{
+    for (const VertexId vertex : searchSpace.touchedVertexes)
+    {
+        searchSpace.weights[vertex] = NoRoute;
+        searchSpace.prevArcs[vertex] = NoArc;
+    }
+    searchSpace.touchedVertexes.clear();
+}
+
+template <typename Weight>
+std::optional<typename ContractionHierarchyRouter<Weight>::RouteInfo> ContractionHierarchyRouter<
+    Weight>::buildRoute(VertexId from, VertexId to) const
+{
+    // Router keeps only the last edge of a route and takes the rest of it from the route to the
+    // start of that edge, so the route is unpacked from its end edge by edge the same way. Its
+    // weight is summed up over the edges from the end too, the same way as Router's route is
+    searchUpward(forwardGraph_, &Edge<Weight>::to, from, forwardSearchSpace_);
+    Weight routeWeight = 0;
+    ExpandedRoute edges;
+    for (VertexId vertex = to; vertex != from;)
+    {
+        const auto meetingVertex = findMeetingVertex(from, vertex);
+        if (!meetingVertex)
+        {
+            return std::nullopt;
+        }
+
+        ArcId lastArcId = *meetingVertex == vertex
+                              ? forwardSearchSpace_.prevArcs[vertex]
+                              : getSearchRoute(backwardSearchSpace_, false, *meetingVertex).back();
+        while (lastArcId >= graph_.getEdgeCount())
+        {
+            lastArcId = shortcuts_[lastArcId - graph_.getEdgeCount()].secondArc;
+        }
+        const auto& lastEdge = graph_.getEdge(lastArcId);
+        routeWeight += lastEdge.weight;
+        edges.push_back(lastArcId);
+        vertex = lastEdge.from;
+    }
+    std::reverse(std::begin(edges), std::end(edges));
+
+    const RouteId routeId = nextRouteId_++;
+    const size_t routeEdgeCount = edges.size();
+
+    expandedRoutesCache_[routeId] = std::move(edges);
+
+    return RouteInfo{routeId, routeWeight, routeEdgeCount};
+}
+
+// The route goes up from its ends to the most important vertex of it. Among the routes of equal
+// weight Router keeps the one it finds first relaxing the routes through the vertexes in the order
+// of their ids: the one whose most important vertex is the least. The route meeting at one of its
+// ends goes only through the vertexes less than its ends, so it's found before all the others
+template <typename Weight>
+std::optional<VertexId> ContractionHierarchyRouter<Weight>::findMeetingVertex(VertexId from,
+                                                                              VertexId to) const
+{
+    searchUpward(backwardGraph_, &Edge<Weight>::from, to, backwardSearchSpace_);
+    Weight bestWeight = NoRoute;
+    std::optional<VertexId> meetingVertex;
+    for (const VertexId vertex : backwardSearchSpace_.touchedVertexes)
+    {
+        const Weight weight =
+            forwardSearchSpace_.weights[vertex] + backwardSearchSpace_.weights[vertex];
+        if (weight < bestWeight ||
+            (weight < NoRoute && !(bestWeight < weight) && *meetingVertex != from &&
+             *meetingVertex != to && (vertex == from || vertex == to || vertex < *meetingVertex)))
+        {
+            bestWeight = weight;
+            meetingVertex = vertex;
+        }
+    }
+    return meetingVertex;
+}
+
+template <typename Weight>
+void ContractionHierarchyRouter<Weight>::searchUpward(const UpwardGraph& upwardGraph,
+                                                      VertexId Edge<Weight>::*arcEnd,
+                                                      VertexId from,
+                                                      SearchSpace& searchSpace) const
+{
+    using QueueItem = std::pair<Weight, VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+
+    resetSearchSpace(searchSpace);
+    searchSpace.weights[from] = 0;
+    searchSpace.touchedVertexes.push_back(from);
+    queue.push({0, from});
+    while (!queue.empty())
+    {
+        const auto [weight, vertex] = queue.top();
+        queue.pop();
+        if (searchSpace.weights[vertex] < weight)
+        {
+            continue;
+        }
+
+        for (size_t index = upwardGraph.offsets[vertex]; index < upwardGraph.offsets[vertex + 1];
+             ++index)
+        {
+            const ArcId arcId = upwardGraph.arcIds[index];
+            const auto& arc = getArc(arcId);
+            const VertexId nextVertex = arc.*arcEnd;
+            const Weight candidateWeight = weight + arc.weight;
+            if (candidateWeight < searchSpace.weights[nextVertex])
+            {
+                if (!(searchSpace.weights[nextVertex] < NoRoute))
+                {
+                    searchSpace.touchedVertexes.push_back(nextVertex);
+                }
+                searchSpace.weights[nextVertex] = candidateWeight;
+                searchSpace.prevArcs[nextVertex] = arcId;
+                queue.push({candidateWeight, nextVertex});
+            }
+            else if (!(searchSpace.weights[nextVertex] < candidateWeight))
+            {
+                // Router finds the route through the least vertex first. The weight stays the same,
+                // so the routes going on from the vertex don't change
+                const auto& currentArc = getArc(searchSpace.prevArcs[nextVertex]);
+                if (vertex < (arcEnd == &Edge<Weight>::to ? currentArc.from : currentArc.to))
+                {
+                    searchSpace.prevArcs[nextVertex] = arcId;
+                }
+            }
+        }
+    }
+}
+
+template <typename Weight>
+std::vector<Weight> ContractionHierarchyRouter<Weight>::findRouteWeights(
+    const std::vector<VertexId>& sources, const std::vector<VertexId>& targets) const
+{
+    struct BucketItem
+    {
+        size_t targetIndex;
+        Weight weight;
+    };
+    std::unordered_map<VertexId, std::vector<BucketItem>> buckets;
+    for (size_t targetIndex = 0; targetIndex < targets.size(); ++targetIndex)
+    {
+        searchUpward(
+            backwardGraph_, &Edge<Weight>::from, targets[targetIndex], backwardSearchSpace_);
+        for (const VertexId vertex : backwardSearchSpace_.touchedVertexes)
+        {
+            buckets[vertex].push_back({targetIndex, backwardSearchSpace_.weights[vertex]});
+        }
+    }
+
+    std::vector<Weight> weights(sources.size() * targets.size(), NoRoute);
+    for (size_t sourceIndex = 0; sourceIndex < sources.size(); ++sourceIndex)
+    {
+        searchUpward(forwardGraph_, &Edge<Weight>::to, sources[sourceIndex], forwardSearchSpace_);
+        Weight* row = &weights[sourceIndex * targets.size()];
+        for (const VertexId vertex : forwardSearchSpace_.touchedVertexes)
+        {
+            if (const auto* bucket = getValuePointer(buckets, vertex))
+            {
+                const Weight weight = forwardSearchSpace_.weights[vertex];
+                for (const auto& [targetIndex, bucketWeight] : *bucket)
+                {
+                    row[targetIndex] = std::min(row[targetIndex], weight + bucketWeight);
+                }
+            }
+        }
+    }
+    return weights;
+}
+
+template <typename Weight>
+std::vector<typename ContractionHierarchyRouter<Weight>::ArcId> ContractionHierarchyRouter<
+    Weight>::getSearchRoute(const SearchSpace& searchSpace, bool isForward, VertexId vertex) const
+{
+    std::vector<ArcId> arcIds;
+    for (ArcId arcId = searchSpace.prevArcs[vertex]; arcId != NoArc;
+         arcId = searchSpace.prevArcs[isForward ? getArc(arcId).from : getArc(arcId).to])
+    {
+        arcIds.push_back(arcId);
+    }
+    if (isForward)
+    {
+        std::reverse(std::begin(arcIds), std::end(arcIds));
+    }
+    return arcIds;
+}
+
+template <typename Weight>
+EdgeId ContractionHierarchyRouter<Weight>::getRouteEdge(RouteId routeId, size_t edgeIndex) const
+{
+    return expandedRoutesCache_.at(routeId)[edgeIndex];
+}
+
+template <typename Weight>
+void ContractionHierarchyRouter<Weight>::releaseRoute(RouteId routeId)
+{
+    expandedRoutesCache_.erase(routeId);
+}
+
+template <typename Weight>
+void ContractionHierarchyRouter<Weight>::serialize(
+    GraphProto::ContractionHierarchyRouter& proto) const
+{
+    static_assert(std::is_same_v<Weight, double>,
+                  "Serialization is implemented only for double weights");
+
+    proto.mutable_shortcuts()->Reserve(static_cast<int>(shortcuts_.size()));
+    for (const auto& shortcut : shortcuts_)
+    {
+        auto& shortcutProto = *proto.add_shortcuts();
+        shortcutProto.set_from(shortcut.arc.from);
+        shortcutProto.set_to(shortcut.arc.to);
+        shortcutProto.set_weight(shortcut.arc.weight);
+        shortcutProto.set_first_arc(shortcut.firstArc);
+        shortcutProto.set_second_arc(shortcut.secondArc);
+    }
+
+    for (VertexId vertex = 0; vertex < graph_.getVertexCount(); ++vertex)
+    {
+        auto& upwardArcsProto = *proto.add_upward_arcs();
+        for (size_t index = forwardGraph_.offsets[vertex]; index < forwardGraph_.offsets[vertex + 1];
+             ++index)
+        {
+            upwardArcsProto.add_out_arc_ids(forwardGraph_.arcIds[index]);
+        }
+        for (size_t index = backwardGraph_.offsets[vertex];
+             index < backwardGraph_.offsets[vertex + 1];
+             ++index)
+        {
+            upwardArcsProto.add_in_arc_ids(backwardGraph_.arcIds[index]);
+        }
+    }
+}
+
+template <typename Weight>
+ContractionHierarchyRouter<Weight>::ContractionHierarchyRouter(
+    const Graph& graph, const GraphProto::ContractionHierarchyRouter& proto)
+    : graph_(graph)
+{
+    const size_t vertexCount = graph.getVertexCount();
+    ASSERT_WITH_MESSAGE(static_cast<size_t>(proto.upward_arcs_size()) == vertexCount,
+                        "contraction hierarchy doesn't match the graph");
+
+    const size_t arcCount = graph.getEdgeCount() + static_cast<size_t>(proto.shortcuts_size());
+    const auto checkArc = [arcCount](uint64_t arcId) {
+        ASSERT_WITH_MESSAGE(arcId < arcCount, "wrong arc id " << arcId);
+        return static_cast<ArcId>(arcId);
+    };
+
+    shortcuts_.reserve(static_cast<size_t>(proto.shortcuts_size()));
+    for (const auto& shortcutProto : proto.shortcuts())
+    {
+        // A shortcut is made of the arcs made before it, so unpacking it comes to the edges
+        const ArcId arcId = graph.getEdgeCount() + shortcuts_.size();
+        const Shortcut shortcut{{shortcutProto.from(), shortcutProto.to(), shortcutProto.weight()},
+                                checkArc(shortcutProto.first_arc()),
+                                checkArc(shortcutProto.second_arc())};
+        ASSERT_WITH_MESSAGE(shortcut.firstArc < arcId && shortcut.secondArc < arcId,
+                            "shortcut " << arcId << " refers to a later arc");
+        const auto& firstArc = getArc(shortcut.firstArc);
+        const auto& secondArc = getArc(shortcut.secondArc);
+        ASSERT_WITH_MESSAGE(shortcut.arc.from < vertexCount && shortcut.arc.to < vertexCount &&
+                                firstArc.from == shortcut.arc.from &&
+                                firstArc.to == secondArc.from && secondArc.to == shortcut.arc.to,
+                            "shortcut " << arcId << " doesn't join its arcs");
+        shortcuts_.push_back(shortcut);
+    }
+
+    std::vector<std::vector<ArcId>> outArcIds(vertexCount);
+    std::vector<std::vector<ArcId>> inArcIds(vertexCount);
+    for (VertexId vertex = 0; vertex < vertexCount; ++vertex)
+    {
+        const auto& upwardArcsProto = proto.upward_arcs(static_cast<int>(vertex));
+        // The searches go only up, so they never come back to the vertexes they passed
+        for (const uint64_t arcId : upwardArcsProto.out_arc_ids())
+        {
+            const auto& arc = getArc(checkArc(arcId));
+            ASSERT_WITH_MESSAGE(arc.from == vertex && vertex < arc.to,
+                                "arc " << arcId << " doesn't go up from vertex " << vertex);
+            outArcIds[vertex].push_back(arcId);
+        }
+        for (const uint64_t arcId : upwardArcsProto.in_arc_ids())
+        {
+            const auto& arc = getArc(checkArc(arcId));
+            ASSERT_WITH_MESSAGE(arc.to == vertex && vertex < arc.from,
+                                "arc " << arcId << " doesn't come down to vertex " << vertex);
+            inArcIds[vertex].push_back(arcId);
+        }
+    }
+    buildUpwardGraphs(outArcIds, inArcIds);
+}
+
+template <typename Weight>
+std::unique_ptr<ContractionHierarchyRouter<Weight>> ContractionHierarchyRouter<Weight>::deserialize(
+    const GraphProto::ContractionHierarchyRouter& proto, const Graph& graph)
+{
+    return std::unique_ptr<ContractionHierarchyRouter>(
+        new ContractionHierarchyRouter(graph, proto)); // Ctor is private, so can't use make_unique
+}
+
+} // namespace Graph
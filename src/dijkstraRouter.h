@@ -0,0 +1,291 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+#include "utils.h"
+
+#include "graph.pb.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <list>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+namespace Graph
+{
+// Router which doesn't precalculate anything. It finds shortest path tree from the source vertex
+// of a route by Dijkstra's algorithm on the first request and keeps the latest trees in LRU cache
+template <typename Weight>
+class DijkstraRouter
+{
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+    using ExpandedRoute = std::vector<EdgeId>;
+
+    static constexpr Weight NoRoute = std::numeric_limits<Weight>::infinity();
+
+    // Weight of a missing route is NoRoute, previous edge of the source vertex is NoEdge
+    struct ShortestPathTree
+    {
+        std::vector<Weight> weights;
+        std::vector<CompactEdgeId> prevEdges;
+    };
+
+    struct CachedTree
+    {
+        ShortestPathTree tree;
+        std::list<VertexId>::iterator recencyIt;
+    };
+
+public:
+    using RouteId = uint64_t;
+    using RouteInfo = typename Router<Weight>::RouteInfo;
+
+    DijkstraRouter(const Graph& graph, size_t cacheCapacity);
+
+    void serialize(GraphProto::DijkstraRouter& proto) const;
+    static std::unique_ptr<DijkstraRouter> deserialize(const GraphProto::DijkstraRouter& proto,
+                                                       const Graph& graph);
+
+    std::optional<RouteInfo> buildRoute(VertexId from, VertexId to) const;
+    // Weights of the routes from every source to every target row by row, infinity where there is
+    // no route. One shortest path tree is taken for every source
+    std::vector<Weight> findRouteWeights(const std::vector<VertexId>& sources,
+                                         const std::vector<VertexId>& targets) const;
+    EdgeId getRouteEdge(RouteId routeId, size_t edgeIndex) const;
+    void releaseRoute(RouteId routeId);
+    // Drops the cached trees, they are outdated once the graph has changed
+    void clearCache();
+
+private:
+    const ShortestPathTree& getShortestPathTree(VertexId from) const;
+    ShortestPathTree buildShortestPathTree(VertexId from) const;
+    bool isPreferredAmongEqual(const ShortestPathTree& tree,
+                               const std::vector<size_t>& edgeCounts,
+                               VertexId lastVertex,
+                               VertexId currentLastVertex) const;
+
+private:
+    const Graph& graph_;
+    const size_t cacheCapacity_;
+
+    mutable std::unordered_map<VertexId, CachedTree> cachedTrees_;
+    // Source vertexes of the cached trees, the most recently used one goes first
+    mutable std::list<VertexId> recentlyUsedSources_;
+
+    mutable RouteId nextRouteId_ = 0;
+    mutable std::unordered_map<RouteId, ExpandedRoute> expandedRoutesCache_;
+};
+
+template <typename Weight>
+DijkstraRouter<Weight>::DijkstraRouter(const Graph& graph, size_t cacheCapacity)
+    : graph_(graph)
+    , cacheCapacity_(cacheCapacity)
+{
+    ASSERT_WITH_MESSAGE(cacheCapacity > 0, "Cache of shortest path trees can't be empty");
+    ASSERT_WITH_MESSAGE(graph.isFrozen(), "The graph has to be frozen for the router");
+    ASSERT_WITH_MESSAGE(graph.getEdgeCount() < NoEdge, "Too many edges for the router");
+}
+
+template <typename Weight>
+const typename DijkstraRouter<Weight>::ShortestPathTree& DijkstraRouter<
+    Weight>::getShortestPathTree(VertexId from) const
+{
+    if (auto it = cachedTrees_.find(from); it != cachedTrees_.end())
+    {
+        recentlyUsedSources_.splice(
+            recentlyUsedSources_.begin(), recentlyUsedSources_, it->second.recencyIt);
+        return it->second.tree;
+    }
+
+    if (cachedTrees_.size() == cacheCapacity_)
+    {
+        cachedTrees_.erase(recentlyUsedSources_.back());
+        recentlyUsedSources_.pop_back();
+    }
+
+    recentlyUsedSources_.push_front(from);
+    auto& cachedTree = cachedTrees_[from];
+    cachedTree.tree = buildShortestPathTree(from);
+    cachedTree.recencyIt = recentlyUsedSources_.begin();
+    return cachedTree.tree;
+}
+
+template <typename Weight>
+typename DijkstraRouter<Weight>::ShortestPathTree DijkstraRouter<Weight>::buildShortestPathTree(
+    VertexId from) const
+{
+    const size_t vertexCount = graph_.getVertexCount();
+    ShortestPathTree tree{std::vector<Weight>(vertexCount, NoRoute),
+                          std::vector<CompactEdgeId>(vertexCount, NoEdge)};
+
+    using QueueItem = std::pair<Weight, VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+
+    std::vector<bool> isSettled(vertexCount, false);
+    // Count of edges in the route to the vertex
+    std::vector<size_t> edgeCounts(vertexCount, 0);
+    tree.weights[from] = 0;
+    queue.push({0, from});
+    while (!queue.empty())
+    {
+        const auto [weight, vertex] = queue.top();
+        queue.pop();
+        if (isSettled[vertex])
+        {
+            // The vertex was already settled with a shorter route
+            continue;
+        }
+        isSettled[vertex] = true;
+
+        for (const auto& edge : graph_.getEdgesWhichStartFrom(vertex))
+        {
+            ASSERT_WITH_MESSAGE(edge.weight >= 0,
+                                "Router works only with edges with non-negative weight");
+
+            const Weight candidateWeight = weight + edge.weight;
+            if (candidateWeight < tree.weights[edge.to])
+            {
+                tree.weights[edge.to] = candidateWeight;
+                tree.prevEdges[edge.to] = static_cast<CompactEdgeId>(edge.id);
+                edgeCounts[edge.to] = edgeCounts[vertex] + 1;
+                queue.push({candidateWeight, edge.to});
+            }
+            else if (!(tree.weights[edge.to] < candidateWeight) && !isSettled[edge.to] &&
+                     isPreferredAmongEqual(
+                         tree, edgeCounts, vertex, graph_.getEdge(tree.prevEdges[edge.to]).from))
+            {
+                tree.prevEdges[edge.to] = static_cast<CompactEdgeId>(edge.id);
+                edgeCounts[edge.to] = edgeCounts[vertex] + 1;
+            }
+        }
+    }
+
+    return tree;
+}
+
+// Among the routes of equal weight Floyd-Warshall algorithm chooses the one with the least greatest
+// intermediate vertex, then recursively the same way for the parts of the route before and after
+// it. That is the route whose intermediate vertexes sorted descending are lexicographically the
+// least, so Router and DijkstraRouter give the same routes. Both routes go through settled vertexes
+// only, so their previous edges won't change anymore. With zero weight edges a vertex may be settled
+// before the equal route to it is found, then the choice may differ from Router's one
+template <typename Weight>
+bool DijkstraRouter<Weight>::isPreferredAmongEqual(const ShortestPathTree& tree,
+                                                   const std::vector<size_t>& edgeCounts,
+                                                   VertexId lastVertex,
+                                                   VertexId currentLastVertex) const
+{
+    if (lastVertex == currentLastVertex)
+    {
+        // Parallel edges, the first one is kept
+        return false;
+    }
+
+    // The routes are the same before their last common vertex, so only the rest of them is compared
+    std::vector<VertexId> vertexes;
+    std::vector<VertexId> currentVertexes;
+    while (lastVertex != currentLastVertex)
+    {
+        if (edgeCounts[lastVertex] >= edgeCounts[currentLastVertex])
+        {
+            vertexes.push_back(lastVertex);
+            lastVertex = graph_.getEdge(tree.prevEdges[lastVertex]).from;
+        }
+        else
+        {
+            currentVertexes.push_back(currentLastVertex);
+            currentLastVertex = graph_.getEdge(tree.prevEdges[currentLastVertex]).from;
+        }
+    }
+
+    std::sort(std::begin(vertexes), std::end(vertexes), std::greater<VertexId>());
+    std::sort(std::begin(currentVertexes), std::end(currentVertexes), std::greater<VertexId>());
+    return std::lexicographical_compare(std::begin(vertexes),
+                                        std::end(vertexes),
+                                        std::begin(currentVertexes),
+                                        std::end(currentVertexes));
+}
+
+template <typename Weight>
+std::optional<typename DijkstraRouter<Weight>::RouteInfo> DijkstraRouter<Weight>::buildRoute(
+    VertexId from, VertexId to) const
+{
+    const auto& tree = getShortestPathTree(from);
+    const Weight weight = tree.weights[to];
+    if (!(weight < NoRoute))
+    {
+        return std::nullopt;
+    }
+
+    std::vector<EdgeId> edges;
+    for (CompactEdgeId edgeId = tree.prevEdges[to]; edgeId != NoEdge;
+         edgeId = tree.prevEdges[graph_.getEdge(edgeId).from])
+    {
+        edges.push_back(edgeId);
+    }
+    std::reverse(std::begin(edges), std::end(edges));
+
+    const RouteId routeId = nextRouteId_++;
+    const size_t routeEdgeCount = edges.size();
+
+    expandedRoutesCache_[routeId] = std::move(edges);
+
+    return RouteInfo{routeId, weight, routeEdgeCount};
+}
+
+template <typename Weight>
+std::vector<Weight> DijkstraRouter<Weight>::findRouteWeights(
+    const std::vector<VertexId>& sources, const std::vector<VertexId>& targets) const
+{
+    std::vector<Weight> weights;
+    weights.reserve(sources.size() * targets.size());
+    for (const VertexId from : sources)
+    {
+        const auto& tree = getShortestPathTree(from);
+        for (const VertexId to : targets)
+        {
+            weights.push_back(tree.weights[to]);
+        }
+    }
+    return weights;
+}
+
+template <typename Weight>
+EdgeId DijkstraRouter<Weight>::getRouteEdge(RouteId routeId, size_t edgeIndex) const
+{
+    return expandedRoutesCache_.at(routeId)[edgeIndex];
+}
+
+template <typename Weight>
+void DijkstraRouter<Weight>::releaseRoute(RouteId routeId)
+{
+    expandedRoutesCache_.erase(routeId);
+}
+
+template <typename Weight>
+void DijkstraRouter<Weight>::clearCache()
+{
+    cachedTrees_.clear();
+    recentlyUsedSources_.clear();
+}
+
+template <typename Weight>
+void DijkstraRouter<Weight>::serialize(GraphProto::DijkstraRouter& proto) const
+{
+    proto.set_cache_capacity(cacheCapacity_);
+}
+
+template <typename Weight>
+std::unique_ptr<DijkstraRouter<Weight>> DijkstraRouter<Weight>::deserialize(
+    const GraphProto::DijkstraRouter& proto, const Graph& graph)
+{
+    return std::make_unique<DijkstraRouter>(graph, proto.cache_capacity());
+}
+
+} // namespace Graph
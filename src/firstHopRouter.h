@@ -0,0 +1,338 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+#include "utils.h"
+
+#include "graph.pb.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace Graph
+{
+// Routes between all pairs of vertexes kept as their weights and their first edges instead of the
+// previous ones. The next edge of a route is the first edge of the route from the end of the
+// current one, so the route is walked from its first edge to its last one, nothing is allocated and
+// nothing is reversed. The first edges take 16 bits while the graph has less than 65535 edges and
+// 32 bits otherwise. The matrices are made from the ones of Router and are kept for every weakly
+// connected component as well. The routes can't be updated
+template <typename Weight>
+class FirstHopRouter
+{
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+    using FirstHops = std::variant<std::vector<uint16_t>, std::vector<uint32_t>>;
+
+    static constexpr Weight NoRoute = std::numeric_limits<Weight>::infinity();
+
+public:
+    FirstHopRouter(const Graph& graph, const Router<Weight>& router);
+
+    void serialize(GraphProto::FirstHopRouter& proto) const;
+    static std::unique_ptr<FirstHopRouter> deserialize(const GraphProto::FirstHopRouter& proto,
+                                                       const Graph& graph);
+
+    std::optional<Weight> findRouteWeight(VertexId from, VertexId to) const;
+    // Calls callback(edgeId) for every edge of the route from the first one to the last one.
+    // Returns false if there is no route. Safe to call from several threads at once
+    template <typename Callback>
+    bool forEachRouteEdge(VertexId from, VertexId to, Callback callback) const;
+    // Weights of the routes from every source to every target row by row, infinity where there is
+    // no route
+    std::vector<Weight> findRouteWeights(const std::vector<VertexId>& sources,
+                                         const std::vector<VertexId>& targets) const;
+
+    // Size of a first edge id in bytes, 2 or 4
+    size_t getFirstHopSize() const;
+
+private:
+    explicit FirstHopRouter(const Graph& graph);
+
+    void addComponent(const std::vector<VertexId>& vertexes);
+    void fillFirstHops(const std::vector<CompactEdgeId>& firstHops);
+    // Index of the route in the matrices, both vertexes have to be in the same component
+    size_t getRouteIndex(VertexId from, VertexId to) const;
+
+    template <typename EdgeIdType>
+    static constexpr EdgeIdType NoHop = std::numeric_limits<EdgeIdType>::max();
+
+private:
+    const Graph& graph_;
+
+    // Component of every vertex and the index of the vertex in it. The routes of a component go row
+    // by row from its offset in the matrices
+    std::vector<size_t> vertexComponents_;
+    std::vector<VertexId> vertexIndexes_;
+    std::vector<std::vector<VertexId>> componentVertexes_;
+    std::vector<size_t> componentOffsets_;
+
+    std::vector<Weight> weights_;
+    FirstHops firstHops_;
+};
+
+template <typename Weight>
+FirstHopRouter<Weight>::FirstHopRouter(const Graph& graph)
+    : graph_(graph)
+    , vertexComponents_(graph.getVertexCount(), 0)
+    , vertexIndexes_(graph.getVertexCount(), 0)
+{
+    ASSERT_WITH_MESSAGE(graph.isFrozen(), "The graph has to be frozen for the router");
+    if (graph.getEdgeCount() < NoHop<uint16_t>)
+    {
+        firstHops_ = std::vector<uint16_t>();
+    }
+    else
+    {
+        ASSERT_WITH_MESSAGE(graph.getEdgeCount() < NoHop<uint32_t>,
+                            "Too many edges for the router");
+        firstHops_ = std::vector<uint32_t>();
+    }
+}
+
+// Routes to the same target are joined into a tree, so a walk never goes round. The route of
+// Router from a vertex is followed from its first edge until a vertex which already has the first
+// edge to the target, the walk from there goes on along its own route. That's a shortest route as
+// well, but among several routes of equal weight it may be another one than Router's
+template <typename Weight>
+FirstHopRouter<Weight>::FirstHopRouter(const Graph& graph, const Router<Weight>& router)
+    : FirstHopRouter(graph)
+{
+    std::vector<CompactEdgeId> firstHops;
+    std::vector<EdgeId> routeEdges;
+    for (const auto& vertexes : findWeaklyConnectedComponents(graph))
+    {
+        addComponent(vertexes);
+        const size_t vertexCount = vertexes.size();
+        firstHops.assign(vertexCount * vertexCount, NoEdge);
+        for (size_t fromIndex = 0; fromIndex < vertexCount; ++fromIndex)
+        {
+            for (size_t toIndex = 0; toIndex < vertexCount; ++toIndex)
+            {
+                const auto route = router.getRoute(vertexes[fromIndex], vertexes[toIndex]);
+                weights_.push_back(route ? route->getWeight() : NoRoute);
+                if (!route || firstHops[fromIndex * vertexCount + toIndex] != NoEdge)
+                {
+                    continue;
+                }
+
+                routeEdges.assign(route->begin(), route->end());
+                for (auto it = routeEdges.rbegin(); it != routeEdges.rend(); ++it)
+                {
+                    const VertexId vertexIndex = vertexIndexes_[graph.getEdge(*it).from];
+                    auto& firstHop = firstHops[vertexIndex * vertexCount + toIndex];
+                    if (firstHop != NoEdge)
+                    {
+                        break;
+                    }
+                    firstHop = static_cast<CompactEdgeId>(*it);
+                }
+            }
+        }
+        fillFirstHops(firstHops);
+    }
+}
+
+template <typename Weight>
+void FirstHopRouter<Weight>::addComponent(const std::vector<VertexId>& vertexes)
+{
+    for (size_t index = 0; index < vertexes.size(); ++index)
+    {
+        vertexComponents_[vertexes[index]] = componentVertexes_.size();
+        vertexIndexes_[vertexes[index]] = index;
+    }
+    componentVertexes_.push_back(vertexes);
+    componentOffsets_.push_back(weights_.size());
+}
+
+template <typename Weight>
+void FirstHopRouter<Weight>::fillFirstHops(const std::vector<CompactEdgeId>& firstHops)
+{
+    std::visit(
+        [&firstHops](auto& hops) {
+            using EdgeIdType = typename std::decay_t<decltype(hops)>::value_type;
+            for (const CompactEdgeId firstHop : firstHops)
+            {
+                hops.push_back(firstHop == NoEdge ? NoHop<EdgeIdType>
+                                                  : static_cast<EdgeIdType>(firstHop));
+            }
+        },
+        firstHops_);
+}
+
+template <typename Weight>
+size_t FirstHopRouter<Weight>::getRouteIndex(VertexId from, VertexId to) const
+{
+    const size_t component = vertexComponents_[from];
+    return componentOffsets_[component] +
+           vertexIndexes_[from] * componentVertexes_[component].size() + vertexIndexes_[to];
+}
+
+template <typename Weight>
+std::optional<Weight> FirstHopRouter<Weight>::findRouteWeight(VertexId from, VertexId to) const
+{
+    if (vertexComponents_[from] != vertexComponents_[to])
+    {
+        return std::nullopt;
+    }
+    const Weight weight = weights_[getRouteIndex(from, to)];
+    if (!(weight < NoRoute))
+    {
+        return std::nullopt;
+    }
+    return weight;
+}
+
+template <typename Weight>
+template <typename Callback>
+bool FirstHopRouter<Weight>::forEachRouteEdge(VertexId from, VertexId to, Callback callback) const
+{
+    if (!findRouteWeight(from, to))
+    {
+        return false;
+    }
+
+    std::visit(
+        [this, from, to, &callback](const auto& hops) {
+            for (VertexId vertex = from; vertex != to;)
+            {
+                const EdgeId edgeId = hops[getRouteIndex(vertex, to)];
+                callback(edgeId);
+                vertex = graph_.getEdge(edgeId).to;
+            }
+        },
+        firstHops_);
+    return true;
+}
+
+template <typename Weight>
+std::vector<Weight> FirstHopRouter<Weight>::findRouteWeights(
+    const std::vector<VertexId>& sources, const std::vector<VertexId>& targets) const
+{
+    std::vector<Weight> weights;
+    weights.reserve(sources.size() * targets.size());
+    for (const VertexId from : sources)
+    {
+        for (const VertexId to : targets)
+        {
+            weights.push_back(findRouteWeight(from, to).value_or(NoRoute));
+        }
+    }
+    return weights;
+}
+
+template <typename Weight>
+size_t FirstHopRouter<Weight>::getFirstHopSize() const
+{
+    return std::visit(
+        [](const auto& hops) {
+            return sizeof(typename std::decay_t<decltype(hops)>::value_type);
+        },
+        firstHops_);
+}
+
+// The first edges are packed into bytes, little-endian, getFirstHopSize() bytes each
+template <typename Weight>
+void FirstHopRouter<Weight>::serialize(GraphProto::FirstHopRouter& proto) const
+{
+    for (const auto& vertexes : componentVertexes_)
+    {
+        proto.mutable_component_vertexes()->Add(std::begin(vertexes), std::end(vertexes));
+        proto.add_component_sizes(vertexes.size());
+    }
+    proto.mutable_weights()->Reserve(static_cast<int>(weights_.size()));
+    for (const Weight weight : weights_)
+    {
+        proto.add_weights(static_cast<double>(weight));
+    }
+
+    const size_t firstHopSize = getFirstHopSize();
+    proto.set_first_hop_size(static_cast<uint32_t>(firstHopSize));
+    std::string bytes;
+    bytes.reserve(weights_.size() * firstHopSize);
+    std::visit(
+        [&bytes, firstHopSize](const auto& hops) {
+            for (const auto firstHop : hops)
+            {
+                for (size_t byteIndex = 0; byteIndex < firstHopSize; ++byteIndex)
+                {
+                    bytes.push_back(static_cast<char>((firstHop >> (byteIndex * 8)) & 0xFF));
+                }
+            }
+        },
+        firstHops_);
+    proto.set_first_hops(std::move(bytes));
+}
+
+template <typename Weight>
+std::unique_ptr<FirstHopRouter<Weight>> FirstHopRouter<Weight>::deserialize(
+    const GraphProto::FirstHopRouter& proto, const Graph& graph)
+{
+    // Ctor is private, so can't use make_unique
+    std::unique_ptr<FirstHopRouter> router(new FirstHopRouter(graph));
+    const size_t vertexCount = graph.getVertexCount();
+
+    std::vector<bool> isTaken(vertexCount, false);
+    size_t vertexIndex = 0;
+    for (const uint64_t componentSize : proto.component_sizes())
+    {
+        ASSERT_WITH_MESSAGE(
+            componentSize <= static_cast<size_t>(proto.component_vertexes_size()) - vertexIndex,
+            "first hop routes don't match the graph");
+        std::vector<VertexId> vertexes;
+        vertexes.reserve(componentSize);
+        for (size_t index = 0; index < componentSize; ++index)
+        {
+            const VertexId vertex = proto.component_vertexes(static_cast<int>(vertexIndex++));
+            ASSERT_WITH_MESSAGE(vertex < vertexCount && !isTaken[vertex],
+                                "first hop routes don't match the graph");
+            isTaken[vertex] = true;
+            vertexes.push_back(vertex);
+        }
+        router->addComponent(vertexes);
+        router->weights_.resize(router->weights_.size() + componentSize * componentSize);
+    }
+    ASSERT_WITH_MESSAGE(vertexIndex == vertexCount &&
+                            static_cast<size_t>(proto.component_vertexes_size()) == vertexCount &&
+                            static_cast<size_t>(proto.weights_size()) == router->weights_.size(),
+                        "first hop routes don't match the graph");
+    for (size_t index = 0; index < router->weights_.size(); ++index)
+    {
+        router->weights_[index] = static_cast<Weight>(proto.weights(static_cast<int>(index)));
+    }
+
+    const size_t firstHopSize = router->getFirstHopSize();
+    const auto& bytes = proto.first_hops();
+    ASSERT_WITH_MESSAGE(proto.first_hop_size() == firstHopSize &&
+                            bytes.size() == router->weights_.size() * firstHopSize,
+                        "first hop routes don't match the graph");
+    std::visit(
+        [&bytes, firstHopSize, &graph](auto& hops) {
+            using EdgeIdType = typename std::decay_t<decltype(hops)>::value_type;
+            hops.resize(bytes.size() / firstHopSize);
+            for (size_t index = 0; index < hops.size(); ++index)
+            {
+                EdgeIdType firstHop = 0;
+                for (size_t byteIndex = 0; byteIndex < firstHopSize; ++byteIndex)
+                {
+                    const auto byte = static_cast<uint8_t>(bytes[index * firstHopSize + byteIndex]);
+                    firstHop = static_cast<EdgeIdType>(
+                        firstHop | static_cast<uint32_t>(byte) << (byteIndex * 8));
+                }
+                ASSERT_WITH_MESSAGE(firstHop < graph.getEdgeCount() ||
+                                        firstHop == NoHop<EdgeIdType>,
+                                    "wrong edge id " << firstHop);
+                hops[index] = firstHop;
+            }
+        },
+        router->firstHops_);
+    return router;
+}
+
+} // namespace Graph
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+
+namespace Graph
+{
+// Non-negative weight with four decimal digits kept in 32 bits as a count of 1 / Scale units. The
+// greatest count is infinity, sums saturate at it, so a sum with an infinite weight stays infinite.
+// Finite weights are up to about 429496
+class FixedPointWeight
+{
+public:
+    static constexpr double Scale = 10000;
+
+    constexpr FixedPointWeight() = default;
+    // Rounded to the nearest unit, infinite and too big values become infinity
+    FixedPointWeight(double value);
+
+    static constexpr FixedPointWeight fromUnits(uint32_t units);
+
+    constexpr uint32_t getUnits() const;
+    explicit operator double() const;
+
+    friend constexpr FixedPointWeight operator+(FixedPointWeight lhs, FixedPointWeight rhs);
+    friend constexpr bool operator<(FixedPointWeight lhs, FixedPointWeight rhs);
+    friend constexpr bool operator==(FixedPointWeight lhs, FixedPointWeight rhs);
+
+private:
+    static constexpr uint32_t InfiniteUnits = std::numeric_limits<uint32_t>::max();
+
+    uint32_t units_ = 0;
+};
+
+static_assert(sizeof(FixedPointWeight) == sizeof(uint32_t),
+              "Kernels read arrays of fixed-point weights as arrays of their units");
+
+inline FixedPointWeight::FixedPointWeight(double value)
+{
+    const double units = std::round(value * Scale);
+    units_ = units < InfiniteUnits ? static_cast<uint32_t>(units) : InfiniteUnits;
+}
+
+constexpr FixedPointWeight FixedPointWeight::fromUnits(uint32_t units)
+{
+    FixedPointWeight weight;
+    weight.units_ = units;
+    return weight;
+}
+
+constexpr uint32_t FixedPointWeight::getUnits() const
+{
+    return units_;
+}
+
+inline FixedPointWeight::operator double() const
+{
+    return units_ == InfiniteUnits ? std::numeric_limits<double>::infinity() : units_ / Scale;
+}
+
+constexpr FixedPointWeight operator+(FixedPointWeight lhs, FixedPointWeight rhs)
+{
+    return FixedPointWeight::fromUnits(rhs.units_ < FixedPointWeight::InfiniteUnits - lhs.units_
+                                           ? lhs.units_ + rhs.units_
+                                           : FixedPointWeight::InfiniteUnits);
+}
+
+constexpr bool operator<(FixedPointWeight lhs, FixedPointWeight rhs)
+{
+    return lhs.units_ < rhs.units_;
+}
+
+constexpr bool operator==(FixedPointWeight lhs, FixedPointWeight rhs)
+{
+    return lhs.units_ == rhs.units_;
+}
+
+constexpr bool operator!=(FixedPointWeight lhs, FixedPointWeight rhs)
+{
+    return !(lhs == rhs);
+}
+
+constexpr bool operator>(FixedPointWeight lhs, FixedPointWeight rhs)
+{
+    return rhs < lhs;
+}
+
+constexpr bool operator<=(FixedPointWeight lhs, FixedPointWeight rhs)
+{
+    return !(rhs < lhs);
+}
+
+constexpr bool operator>=(FixedPointWeight lhs, FixedPointWeight rhs)
+{
+    return !(lhs < rhs);
+}
+
+inline std::ostream& operator<<(std::ostream& stream, FixedPointWeight weight)
+{
+    return stream << static_cast<double>(weight);
+}
+} // namespace Graph
+
+namespace std
+{
+template <>
+class numeric_limits<Graph::FixedPointWeight>
+{
+public:
+    static constexpr bool is_specialized = true;
+    static constexpr bool has_infinity = true;
+
+    static constexpr Graph::FixedPointWeight infinity()
+    {
+        return Graph::FixedPointWeight::fromUnits(numeric_limits<uint32_t>::max());
+    }
+    static constexpr Graph::FixedPointWeight max()
+    {
+        return Graph::FixedPointWeight::fromUnits(numeric_limits<uint32_t>::max() - 1);
+    }
+    static constexpr Graph::FixedPointWeight lowest()
+    {
+        return Graph::FixedPointWeight::fromUnits(0);
+    }
+};
+} // namespace std
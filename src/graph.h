@@ -4,7 +4,9 @@
 
 #include "graph.pb.h"
 
-#include <type_traits>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
 #include <vector>
 
 namespace Graph
@@ -13,6 +15,10 @@ namespace Graph
 using VertexId = size_t;
 using EdgeId = size_t;
 
+// Edge id stored in 32 bits where compactness matters. NoEdge stands for the absence of an edge
+using CompactEdgeId = uint32_t;
+constexpr CompactEdgeId NoEdge = std::numeric_limits<CompactEdgeId>::max();
+
 template <typename Weight>
 struct Edge
 {
@@ -21,49 +27,156 @@ struct Edge
     Weight weight;
 };
 
+// Edge as it is kept among the out-edges of its start vertex
+template <typename Weight>
+struct OutEdge
+{
+    EdgeId id;
+    VertexId to;
+    Weight weight;
+};
+
+// Edges are added to the graph first, then it's frozen into compressed sparse rows: out-edges of
+// every vertex go one after another with their targets and weights, so scanning them reads
+// contiguous memory. Adding a vertex or an edge unfreezes the graph, its out-edges can be read only
+// after it's frozen again
 template <typename Weight>
 class DirectedWeightedGraph
 {
 private:
-    using EdgesVector = std::vector<EdgeId>;
-    using VertexesRange = Range<typename EdgesVector::const_iterator>;
+    using OutEdgesRange = Range<const OutEdge<Weight>*>;
 
 public:
     DirectedWeightedGraph(size_t vertexСount = 0);
+    VertexId addVertex();
     EdgeId addEdge(const Edge<Weight>& edge);
+    // An edge of infinite weight can't be a part of any route, that's how edges are removed
+    void setEdgeWeight(EdgeId edgeId, Weight weight);
+    // Moves every vertex v to newVertexIds[v], the ids have to be a permutation. Edges keep their
+    // ids, the graph has to be frozen again
+    void renumberVertexes(const std::vector<VertexId>& newVertexIds);
+    void freeze();
 
+    bool isFrozen() const;
     size_t getVertexCount() const;
     size_t getEdgeCount() const;
     const Edge<Weight>& getEdge(EdgeId edgeId) const;
-    VertexesRange getEdgesWhichStartFrom(VertexId vertex) const;
+    // Out-edges of the vertex in the order they were added
+    OutEdgesRange getEdgesWhichStartFrom(VertexId vertex) const;
 
     void serialize(GraphProto::DirectedWeightedGraph& proto) const;
     static DirectedWeightedGraph deserialize(const GraphProto::DirectedWeightedGraph& proto);
 
 private:
+    size_t vertexCount_;
     std::vector<Edge<Weight>> edges_;
-    std::vector<EdgesVector> vertexes_;
+
+    bool isFrozen_ = false;
+    // Out-edges of the vertex v are outEdges_[outEdgeOffsets_[v]] ...
+    // outEdges_[outEdgeOffsets_[v + 1] - 1], edgePositions_ keeps the position of every edge there
+    std::vector<size_t> outEdgeOffsets_;
+    std::vector<OutEdge<Weight>> outEdges_;
+    std::vector<size_t> edgePositions_;
 };
 
 template <typename Weight>
 DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertexCount)
-    : vertexes_(vertexCount)
+    : vertexCount_(vertexCount)
+{
+    freeze();
+}
+
+template <typename Weight>
+VertexId DirectedWeightedGraph<Weight>::addVertex()
 {
+    isFrozen_ = false;
+    return vertexCount_++;
 }
 
 template <typename Weight>
 EdgeId DirectedWeightedGraph<Weight>::addEdge(const Edge<Weight>& edge)
 {
+    isFrozen_ = false;
     edges_.push_back(edge);
-    const EdgeId id = edges_.size() - 1;
-    vertexes_[edge.from].push_back(id);
-    return id;
+    return edges_.size() - 1;
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::setEdgeWeight(EdgeId edgeId, Weight weight)
+{
+    edges_[edgeId].weight = weight;
+    if (isFrozen_)
+    {
+        outEdges_[edgePositions_[edgeId]].weight = weight;
+    }
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::renumberVertexes(const std::vector<VertexId>& newVertexIds)
+{
+    ASSERT_WITH_MESSAGE(newVertexIds.size() == vertexCount_,
+                        "new ids are given for " << newVertexIds.size() << " vertexes of "
+                                                 << vertexCount_);
+    std::vector<bool> isTaken(vertexCount_, false);
+    for (const VertexId vertex : newVertexIds)
+    {
+        ASSERT_WITH_MESSAGE(vertex < vertexCount_ && !isTaken[vertex],
+                            "new vertex ids aren't a permutation");
+        isTaken[vertex] = true;
+    }
+
+    isFrozen_ = false;
+    for (auto& edge : edges_)
+    {
+        edge.from = newVertexIds[edge.from];
+        edge.to = newVertexIds[edge.to];
+    }
+}
+
+// Counting sort of the edges by their start vertexes, it keeps the order of the edges of a vertex
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::freeze()
+{
+    if (isFrozen_)
+    {
+        return;
+    }
+
+    outEdgeOffsets_.assign(vertexCount_ + 1, 0);
+    for (const auto& edge : edges_)
+    {
+        ASSERT_WITH_MESSAGE(edge.from < vertexCount_ && edge.to < vertexCount_,
+                            "edge " << edge.from << " -> " << edge.to << " is out of the graph");
+        outEdgeOffsets_[edge.from + 1]++;
+    }
+    for (VertexId vertex = 0; vertex < vertexCount_; vertex++)
+    {
+        outEdgeOffsets_[vertex + 1] += outEdgeOffsets_[vertex];
+    }
+
+    outEdges_.resize(edges_.size());
+    edgePositions_.resize(edges_.size());
+    auto nextPositions = outEdgeOffsets_;
+    for (EdgeId edgeId = 0; edgeId < edges_.size(); edgeId++)
+    {
+        const auto& edge = edges_[edgeId];
+        const size_t position = nextPositions[edge.from]++;
+        outEdges_[position] = {edgeId, edge.to, edge.weight};
+        edgePositions_[edgeId] = position;
+    }
+    isFrozen_ = true;
+}
+
+template <typename Weight>
+bool DirectedWeightedGraph<Weight>::isFrozen() const
+{
+    return isFrozen_;
 }
 
 template <typename Weight>
 size_t DirectedWeightedGraph<Weight>::getVertexCount() const
 {
-    return vertexes_.size();
+    return vertexCount_;
 }
 
 template <typename Weight>
@@ -79,66 +192,206 @@ const Edge<Weight>& DirectedWeightedGraph<Weight>::getEdge(EdgeId edgeId) const
 }
 
 template <typename Weight>
-typename DirectedWeightedGraph<Weight>::VertexesRange DirectedWeightedGraph<
+typename DirectedWeightedGraph<Weight>::OutEdgesRange DirectedWeightedGraph<
     Weight>::getEdgesWhichStartFrom(VertexId vertex) const
 {
-    const auto& edges = vertexes_[vertex];
-    return {std::begin(edges), std::end(edges)};
+    const auto* outEdges = outEdges_.data();
+    return {outEdges + outEdgeOffsets_[vertex], outEdges + outEdgeOffsets_[vertex + 1]};
 }
 
+// The compressed sparse rows are written as they are, packed. Edge ids go in the order of the rows,
+// so the edges are restored from them without sorting. Weights are written as doubles, which keep
+// every weight of the narrower types exactly
 template <typename Weight>
 void DirectedWeightedGraph<Weight>::serialize(GraphProto::DirectedWeightedGraph& proto) const
 {
-    static_assert(std::is_same_v<Weight, double>,
-                  "Serialization is implemented only for double weights");
+    ASSERT_WITH_MESSAGE(isFrozen_, "only a frozen graph can be serialized");
 
-    for (const auto& edge : edges_)
+    *proto.mutable_out_edge_offsets() = {outEdgeOffsets_.begin(), outEdgeOffsets_.end()};
+    auto& ids = *proto.mutable_out_edge_ids();
+    auto& targets = *proto.mutable_out_edge_targets();
+    auto& weights = *proto.mutable_out_edge_weights();
+    ids.Reserve(static_cast<int>(outEdges_.size()));
+    targets.Reserve(static_cast<int>(outEdges_.size()));
+    weights.Reserve(static_cast<int>(outEdges_.size()));
+    for (const auto& outEdge : outEdges_)
+    {
+        ids.AddAlreadyReserved(outEdge.id);
+        targets.AddAlreadyReserved(outEdge.to);
+        weights.AddAlreadyReserved(static_cast<double>(outEdge.weight));
+    }
+}
+
+// Vertexes joined by an edge in any direction are united into one component. The components go in
+// the order of their least vertexes, the vertexes of a component in increasing order
+template <typename Weight>
+std::vector<std::vector<VertexId>> findWeaklyConnectedComponents(
+    const DirectedWeightedGraph<Weight>& graph)
+{
+    const size_t vertexCount = graph.getVertexCount();
+    std::vector<VertexId> parents(vertexCount);
+    for (VertexId vertex = 0; vertex < vertexCount; vertex++)
+    {
+        parents[vertex] = vertex;
+    }
+    const auto findRoot = [&parents](VertexId vertex) {
+        while (parents[vertex] != vertex)
+        {
+            parents[vertex] = parents[parents[vertex]];
+            vertex = parents[vertex];
+        }
+        return vertex;
+    };
+    for (EdgeId edgeId = 0; edgeId < graph.getEdgeCount(); edgeId++)
     {
-        auto& edgeProto = *proto.add_edges();
-        edgeProto.set_from(edge.from);
-        edgeProto.set_to(edge.to);
-        edgeProto.set_weight(edge.weight);
+        const auto& edge = graph.getEdge(edgeId);
+        const VertexId fromRoot = findRoot(edge.from);
+        const VertexId toRoot = findRoot(edge.to);
+        parents[std::max(fromRoot, toRoot)] = std::min(fromRoot, toRoot);
     }
 
-    for (const auto& vertex : vertexes_)
+    std::vector<std::vector<VertexId>> componentVertexes;
+    std::vector<size_t> rootComponents(vertexCount, 0);
+    for (VertexId vertex = 0; vertex < vertexCount; vertex++)
     {
-        auto& vertexesVectorProto = *proto.add_incidence_lists();
-        for (const auto edgeId : vertex)
+        const VertexId root = findRoot(vertex);
+        if (root == vertex)
         {
-            vertexesVectorProto.add_edge_ids(edgeId);
+            rootComponents[root] = componentVertexes.size();
+            componentVertexes.emplace_back();
         }
+        componentVertexes[rootComponents[root]].push_back(vertex);
     }
+
+    return componentVertexes;
 }
 
+// Reverse Cuthill-McKee order: the vertexes of every weakly connected component are visited breadth
+// first from a vertex of the least degree, the neighbours of a vertex in the order of their
+// degrees, and the whole order is reversed. Neighbouring vertexes get close ids, so their rows of
+// a routes matrix and their out-edges are close in memory. Ties go in the order of the old ids.
+// Returns the new id of every vertex
 template <typename Weight>
-DirectedWeightedGraph<Weight> DirectedWeightedGraph<Weight>::deserialize(
-    const GraphProto::DirectedWeightedGraph& proto)
+std::vector<VertexId> findReverseCuthillMcKeeOrder(const DirectedWeightedGraph<Weight>& graph)
 {
-    static_assert(std::is_same_v<Weight, double>,
-                  "Serialization is implemented only for double weights");
+    const size_t vertexCount = graph.getVertexCount();
+    std::vector<std::vector<VertexId>> neighbours(vertexCount);
+    for (EdgeId edgeId = 0; edgeId < graph.getEdgeCount(); edgeId++)
+    {
+        const auto& edge = graph.getEdge(edgeId);
+        if (edge.from != edge.to)
+        {
+            neighbours[edge.from].push_back(edge.to);
+            neighbours[edge.to].push_back(edge.from);
+        }
+    }
+    for (auto& vertexNeighbours : neighbours)
+    {
+        std::sort(std::begin(vertexNeighbours), std::end(vertexNeighbours));
+        vertexNeighbours.erase(
+            std::unique(std::begin(vertexNeighbours), std::end(vertexNeighbours)),
+            std::end(vertexNeighbours));
+    }
+    const auto isLessByDegree = [&neighbours](VertexId lhs, VertexId rhs) {
+        return neighbours[lhs].size() < neighbours[rhs].size();
+    };
+    for (auto& vertexNeighbours : neighbours)
+    {
+        std::stable_sort(std::begin(vertexNeighbours), std::end(vertexNeighbours), isLessByDegree);
+    }
 
-    DirectedWeightedGraph graph;
+    std::vector<VertexId> starts(vertexCount);
+    for (VertexId vertex = 0; vertex < vertexCount; vertex++)
+    {
+        starts[vertex] = vertex;
+    }
+    std::stable_sort(std::begin(starts), std::end(starts), isLessByDegree);
 
-    graph.edges_.reserve(static_cast<unsigned int>(proto.edges_size()));
-    for (const auto& edgeProto : proto.edges())
+    std::vector<VertexId> order;
+    order.reserve(vertexCount);
+    std::vector<bool> isVisited(vertexCount, false);
+    for (const VertexId start : starts)
     {
-        auto& edge = graph.edges_.emplace_back();
-        edge.from = edgeProto.from();
-        edge.to = edgeProto.to();
-        edge.weight = edgeProto.weight();
+        if (isVisited[start])
+        {
+            continue;
+        }
+        isVisited[start] = true;
+        order.push_back(start);
+        // The queue of the search is the tail of the order
+        for (size_t index = order.size() - 1; index < order.size(); index++)
+        {
+            for (const VertexId neighbour : neighbours[order[index]])
+            {
+                if (!isVisited[neighbour])
+                {
+                    isVisited[neighbour] = true;
+                    order.push_back(neighbour);
+                }
+            }
+        }
     }
 
-    graph.vertexes_.reserve(static_cast<unsigned int>(proto.incidence_lists_size()));
-    for (const auto& vertexesVectorProto : proto.incidence_lists())
+    std::vector<VertexId> newVertexIds(vertexCount);
+    for (size_t index = 0; index < vertexCount; index++)
     {
-        auto& vertexes = graph.vertexes_.emplace_back();
-        vertexes.reserve(static_cast<unsigned int>(vertexesVectorProto.edge_ids_size()));
-        for (const auto edgeId : vertexesVectorProto.edge_ids())
+        newVertexIds[order[index]] = vertexCount - 1 - index;
+    }
+    return newVertexIds;
+}
+
+template <typename Weight>
+DirectedWeightedGraph<Weight> DirectedWeightedGraph<Weight>::deserialize(
+    const GraphProto::DirectedWeightedGraph& proto)
+{
+    if (proto.out_edge_offsets().empty())
+    {
+        // Bases made before the compressed sparse rows keep the edges and the incidence lists
+        DirectedWeightedGraph graph(static_cast<size_t>(proto.incidence_lists_size()));
+        for (const auto& edgeProto : proto.edges())
         {
-            vertexes.push_back(edgeId);
+            graph.addEdge(
+                {edgeProto.from(), edgeProto.to(), static_cast<Weight>(edgeProto.weight())});
         }
+        graph.freeze();
+        return graph;
     }
 
+    const size_t edgeCount = static_cast<size_t>(proto.out_edge_ids_size());
+    ASSERT_WITH_MESSAGE(static_cast<size_t>(proto.out_edge_targets_size()) == edgeCount &&
+                            static_cast<size_t>(proto.out_edge_weights_size()) == edgeCount &&
+                            proto.out_edge_offsets(0) == 0 &&
+                            proto.out_edge_offsets(proto.out_edge_offsets_size() - 1) == edgeCount &&
+                            std::is_sorted(proto.out_edge_offsets().begin(),
+                                           proto.out_edge_offsets().end()),
+                        "wrong out-edges of the graph");
+
+    DirectedWeightedGraph graph(static_cast<size_t>(proto.out_edge_offsets_size() - 1));
+    graph.outEdgeOffsets_ = {proto.out_edge_offsets().begin(), proto.out_edge_offsets().end()};
+    // Every edge goes out of exactly one position
+    std::vector<bool> isEdgeRead(edgeCount, false);
+    graph.edges_.resize(edgeCount);
+    graph.outEdges_.resize(edgeCount);
+    graph.edgePositions_.resize(edgeCount);
+    for (VertexId vertex = 0; vertex < graph.vertexCount_; vertex++)
+    {
+        for (size_t position = graph.outEdgeOffsets_[vertex];
+             position < graph.outEdgeOffsets_[vertex + 1];
+             position++)
+        {
+            const EdgeId edgeId = proto.out_edge_ids(static_cast<int>(position));
+            const VertexId to = proto.out_edge_targets(static_cast<int>(position));
+            const auto weight =
+                static_cast<Weight>(proto.out_edge_weights(static_cast<int>(position)));
+            ASSERT_WITH_MESSAGE(edgeId < edgeCount && to < graph.vertexCount_,
+                                "wrong out-edge of the vertex " << vertex);
+            ASSERT_WITH_MESSAGE(!isEdgeRead[edgeId], "wrong out-edges of the graph");
+            isEdgeRead[edgeId] = true;
+            graph.edges_[edgeId] = {vertex, to, weight};
+            graph.outEdges_[position] = {edgeId, to, weight};
+            graph.edgePositions_[edgeId] = position;
+        }
+    }
     return graph;
 }
 
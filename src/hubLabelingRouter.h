@@ -0,0 +1,467 @@
+#pragma once
+
+#include "graph.h"
+#include "utils.h"
+
+#include "graph.pb.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <vector>
+
+namespace Graph
+{
+// Router based on hub labels. The forward label of a vertex keeps the weights of the routes from it
+// to some hub vertexes, the backward label keeps the ones from the hubs to it. For any route the
+// forward label of its start and the backward label of its end have a common hub on a shortest
+// route, so the weight is found by merging the two labels. The labels are built by pruned landmark
+// labeling: the vertexes become hubs from the greatest degree one, and the search from a hub
+// doesn't go on from a vertex whose route is already covered by the more important hubs
+template <typename Weight>
+class HubLabelingRouter
+{
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+    // Position of the hub in the order of importance, the labels are sorted by it
+    using HubRank = uint32_t;
+
+    static constexpr Weight NoRoute = std::numeric_limits<Weight>::infinity();
+
+    // Edge goes from the vertex toward the hub in a forward label and to the vertex from the hub's
+    // side in a backward one. The route is unpacked by following them through the labels of the
+    // same hub. It's NoEdge in the labels of the hub itself
+    struct LabelEntry
+    {
+        HubRank hub;
+        Weight weight;
+        CompactEdgeId edge;
+    };
+
+    // Labels of the vertex v are entries[offsets[v]] ... entries[offsets[v + 1] - 1]
+    struct Labels
+    {
+        std::vector<size_t> offsets;
+        std::vector<LabelEntry> entries;
+    };
+
+    // Weight of the route and its hub
+    struct Meeting
+    {
+        Weight weight;
+        HubRank hub;
+    };
+
+public:
+    explicit HubLabelingRouter(const Graph& graph);
+
+    void serialize(GraphProto::HubLabelingRouter& proto) const;
+    static std::unique_ptr<HubLabelingRouter> deserialize(
+        const GraphProto::HubLabelingRouter& proto, const Graph& graph);
+
+    std::optional<Weight> findRouteWeight(VertexId from, VertexId to) const;
+    // Calls callback(edgeId) for every edge of the route from the first one to the last one.
+    // Returns false if there is no route. Safe to call from several threads at once
+    template <typename Callback>
+    bool forEachRouteEdge(VertexId from, VertexId to, Callback callback) const;
+    // Weights of the routes from every source to every target row by row, infinity where there is
+    // no route. Every weight is a merge of two labels
+    std::vector<Weight> findRouteWeights(const std::vector<VertexId>& sources,
+                                         const std::vector<VertexId>& targets) const;
+
+    // Count of the entries in the labels of all the vertexes
+    size_t getLabelEntryCount() const;
+
+private:
+    HubLabelingRouter(const Graph& graph, const GraphProto::HubLabelingRouter& proto);
+
+    // Labels are built in vectors of every vertex, then put together
+    void buildLabels();
+    static Labels joinLabels(const std::vector<std::vector<LabelEntry>>& vertexLabels);
+
+    std::optional<Meeting> findMeeting(VertexId from, VertexId to) const;
+    const LabelEntry& findLabelEntry(const Labels& labels, VertexId vertex, HubRank hub) const;
+
+    static void serializeLabels(const Labels& labels, GraphProto::HubLabels& proto);
+    Labels deserializeLabels(const GraphProto::HubLabels& proto) const;
+
+private:
+    const Graph& graph_;
+    Labels forwardLabels_;
+    Labels backwardLabels_;
+};
+
+template <typename Weight>
+HubLabelingRouter<Weight>::HubLabelingRouter(const Graph& graph)
+    : graph_(graph)
+{
+    ASSERT_WITH_MESSAGE(graph.isFrozen(), "The graph has to be frozen for the router");
+    ASSERT_WITH_MESSAGE(graph.getEdgeCount() < NoEdge, "Too many edges for the router");
+    ASSERT_WITH_MESSAGE(graph.getVertexCount() <= std::numeric_limits<HubRank>::max(),
+                        "Too many vertexes for the router");
+    buildLabels();
+}
+
+// A search from the hub settles the vertexes in the order of their route weights. The route to
+// a vertex is covered if the labels already give a route of the same weight, then the vertex gets
+// no entry and isn't searched on, as the routes through it are covered as well. The vertex the
+// route comes from has always got an entry, so the routes can be unpacked
+template <typename Weight>
+void HubLabelingRouter<Weight>::buildLabels()
+{
+    const size_t vertexCount = graph_.getVertexCount();
+
+    // Edges coming into the vertex v are inEdges[inOffsets[v]] ... inEdges[inOffsets[v + 1] - 1]
+    std::vector<size_t> inOffsets(vertexCount + 1, 0);
+    std::vector<size_t> degrees(vertexCount, 0);
+    for (EdgeId edgeId = 0; edgeId < graph_.getEdgeCount(); ++edgeId)
+    {
+        const auto& edge = graph_.getEdge(edgeId);
+        ASSERT_WITH_MESSAGE(edge.weight >= 0,
+                            "Router works only with edges with non-negative weight");
+        inOffsets[edge.to + 1]++;
+        degrees[edge.from]++;
+        degrees[edge.to]++;
+    }
+    for (VertexId vertex = 0; vertex < vertexCount; ++vertex)
+    {
+        inOffsets[vertex + 1] += inOffsets[vertex];
+    }
+    std::vector<EdgeId> inEdges(graph_.getEdgeCount());
+    auto nextIndexes = inOffsets;
+    for (EdgeId edgeId = 0; edgeId < graph_.getEdgeCount(); ++edgeId)
+    {
+        inEdges[nextIndexes[graph_.getEdge(edgeId).to]++] = edgeId;
+    }
+
+    // Vertexes of greater degree cover more routes, so they go first
+    std::vector<VertexId> hubs(vertexCount);
+    for (VertexId vertex = 0; vertex < vertexCount; ++vertex)
+    {
+        hubs[vertex] = vertex;
+    }
+    std::stable_sort(std::begin(hubs), std::end(hubs), [&degrees](VertexId lhs, VertexId rhs) {
+        return degrees[lhs] > degrees[rhs];
+    });
+
+    std::vector<std::vector<LabelEntry>> forwardLabels(vertexCount);
+    std::vector<std::vector<LabelEntry>> backwardLabels(vertexCount);
+
+    // Weights of the routes between the current hub and the more important ones by their ranks
+    std::vector<Weight> hubWeights(vertexCount, NoRoute);
+    std::vector<Weight> weights(vertexCount, NoRoute);
+    std::vector<CompactEdgeId> prevEdges(vertexCount, NoEdge);
+    std::vector<bool> isSettled(vertexCount, false);
+    std::vector<VertexId> touchedVertexes;
+
+    using QueueItem = std::pair<Weight, VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+
+    // Routes from the hub fill the backward labels, the ones to it fill the forward labels
+    const auto search = [&](VertexId hub, HubRank rank, bool isForward) {
+        const auto& hubLabel = isForward ? forwardLabels[hub] : backwardLabels[hub];
+        auto& labels = isForward ? backwardLabels : forwardLabels;
+        for (const auto& entry : hubLabel)
+        {
+            hubWeights[entry.hub] = entry.weight;
+        }
+
+        weights[hub] = 0;
+        touchedVertexes.push_back(hub);
+        queue.push({0, hub});
+        while (!queue.empty())
+        {
+            const Weight weight = queue.top().first;
+            const VertexId vertex = queue.top().second;
+            queue.pop();
+            if (isSettled[vertex])
+            {
+                continue;
+            }
+            isSettled[vertex] = true;
+
+            if (vertex != hub)
+            {
+                Weight coveredWeight = NoRoute;
+                for (const auto& entry : labels[vertex])
+                {
+                    coveredWeight = std::min(coveredWeight, hubWeights[entry.hub] + entry.weight);
+                }
+                if (!(weight < coveredWeight))
+                {
+                    continue;
+                }
+            }
+            labels[vertex].push_back({rank, weight, prevEdges[vertex]});
+
+            const auto relax = [&](EdgeId edgeId, VertexId next, Weight edgeWeight) {
+                const Weight candidateWeight = weight + edgeWeight;
+                if (candidateWeight < weights[next])
+                {
+                    if (!(weights[next] < NoRoute))
+                    {
+                        touchedVertexes.push_back(next);
+                    }
+                    weights[next] = candidateWeight;
+                    prevEdges[next] = static_cast<CompactEdgeId>(edgeId);
+                    queue.push({candidateWeight, next});
+                }
+            };
+            if (isForward)
+            {
+                for (const auto& edge : graph_.getEdgesWhichStartFrom(vertex))
+                {
+                    relax(edge.id, edge.to, edge.weight);
+                }
+            }
+            else
+            {
+                for (size_t index = inOffsets[vertex]; index < inOffsets[vertex + 1]; ++index)
+                {
+                    const auto& edge = graph_.getEdge(inEdges[index]);
+                    relax(inEdges[index], edge.from, edge.weight);
+                }
+            }
+        }
+
+        for (const auto& entry : hubLabel)
+        {
+            hubWeights[entry.hub] = NoRoute;
+        }
+        for (const VertexId vertex : touchedVertexes)
+        {
+            weights[vertex] = NoRoute;
+            prevEdges[vertex] = NoEdge;
+            isSettled[vertex] = false;
+        }
+        touchedVertexes.clear();
+    };
+
+    for (HubRank rank = 0; rank < vertexCount; ++rank)
+    {
+        search(hubs[rank], rank, true);
+        search(hubs[rank], rank, false);
+    }
+
+    forwardLabels_ = joinLabels(forwardLabels);
+    backwardLabels_ = joinLabels(backwardLabels);
+}
+
+template <typename Weight>
+typename HubLabelingRouter<Weight>::Labels HubLabelingRouter<Weight>::joinLabels(
+    const std::vector<std::vector<LabelEntry>>& vertexLabels)
+{
+    Labels labels;
+    labels.offsets.reserve(vertexLabels.size() + 1);
+    labels.offsets.push_back(0);
+    for (const auto& label : vertexLabels)
+    {
+        labels.entries.insert(std::end(labels.entries), std::begin(label), std::end(label));
+        labels.offsets.push_back(labels.entries.size());
+    }
+    return labels;
+}
+
+// Among the hubs of equal route weight the most important one is taken
+template <typename Weight>
+std::optional<typename HubLabelingRouter<Weight>::Meeting> HubLabelingRouter<
+    Weight>::findMeeting(VertexId from, VertexId to) const
+{
+    std::optional<Meeting> meeting;
+    size_t forwardIndex = forwardLabels_.offsets[from];
+    const size_t forwardEnd = forwardLabels_.offsets[from + 1];
+    size_t backwardIndex = backwardLabels_.offsets[to];
+    const size_t backwardEnd = backwardLabels_.offsets[to + 1];
+    while (forwardIndex < forwardEnd && backwardIndex < backwardEnd)
+    {
+        const auto& forwardEntry = forwardLabels_.entries[forwardIndex];
+        const auto& backwardEntry = backwardLabels_.entries[backwardIndex];
+        if (forwardEntry.hub < backwardEntry.hub)
+        {
+            ++forwardIndex;
+        }
+        else if (backwardEntry.hub < forwardEntry.hub)
+        {
+            ++backwardIndex;
+        }
+        else
+        {
+            const Weight weight = forwardEntry.weight + backwardEntry.weight;
+            if (!meeting || weight < meeting->weight)
+            {
+                meeting = Meeting{weight, forwardEntry.hub};
+            }
+            ++forwardIndex;
+            ++backwardIndex;
+        }
+    }
+    return meeting;
+}
+
+template <typename Weight>
+const typename HubLabelingRouter<Weight>::LabelEntry& HubLabelingRouter<Weight>::findLabelEntry(
+    const Labels& labels, VertexId vertex, HubRank hub) const
+{
+    const auto entries = std::begin(labels.entries);
+    const auto begin = entries + static_cast<std::ptrdiff_t>(labels.offsets[vertex]);
+    const auto end = entries + static_cast<std::ptrdiff_t>(labels.offsets[vertex + 1]);
+    const auto it = std::lower_bound(begin, end, hub, [](const LabelEntry& entry, HubRank rank) {
+        return entry.hub < rank;
+    });
+    ASSERT_WITH_MESSAGE(it != end && it->hub == hub,
+                        "hub " << hub << " is missing in the labels of the vertex " << vertex);
+    return *it;
+}
+
+template <typename Weight>
+std::optional<Weight> HubLabelingRouter<Weight>::findRouteWeight(VertexId from, VertexId to) const
+{
+    const auto meeting = findMeeting(from, to);
+    if (!meeting)
+    {
+        return std::nullopt;
+    }
+    return meeting->weight;
+}
+
+// The edges up to the hub follow the forward labels from the start. The ones after it are found
+// from the end backwards, so they are called once all of them are found
+template <typename Weight>
+template <typename Callback>
+bool HubLabelingRouter<Weight>::forEachRouteEdge(VertexId from,
+                                                 VertexId to,
+                                                 Callback callback) const
+{
+    const auto meeting = findMeeting(from, to);
+    if (!meeting)
+    {
+        return false;
+    }
+
+    for (VertexId vertex = from;;)
+    {
+        const CompactEdgeId edgeId = findLabelEntry(forwardLabels_, vertex, meeting->hub).edge;
+        if (edgeId == NoEdge)
+        {
+            break;
+        }
+        callback(EdgeId{edgeId});
+        vertex = graph_.getEdge(edgeId).to;
+    }
+    std::vector<EdgeId> hubEdges;
+    for (VertexId vertex = to;;)
+    {
+        const CompactEdgeId edgeId = findLabelEntry(backwardLabels_, vertex, meeting->hub).edge;
+        if (edgeId == NoEdge)
+        {
+            break;
+        }
+        hubEdges.push_back(edgeId);
+        vertex = graph_.getEdge(edgeId).from;
+    }
+    for (auto it = std::rbegin(hubEdges); it != std::rend(hubEdges); ++it)
+    {
+        callback(*it);
+    }
+    return true;
+}
+
+template <typename Weight>
+std::vector<Weight> HubLabelingRouter<Weight>::findRouteWeights(
+    const std::vector<VertexId>& sources, const std::vector<VertexId>& targets) const
+{
+    std::vector<Weight> weights;
+    weights.reserve(sources.size() * targets.size());
+    for (const VertexId from : sources)
+    {
+        for (const VertexId to : targets)
+        {
+            const auto meeting = findMeeting(from, to);
+            weights.push_back(meeting ? meeting->weight : NoRoute);
+        }
+    }
+    return weights;
+}
+
+template <typename Weight>
+size_t HubLabelingRouter<Weight>::getLabelEntryCount() const
+{
+    return forwardLabels_.entries.size() + backwardLabels_.entries.size();
+}
+
+template <typename Weight>
+void HubLabelingRouter<Weight>::serializeLabels(const Labels& labels, GraphProto::HubLabels& proto)
+{
+    *proto.mutable_offsets() = {labels.offsets.begin(), labels.offsets.end()};
+    const int entryCount = static_cast<int>(labels.entries.size());
+    proto.mutable_hubs()->Reserve(entryCount);
+    proto.mutable_weights()->Reserve(entryCount);
+    proto.mutable_edges()->Reserve(entryCount);
+    for (const auto& entry : labels.entries)
+    {
+        proto.add_hubs(entry.hub);
+        proto.add_weights(static_cast<double>(entry.weight));
+        proto.add_edges(entry.edge);
+    }
+}
+
+template <typename Weight>
+void HubLabelingRouter<Weight>::serialize(GraphProto::HubLabelingRouter& proto) const
+{
+    serializeLabels(forwardLabels_, *proto.mutable_forward_labels());
+    serializeLabels(backwardLabels_, *proto.mutable_backward_labels());
+}
+
+template <typename Weight>
+typename HubLabelingRouter<Weight>::Labels HubLabelingRouter<Weight>::deserializeLabels(
+    const GraphProto::HubLabels& proto) const
+{
+    const size_t vertexCount = graph_.getVertexCount();
+    const size_t entryCount = static_cast<size_t>(proto.hubs_size());
+    ASSERT_WITH_MESSAGE(static_cast<size_t>(proto.offsets_size()) == vertexCount + 1 &&
+                            proto.offsets(0) == 0 &&
+                            proto.offsets(proto.offsets_size() - 1) == entryCount &&
+                            std::is_sorted(proto.offsets().begin(), proto.offsets().end()) &&
+                            proto.weights_size() == proto.hubs_size() &&
+                            proto.edges_size() == proto.hubs_size(),
+                        "hub labels don't match the graph");
+
+    Labels labels;
+    labels.offsets = {proto.offsets().begin(), proto.offsets().end()};
+    labels.entries.reserve(entryCount);
+    for (size_t index = 0; index < entryCount; ++index)
+    {
+        const int protoIndex = static_cast<int>(index);
+        const uint32_t hub = proto.hubs(protoIndex);
+        const uint32_t edgeId = proto.edges(protoIndex);
+        ASSERT_WITH_MESSAGE(hub < vertexCount, "wrong hub rank " << hub);
+        ASSERT_WITH_MESSAGE(edgeId < graph_.getEdgeCount() || edgeId == NoEdge,
+                            "wrong edge id " << edgeId);
+        labels.entries.push_back({hub, static_cast<Weight>(proto.weights(protoIndex)), edgeId});
+    }
+    return labels;
+}
+
+template <typename Weight>
+HubLabelingRouter<Weight>::HubLabelingRouter(const Graph& graph,
+                                             const GraphProto::HubLabelingRouter& proto)
+    : graph_(graph)
+    , forwardLabels_(deserializeLabels(proto.forward_labels()))
+    , backwardLabels_(deserializeLabels(proto.backward_labels()))
+{
+}
+
+template <typename Weight>
+std::unique_ptr<HubLabelingRouter<Weight>> HubLabelingRouter<Weight>::deserialize(
+    const GraphProto::HubLabelingRouter& proto, const Graph& graph)
+{
+    return std::unique_ptr<HubLabelingRouter>(
+        new HubLabelingRouter(graph, proto)); // Ctor is private, so can't use make_unique
+}
+
+} // namespace Graph
@@ -1,6 +1,8 @@
 #include "json.h"
 #include "utils.h"
 
+#include <limits>
+
 using namespace std;
 
 namespace Json
@@ -33,6 +35,17 @@ Node loadBool(istream& input)
     return Node(s == "true");
 }
 
+Node loadNull(istream& input)
+{
+    string s;
+    while (isalpha(input.peek()))
+    {
+        s.push_back(static_cast<char>(input.get()));
+    }
+    ASSERT_WITH_MESSAGE(s == "null", "Can't cast string " + s + " to null");
+    return Node(nullptr);
+}
+
 Node loadNumber(istream& input)
 {
     bool isNegative = input.peek() == '-';
@@ -116,6 +129,11 @@ Node loadNode(istream& input)
         input.putback(c);
         return loadBool(input);
     }
+    else if (c == 'n')
+    {
+        input.putback(c);
+        return loadNull(input);
+    }
     else if (isdigit(c) || c == '-')
     {
         input.putback(c);
@@ -151,6 +169,11 @@ void printValue(const bool& value, ostream& output)
     output << std::boolalpha << value;
 }
 
+void printValue(std::nullptr_t, ostream& output)
+{
+    output << "null";
+}
+
 void printValue(const Array& nodes, ostream& output)
 {
     output << '[';
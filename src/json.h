@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <iostream>
 #include <map>
 #include <string>
@@ -13,7 +14,7 @@ class Node;
 using Array = std::vector<Node>;
 using Map = std::map<std::string, Node>;
 
-class Node final : public std::variant<Map, std::string, Array, int, double, bool>
+class Node final : public std::variant<Map, std::string, Array, int, double, bool, std::nullptr_t>
 {
 public:
     using variant::variant;
@@ -79,6 +80,11 @@ public:
     {
         return std::get<bool>(*this);
     }
+
+    bool isNull() const
+    {
+        return std::holds_alternative<std::nullptr_t>(*this);
+    }
 };
 
 class Tree
@@ -114,6 +120,8 @@ void printValue(const std::string& value, std::ostream& output);
 
 void printValue(const bool& value, std::ostream& output);
 
+void printValue(std::nullptr_t, std::ostream& output);
+
 void printValue(const Array& nodes, std::ostream& output);
 
 void printValue(const Map& map, std::ostream& output);
@@ -4,26 +4,35 @@
 #include "transportCatalog.h"
 #include "utils.h"
 
-#include <fstream>
+#include <cstdio>
+#include <iostream>
 
 using namespace std;
 
 namespace
 {
-constexpr auto WrongParametrsMsg("Usage: transport_catalog [make_base|process_requests]\n");
+constexpr auto WrongParametrsMsg(
+    "Usage: transport_catalog [make_base|update_base|process_requests]\n");
 
-string readFileData(const string& fileName)
+void saveDatabase(const TransportCatalog& database,
+                  const Json::Map& serialisationSettings,
+                  const string& fileName)
 {
-    ifstream file(fileName, ios::binary | ios::ate);
-    ASSERT_WITH_MESSAGE(file, "can't read open the file " + fileName);
-    const ifstream::pos_type endPos = file.tellg();
-    file.seekg(0, ios::beg);
-
-    string data(static_cast<size_t>(endPos), '\0');
-    file.read(&data[0], endPos);
-    return data;
-}
+    const auto formatIt = serialisationSettings.find("format");
+    const string format =
+        formatIt != serialisationSettings.end() ? formatIt->second.asString() : "protobuf";
+    ASSERT_WITH_MESSAGE(format == "protobuf" || format == "mapped",
+                        "unknown serialization format " << format);
+    if (format == "mapped")
+    {
+        database.saveMapped(fileName);
+    }
+    else
+    {
+        database.save(fileName);
+    }
 }
+} // namespace
 
 int main(int argc, const char* argv[])
 {
@@ -36,8 +45,8 @@ int main(int argc, const char* argv[])
     const auto inputJsonTree = Json::load(cin);
     const auto& inputMap = inputJsonTree.getRoot().asMap();
 
-    const string& serialisationFileName =
-        inputMap.at("serialization_settings").asMap().at("file").asString();
+    const auto& serialisationSettings = inputMap.at("serialization_settings").asMap();
+    const string& serialisationFileName = serialisationSettings.at("file").asString();
 
     const string_view mode(argv[1]);
     if (mode == "make_base")
@@ -46,12 +55,21 @@ int main(int argc, const char* argv[])
             BaseRequests::parseRequests(inputMap.at("base_requests").asArray());
         const auto& routingSettings = inputMap.at("routing_settings").asMap();
         TransportCatalog database(baseRequests, routingSettings);
-        ofstream(serialisationFileName) << database.serialize();
+        saveDatabase(database, serialisationSettings, serialisationFileName);
+    }
+    else if (mode == "update_base")
+    {
+        auto database = TransportCatalog::load(serialisationFileName);
+        database.update(BaseRequests::parseRequests(inputMap.at("base_requests").asArray()));
+        // The old base may still be mapped, so the new one takes its place once it's written
+        const string updatedFileName = serialisationFileName + ".updated";
+        saveDatabase(database, serialisationSettings, updatedFileName);
+        ASSERT_WITH_MESSAGE(rename(updatedFileName.c_str(), serialisationFileName.c_str()) == 0,
+                            "can't replace the base " << serialisationFileName);
     }
     else if (mode == "process_requests")
     {
-        const auto database =
-            TransportCatalog::deserialize(readFileData(serialisationFileName));
+        const auto database = TransportCatalog::load(serialisationFileName);
         const auto& statRequests = inputMap.at("stat_requests").asArray();
         const auto responses = StatRequests::processAll(database, statRequests);
         Json::printValue(responses, cout);
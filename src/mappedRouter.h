@@ -0,0 +1,317 @@
+#pragma once
+
+#include "alignedAllocator.h"
+#include "graph.h"
+#include "mappedFile.h"
+#include "router.h"
+#include "utils.h"
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace Graph
+{
+// Routes matrices of Router read in place from a section of a mapped file, nothing is copied when
+// the router is made. The section starts with Header, the arrays follow it in the order of Layout,
+// each one aligned to CacheLineSize. The routes can't be updated
+template <typename Weight>
+class MappedRouter
+{
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+    static_assert(std::is_trivially_copyable_v<Weight>,
+                  "Weights are read from the file as they are");
+
+    static constexpr Weight NoRoute = std::numeric_limits<Weight>::infinity();
+
+    struct Header
+    {
+        uint64_t vertexCount;
+        uint64_t edgeCount;
+        uint64_t componentCount;
+        uint64_t cellCount;
+    };
+
+    // Offsets of the arrays from the beginning of the section
+    struct Layout
+    {
+        // uint32_t, the component of every vertex and the index of the vertex in it
+        size_t vertexComponents;
+        size_t vertexIndexes;
+        // uint64_t, the offset of the routes of every component from the beginning of the
+        // matrices and the count of its vertexes
+        size_t componentOffsets;
+        size_t componentSizes;
+        // The matrices of all the components one after another, row by row
+        size_t weights;
+        size_t prevEdges;
+        size_t size;
+    };
+
+public:
+    MappedRouter(const Graph& graph, MappedSection section);
+
+    // Writes the section of the routes of the router to the stream
+    static void write(const Graph& graph,
+                      const Router<Weight>& router,
+                      google::protobuf::io::ZeroCopyOutputStream& stream);
+
+    std::optional<Weight> findRouteWeight(VertexId from, VertexId to) const;
+    // Calls callback(edgeId) for every edge of the route from the last one to the first one.
+    // Returns false if there is no route. Safe to call from several threads at once
+    template <typename Callback>
+    bool forEachRouteEdgeBackwards(VertexId from, VertexId to, Callback callback) const;
+    // Weights of the routes from every source to every target row by row, infinity where there is
+    // no route
+    std::vector<Weight> findRouteWeights(const std::vector<VertexId>& sources,
+                                         const std::vector<VertexId>& targets) const;
+
+    const MappedSection& getSection() const;
+
+private:
+    static Layout makeLayout(const Header& header);
+    // Index of the route in the matrices, both vertexes have to be in the same component
+    size_t getRouteIndex(VertexId from, VertexId to) const;
+
+private:
+    const Graph& graph_;
+    MappedSection section_;
+
+    const uint32_t* vertexComponents_ = nullptr;
+    const uint32_t* vertexIndexes_ = nullptr;
+    const uint64_t* componentOffsets_ = nullptr;
+    const uint64_t* componentSizes_ = nullptr;
+    const Weight* weights_ = nullptr;
+    const CompactEdgeId* prevEdges_ = nullptr;
+};
+
+template <typename Weight>
+typename MappedRouter<Weight>::Layout MappedRouter<Weight>::makeLayout(const Header& header)
+{
+    const auto alignUp = [](size_t offset) {
+        return (offset + CacheLineSize - 1) / CacheLineSize * CacheLineSize;
+    };
+
+    Layout layout = {};
+    layout.vertexComponents = alignUp(sizeof(Header));
+    layout.vertexIndexes =
+        alignUp(layout.vertexComponents + header.vertexCount * sizeof(uint32_t));
+    layout.componentOffsets = alignUp(layout.vertexIndexes + header.vertexCount * sizeof(uint32_t));
+    layout.componentSizes =
+        alignUp(layout.componentOffsets + header.componentCount * sizeof(uint64_t));
+    layout.weights = alignUp(layout.componentSizes + header.componentCount * sizeof(uint64_t));
+    layout.prevEdges = alignUp(layout.weights + header.cellCount * sizeof(Weight));
+    layout.size = layout.prevEdges + header.cellCount * sizeof(CompactEdgeId);
+    return layout;
+}
+
+template <typename Weight>
+void MappedRouter<Weight>::write(const Graph& graph,
+                                 const Router<Weight>& router,
+                                 google::protobuf::io::ZeroCopyOutputStream& stream)
+{
+    const auto components = findWeaklyConnectedComponents(graph);
+    const Header header{graph.getVertexCount(),
+                        graph.getEdgeCount(),
+                        components.size(),
+                        router.getCellCount()};
+    ASSERT_WITH_MESSAGE(header.vertexCount < std::numeric_limits<uint32_t>::max(),
+                        "Too many vertexes for the mapped router");
+    ASSERT_WITH_MESSAGE(header.edgeCount < NoEdge, "Too many edges for the mapped router");
+    const Layout layout = makeLayout(header);
+
+    std::vector<uint32_t> vertexComponents(header.vertexCount);
+    std::vector<uint32_t> vertexIndexes(header.vertexCount);
+    std::vector<uint64_t> componentOffsets(header.componentCount);
+    std::vector<uint64_t> componentSizes(header.componentCount);
+    uint64_t cellCount = 0;
+    for (size_t component = 0; component < components.size(); ++component)
+    {
+        const auto& vertexes = components[component];
+        componentOffsets[component] = cellCount;
+        componentSizes[component] = vertexes.size();
+        for (size_t index = 0; index < vertexes.size(); ++index)
+        {
+            vertexComponents[vertexes[index]] = static_cast<uint32_t>(component);
+            vertexIndexes[vertexes[index]] = static_cast<uint32_t>(index);
+        }
+        cellCount += vertexes.size() * vertexes.size();
+    }
+    ASSERT_WITH_MESSAGE(cellCount == header.cellCount, "Routes don't match the graph");
+
+    // The arrays are written one after another, zeros fill the gaps up to their offsets
+    google::protobuf::io::CodedOutputStream output(&stream);
+    size_t position = 0;
+    const auto writeItems = [&output, &position](const auto* items, size_t count) {
+        const size_t size = count * sizeof(*items);
+        ASSERT_WITH_MESSAGE(size <= static_cast<size_t>(std::numeric_limits<int>::max()),
+                            "Too many items to write at once");
+        output.WriteRaw(items, static_cast<int>(size));
+        position += size;
+    };
+    const auto skipTo = [&writeItems, &position](size_t offset) {
+        ASSERT_WITH_MESSAGE(offset >= position && offset - position < CacheLineSize,
+                            "wrong layout of the mapped routes");
+        const char zeros[CacheLineSize] = {};
+        writeItems(zeros, offset - position);
+    };
+
+    writeItems(&header, 1);
+    skipTo(layout.vertexComponents);
+    writeItems(vertexComponents.data(), vertexComponents.size());
+    skipTo(layout.vertexIndexes);
+    writeItems(vertexIndexes.data(), vertexIndexes.size());
+    skipTo(layout.componentOffsets);
+    writeItems(componentOffsets.data(), componentOffsets.size());
+    skipTo(layout.componentSizes);
+    writeItems(componentSizes.data(), componentSizes.size());
+
+    // The matrices are written cell by cell in the order of the components, row by row
+    const auto writeMatrix = [&components, &router, &writeItems](const auto& getItem) {
+        for (const auto& vertexes : components)
+        {
+            for (const VertexId from : vertexes)
+            {
+                for (const VertexId to : vertexes)
+                {
+                    const auto item = getItem(router.getRoute(from, to));
+                    writeItems(&item, 1);
+                }
+            }
+        }
+    };
+    skipTo(layout.weights);
+    writeMatrix([](const auto& route) { return route ? route->getWeight() : NoRoute; });
+    skipTo(layout.prevEdges);
+    writeMatrix([](const auto& route) {
+        return route && route->begin() != route->end()
+                   ? static_cast<CompactEdgeId>(*route->begin())
+                   : NoEdge;
+    });
+}
+
+// Only the header and the small arrays are checked, the previous edges are checked when they are
+// walked, so the matrices aren't read until the routes are asked for
+template <typename Weight>
+MappedRouter<Weight>::MappedRouter(const Graph& graph, MappedSection section)
+    : graph_(graph)
+    , section_(std::move(section))
+{
+    ASSERT_WITH_MESSAGE(graph.isFrozen(), "The graph has to be frozen for the router");
+
+    Header header = {};
+    std::memcpy(&header, section_.getArray<char>(0, sizeof(Header)), sizeof(Header));
+    ASSERT_WITH_MESSAGE(header.vertexCount == graph.getVertexCount() &&
+                            header.edgeCount == graph.getEdgeCount() &&
+                            header.componentCount <= header.vertexCount &&
+                            header.cellCount <= section_.getSize() / sizeof(Weight),
+                        "mapped routes don't match the graph");
+    const Layout layout = makeLayout(header);
+    ASSERT_WITH_MESSAGE(layout.size <= section_.getSize(), "mapped routes are truncated");
+
+    vertexComponents_ = section_.getArray<uint32_t>(layout.vertexComponents, header.vertexCount);
+    vertexIndexes_ = section_.getArray<uint32_t>(layout.vertexIndexes, header.vertexCount);
+    componentOffsets_ = section_.getArray<uint64_t>(layout.componentOffsets, header.componentCount);
+    componentSizes_ = section_.getArray<uint64_t>(layout.componentSizes, header.componentCount);
+    weights_ = section_.getArray<Weight>(layout.weights, header.cellCount);
+    prevEdges_ = section_.getArray<CompactEdgeId>(layout.prevEdges, header.cellCount);
+
+    for (size_t component = 0; component < header.componentCount; ++component)
+    {
+        const uint64_t size = componentSizes_[component];
+        ASSERT_WITH_MESSAGE(size <= header.vertexCount &&
+                                componentOffsets_[component] <= header.cellCount &&
+                                size * size <= header.cellCount - componentOffsets_[component],
+                            "mapped routes don't match the graph");
+    }
+    for (VertexId vertex = 0; vertex < header.vertexCount; ++vertex)
+    {
+        ASSERT_WITH_MESSAGE(vertexComponents_[vertex] < header.componentCount &&
+                                vertexIndexes_[vertex] < componentSizes_[vertexComponents_[vertex]],
+                            "mapped routes don't match the graph");
+    }
+}
+
+template <typename Weight>
+size_t MappedRouter<Weight>::getRouteIndex(VertexId from, VertexId to) const
+{
+    const uint32_t component = vertexComponents_[from];
+    return componentOffsets_[component] + vertexIndexes_[from] * componentSizes_[component] +
+           vertexIndexes_[to];
+}
+
+template <typename Weight>
+std::optional<Weight> MappedRouter<Weight>::findRouteWeight(VertexId from, VertexId to) const
+{
+    if (vertexComponents_[from] != vertexComponents_[to])
+    {
+        return std::nullopt;
+    }
+    const Weight weight = weights_[getRouteIndex(from, to)];
+    if (!(weight < NoRoute))
+    {
+        return std::nullopt;
+    }
+    return weight;
+}
+
+template <typename Weight>
+template <typename Callback>
+bool MappedRouter<Weight>::forEachRouteEdgeBackwards(VertexId from,
+                                                     VertexId to,
+                                                     Callback callback) const
+{
+    if (!findRouteWeight(from, to))
+    {
+        return false;
+    }
+
+    // A route has less edges than the graph has vertexes, so a broken file can't make it go round
+    size_t edgeCount = 0;
+    for (CompactEdgeId edgeId = prevEdges_[getRouteIndex(from, to)]; edgeId != NoEdge;
+         edgeId = prevEdges_[getRouteIndex(from, to)])
+    {
+        ++edgeCount;
+        ASSERT_WITH_MESSAGE(edgeId < graph_.getEdgeCount() && edgeCount < graph_.getVertexCount(),
+                            "wrong edge id " << edgeId);
+        callback(static_cast<EdgeId>(edgeId));
+        to = graph_.getEdge(edgeId).from;
+        ASSERT_WITH_MESSAGE(vertexComponents_[to] == vertexComponents_[from],
+                            "wrong edge id " << edgeId);
+    }
+    return true;
+}
+
+template <typename Weight>
+std::vector<Weight> MappedRouter<Weight>::findRouteWeights(
+    const std::vector<VertexId>& sources, const std::vector<VertexId>& targets) const
+{
+    std::vector<Weight> weights;
+    weights.reserve(sources.size() * targets.size());
+    for (const VertexId from : sources)
+    {
+        for (const VertexId to : targets)
+        {
+            weights.push_back(findRouteWeight(from, to).value_or(NoRoute));
+        }
+    }
+    return weights;
+}
+
+template <typename Weight>
+const MappedSection& MappedRouter<Weight>::getSection() const
+{
+    return section_;
+}
+
+} // namespace Graph
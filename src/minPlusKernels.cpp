@@ -0,0 +1,292 @@
+#include "minPlusKernels.h"
+#include "utils.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MIN_PLUS_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace Graph
+{
+namespace MinPlus
+{
+namespace
+{
+#ifdef MIN_PLUS_X86_KERNELS
+// Four routes at a time: weights are compared and blended as doubles, previous edges as 32-bit
+// integers with the comparison mask narrowed to 32-bit lanes. Candidates of missing routes are
+// infinite, so they never pass the comparison and need no separate check
+__attribute__((target("avx2"))) void relaxRowAvx2(double weightFrom,
+                                                  CompactEdgeId prevEdgeFrom,
+                                                  const double* weightsThrough,
+                                                  const CompactEdgeId* prevEdgesThrough,
+                                                  double* weights,
+                                                  CompactEdgeId* prevEdges,
+                                                  size_t count)
+{
+    constexpr size_t LaneCount = 4;
+
+    const __m256d weightFromLanes = _mm256_set1_pd(weightFrom);
+    const __m128i prevEdgeFromLanes = _mm_set1_epi32(static_cast<int>(prevEdgeFrom));
+    const __m128i noEdgeLanes = _mm_set1_epi32(static_cast<int>(NoEdge));
+    const __m256i evenHalvesIndexes = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+
+    size_t index = 0;
+    for (; index + LaneCount <= count; index += LaneCount)
+    {
+        const __m256d candidateWeights =
+            _mm256_add_pd(weightFromLanes, _mm256_loadu_pd(weightsThrough + index));
+        const __m256d currentWeights = _mm256_loadu_pd(weights + index);
+        const __m256d isShorter = _mm256_cmp_pd(candidateWeights, currentWeights, _CMP_LT_OQ);
+        if (_mm256_testz_pd(isShorter, isShorter))
+        {
+            continue;
+        }
+        _mm256_storeu_pd(weights + index,
+                         _mm256_blendv_pd(currentWeights, candidateWeights, isShorter));
+
+        const __m128i isShorterNarrowed = _mm256_castsi256_si128(
+            _mm256_permutevar8x32_epi32(_mm256_castpd_si256(isShorter), evenHalvesIndexes));
+        const __m128i prevEdgesThroughLanes =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(prevEdgesThrough + index));
+        const __m128i candidatePrevEdges =
+            _mm_blendv_epi8(prevEdgesThroughLanes,
+                            prevEdgeFromLanes,
+                            _mm_cmpeq_epi32(prevEdgesThroughLanes, noEdgeLanes));
+        auto* prevEdgesLanes = reinterpret_cast<__m128i*>(prevEdges + index);
+        _mm_storeu_si128(prevEdgesLanes,
+                         _mm_blendv_epi8(
+                             _mm_loadu_si128(prevEdgesLanes), candidatePrevEdges, isShorterNarrowed));
+    }
+
+    relaxRowScalar(weightFrom,
+                   prevEdgeFrom,
+                   weightsThrough + index,
+                   prevEdgesThrough + index,
+                   weights + index,
+                   prevEdges + index,
+                   count - index);
+}
+
+// Eight routes at a time, a float and a previous edge have the same width, so the comparison mask
+// blends both of them
+__attribute__((target("avx2"))) void relaxRowAvx2(float weightFrom,
+                                                  CompactEdgeId prevEdgeFrom,
+                                                  const float* weightsThrough,
+                                                  const CompactEdgeId* prevEdgesThrough,
+                                                  float* weights,
+                                                  CompactEdgeId* prevEdges,
+                                                  size_t count)
+{
+    constexpr size_t LaneCount = 8;
+
+    const __m256 weightFromLanes = _mm256_set1_ps(weightFrom);
+    const __m256i prevEdgeFromLanes = _mm256_set1_epi32(static_cast<int>(prevEdgeFrom));
+    const __m256i noEdgeLanes = _mm256_set1_epi32(static_cast<int>(NoEdge));
+
+    size_t index = 0;
+    for (; index + LaneCount <= count; index += LaneCount)
+    {
+        const __m256 candidateWeights =
+            _mm256_add_ps(weightFromLanes, _mm256_loadu_ps(weightsThrough + index));
+        const __m256 currentWeights = _mm256_loadu_ps(weights + index);
+        const __m256 isShorter = _mm256_cmp_ps(candidateWeights, currentWeights, _CMP_LT_OQ);
+        if (_mm256_testz_ps(isShorter, isShorter))
+        {
+            continue;
+        }
+        _mm256_storeu_ps(weights + index,
+                         _mm256_blendv_ps(currentWeights, candidateWeights, isShorter));
+
+        const __m256i prevEdgesThroughLanes =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prevEdgesThrough + index));
+        const __m256i candidatePrevEdges =
+            _mm256_blendv_epi8(prevEdgesThroughLanes,
+                               prevEdgeFromLanes,
+                               _mm256_cmpeq_epi32(prevEdgesThroughLanes, noEdgeLanes));
+        auto* prevEdgesLanes = reinterpret_cast<__m256i*>(prevEdges + index);
+        _mm256_storeu_si256(prevEdgesLanes,
+                            _mm256_blendv_epi8(_mm256_loadu_si256(prevEdgesLanes),
+                                               candidatePrevEdges,
+                                               _mm256_castps_si256(isShorter)));
+    }
+
+    relaxRowScalar(weightFrom,
+                   prevEdgeFrom,
+                   weightsThrough + index,
+                   prevEdgesThrough + index,
+                   weights + index,
+                   prevEdges + index,
+                   count - index);
+}
+
+// Eight routes at a time on the units of the weights. AVX2 has neither unsigned comparison nor
+// saturating addition of 32-bit integers, so the sign bits are flipped to compare them as signed
+// ones and a wrapped sum is detected by being less than the weight from. Infinite weights through
+// wrap around too unless the weight from is zero, then the sum is infinite and isn't shorter
+__attribute__((target("avx2"))) void relaxRowAvx2(FixedPointWeight weightFrom,
+                                                  CompactEdgeId prevEdgeFrom,
+                                                  const FixedPointWeight* weightsThrough,
+                                                  const CompactEdgeId* prevEdgesThrough,
+                                                  FixedPointWeight* weights,
+                                                  CompactEdgeId* prevEdges,
+                                                  size_t count)
+{
+    constexpr size_t LaneCount = 8;
+
+    const __m256i signBits = _mm256_set1_epi32(numeric_limits<int32_t>::min());
+    const __m256i weightFromLanes = _mm256_set1_epi32(static_cast<int>(weightFrom.getUnits()));
+    const __m256i signedWeightFromLanes = _mm256_xor_si256(weightFromLanes, signBits);
+    const __m256i prevEdgeFromLanes = _mm256_set1_epi32(static_cast<int>(prevEdgeFrom));
+    const __m256i noEdgeLanes = _mm256_set1_epi32(static_cast<int>(NoEdge));
+
+    size_t index = 0;
+    for (; index + LaneCount <= count; index += LaneCount)
+    {
+        const __m256i candidateWeights = _mm256_add_epi32(
+            weightFromLanes,
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weightsThrough + index)));
+        const __m256i signedCandidateWeights = _mm256_xor_si256(candidateWeights, signBits);
+        auto* weightsLanes = reinterpret_cast<__m256i*>(weights + index);
+        const __m256i currentWeights = _mm256_loadu_si256(weightsLanes);
+        const __m256i isShorter = _mm256_andnot_si256(
+            _mm256_cmpgt_epi32(signedWeightFromLanes, signedCandidateWeights),
+            _mm256_cmpgt_epi32(_mm256_xor_si256(currentWeights, signBits),
+                               signedCandidateWeights));
+        if (_mm256_testz_si256(isShorter, isShorter))
+        {
+            continue;
+        }
+        _mm256_storeu_si256(weightsLanes,
+                            _mm256_blendv_epi8(currentWeights, candidateWeights, isShorter));
+
+        const __m256i prevEdgesThroughLanes =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prevEdgesThrough + index));
+        const __m256i candidatePrevEdges =
+            _mm256_blendv_epi8(prevEdgesThroughLanes,
+                               prevEdgeFromLanes,
+                               _mm256_cmpeq_epi32(prevEdgesThroughLanes, noEdgeLanes));
+        auto* prevEdgesLanes = reinterpret_cast<__m256i*>(prevEdges + index);
+        _mm256_storeu_si256(
+            prevEdgesLanes,
+            _mm256_blendv_epi8(_mm256_loadu_si256(prevEdgesLanes), candidatePrevEdges, isShorter));
+    }
+
+    relaxRowScalar(weightFrom,
+                   prevEdgeFrom,
+                   weightsThrough + index,
+                   prevEdgesThrough + index,
+                   weights + index,
+                   prevEdges + index,
+                   count - index);
+}
+#endif
+
+template <typename Weight>
+void relaxRowByKernel(Kernel kernel,
+                      Weight weightFrom,
+                      CompactEdgeId prevEdgeFrom,
+                      const Weight* weightsThrough,
+                      const CompactEdgeId* prevEdgesThrough,
+                      Weight* weights,
+                      CompactEdgeId* prevEdges,
+                      size_t count)
+{
+#ifdef MIN_PLUS_X86_KERNELS
+    if (kernel == Kernel::Avx2)
+    {
+        relaxRowAvx2(
+            weightFrom, prevEdgeFrom, weightsThrough, prevEdgesThrough, weights, prevEdges, count);
+        return;
+    }
+#endif
+    ASSERT_WITH_MESSAGE(kernel == Kernel::Scalar,
+                        getKernelName(kernel) << " kernel is not supported on this platform");
+    relaxRowScalar(
+        weightFrom, prevEdgeFrom, weightsThrough, prevEdgesThrough, weights, prevEdges, count);
+}
+} // namespace
+
+Kernel getBestSupportedKernel()
+{
+#ifdef MIN_PLUS_X86_KERNELS
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return Kernel::Avx2;
+    }
+#endif
+    return Kernel::Scalar;
+}
+
+const char* getKernelName(Kernel kernel)
+{
+    switch (kernel)
+    {
+        case Kernel::Scalar:
+            return "scalar";
+        case Kernel::Avx2:
+            return "avx2";
+    }
+    UNREACHABLE("unknown kernel");
+}
+
+void relaxRow(Kernel kernel,
+              double weightFrom,
+              CompactEdgeId prevEdgeFrom,
+              const double* weightsThrough,
+              const CompactEdgeId* prevEdgesThrough,
+              double* weights,
+              CompactEdgeId* prevEdges,
+              size_t count)
+{
+    relaxRowByKernel(kernel,
+                     weightFrom,
+                     prevEdgeFrom,
+                     weightsThrough,
+                     prevEdgesThrough,
+                     weights,
+                     prevEdges,
+                     count);
+}
+
+void relaxRow(Kernel kernel,
+              float weightFrom,
+              CompactEdgeId prevEdgeFrom,
+              const float* weightsThrough,
+              const CompactEdgeId* prevEdgesThrough,
+              float* weights,
+              CompactEdgeId* prevEdges,
+              size_t count)
+{
+    relaxRowByKernel(kernel,
+                     weightFrom,
+                     prevEdgeFrom,
+                     weightsThrough,
+                     prevEdgesThrough,
+                     weights,
+                     prevEdges,
+                     count);
+}
+
+void relaxRow(Kernel kernel,
+              FixedPointWeight weightFrom,
+              CompactEdgeId prevEdgeFrom,
+              const FixedPointWeight* weightsThrough,
+              const CompactEdgeId* prevEdgesThrough,
+              FixedPointWeight* weights,
+              CompactEdgeId* prevEdges,
+              size_t count)
+{
+    relaxRowByKernel(kernel,
+                     weightFrom,
+                     prevEdgeFrom,
+                     weightsThrough,
+                     prevEdgesThrough,
+                     weights,
+                     prevEdges,
+                     count);
+}
+} // namespace MinPlus
+} // namespace Graph
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "fixedPointWeight.h"
+#include "graph.h"
+
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+
+namespace Graph
+{
+namespace MinPlus
+{
+enum class Kernel
+{
+    Scalar,
+    Avx2
+};
+
+Kernel getBestSupportedKernel();
+const char* getKernelName(Kernel kernel);
+
+// Relaxes count routes from one vertex through another one, given the route to the through-vertex
+// and the routes from it. Missing routes have infinite weight, routes without edges have NoEdge
+// previous edge. A candidate route replaces the current one only if it is strictly shorter
+template <typename Weight>
+void relaxRowScalar(Weight weightFrom,
+                    CompactEdgeId prevEdgeFrom,
+                    const Weight* weightsThrough,
+                    const CompactEdgeId* prevEdgesThrough,
+                    Weight* weights,
+                    CompactEdgeId* prevEdges,
+                    size_t count)
+{
+    for (size_t index = 0; index < count; ++index)
+    {
+        if (weightsThrough[index] < std::numeric_limits<Weight>::infinity())
+        {
+            const Weight candidateWeight = weightFrom + weightsThrough[index];
+            if (candidateWeight < weights[index])
+            {
+                weights[index] = candidateWeight;
+                prevEdges[index] =
+                    prevEdgesThrough[index] != NoEdge ? prevEdgesThrough[index] : prevEdgeFrom;
+            }
+        }
+    }
+}
+
+void relaxRow(Kernel kernel,
+              double weightFrom,
+              CompactEdgeId prevEdgeFrom,
+              const double* weightsThrough,
+              const CompactEdgeId* prevEdgesThrough,
+              double* weights,
+              CompactEdgeId* prevEdges,
+              size_t count);
+void relaxRow(Kernel kernel,
+              float weightFrom,
+              CompactEdgeId prevEdgeFrom,
+              const float* weightsThrough,
+              const CompactEdgeId* prevEdgesThrough,
+              float* weights,
+              CompactEdgeId* prevEdges,
+              size_t count);
+void relaxRow(Kernel kernel,
+              FixedPointWeight weightFrom,
+              CompactEdgeId prevEdgeFrom,
+              const FixedPointWeight* weightsThrough,
+              const CompactEdgeId* prevEdgesThrough,
+              FixedPointWeight* weights,
+              CompactEdgeId* prevEdges,
+              size_t count);
+
+// Uses the best kernel the processor supports
+template <typename Weight>
+void relaxRow(Weight weightFrom,
+              CompactEdgeId prevEdgeFrom,
+              const Weight* weightsThrough,
+              const CompactEdgeId* prevEdgesThrough,
+              Weight* weights,
+              CompactEdgeId* prevEdges,
+              size_t count)
+{
+    if constexpr (std::is_same_v<Weight, double> || std::is_same_v<Weight, float> ||
+                  std::is_same_v<Weight, FixedPointWeight>)
+    {
+        static const Kernel kernel = getBestSupportedKernel();
+        relaxRow(kernel, weightFrom, prevEdgeFrom, weightsThrough, prevEdgesThrough, weights,
+                 prevEdges, count);
+    }
+    else
+    {
+        relaxRowScalar(weightFrom, prevEdgeFrom, weightsThrough, prevEdgesThrough, weights,
+                       prevEdges, count);
+    }
+}
+} // namespace MinPlus
+} // namespace Graph
@@ -0,0 +1,46 @@
+#include "nameTable.h"
+#include "utils.h"
+
+#include <algorithm>
+
+using namespace std;
+
+NameTable::NameTable(vector<string> names)
+    : names_(move(names))
+{
+    sort(begin(names_), end(names_));
+    names_.erase(unique(begin(names_), end(names_)), end(names_));
+}
+
+size_t NameTable::getSize() const
+{
+    return names_.size();
+}
+
+const string& NameTable::getName(size_t id) const
+{
+    ASSERT_WITH_MESSAGE(id < names_.size(), "unknown name id " << id);
+    return names_[id];
+}
+
+optional<size_t> NameTable::findId(string_view name) const
+{
+    const auto it = lower_bound(begin(names_), end(names_), name);
+    if (it == end(names_) || *it != name)
+    {
+        return nullopt;
+    }
+    return static_cast<size_t>(it - begin(names_));
+}
+
+size_t NameTable::getId(string_view name) const
+{
+    const auto id = findId(name);
+    ASSERT_WITH_MESSAGE(id, "unknown name " << name);
+    return *id;
+}
+
+const vector<string>& NameTable::getNames() const
+{
+    return names_;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Names sorted in the byte order and kept once, a name is referred to by its index in the table.
+// The names don't move, so views of them are valid as long as the table is
+class NameTable
+{
+public:
+    NameTable() = default;
+    // Duplicates are dropped
+    explicit NameTable(std::vector<std::string> names);
+
+    NameTable(const NameTable&) = delete;
+    NameTable& operator=(const NameTable&) = delete;
+    NameTable(NameTable&&) = default;
+    NameTable& operator=(NameTable&&) = default;
+
+    size_t getSize() const;
+    const std::string& getName(size_t id) const;
+    std::optional<size_t> findId(std::string_view name) const;
+    // The name has to be in the table
+    size_t getId(std::string_view name) const;
+    const std::vector<std::string>& getNames() const;
+
+private:
+    std::vector<std::string> names_;
+};
+
+// Names of the stops and the buses the messages of a base refer to by their ids
+struct BaseNames
+{
+    NameTable stops;
+    NameTable buses;
+};
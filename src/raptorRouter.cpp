@@ -0,0 +1,286 @@
+#include "raptorRouter.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+namespace
+{
+constexpr double NoArrival = numeric_limits<double>::infinity();
+constexpr size_t NoPosition = numeric_limits<size_t>::max();
+} // namespace
+
+RaptorRouter::RaptorRouter(const BaseRequests::ParsedBuses& buses,
+                           const RouteDistancesMap& routeDistances,
+                           const unordered_map<string, StopId>& stopIds,
+                           int busWaitTime,
+                           double busVelocity,
+                           optional<size_t> maxTransfers)
+    : busWaitTime_(busWaitTime)
+    , busVelocity_(busVelocity)
+    , maxTransfers_(maxTransfers)
+    , stopNames_(stopIds.size())
+{
+    for (const auto& [stopName, stopId] : stopIds)
+    {
+        ASSERT_WITH_MESSAGE(stopId < stopNames_.size(), "wrong id of the stop " << stopName);
+        stopNames_[stopId] = stopName;
+    }
+
+    busOffsets_.push_back(0);
+    for (const auto& [busName, goingThroughStops] : buses)
+    {
+        busNames_.push_back(busName);
+        size_t distance = 0;
+        for (auto stopIt = goingThroughStops.begin(); stopIt < goingThroughStops.end(); stopIt++)
+        {
+            if (stopIt != goingThroughStops.begin())
+            {
+                distance += routeDistances.at({*prev(stopIt), *stopIt});
+            }
+            busStops_.push_back(stopIds.at(*stopIt));
+            busDistances_.push_back(distance);
+        }
+        busOffsets_.push_back(busStops_.size());
+    }
+
+    buildStopBuses();
+}
+
+void RaptorRouter::buildStopBuses()
+{
+    const size_t stopCount = stopNames_.size();
+    stopOffsets_.assign(stopCount + 1, 0);
+    for (const StopId stop : busStops_)
+    {
+        ASSERT_WITH_MESSAGE(stop < stopCount, "wrong stop id " << stop);
+        stopOffsets_[stop + 1]++;
+    }
+    for (StopId stop = 0; stop < stopCount; stop++)
+    {
+        stopOffsets_[stop + 1] += stopOffsets_[stop];
+    }
+
+    stopBuses_.resize(busStops_.size());
+    auto nextIndexes = stopOffsets_;
+    for (size_t busIndex = 0; busIndex < busNames_.size(); busIndex++)
+    {
+        for (size_t index = busOffsets_[busIndex]; index < busOffsets_[busIndex + 1]; index++)
+        {
+            stopBuses_[nextIndexes[busStops_[index]]++] = {busIndex, index - busOffsets_[busIndex]};
+        }
+    }
+}
+
+double RaptorRouter::calculateTransitTime(size_t busIndex,
+                                          size_t boardingPosition,
+                                          size_t alightingPosition) const
+{
+    const size_t offset = busOffsets_[busIndex];
+    const size_t distance =
+        busDistances_[offset + alightingPosition] - busDistances_[offset + boardingPosition];
+    return static_cast<double>(distance) / busVelocity_;
+}
+
+RaptorRouter::Rounds RaptorRouter::runRounds(StopId from, optional<StopId> to) const
+{
+    const size_t stopCount = stopNames_.size();
+    const Label noLabel = {NoPosition, NoPosition, NoPosition};
+
+    // Arrivals and labels of every round. Round k keeps the fastest journeys of at most k rides,
+    // its labels are set only for the stops improved in it
+    vector<vector<double>> arrivals = {vector<double>(stopCount, NoArrival)};
+    vector<vector<Label>> labels = {vector<Label>(stopCount, noLabel)};
+    arrivals[0][from] = 0;
+    // The fastest arrivals of all the rounds, a journey is continued only if it improves them
+    vector<double> bestArrivals(stopCount, NoArrival);
+    bestArrivals[from] = 0;
+
+    vector<StopId> markedStops = {from};
+    vector<bool> isMarked(stopCount, false);
+    isMarked[from] = true;
+    vector<size_t> firstMarkedPositions(busNames_.size(), NoPosition);
+    vector<size_t> busesToScan;
+
+    const size_t maxRideCount = maxTransfers_ ? *maxTransfers_ + 1 : numeric_limits<size_t>::max();
+    for (size_t round = 1; round <= maxRideCount && !markedStops.empty(); round++)
+    {
+        // Every bus going through the stops improved in the previous round is scanned from the
+        // first of them
+        for (const StopId stop : markedStops)
+        {
+            isMarked[stop] = false;
+            for (size_t index = stopOffsets_[stop]; index < stopOffsets_[stop + 1]; index++)
+            {
+                const auto [busIndex, position] = stopBuses_[index];
+                if (firstMarkedPositions[busIndex] == NoPosition)
+                {
+                    busesToScan.push_back(busIndex);
+                }
+                firstMarkedPositions[busIndex] = min(firstMarkedPositions[busIndex], position);
+            }
+        }
+        markedStops.clear();
+
+        arrivals.push_back(arrivals.back());
+        labels.emplace_back(stopCount, noLabel);
+        const auto& previousArrivals = arrivals[round - 1];
+        auto& roundArrivals = arrivals[round];
+        auto& roundLabels = labels[round];
+
+        for (const size_t busIndex : busesToScan)
+        {
+            const size_t offset = busOffsets_[busIndex];
+            const size_t busStopCount = busOffsets_[busIndex + 1] - offset;
+            size_t boardingPosition = NoPosition;
+            double boardingTime = NoArrival;
+            for (size_t position = firstMarkedPositions[busIndex]; position < busStopCount;
+                 position++)
+            {
+                const StopId stop = busStops_[offset + position];
+                const double transitTime =
+                    boardingPosition == NoPosition
+                        ? 0
+                        : calculateTransitTime(busIndex, boardingPosition, position);
+                if (boardingPosition != NoPosition)
+                {
+                    const double arrival = boardingTime + busWaitTime_ + transitTime;
+                    if (arrival < bestArrivals[stop] && (!to || arrival < bestArrivals[*to]))
+                    {
+                        roundArrivals[stop] = arrival;
+                        bestArrivals[stop] = arrival;
+                        roundLabels[stop] = {busIndex, boardingPosition, position};
+                        if (!isMarked[stop])
+                        {
+                            isMarked[stop] = true;
+                            markedStops.push_back(stop);
+                        }
+                    }
+                }
+
+                // Boarding at this stop is better if it was reached before the bus being ridden
+                // would get here, the wait time is the same
+                if (previousArrivals[stop] < boardingTime + transitTime)
+                {
+                    boardingPosition = position;
+                    boardingTime = previousArrivals[stop];
+                }
+            }
+            firstMarkedPositions[busIndex] = NoPosition;
+        }
+        busesToScan.clear();
+    }
+
+    return {move(labels), move(bestArrivals)};
+}
+
+optional<RaptorRouter::Journey> RaptorRouter::findJourney(StopId from, StopId to) const
+{
+    const auto [labels, bestArrivals] = runRounds(from, to);
+    if (!(bestArrivals[to] < NoArrival))
+    {
+        return nullopt;
+    }
+
+    Journey journey{bestArrivals[to], {}};
+    size_t round = labels.size() - 1;
+    for (StopId stop = to; stop != from; round--)
+    {
+        while (labels[round][stop].busIndex == NoPosition)
+        {
+            round--;
+        }
+        const auto [busIndex, boardingPosition, alightingPosition] = labels[round][stop];
+        stop = busStops_[busOffsets_[busIndex] + boardingPosition];
+        journey.rides.push_back({busIndex,
+                                 stop,
+                                 alightingPosition - boardingPosition,
+                                 calculateTransitTime(busIndex, boardingPosition, alightingPosition)});
+    }
+    reverse(begin(journey.rides), end(journey.rides));
+    return journey;
+}
+
+vector<double> RaptorRouter::findJourneyTimes(const vector<StopId>& sources,
+                                              const vector<StopId>& targets) const
+{
+    vector<double> times;
+    times.reserve(sources.size() * targets.size());
+    for (const StopId from : sources)
+    {
+        const auto bestArrivals = runRounds(from, nullopt).bestArrivals;
+        for (const StopId to : targets)
+        {
+            times.push_back(bestArrivals[to]);
+        }
+    }
+    return times;
+}
+
+int RaptorRouter::getBusWaitTime() const
+{
+    return busWaitTime_;
+}
+
+const string& RaptorRouter::getBusName(size_t busIndex) const
+{
+    return busNames_[busIndex];
+}
+
+const string& RaptorRouter::getStopName(StopId stop) const
+{
+    return stopNames_[stop];
+}
+
+void RaptorRouter::serialize(TCProto::RaptorRouter& proto) const
+{
+    proto.set_bus_wait_time(busWaitTime_);
+    proto.set_bus_velocity(busVelocity_);
+    if (maxTransfers_)
+    {
+        proto.set_has_max_transfers(true);
+        proto.set_max_transfers(*maxTransfers_);
+    }
+
+    for (const auto& stopName : stopNames_)
+    {
+        proto.add_stop_names(stopName);
+    }
+    for (const auto& busName : busNames_)
+    {
+        proto.add_bus_names(busName);
+    }
+    *proto.mutable_bus_offsets() = {busOffsets_.begin(), busOffsets_.end()};
+    *proto.mutable_bus_stops() = {busStops_.begin(), busStops_.end()};
+    *proto.mutable_bus_distances() = {busDistances_.begin(), busDistances_.end()};
+}
+
+unique_ptr<RaptorRouter> RaptorRouter::deserialize(const TCProto::RaptorRouter& proto)
+{
+    unique_ptr<RaptorRouter> raptorRouterPtr(
+        new RaptorRouter); // Ctor is private, so can't use make_unique
+
+    raptorRouterPtr->busWaitTime_ = proto.bus_wait_time();
+    raptorRouterPtr->busVelocity_ = proto.bus_velocity();
+    if (proto.has_max_transfers())
+    {
+        raptorRouterPtr->maxTransfers_ = proto.max_transfers();
+    }
+
+    raptorRouterPtr->stopNames_ = {proto.stop_names().begin(), proto.stop_names().end()};
+    raptorRouterPtr->busNames_ = {proto.bus_names().begin(), proto.bus_names().end()};
+    raptorRouterPtr->busOffsets_ = {proto.bus_offsets().begin(), proto.bus_offsets().end()};
+    raptorRouterPtr->busStops_ = {proto.bus_stops().begin(), proto.bus_stops().end()};
+    raptorRouterPtr->busDistances_ = {proto.bus_distances().begin(), proto.bus_distances().end()};
+
+    const auto& router = *raptorRouterPtr;
+    ASSERT_WITH_MESSAGE(router.busOffsets_.size() == router.busNames_.size() + 1 &&
+                            router.busOffsets_.back() == router.busStops_.size() &&
+                            router.busDistances_.size() == router.busStops_.size(),
+                        "wrong stop sequences of the buses");
+    raptorRouterPtr->buildStopBuses();
+
+    return raptorRouterPtr;
+}
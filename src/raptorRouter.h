@@ -0,0 +1,111 @@
+#pragma once
+
+#include "baseRequests.h"
+#include "graph.h"
+#include "routeDistancesDict.h"
+
+#include "transport_router.pb.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Round-based router (RAPTOR) working directly on the stop sequences of the buses. Round k finds
+// the fastest journeys with k rides by scanning every bus which goes through a stop improved in the
+// previous round, so it needs neither a graph nor any precalculation
+class RaptorRouter
+{
+public:
+    using StopId = Graph::VertexId;
+
+    // Ride on a bus from one of its stops to another one
+    struct Ride
+    {
+        size_t busIndex;
+        StopId from;
+        size_t spanCount;
+        double transitTime;
+    };
+
+    struct Journey
+    {
+        double totalTime;
+        std::vector<Ride> rides;
+    };
+
+    // Stop ids are taken from stopIds and have to be in [0, stop count)
+    RaptorRouter(const BaseRequests::ParsedBuses& buses,
+                 const RouteDistancesMap& routeDistances,
+                 const std::unordered_map<std::string, StopId>& stopIds,
+                 int busWaitTime,
+                 double busVelocity,
+                 std::optional<size_t> maxTransfers);
+
+    // Journey with at most maxTransfers transfers, if it is limited in the settings
+    std::optional<Journey> findJourney(StopId from, StopId to) const;
+    // Total times of the journeys from every source to every target row by row, infinity where
+    // there is no journey. The rounds run once for every source, without pruning by a target
+    std::vector<double> findJourneyTimes(const std::vector<StopId>& sources,
+                                         const std::vector<StopId>& targets) const;
+
+    int getBusWaitTime() const;
+    const std::string& getBusName(size_t busIndex) const;
+    const std::string& getStopName(StopId stop) const;
+
+    void serialize(TCProto::RaptorRouter& proto) const;
+    static std::unique_ptr<RaptorRouter> deserialize(const TCProto::RaptorRouter& proto);
+
+private:
+    // Position of a stop in the stop sequence of a bus
+    struct BusStop
+    {
+        size_t busIndex;
+        size_t position;
+    };
+
+    // The last ride of the fastest journey to a stop found in a round
+    struct Label
+    {
+        size_t busIndex;
+        size_t boardingPosition;
+        size_t alightingPosition;
+    };
+
+    // Labels of every round and the fastest arrivals of all of them
+    struct Rounds
+    {
+        std::vector<std::vector<Label>> labels;
+        std::vector<double> bestArrivals;
+    };
+
+    RaptorRouter() = default;
+
+    // Journeys which can't be faster than the fastest one to the target are dropped. Without
+    // a target all the stops are reached
+    Rounds runRounds(StopId from, std::optional<StopId> to) const;
+
+    void buildStopBuses();
+    double calculateTransitTime(size_t busIndex,
+                                size_t boardingPosition,
+                                size_t alightingPosition) const;
+
+private:
+    int busWaitTime_ = 0;
+    double busVelocity_ = 0;
+    std::optional<size_t> maxTransfers_;
+
+    std::vector<std::string> stopNames_;
+    std::vector<std::string> busNames_;
+    // Stops of the bus b are busStops_[busOffsets_[b]] ... busStops_[busOffsets_[b + 1] - 1].
+    // busDistances_ keeps the distance from the first stop of the bus for every one of them
+    std::vector<size_t> busOffsets_;
+    std::vector<StopId> busStops_;
+    std::vector<size_t> busDistances_;
+
+    // All the positions of the stop s in the bus sequences are
+    // stopBuses_[stopOffsets_[s]] ... stopBuses_[stopOffsets_[s + 1] - 1]
+    std::vector<size_t> stopOffsets_;
+    std::vector<BusStop> stopBuses_;
+};
@@ -11,7 +11,7 @@ struct FromTo
 
 inline bool operator==(const FromTo& lhs, const FromTo& rhs)
 {
-    return lhs.from == rhs.from && lhs.from == rhs.from;
+    return lhs.from == rhs.from && lhs.to == rhs.to;
 }
 
 struct FromToHasher
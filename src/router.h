@@ -1,28 +1,102 @@
 #pragma once
 
+#include "alignedAllocator.h"
+#include "fixedPointWeight.h"
 #include "graph.h"
+#include "minPlusKernels.h"
+#include "parallel.h"
 #include "utils.h"
 
 #include "graph.pb.h"
 
 #include <algorithm>
+#include <bitset>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 namespace Graph
 {
+// Edge whose weight has changed since the routes were found, an added edge had infinite weight
 template <typename Weight>
+struct EdgeWeightChange
+{
+    EdgeId edgeId;
+    Weight oldWeight;
+};
+
+// Routes between all pairs of vertexes. The routes matrix may keep narrower weights than the graph
+// to take less memory, then the weights of the edges are rounded to them
+template <typename Weight, typename GraphWeight = Weight>
 class Router
 {
 private:
-    using Graph = DirectedWeightedGraph<Weight>;
+    using Graph = DirectedWeightedGraph<GraphWeight>;
     using ExpandedRoute = std::vector<EdgeId>;
 
-    struct RouteInternalData
+    static constexpr Weight NoRoute = std::numeric_limits<Weight>::infinity();
+    static constexpr size_t NoComponent = std::numeric_limits<size_t>::max();
+    // Versions of GraphProto::Router, serialize writes the sharded one, the earlier ones are read
+    // as well
+    static constexpr uint32_t PackedEncodingVersion = 1;
+    static constexpr uint32_t ShardedEncodingVersion = 2;
+    static constexpr size_t BitmapWordSize = 64;
+    // Cells of a shard of the routes matrix, whole rows up to this count are taken into it
+    static constexpr size_t ShardCellCount = 1 << 16;
+
+    // Matrix of routes stored row by row as a structure of arrays. Weight of a missing route is
+    // NoRoute, previous edge of a route without edges (from a vertex to itself) is NoEdge
+    struct RoutesInternalData
     {
-        Weight weight;
-        std::optional<EdgeId> prevEdge;
+        RoutesInternalData(size_t rows, size_t columns)
+            : columnCount(columns)
+            , weights(rows * columns, NoRoute)
+            , prevEdges(rows * columns, NoEdge)
+        {
+        }
+
+        size_t getIndex(VertexId row, VertexId column) const
+        {
+            return row * columnCount + column;
+        }
+
+        size_t columnCount;
+        AlignedVector<Weight> weights;
+        AlignedVector<CompactEdgeId> prevEdges;
+    };
+
+    // Routes exist only between the vertexes of the same weakly connected component of the graph,
+    // so every component has a routes matrix of its own. Its vertexes go in increasing order
+    struct Component
+    {
+        std::vector<VertexId> vertexes;
+        RoutesInternalData routes;
+    };
+
+    struct Tile
+    {
+        VertexId rowsBegin;
+        VertexId rowsEnd;
+        VertexId columnsBegin;
+        VertexId columnsEnd;
+    };
+
+    // Rows and columns of the vertexes of the current block, each one taken right before relaxing
+    // routes through the vertex. The block vertex index is the first index of rows and the second
+    // one of columns
+    struct ThroughBlock
+    {
+        VertexId begin;
+        VertexId end;
+        RoutesInternalData rows;
+        RoutesInternalData columns;
     };
-    using RouteInternalDataForOneVertex = std::vector<std::optional<RouteInternalData>>;
-    using RoutesInternalData = std::vector<RouteInternalDataForOneVertex>;
 
 public:
     using RouteId = uint64_t;
@@ -34,140 +108,695 @@ public:
         size_t edgeCount;
     };
 
-    Router(const Graph& graph);
+    // Route which walks the previous edges of the routes matrix, so its edges go from the last one
+    // to the first one. It changes nothing in the router and needs no releasing, so routes can be
+    // viewed from several threads at once. It's valid as long as the router is
+    class RouteView
+    {
+    public:
+        class Iterator
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = EdgeId;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const EdgeId*;
+            using reference = EdgeId;
+
+            EdgeId operator*() const;
+            Iterator& operator++();
+            bool operator==(const Iterator& other) const;
+            bool operator!=(const Iterator& other) const;
+
+        private:
+            friend class RouteView;
+
+            Iterator(const Router& router, VertexId from, CompactEdgeId edgeId);
+
+            const Router* router_;
+            VertexId from_;
+            CompactEdgeId edgeId_;
+        };
+
+        Weight getWeight() const;
+        Iterator begin() const;
+        Iterator end() const;
+
+    private:
+        friend class Router;
+
+        RouteView(const Router& router, VertexId from, VertexId to);
+
+        const Router& router_;
+        VertexId from_;
+        size_t index_;
+    };
+
+    using EdgeChange = EdgeWeightChange<GraphWeight>;
+
+    Router(const Graph& graph, size_t threadCount = 1);
 
-    void serialize(GraphProto::Router& proto);
-    static std::unique_ptr<Router> deserialize(const GraphProto::Router& proto, const Graph& graph);
+    // Updates the routes after vertexes and edges have been added to the graph or weights of its
+    // edges have changed, instead of the precalculation from scratch. An added vertex gets
+    // a component of its own, the components joined by an added edge are merged. Routes are
+    // relaxed through every added or decreased edge in O(C^2), where C is the size of its
+    // component. Rows of the sources whose routes went through an increased edge are found anew by
+    // Dijkstra's algorithm. Among routes of equal weight the chosen ones may differ from the ones
+    // the precalculation would choose
+    void update(const std::vector<EdgeChange>& changes, size_t threadCount = 1);
 
+    // The shards of the routes matrices are encoded and read on up to threadCount threads, the
+    // result doesn't depend on it
+    void serialize(GraphProto::Router& proto, size_t threadCount = 1) const;
+    static std::unique_ptr<Router> deserialize(const GraphProto::Router& proto,
+                                               const Graph& graph,
+                                               size_t threadCount = 1);
+
+    std::optional<RouteView> getRoute(VertexId from, VertexId to) const;
+    // Weights of the routes from every source to every target row by row, infinity where there is
+    // no route
+    std::vector<Weight> findRouteWeights(const std::vector<VertexId>& sources,
+                                         const std::vector<VertexId>& targets) const;
+
+    // Routes expanded into the router, they have to be released. Unlike getRoute these methods
+    // change the router, so they can't be called from several threads at once
     std::optional<RouteInfo> buildRoute(VertexId from, VertexId to) const;
     EdgeId getRouteEdge(RouteId routeId, size_t edgeIndex) const;
     void releaseRoute(RouteId routeId);
 
+    size_t getComponentCount() const;
+    // Count of the cells of all the routes matrices, the sum of the squared component sizes
+    size_t getCellCount() const;
+
 private:
-    Router(const Graph& graph, const GraphProto::Router& proto);
+    // Size of the side of the tiles the routes matrix is split into during the precalculation
+    static constexpr size_t TileSize = 64;
+
+    // Block of rows of the routes matrix of a component, encoded on its own
+    struct Shard
+    {
+        size_t component;
+        size_t firstCell;
+        size_t cellCount;
+    };
+
+    Router(const Graph& graph, const GraphProto::Router& proto, size_t threadCount);
+    static size_t getShardRowCount(size_t vertexCount);
+    static void writePackedRoutes(const RoutesInternalData& routes,
+                                  size_t firstCell,
+                                  size_t cellCount,
+                                  GraphProto::RoutesShard& proto);
+    // Returns false if the routes don't match the cells
+    template <typename ProtoWeights>
+    static bool readPackedRoutes(const google::protobuf::RepeatedField<uint64_t>& routeBitmap,
+                                 const ProtoWeights& protoWeights,
+                                 const google::protobuf::RepeatedField<uint32_t>& protoPrevEdges,
+                                 RoutesInternalData& routes,
+                                 size_t firstCell,
+                                 size_t cellCount);
+    static bool readShardRoutes(const GraphProto::RoutesShard& proto,
+                                RoutesInternalData& routes,
+                                size_t firstCell,
+                                size_t cellCount);
+    template <typename ProtoWeight>
+    static Weight readWeight(ProtoWeight weight);
 
-    void initializeRoutesInternalData();
+    // Makes the components with the matrices of no routes
+    void findComponents();
+    void addComponent(std::vector<VertexId> vertexes);
+    void mergeComponents(size_t lhsComponent, size_t rhsComponent);
+    // Index of the route in the routes matrix of the component of both vertexes
+    size_t getRouteIndex(VertexId from, VertexId to) const;
+    const RoutesInternalData& getComponentRoutes(VertexId vertex) const;
 
-    void relaxRoute(VertexId vertexFrom,
-                    VertexId vertexTo,
-                    const RouteInternalData& routeFrom,
-                    const RouteInternalData& routeTo);
+    void initializeRoutesInternalData(Component& component);
 
-    void relaxRoutesInternalDataThroughVertex(size_t vertexCount, VertexId vertexThrough);
+    static Tile makeTile(size_t vertexCount, size_t rowsTileIndex, size_t columnsTileIndex);
+    static void relaxRoutesInternalDataThroughBlock(RoutesInternalData& routes,
+                                                    size_t blockIndex,
+                                                    size_t threadCount,
+                                                    ThroughBlock& block);
+    static void relaxTile(RoutesInternalData& routes, const Tile& tile, ThroughBlock& block);
+
+    void addNewVertexes();
+    void relaxRoutesThroughEdge(EdgeId edgeId, size_t threadCount);
+    void recalculateRow(VertexId from);
 
 private:
     const Graph& graph_;
     mutable RouteId nextRouteId_ = 0;
 
     mutable std::unordered_map<RouteId, ExpandedRoute> expandedRoutesCache_;
-    RoutesInternalData routesInternalData_;
+    std::vector<Component> components_;
+    // Component of every vertex and the index of the vertex in it
+    std::vector<size_t> vertexComponents_;
+    std::vector<VertexId> vertexIndexes_;
 };
 
-template <typename Weight>
-Router<Weight>::Router(const Graph& graph)
+// Blocked Floyd-Warshall algorithm. Vertexes to relax routes through are taken by blocks of
+// TileSize. For every block the diagonal tile is relaxed first, then the tiles in the same rows and
+// columns, then all the other ones. Tiles of one phase don't depend on each other, so they are
+// relaxed in parallel. Every cell is relaxed through the same vertexes in the same order and with
+// the same values as in the classic algorithm, so the result doesn't depend on tiles and threads
+template <typename Weight, typename GraphWeight>
+Router<Weight, GraphWeight>::Router(const Graph& graph, size_t threadCount)
     : graph_(graph)
-    , routesInternalData_(graph.getVertexCount(),
-                          RouteInternalDataForOneVertex(graph.getVertexCount()))
 {
-    initializeRoutesInternalData();
+    ASSERT_WITH_MESSAGE(graph.isFrozen(), "The graph has to be frozen for the router");
+    ASSERT_WITH_MESSAGE(graph.getEdgeCount() < NoEdge, "Too many edges for the router");
 
-    const size_t vertexCount = graph.getVertexCount();
-    for (VertexId vertexThrough = 0; vertexThrough < vertexCount; ++vertexThrough)
+    findComponents();
+    for (auto& component : components_)
     {
-        relaxRoutesInternalDataThroughVertex(vertexCount, vertexThrough);
+        initializeRoutesInternalData(component);
+
+        auto& routes = component.routes;
+        const size_t vertexCount = component.vertexes.size();
+        ThroughBlock block{0,
+                           0,
+                           RoutesInternalData(TileSize, vertexCount),
+                           RoutesInternalData(vertexCount, TileSize)};
+
+        const size_t tileCount = (vertexCount + TileSize - 1) / TileSize;
+        for (size_t blockIndex = 0; blockIndex < tileCount; ++blockIndex)
+        {
+            relaxRoutesInternalDataThroughBlock(routes, blockIndex, threadCount, block);
+        }
     }
 }
 
-template <typename Weight>
-void Router<Weight>::initializeRoutesInternalData()
+template <typename Weight, typename GraphWeight>
+void Router<Weight, GraphWeight>::findComponents()
 {
     const size_t vertexCount = graph_.getVertexCount();
-    for (VertexId vertex = 0; vertex < vertexCount; ++vertex)
+    components_.clear();
+    vertexComponents_.assign(vertexCount, 0);
+    vertexIndexes_.assign(vertexCount, 0);
+    for (auto& vertexes : findWeaklyConnectedComponents(graph_))
+    {
+        addComponent(std::move(vertexes));
+    }
+}
+
+template <typename Weight, typename GraphWeight>
+void Router<Weight, GraphWeight>::addComponent(std::vector<VertexId> vertexes)
+{
+    const size_t vertexCount = vertexes.size();
+    for (size_t index = 0; index < vertexCount; ++index)
+    {
+        vertexComponents_[vertexes[index]] = components_.size();
+        vertexIndexes_[vertexes[index]] = index;
+    }
+    components_.push_back({std::move(vertexes), RoutesInternalData(vertexCount, vertexCount)});
+}
+
+// The routes of the merged components are kept, there are no routes between them yet
+template <typename Weight, typename GraphWeight>
+void Router<Weight, GraphWeight>::mergeComponents(size_t lhsComponent, size_t rhsComponent)
+{
+    const auto& lhs = components_[lhsComponent];
+    const auto& rhs = components_[rhsComponent];
+    std::vector<VertexId> vertexes;
+    vertexes.reserve(lhs.vertexes.size() + rhs.vertexes.size());
+    std::merge(std::begin(lhs.vertexes),
+               std::end(lhs.vertexes),
+               std::begin(rhs.vertexes),
+               std::end(rhs.vertexes),
+               std::back_inserter(vertexes));
+
+    const size_t vertexCount = vertexes.size();
+    Component merged{std::move(vertexes), RoutesInternalData(vertexCount, vertexCount)};
+    std::vector<VertexId> mergedIndexes(vertexCount);
+    for (size_t index = 0; index < vertexCount; ++index)
+    {
+        mergedIndexes[index] = vertexIndexes_[merged.vertexes[index]];
+    }
+    for (size_t from = 0; from < vertexCount; ++from)
+    {
+        const size_t fromComponent = vertexComponents_[merged.vertexes[from]];
+        const auto& routes = components_[fromComponent].routes;
+        for (size_t to = 0; to < vertexCount; ++to)
+        {
+            if (vertexComponents_[merged.vertexes[to]] == fromComponent)
+            {
+                const size_t index = routes.getIndex(mergedIndexes[from], mergedIndexes[to]);
+                const size_t mergedIndex = merged.routes.getIndex(from, to);
+                merged.routes.weights[mergedIndex] = routes.weights[index];
+                merged.routes.prevEdges[mergedIndex] = routes.prevEdges[index];
+            }
+        }
+    }
+
+    // The last component takes the place of the removed one
+    const size_t keptComponent = std::min(lhsComponent, rhsComponent);
+    const size_t removedComponent = std::max(lhsComponent, rhsComponent);
+    components_[keptComponent] = std::move(merged);
+    if (removedComponent + 1 != components_.size())
+    {
+        components_[removedComponent] = std::move(components_.back());
+    }
+    components_.pop_back();
+
+    for (const size_t component : {keptComponent, removedComponent})
+    {
+        if (component < components_.size())
+        {
+            const auto& componentVertexes = components_[component].vertexes;
+            for (size_t index = 0; index < componentVertexes.size(); ++index)
+            {
+                vertexComponents_[componentVertexes[index]] = component;
+                vertexIndexes_[componentVertexes[index]] = index;
+            }
+        }
+    }
+}
+
+template <typename Weight, typename GraphWeight>
+size_t Router<Weight, GraphWeight>::getRouteIndex(VertexId from, VertexId to) const
+{
+    return getComponentRoutes(from).getIndex(vertexIndexes_[from], vertexIndexes_[to]);
+}
+
+template <typename Weight, typename GraphWeight>
+const typename Router<Weight, GraphWeight>::RoutesInternalData& Router<
+    Weight, GraphWeight>::getComponentRoutes(VertexId vertex) const
+{
+    return components_[vertexComponents_[vertex]].routes;
+}
+
+template <typename Weight, typename GraphWeight>
+void Router<Weight, GraphWeight>::initializeRoutesInternalData(Component& component)
+{
+    auto& routes = component.routes;
+    for (size_t index = 0; index < component.vertexes.size(); ++index)
     {
-        routesInternalData_[vertex][vertex] = RouteInternalData{0, std::nullopt};
-        for (const EdgeId edgeId : graph_.getEdgesWhichStartFrom(vertex))
+        routes.weights[routes.getIndex(index, index)] = 0;
+        for (const auto& edge : graph_.getEdgesWhichStartFrom(component.vertexes[index]))
         {
-            const auto& edge = graph_.getEdge(edgeId);
             ASSERT_WITH_MESSAGE(edge.weight >= 0,
                                 "Router works only with edges with non-negative weight");
 
-            auto& routeInternalData = routesInternalData_[vertex][edge.to];
-            if (!routeInternalData || routeInternalData->weight > edge.weight)
+            const size_t routeIndex = routes.getIndex(index, vertexIndexes_[edge.to]);
+            const auto weight = static_cast<Weight>(edge.weight);
+            if (routes.weights[routeIndex] > weight)
             {
-                routeInternalData = RouteInternalData{edge.weight, edgeId};
+                routes.weights[routeIndex] = weight;
+                routes.prevEdges[routeIndex] = static_cast<CompactEdgeId>(edge.id);
             }
         }
     }
 }
 
-template <typename Weight>
-void Router<Weight>::relaxRoute(VertexId vertexFrom,
-                                VertexId vertexTo,
-                                const RouteInternalData& routeFrom,
-                                const RouteInternalData& routeTo)
+template <typename Weight, typename GraphWeight>
+typename Router<Weight, GraphWeight>::Tile Router<Weight, GraphWeight>::makeTile(
+    size_t vertexCount, size_t rowsTileIndex, size_t columnsTileIndex)
 {
-    auto& routeRelaxing = routesInternalData_[vertexFrom][vertexTo];
-    const Weight candidateWeight = routeFrom.weight + routeTo.weight;
-    if (!routeRelaxing || candidateWeight < routeRelaxing->weight)
+    return {rowsTileIndex * TileSize,
+            std::min((rowsTileIndex + 1) * TileSize, vertexCount),
+            columnsTileIndex * TileSize,
+            std::min((columnsTileIndex + 1) * TileSize, vertexCount)};
+}
+
+template <typename Weight, typename GraphWeight>
+void Router<Weight, GraphWeight>::relaxRoutesInternalDataThroughBlock(RoutesInternalData& routes,
+                                                                      size_t blockIndex,
+                                                                      size_t threadCount,
+                                                                      ThroughBlock& block)
+{
+    const size_t vertexCount = routes.columnCount;
+    const Tile diagonalTile = makeTile(vertexCount, blockIndex, blockIndex);
+    block.begin = diagonalTile.rowsBegin;
+    block.end = diagonalTile.rowsEnd;
+
+    relaxTile(routes, diagonalTile, block);
+
+    const size_t tileCount = (vertexCount + TileSize - 1) / TileSize;
+
+    // The first tileCount tasks are the tiles of the block rows, the others are of its columns
+    parallelFor(2 * tileCount, threadCount, [&](size_t taskIndex) {
+        const size_t tileIndex = taskIndex % tileCount;
+        if (tileIndex != blockIndex)
+        {
+            relaxTile(routes,
+                      taskIndex < tileCount ? makeTile(vertexCount, blockIndex, tileIndex)
+                                            : makeTile(vertexCount, tileIndex, blockIndex),
+                      block);
+        }
+    });
+
+    parallelFor(tileCount * tileCount, threadCount, [&](size_t taskIndex) {
+        const size_t rowsTileIndex = taskIndex / tileCount;
+        const size_t columnsTileIndex = taskIndex % tileCount;
+        if (rowsTileIndex != blockIndex && columnsTileIndex != blockIndex)
+        {
+            relaxTile(routes, makeTile(vertexCount, rowsTileIndex, columnsTileIndex), block);
+        }
+    });
+}
+
+template <typename Weight, typename GraphWeight>
+void Router<Weight, GraphWeight>::relaxTile(RoutesInternalData& routes,
+                                            const Tile& tile,
+                                            ThroughBlock& block)
+{
+    for (VertexId vertexThrough = block.begin; vertexThrough < block.end; ++vertexThrough)
     {
-        routeRelaxing = {candidateWeight, routeTo.prevEdge ? routeTo.prevEdge : routeFrom.prevEdge};
+        const size_t throughIndex = vertexThrough - block.begin;
+
+        // Routes from and to the through-vertex are not changed by relaxing through it, so it's the
+        // right moment to take them for the tiles of the next phases
+        if (tile.rowsBegin <= vertexThrough && vertexThrough < tile.rowsEnd)
+        {
+            const size_t index = routes.getIndex(vertexThrough, tile.columnsBegin);
+            const size_t blockIndex = block.rows.getIndex(throughIndex, tile.columnsBegin);
+            const size_t count = tile.columnsEnd - tile.columnsBegin;
+            std::copy_n(&routes.weights[index], count, &block.rows.weights[blockIndex]);
+            std::copy_n(
+                &routes.prevEdges[index], count, &block.rows.prevEdges[blockIndex]);
+        }
+        if (tile.columnsBegin <= vertexThrough && vertexThrough < tile.columnsEnd)
+        {
+            for (VertexId vertexFrom = tile.rowsBegin; vertexFrom < tile.rowsEnd; ++vertexFrom)
+            {
+                const size_t index = routes.getIndex(vertexFrom, vertexThrough);
+                const size_t blockIndex = block.columns.getIndex(vertexFrom, throughIndex);
+                block.columns.weights[blockIndex] = routes.weights[index];
+                block.columns.prevEdges[blockIndex] = routes.prevEdges[index];
+            }
+        }
+
+        const size_t throughRowIndex = block.rows.getIndex(throughIndex, tile.columnsBegin);
+        for (VertexId vertexFrom = tile.rowsBegin; vertexFrom < tile.rowsEnd; ++vertexFrom)
+        {
+            const size_t fromIndex = block.columns.getIndex(vertexFrom, throughIndex);
+            const Weight weightFrom = block.columns.weights[fromIndex];
+            if (weightFrom < NoRoute)
+            {
+                const size_t index = routes.getIndex(vertexFrom, tile.columnsBegin);
+                MinPlus::relaxRow(weightFrom,
+                                  block.columns.prevEdges[fromIndex],
+                                  &block.rows.weights[throughRowIndex],
+                                  &block.rows.prevEdges[throughRowIndex],
+                                  &routes.weights[index],
+                                  &routes.prevEdges[index],
+                                  tile.columnsEnd - tile.columnsBegin);
+            }
+        }
     }
 }
 
-template <typename Weight>
-void Router<Weight>::relaxRoutesInternalDataThroughVertex(size_t vertexCount,
-                                                          VertexId vertexThrough)
+template <typename Weight, typename GraphWeight>
+void Router<Weight, GraphWeight>::update(const std::vector<EdgeChange>& changes,
+                                         size_t threadCount)
 {
-    for (VertexId vertexFrom = 0; vertexFrom < vertexCount; ++vertexFrom)
+    ASSERT_WITH_MESSAGE(graph_.isFrozen(), "The graph has to be frozen for the router");
+    ASSERT_WITH_MESSAGE(graph_.getEdgeCount() < NoEdge, "Too many edges for the router");
+    addNewVertexes();
+    for (const auto& change : changes)
+    {
+        const auto& edge = graph_.getEdge(change.edgeId);
+        if (vertexComponents_[edge.from] != vertexComponents_[edge.to])
+        {
+            mergeComponents(vertexComponents_[edge.from], vertexComponents_[edge.to]);
+        }
+    }
+
+    // The shortest path tree of a source has an increased edge if the route to the end of the edge
+    // goes through it. Such sources are found before any route changes
+    const size_t vertexCount = graph_.getVertexCount();
+    std::vector<bool> isRowOutdated(vertexCount, false);
+    std::vector<EdgeId> decreasedEdges;
+    for (const auto& [edgeId, oldWeight] : changes)
     {
-        if (const auto& routeFrom = routesInternalData_[vertexFrom][vertexThrough])
+        const auto& edge = graph_.getEdge(edgeId);
+        ASSERT_WITH_MESSAGE(edge.weight >= 0,
+                            "Router works only with edges with non-negative weight");
+        if (edge.weight < oldWeight)
         {
-            for (VertexId vertexTo = 0; vertexTo < vertexCount; ++vertexTo)
+            decreasedEdges.push_back(edgeId);
+        }
+        else if (oldWeight < edge.weight)
+        {
+            const auto& routes = getComponentRoutes(edge.to);
+            for (const VertexId from : components_[vertexComponents_[edge.to]].vertexes)
             {
-                if (const auto& routeTo = routesInternalData_[vertexThrough][vertexTo])
+                if (routes.prevEdges[getRouteIndex(from, edge.to)] == edgeId)
                 {
-                    relaxRoute(vertexFrom, vertexTo, *routeFrom, *routeTo);
+                    isRowOutdated[from] = true;
                 }
             }
         }
     }
+
+    std::vector<VertexId> outdatedRows;
+    for (VertexId from = 0; from < vertexCount; ++from)
+    {
+        if (isRowOutdated[from])
+        {
+            outdatedRows.push_back(from);
+        }
+    }
+    parallelFor(outdatedRows.size(), threadCount, [&](size_t rowIndex) {
+        recalculateRow(outdatedRows[rowIndex]);
+    });
+
+    // Now every route exists in the new graph and is not longer than the shortest one without the
+    // decreased edges, so relaxing through them one by one makes the routes the shortest ones
+    for (const EdgeId edgeId : decreasedEdges)
+    {
+        relaxRoutesThroughEdge(edgeId, threadCount);
+    }
 }
 
-template <typename Weight>
-std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::buildRoute(VertexId from,
-                                                                             VertexId to) const
+template <typename Weight, typename GraphWeight>
+void Router<Weight, GraphWeight>::addNewVertexes()
+{
+    const size_t oldVertexCount = vertexComponents_.size();
+    const size_t vertexCount = graph_.getVertexCount();
+    vertexComponents_.resize(vertexCount);
+    vertexIndexes_.resize(vertexCount);
+    for (VertexId vertex = oldVertexCount; vertex < vertexCount; ++vertex)
+    {
+        addComponent({vertex});
+        components_.back().routes.weights[0] = 0;
+    }
+}
+
+// Routes from the end of the edge and the ones to its start can't get shorter through it, so the
+// row of the end is only read while the other rows are relaxed in parallel
+template <typename Weight, typename GraphWeight>
+void Router<Weight, GraphWeight>::relaxRoutesThroughEdge(EdgeId edgeId, size_t threadCount)
+{
+    const auto& edge = graph_.getEdge(edgeId);
+    auto& routes = components_[vertexComponents_[edge.to]].routes;
+    const size_t vertexCount = routes.columnCount;
+    const VertexId edgeFrom = vertexIndexes_[edge.from];
+    const VertexId edgeTo = vertexIndexes_[edge.to];
+    const size_t throughRowIndex = routes.getIndex(edgeTo, 0);
+    parallelFor(vertexCount, threadCount, [&](VertexId from) {
+        if (from == edgeTo)
+        {
+            return;
+        }
+        const Weight weightTo = routes.weights[routes.getIndex(from, edgeFrom)];
+        if (!(weightTo < NoRoute))
+        {
+            return;
+        }
+
+        const size_t index = routes.getIndex(from, 0);
+        MinPlus::relaxRow(weightTo + static_cast<Weight>(edge.weight),
+                          static_cast<CompactEdgeId>(edgeId),
+                          &routes.weights[throughRowIndex],
+                          &routes.prevEdges[throughRowIndex],
+                          &routes.weights[index],
+                          &routes.prevEdges[index],
+                          vertexCount);
+    });
+}
+
+template <typename Weight, typename GraphWeight>
+void Router<Weight, GraphWeight>::recalculateRow(VertexId from)
 {
-    const auto& routeInternalData = routesInternalData_[from][to];
-    if (!routeInternalData)
+    // The search doesn't leave the component, so the vertexes are its indexes
+    auto& routes = components_[vertexComponents_[from]].routes;
+    const size_t vertexCount = routes.columnCount;
+    const size_t rowIndex = routes.getIndex(vertexIndexes_[from], 0);
+    Weight* weights = &routes.weights[rowIndex];
+    CompactEdgeId* prevEdges = &routes.prevEdges[rowIndex];
+    std::fill_n(weights, vertexCount, NoRoute);
+    std::fill_n(prevEdges, vertexCount, NoEdge);
+
+    using QueueItem = std::pair<Weight, VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    std::vector<bool> isSettled(vertexCount, false);
+    weights[vertexIndexes_[from]] = 0;
+    queue.push({0, from});
+    while (!queue.empty())
+    {
+        const auto [weight, vertex] = queue.top();
+        queue.pop();
+        if (isSettled[vertexIndexes_[vertex]])
+        {
+            continue;
+        }
+        isSettled[vertexIndexes_[vertex]] = true;
+
+        for (const auto& edge : graph_.getEdgesWhichStartFrom(vertex))
+        {
+            const Weight candidateWeight = weight + static_cast<Weight>(edge.weight);
+            const VertexId to = vertexIndexes_[edge.to];
+            if (candidateWeight < weights[to])
+            {
+                weights[to] = candidateWeight;
+                prevEdges[to] = static_cast<CompactEdgeId>(edge.id);
+                queue.push({candidateWeight, edge.to});
+            }
+        }
+    }
+}
+
+template <typename Weight, typename GraphWeight>
+Router<Weight, GraphWeight>::RouteView::Iterator::Iterator(const Router& router,
+                                                           VertexId from,
+                                                           CompactEdgeId edgeId)
+    : router_(&router)
+    , from_(from)
+    , edgeId_(edgeId)
+{
+}
+
+template <typename Weight, typename GraphWeight>
+EdgeId Router<Weight, GraphWeight>::RouteView::Iterator::operator*() const
+{
+    return edgeId_;
+}
+
+template <typename Weight, typename GraphWeight>
+typename Router<Weight, GraphWeight>::RouteView::Iterator&
+Router<Weight, GraphWeight>::RouteView::Iterator::operator++()
+{
+    const VertexId to = router_->graph_.getEdge(edgeId_).from;
+    edgeId_ = router_->getComponentRoutes(from_).prevEdges[router_->getRouteIndex(from_, to)];
+    return *this;
+}
+
+template <typename Weight, typename GraphWeight>
+bool Router<Weight, GraphWeight>::RouteView::Iterator::operator==(const Iterator& other) const
+{
+    return edgeId_ == other.edgeId_;
+}
+
+template <typename Weight, typename GraphWeight>
+bool Router<Weight, GraphWeight>::RouteView::Iterator::operator!=(const Iterator& other) const
+{
+    return !(*this == other);
+}
+
+template <typename Weight, typename GraphWeight>
+Router<Weight, GraphWeight>::RouteView::RouteView(const Router& router, VertexId from, VertexId to)
+    : router_(router)
+    , from_(from)
+    , index_(router.getRouteIndex(from, to))
+{
+}
+
+template <typename Weight, typename GraphWeight>
+Weight Router<Weight, GraphWeight>::RouteView::getWeight() const
+{
+    return router_.getComponentRoutes(from_).weights[index_];
+}
+
+template <typename Weight, typename GraphWeight>
+typename Router<Weight, GraphWeight>::RouteView::Iterator
+Router<Weight, GraphWeight>::RouteView::begin() const
+{
+    return Iterator(router_, from_, router_.getComponentRoutes(from_).prevEdges[index_]);
+}
+
+template <typename Weight, typename GraphWeight>
+typename Router<Weight, GraphWeight>::RouteView::Iterator
+Router<Weight, GraphWeight>::RouteView::end() const
+{
+    return Iterator(router_, from_, NoEdge);
+}
+
+template <typename Weight, typename GraphWeight>
+std::optional<typename Router<Weight, GraphWeight>::RouteView>
+Router<Weight, GraphWeight>::getRoute(VertexId from, VertexId to) const
+{
+    if (vertexComponents_[from] != vertexComponents_[to] ||
+        !(getComponentRoutes(from).weights[getRouteIndex(from, to)] < NoRoute))
     {
         return std::nullopt;
     }
+    return RouteView(*this, from, to);
+}
 
-    std::vector<EdgeId> edges;
-    for (std::optional<EdgeId> edgeId = routeInternalData->prevEdge; edgeId;
-         edgeId = routesInternalData_[from][graph_.getEdge(*edgeId).from]->prevEdge)
+template <typename Weight, typename GraphWeight>
+std::vector<Weight> Router<Weight, GraphWeight>::findRouteWeights(
+    const std::vector<VertexId>& sources, const std::vector<VertexId>& targets) const
+{
+    std::vector<Weight> weights;
+    weights.reserve(sources.size() * targets.size());
+    for (const VertexId from : sources)
     {
-        edges.push_back(*edgeId);
+        for (const VertexId to : targets)
+        {
+            weights.push_back(vertexComponents_[from] == vertexComponents_[to]
+                                  ? getComponentRoutes(from).weights[getRouteIndex(from, to)]
+                                  : NoRoute);
+        }
     }
+    return weights;
+}
+
+template <typename Weight, typename GraphWeight>
+size_t Router<Weight, GraphWeight>::getComponentCount() const
+{
+    return components_.size();
+}
+
+template <typename Weight, typename GraphWeight>
+size_t Router<Weight, GraphWeight>::getCellCount() const
+{
+    size_t cellCount = 0;
+    for (const auto& component : components_)
+    {
+        cellCount += component.vertexes.size() * component.vertexes.size();
+    }
+    return cellCount;
+}
+
+template <typename Weight, typename GraphWeight>
+std::optional<typename Router<Weight, GraphWeight>::RouteInfo>
+Router<Weight, GraphWeight>::buildRoute(VertexId from, VertexId to) const
+{
+    const auto route = getRoute(from, to);
+    if (!route)
+    {
+        return std::nullopt;
+    }
+
+    std::vector<EdgeId> edges(route->begin(), route->end());
     std::reverse(std::begin(edges), std::end(edges));
 
     const RouteId routeId = nextRouteId_++;
     const size_t routeEdgeCount = edges.size();
-    const Weight weight = routeInternalData->weight;
 
     expandedRoutesCache_[routeId] = std::move(edges);
 
-    return RouteInfo{routeId, weight, routeEdgeCount};
+    return RouteInfo{routeId, route->getWeight(), routeEdgeCount};
 }
 
-template <typename Weight>
-EdgeId Router<Weight>::getRouteEdge(RouteId routeId, size_t edgeIndex) const
+template <typename Weight, typename GraphWeight>
+EdgeId Router<Weight, GraphWeight>::getRouteEdge(RouteId routeId, size_t edgeIndex) const
 {
     return expandedRoutesCache_.at(routeId)[edgeIndex];
 }
 
-template <typename Weight>
-void Router<Weight>::releaseRoute(RouteId routeId)
+template <typename Weight, typename GraphWeight>
+void Router<Weight, GraphWeight>::releaseRoute(RouteId routeId)
 {
     expandedRoutesCache_.erase(routeId);
 }
@@ -190,70 +819,347 @@ inline std::ostream& operator<<(
                   << " edgeCount " << routeInfoOpt->edgeCount;
 }
 
-template <typename Weight>
-void Router<Weight>::serialize(GraphProto::Router& proto)
+template <typename Weight, typename GraphWeight>
+size_t Router<Weight, GraphWeight>::getShardRowCount(size_t vertexCount)
 {
-    static_assert(std::is_same_v<Weight, double>,
-                  "Serialization is implemented only for double weights");
+    return std::max<size_t>(1, ShardCellCount / std::max<size_t>(1, vertexCount));
+}
 
-    for (const auto& routesDataForOneVertex : routesInternalData_)
+// The cells of a component go row by row. Only the existing routes have weights and previous
+// edges, a route exists if its bit of the bitmap is set, the bits go from the lowest one of every
+// word. Float and fixed-point weights are kept in the fields of their own types, 4 bytes each
+template <typename Weight, typename GraphWeight>
+void Router<Weight, GraphWeight>::writePackedRoutes(const RoutesInternalData& routes,
+                                                    size_t firstCell,
+                                                    size_t cellCount,
+                                                    GraphProto::RoutesShard& proto)
+{
+    auto& bitmap = *proto.mutable_route_bitmap();
+    bitmap.Resize(static_cast<int>((cellCount + BitmapWordSize - 1) / BitmapWordSize), 0);
+    if constexpr (std::is_same_v<Weight, float>)
+    {
+        proto.mutable_float_weights()->Reserve(static_cast<int>(cellCount));
+    }
+    else if constexpr (std::is_same_v<Weight, FixedPointWeight>)
+    {
+        proto.mutable_fixed_point_weights()->Reserve(static_cast<int>(cellCount));
+    }
+    else
     {
-        auto& routesDataForOneVertexProto = *proto.add_routes_data();
-        for (const auto& routeData : routesDataForOneVertex)
+        proto.mutable_weights()->Reserve(static_cast<int>(cellCount));
+    }
+    proto.mutable_prev_edges()->Reserve(static_cast<int>(cellCount));
+    for (size_t cell = 0; cell < cellCount; ++cell)
+    {
+        const size_t index = firstCell + cell;
+        if (routes.weights[index] < NoRoute)
         {
-            auto& routeDataProto = *routesDataForOneVertexProto.add_routes_data_for_one_vertex();
-            if (routeData)
+            bitmap[static_cast<int>(cell / BitmapWordSize)] |= uint64_t{1}
+                                                               << (cell % BitmapWordSize);
+            if constexpr (std::is_same_v<Weight, float>)
             {
-                routeDataProto.set_exists(true);
-                routeDataProto.set_weight(routeData->weight);
-                if (routeData->prevEdge)
-                {
-                    routeDataProto.set_has_prev_edge(true);
-                    routeDataProto.set_prev_edge(*routeData->prevEdge);
-                }
+                proto.add_float_weights(routes.weights[index]);
             }
+            else if constexpr (std::is_same_v<Weight, FixedPointWeight>)
+            {
+                proto.add_fixed_point_weights(routes.weights[index].getUnits());
+            }
+            else
+            {
+                proto.add_weights(static_cast<double>(routes.weights[index]));
+            }
+            proto.add_prev_edges(routes.prevEdges[index]);
         }
     }
 }
 
-template <typename Weight>
-Router<Weight>::Router(const Graph& graph, const GraphProto::Router& proto)
+// Every component is split into shards of the same count of rows, which depends on its size only,
+// so the shards are the same whatever the count of threads encoding them
+template <typename Weight, typename GraphWeight>
+void Router<Weight, GraphWeight>::serialize(GraphProto::Router& proto, size_t threadCount) const
+{
+    proto.set_encoding_version(ShardedEncodingVersion);
+    proto.mutable_components()->Reserve(static_cast<int>(components_.size()));
+    std::vector<Shard> shards;
+    std::vector<GraphProto::RoutesShard*> shardProtos;
+    for (size_t componentIndex = 0; componentIndex < components_.size(); ++componentIndex)
+    {
+        const auto& component = components_[componentIndex];
+        auto& componentProto = *proto.add_components();
+        componentProto.mutable_vertexes()->Add(std::begin(component.vertexes),
+                                               std::end(component.vertexes));
+
+        const size_t vertexCount = component.vertexes.size();
+        const size_t shardRowCount = getShardRowCount(vertexCount);
+        componentProto.set_shard_row_count(shardRowCount);
+        for (size_t row = 0; row < vertexCount; row += shardRowCount)
+        {
+            const size_t rowCount = std::min(shardRowCount, vertexCount - row);
+            shards.push_back({componentIndex, row * vertexCount, rowCount * vertexCount});
+            shardProtos.push_back(componentProto.add_shards());
+        }
+    }
+
+    // Every thread fills shards of its own, which are already added to the components
+    parallelFor(shards.size(), threadCount, [&](size_t shardIndex) {
+        const auto& shard = shards[shardIndex];
+        writePackedRoutes(components_[shard.component].routes,
+                          shard.firstCell,
+                          shard.cellCount,
+                          *shardProtos[shardIndex]);
+    });
+}
+
+// Usually every route of the cells exists, then the arrays are taken as they are
+template <typename Weight, typename GraphWeight>
+template <typename ProtoWeights>
+bool Router<Weight, GraphWeight>::readPackedRoutes(
+    const google::protobuf::RepeatedField<uint64_t>& routeBitmap,
+    const ProtoWeights& protoWeights,
+    const google::protobuf::RepeatedField<uint32_t>& protoPrevEdges,
+    RoutesInternalData& routes,
+    size_t firstCell,
+    size_t cellCount)
+{
+    const size_t routeCount = static_cast<size_t>(protoWeights.size());
+    if (static_cast<size_t>(routeBitmap.size()) !=
+            (cellCount + BitmapWordSize - 1) / BitmapWordSize ||
+        routeCount > cellCount || static_cast<size_t>(protoPrevEdges.size()) != routeCount)
+    {
+        return false;
+    }
+    // Bits after the last cell have to be clear, so the set bits are the existing routes
+    size_t bitCount = 0;
+    for (const uint64_t word : routeBitmap)
+    {
+        bitCount += std::bitset<BitmapWordSize>(word).count();
+    }
+    const size_t lastWordBits = cellCount % BitmapWordSize;
+    const bool isPaddingClear =
+        lastWordBits == 0 || routeBitmap.Get(routeBitmap.size() - 1) >> lastWordBits == 0;
+    if (bitCount != routeCount || !isPaddingClear)
+    {
+        return false;
+    }
+
+    const auto weights = routes.weights.begin() + static_cast<std::ptrdiff_t>(firstCell);
+    const auto prevEdges = routes.prevEdges.begin() + static_cast<std::ptrdiff_t>(firstCell);
+    if (routeCount == cellCount)
+    {
+        std::transform(protoWeights.begin(), protoWeights.end(), weights, [](auto weight) {
+            return readWeight(weight);
+        });
+        std::copy(protoPrevEdges.begin(), protoPrevEdges.end(), prevEdges);
+        return true;
+    }
+
+    // The count of the set bits is the count of the routes, so every route is within the arrays
+    size_t routeIndex = 0;
+    for (size_t cell = 0; cell < cellCount; ++cell)
+    {
+        if ((routeBitmap.Get(static_cast<int>(cell / BitmapWordSize)) >>
+             (cell % BitmapWordSize) & 1) != 0)
+        {
+            const int protoIndex = static_cast<int>(routeIndex);
+            weights[static_cast<std::ptrdiff_t>(cell)] = readWeight(protoWeights.Get(protoIndex));
+            prevEdges[static_cast<std::ptrdiff_t>(cell)] = protoPrevEdges.Get(protoIndex);
+            ++routeIndex;
+        }
+    }
+    return true;
+}
+
+// Shards written before the narrower weights had fields of their own keep doubles for any matrix
+template <typename Weight, typename GraphWeight>
+bool Router<Weight, GraphWeight>::readShardRoutes(const GraphProto::RoutesShard& proto,
+                                                  RoutesInternalData& routes,
+                                                  size_t firstCell,
+                                                  size_t cellCount)
+{
+    const auto readRoutes = [&](const auto& protoWeights) {
+        return readPackedRoutes(
+            proto.route_bitmap(), protoWeights, proto.prev_edges(), routes, firstCell, cellCount);
+    };
+    if constexpr (std::is_same_v<Weight, float>)
+    {
+        if (proto.weights_size() == 0)
+        {
+            return readRoutes(proto.float_weights());
+        }
+    }
+    else if constexpr (std::is_same_v<Weight, FixedPointWeight>)
+    {
+        if (proto.weights_size() == 0)
+        {
+            return readRoutes(proto.fixed_point_weights());
+        }
+    }
+    return readRoutes(proto.weights());
+}
+
+// Fixed-point weights are read from their units, the other ones are converted
+template <typename Weight, typename GraphWeight>
+template <typename ProtoWeight>
+Weight Router<Weight, GraphWeight>::readWeight(ProtoWeight weight)
+{
+    if constexpr (std::is_same_v<Weight, FixedPointWeight> && std::is_same_v<ProtoWeight, uint32_t>)
+    {
+        return FixedPointWeight::fromUnits(weight);
+    }
+    else
+    {
+        return static_cast<Weight>(weight);
+    }
+}
+
+// Bases made before the components keep the routes matrix of the whole graph, the cells of the
+// components are taken from it
+template <typename Weight, typename GraphWeight>
+Router<Weight, GraphWeight>::Router(const Graph& graph,
+                                    const GraphProto::Router& proto,
+                                    size_t threadCount)
     : graph_(graph)
 {
-    static_assert(std::is_same_v<Weight, double>,
-                  "Serialization is implemented only for double weights");
+    ASSERT_WITH_MESSAGE(proto.encoding_version() <= ShardedEncodingVersion,
+                        "Unsupported encoding version " << proto.encoding_version()
+                                                        << " of the routes data");
+    const size_t vertexCount = graph.getVertexCount();
+    const auto readRoute = [](const GraphProto::RouteInternalData& routeDataProto,
+                              RoutesInternalData& routes,
+                              size_t index) {
+        if (routeDataProto.exists())
+        {
+            routes.weights[index] = static_cast<Weight>(routeDataProto.weight());
+            if (routeDataProto.has_prev_edge())
+            {
+                routes.prevEdges[index] = static_cast<CompactEdgeId>(routeDataProto.prev_edge());
+            }
+        }
+    };
 
-    routesInternalData_.reserve(static_cast<size_t>(proto.routes_data_size()));
-    for (const auto& routesDataForOneVertexProto : proto.routes_data())
+    if (proto.routes_data_size() > 0)
     {
-        auto& routesDataForOneVertex = routesInternalData_.emplace_back();
-        routesDataForOneVertex.reserve(
-            static_cast<size_t>(routesDataForOneVertexProto.routes_data_for_one_vertex_size()));
-        for (const auto& routeDataForOneVertexProto :
-             routesDataForOneVertexProto.routes_data_for_one_vertex())
+        ASSERT_WITH_MESSAGE(static_cast<size_t>(proto.routes_data_size()) == vertexCount,
+                            "Routes data doesn't match the graph");
+        for (const auto& routesDataForOneVertexProto : proto.routes_data())
         {
-            auto& routeData = routesDataForOneVertex.emplace_back();
-            if (routeDataForOneVertexProto.exists())
+            ASSERT_WITH_MESSAGE(
+                static_cast<size_t>(
+                    routesDataForOneVertexProto.routes_data_for_one_vertex_size()) == vertexCount,
+                "Routes data doesn't match the graph");
+        }
+
+        findComponents();
+        for (auto& component : components_)
+        {
+            const size_t componentSize = component.vertexes.size();
+            for (size_t from = 0; from < componentSize; ++from)
             {
-                routeData = RouteInternalData{routeDataForOneVertexProto.weight(), std::nullopt};
-                if (routeDataForOneVertexProto.has_prev_edge())
+                const auto& routesDataProto = proto.routes_data(
+                    static_cast<int>(component.vertexes[from]));
+                for (size_t to = 0; to < componentSize; ++to)
                 {
-                    routeData->prevEdge = routeDataForOneVertexProto.prev_edge();
+                    readRoute(routesDataProto.routes_data_for_one_vertex(
+                                  static_cast<int>(component.vertexes[to])),
+                              component.routes,
+                              component.routes.getIndex(from, to));
                 }
             }
         }
+        return;
+    }
+
+    vertexComponents_.assign(vertexCount, NoComponent);
+    vertexIndexes_.assign(vertexCount, 0);
+    std::vector<Shard> shards;
+    std::vector<const GraphProto::RoutesShard*> shardProtos;
+    for (const auto& componentProto : proto.components())
+    {
+        const size_t componentSize = static_cast<size_t>(componentProto.vertexes_size());
+        for (const uint64_t vertex : componentProto.vertexes())
+        {
+            ASSERT_WITH_MESSAGE(vertex < vertexCount && vertexComponents_[vertex] == NoComponent,
+                                "Routes data doesn't match the graph");
+            vertexComponents_[vertex] = components_.size();
+        }
+        addComponent({componentProto.vertexes().begin(), componentProto.vertexes().end()});
+
+        auto& routes = components_.back().routes;
+        if (proto.encoding_version() == ShardedEncodingVersion)
+        {
+            const size_t shardRowCount = componentProto.shard_row_count();
+            ASSERT_WITH_MESSAGE(shardRowCount > 0 &&
+                                    static_cast<size_t>(componentProto.shards_size()) ==
+                                        (componentSize + shardRowCount - 1) / shardRowCount,
+                                "Routes data doesn't match the graph");
+            for (size_t row = 0; row < componentSize; row += shardRowCount)
+            {
+                const size_t rowCount = std::min(shardRowCount, componentSize - row);
+                shards.push_back(
+                    {components_.size() - 1, row * componentSize, rowCount * componentSize});
+                shardProtos.push_back(
+                    &componentProto.shards(static_cast<int>(row / shardRowCount)));
+            }
+            continue;
+        }
+        if (proto.encoding_version() == PackedEncodingVersion)
+        {
+            ASSERT_WITH_MESSAGE(readPackedRoutes(componentProto.route_bitmap(),
+                                                 componentProto.weights(),
+                                                 componentProto.prev_edges(),
+                                                 routes,
+                                                 0,
+                                                 routes.weights.size()),
+                                "Routes data doesn't match the graph");
+            continue;
+        }
+
+        ASSERT_WITH_MESSAGE(static_cast<size_t>(componentProto.routes_data_size()) == componentSize,
+                            "Routes data doesn't match the graph");
+        size_t index = 0;
+        for (const auto& routesDataForOneVertexProto : componentProto.routes_data())
+        {
+            ASSERT_WITH_MESSAGE(
+                static_cast<size_t>(
+                    routesDataForOneVertexProto.routes_data_for_one_vertex_size()) ==
+                    componentSize,
+                "Routes data doesn't match the graph");
+            for (const auto& routeDataProto :
+                 routesDataForOneVertexProto.routes_data_for_one_vertex())
+            {
+                readRoute(routeDataProto, routes, index++);
+            }
+        }
     }
+    ASSERT_WITH_MESSAGE(std::find(std::begin(vertexComponents_),
+                                  std::end(vertexComponents_),
+                                  NoComponent) == std::end(vertexComponents_),
+                        "Routes data doesn't match the graph");
+
+    // The shards are parsed along with the message, they fill separate cells, the errors are
+    // reported once all of them are read
+    std::vector<char> isShardRead(shards.size(), false);
+    parallelFor(shards.size(), threadCount, [&](size_t shardIndex) {
+        const auto& shard = shards[shardIndex];
+        isShardRead[shardIndex] = readShardRoutes(*shardProtos[shardIndex],
+                                                  components_[shard.component].routes,
+                                                  shard.firstCell,
+                                                  shard.cellCount);
+    });
+    ASSERT_WITH_MESSAGE(std::find(isShardRead.begin(), isShardRead.end(), false) ==
+                            isShardRead.end(),
+                        "Routes data doesn't match the graph");
 }
 
-template <typename Weight>
-std::unique_ptr<Router<Weight>> Router<Weight>::deserialize(const GraphProto::Router& proto,
-                                                            const Graph& graph)
+template <typename Weight, typename GraphWeight>
+std::unique_ptr<Router<Weight, GraphWeight>> Router<Weight, GraphWeight>::deserialize(
+    const GraphProto::Router& proto, const Graph& graph, size_t threadCount)
 {
     // We can't define Router(Graph&) in the private section, by analogy with TransportRouter(),
     // since we already got it in the public section. So we implement Router(Graph&,
     // GraphProto::Router&) and parse proto file in Ctor instead of this method
     return std::unique_ptr<Router>(
-        new Router(graph, proto)); // Ctor is private, so can't use make_unique
+        new Router(graph, proto, threadCount)); // Ctor is private, so can't use make_unique
 }
 
 } // namespace Graph
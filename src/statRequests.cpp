@@ -10,11 +10,48 @@ using namespace std;
 namespace
 {
 const Json::Map NotFoundErrorResponse = {{"error_message"s, Json::Node("not found"s)}};
+
+vector<string> readStopNames(const Json::Node& node)
+{
+    vector<string> stopNames;
+    stopNames.reserve(node.asArray().size());
+    for (const auto& stopNode : node.asArray())
+    {
+        stopNames.push_back(stopNode.asString());
+    }
+    return stopNames;
+}
+
+Json::Map makeRouteResponse(const TransportRouter::RouteStats& route)
+{
+    Json::Map dict;
+    dict["total_time"] = Json::Node(route.totalTime);
+    Json::Array items;
+    items.reserve(route.routeElements.size() * 2);
+    for (const auto& element : route.routeElements)
+    {
+        auto waitElement = Json::Map{{"type", Json::Node("Wait"s)},
+                                     {"stop_name", Json::Node(string(element.from))},
+                                     {"time", Json::Node(element.waitTime)}};
+        items.push_back(move(waitElement));
+
+        auto busElement =
+            Json::Map{{"type", Json::Node("Bus"s)},
+                      {"bus", Json::Node(string(element.bus))},
+                      {"time", Json::Node(element.transitTime)},
+                      {"span_count", Json::Node(static_cast<int>(element.spanCount))}};
+
+        items.push_back(move(busElement));
+    }
+
+    dict["items"] = move(items);
+    return dict;
+}
 } // namespace
 
 namespace StatRequests
 {
-variant<Stop, Bus, Route> read(const Json::Map& attrs)
+variant<Stop, Bus, Route, RouteMatrix> read(const Json::Map& attrs)
 {
     const string& type = attrs.at("type").asString();
     if (type == "Bus")
@@ -29,6 +66,13 @@ variant<Stop, Bus, Route> read(const Json::Map& attrs)
     {
         return Route{attrs.at("from").asString(), attrs.at("to").asString()};
     }
+    else if (type == "RouteMatrix")
+    {
+        const auto withItemsIt = attrs.find("with_items");
+        return RouteMatrix{readStopNames(attrs.at("from")),
+                           readStopNames(attrs.at("to")),
+                           withItemsIt != attrs.end() && withItemsIt->second.asBool()};
+    }
     UNREACHABLE("unknown type of request: "s + type);
 }
 
@@ -44,7 +88,7 @@ Json::Map Stop::process(const TransportCatalog& database) const
     busNodes.reserve(stop->busNames.size());
     for (const auto& busName : stop->busNames)
     {
-        busNodes.emplace_back(busName);
+        busNodes.emplace_back(string(busName));
     }
     return Json::Map{{"buses", Json::Node(move(busNodes))}};
 }
@@ -67,33 +111,62 @@ Json::Map Bus::process(const TransportCatalog& database) const
 
 Json::Map Route::process(const TransportCatalog& database) const
 {
-    const auto route = database.findRoute(from, to);
-    if (!route)
+    TransportRouter::RouteStats route;
+    if (!database.findRoute(from, to, route))
     {
         return NotFoundErrorResponse;
     }
 
-    Json::Map dict;
-    dict["total_time"] = Json::Node(route->totalTime);
-    Json::Array items;
-    items.reserve(route->routeElements.size());
-    for (const auto& element : route->routeElements)
-    {
-        auto waitElement = Json::Map{{"type", Json::Node("Wait"s)},
-                                     {"stop_name", Json::Node(element.from)},
-                                     {"time", Json::Node(element.waitTime)}};
-        items.push_back(move(waitElement));
+    return makeRouteResponse(route);
+}
 
-        auto busElement =
-            Json::Map{{"type", Json::Node("Bus"s)},
-                      {"bus", Json::Node(element.bus)},
-                      {"time", Json::Node(element.transitTime)},
-                      {"span_count", Json::Node(static_cast<int>(element.spanCount))}};
+Json::Map RouteMatrix::process(const TransportCatalog& database) const
+{
+    const auto times = database.findRouteTimes(from, to);
 
-        items.push_back(move(busElement));
+    Json::Array timeRows;
+    timeRows.reserve(times.size());
+    for (const auto& timeRow : times)
+    {
+        Json::Array timeNodes;
+        timeNodes.reserve(timeRow.size());
+        for (const auto& time : timeRow)
+        {
+            timeNodes.push_back(time ? Json::Node(*time) : Json::Node(nullptr));
+        }
+        timeRows.emplace_back(move(timeNodes));
     }
 
-    dict["items"] = move(items);
+    Json::Map dict;
+    dict["total_times"] = move(timeRows);
+    if (!withItems)
+    {
+        return dict;
+    }
+
+    // The routes are built only for the pairs which have them, one buffer serves all of them
+    TransportRouter::RouteStats route;
+    Json::Array routeRows;
+    routeRows.reserve(times.size());
+    for (size_t fromIndex = 0; fromIndex < from.size(); fromIndex++)
+    {
+        Json::Array routeNodes;
+        routeNodes.reserve(to.size());
+        for (size_t toIndex = 0; toIndex < to.size(); toIndex++)
+        {
+            if (times[fromIndex][toIndex] &&
+                database.findRoute(from[fromIndex], to[toIndex], route))
+            {
+                routeNodes.emplace_back(makeRouteResponse(route));
+            }
+            else
+            {
+                routeNodes.emplace_back(NotFoundErrorResponse);
+            }
+        }
+        routeRows.emplace_back(move(routeNodes));
+    }
+    dict["routes"] = move(routeRows);
     return dict;
 }
 
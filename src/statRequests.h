@@ -5,6 +5,7 @@
 
 #include <string>
 #include <variant>
+#include <vector>
 
 namespace StatRequests
 {
@@ -30,7 +31,18 @@ struct Route
     Json::Map process(const TransportCatalog& database) const;
 };
 
-std::variant<Stop, Bus, Route> read(const Json::Map& attrs);
+// Total times of the routes from every stop of from to every stop of to. The routes themselves are
+// built only if withItems is set
+struct RouteMatrix
+{
+    std::vector<std::string> from;
+    std::vector<std::string> to;
+    bool withItems = false;
+
+    Json::Map process(const TransportCatalog& database) const;
+};
+
+std::variant<Stop, Bus, Route, RouteMatrix> read(const Json::Map& attrs);
 
 Json::Array processAll(const TransportCatalog& database, const Json::Array& requests);
 } // namespace Requests
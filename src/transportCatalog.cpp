@@ -1,23 +1,295 @@
 #include "transportCatalog.h"
+#include "profiler.h"
 #include "utils.h"
 
 #include "transport_catalog.pb.h"
 
+#include <google/protobuf/arena.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+
+#include <algorithm>
+#include <initializer_list>
+#include <limits>
+#include <memory>
+#include <optional>
+
+#include <fcntl.h>
+
 using namespace std;
 
+namespace
+{
+// Sections of the mapped base
+constexpr string_view MappedBaseMagic = "TCMAPPED";
+constexpr uint32_t MappedBaseVersion = 2;
+constexpr size_t NamesSection = 0;
+constexpr size_t StopsSection = 1;
+constexpr size_t BusesSection = 2;
+constexpr size_t RouterSection = 3;
+constexpr size_t RoutesSection = 4;
+constexpr size_t MappedBaseSectionCount = 5;
+// The first version keeps the whole catalog message in one section and the routes in another one
+constexpr uint32_t CatalogMessageVersion = 1;
+constexpr size_t CatalogMessageSection = 0;
+constexpr size_t CatalogMessageRoutesSection = 1;
+
+// Arena for the messages parsed out of data of the size. The messages take about as much memory as
+// the data, so its first block is as big as the data and most of them fit in it
+google::protobuf::ArenaOptions makeArenaOptions(size_t dataSize)
+{
+    google::protobuf::ArenaOptions options;
+    options.start_block_size = max(options.start_block_size, dataSize);
+    options.max_block_size = max(options.max_block_size, options.start_block_size);
+    return options;
+}
+
+// Message parsed either on an arena, which frees the message and all its parts at once, or on the
+// heap. The arena pays off for many small messages only: a repeated scalar field leaves every
+// buffer it outgrows on the arena, which takes more memory than the heap for big packed arrays
+template <typename Proto>
+class ParsedMessage
+{
+public:
+    ParsedMessage(const char* data, size_t size, string_view name, bool isOnArena)
+    {
+        if (isOnArena)
+        {
+            arena_.emplace(makeArenaOptions(size));
+            proto_ = google::protobuf::Arena::CreateMessage<Proto>(&*arena_);
+        }
+        else
+        {
+            heapProto_ = make_unique<Proto>();
+            proto_ = heapProto_.get();
+        }
+        ASSERT_WITH_MESSAGE(size <= static_cast<size_t>(numeric_limits<int>::max()) &&
+                                proto_->ParseFromArray(data, static_cast<int>(size)),
+                            "can't parse the " << name << " of the base");
+    }
+
+    ParsedMessage(const MappedSection& section, string_view name, bool isOnArena)
+        : ParsedMessage(section.getData(), section.getSize(), name, isOnArena)
+    {
+    }
+
+    const Proto& get() const
+    {
+        return *proto_;
+    }
+
+private:
+    optional<google::protobuf::Arena> arena_;
+    unique_ptr<Proto> heapProto_;
+    Proto* proto_ = nullptr;
+};
+
+// Length-delimited fields are written the same way the whole message would have them, so the
+// fields of a message can be written one by one
+uint32_t makeLengthDelimitedTag(int fieldNumber)
+{
+    constexpr uint32_t LengthDelimitedWireType = 2;
+    constexpr int WireTypeBitCount = 3;
+    return static_cast<uint32_t>(fieldNumber) << WireTypeBitCount | LengthDelimitedWireType;
+}
+
+void writeMessage(google::protobuf::io::CodedOutputStream& output,
+                  int fieldNumber,
+                  const google::protobuf::MessageLite& message)
+{
+    const size_t size = message.ByteSizeLong();
+    ASSERT_WITH_MESSAGE(size <= static_cast<size_t>(numeric_limits<int>::max()),
+                        "message of field " << fieldNumber << " is too big");
+    output.WriteTag(makeLengthDelimitedTag(fieldNumber));
+    output.WriteVarint32(static_cast<uint32_t>(size));
+    message.SerializeWithCachedSizes(&output);
+}
+
+void writeNames(google::protobuf::io::CodedOutputStream& output,
+                int fieldNumber,
+                const NameTable& names)
+{
+    for (const string& name : names.getNames())
+    {
+        output.WriteTag(makeLengthDelimitedTag(fieldNumber));
+        output.WriteVarint32(static_cast<uint32_t>(name.size()));
+        output.WriteString(name);
+    }
+}
+
+// Names of the base are sorted already, so their ids stay the same
+NameTable readNameTable(const google::protobuf::RepeatedPtrField<string>& namesProto)
+{
+    NameTable names({namesProto.begin(), namesProto.end()});
+    ASSERT_WITH_MESSAGE(names.getSize() == static_cast<size_t>(namesProto.size()) &&
+                            equal(namesProto.begin(), namesProto.end(), names.getNames().begin()),
+                        "names of the base aren't sorted");
+    return names;
+}
+
+vector<string> collectNames(const google::protobuf::RepeatedPtrField<TCProto::Stop>& stopsProto)
+{
+    vector<string> names;
+    names.reserve(static_cast<size_t>(stopsProto.size()));
+    for (const auto& stopProto : stopsProto)
+    {
+        names.push_back(stopProto.name());
+    }
+    return names;
+}
+
+vector<string> collectNames(const google::protobuf::RepeatedPtrField<TCProto::Bus>& busesProto)
+{
+    vector<string> names;
+    names.reserve(static_cast<size_t>(busesProto.size()));
+    for (const auto& busProto : busesProto)
+    {
+        names.push_back(busProto.name());
+    }
+    return names;
+}
+
+// Request of every stop in the order of the ids. The catalog takes the position of the first
+// request of a stop given several times and the distances of all of them, so the request has them
+BaseRequests::ParsedStops sortStopRequests(const BaseRequests::ParsedStops& stops,
+                                           const NameTable& names)
+{
+    BaseRequests::ParsedStops requests(names.getSize());
+    vector<bool> isFound(names.getSize(), false);
+    for (const auto& stop : stops)
+    {
+        const size_t id = names.getId(stop.name);
+        auto& request = requests[id];
+        if (!isFound[id])
+        {
+            request.name = stop.name;
+            request.position = stop.position;
+            isFound[id] = true;
+        }
+        request.distances.insert(
+            end(request.distances), begin(stop.distances), end(stop.distances));
+    }
+    return requests;
+}
+
+// Request of every bus in the order of the ids, the last one of a bus given several times
+BaseRequests::ParsedBuses sortBusRequests(const BaseRequests::ParsedBuses& buses,
+                                          const NameTable& names)
+{
+    BaseRequests::ParsedBuses requests(names.getSize());
+    for (const auto& bus : buses)
+    {
+        requests[names.getId(bus.name)] = bus;
+    }
+    return requests;
+}
+} // namespace
+
 TransportCatalog::TransportCatalog(const BaseRequests::ParsedRequests& data,
                                    const Json::Map& routingSettings)
 {
-    for (const auto& stop : data.stops)
+    const auto stopsCoordinates = getStopCoordinates(data.stops);
+    const auto routeDistances = getRouteDistances(data.stops);
+    makeStopsAndBuses(data, stopsCoordinates, routeDistances);
+    router_ =
+        make_unique<TransportRouter>(data.buses, routeDistances, stopsCoordinates, routingSettings);
+}
+
+void TransportCatalog::update(const BaseRequests::ParsedRequests& delta)
+{
+    loadStops();
+    loadBuses();
+    loadRouter();
+    ASSERT_WITH_MESSAGE(stopRequests_ && busRequests_,
+                        "the base was made without the requests for the updates");
+
+    BaseRequests::ParsedRequests data{*stopRequests_, *busRequests_};
+    for (const auto& stop : delta.stops)
     {
-        stops_.insert({stop.name, {}});
+        const auto id = names_.stops.findId(stop.name);
+        if (!id)
+        {
+            data.stops.push_back(stop);
+            continue;
+        }
+
+        auto& request = data.stops[*id];
+        request.position = stop.position;
+        for (const auto& distance : stop.distances)
+        {
+            const auto it = find_if(
+                begin(request.distances),
+                end(request.distances),
+                [&distance](const auto& item) { return item.destination == distance.destination; });
+            if (it != end(request.distances))
+            {
+                it->length = distance.length;
+            }
+            else
+            {
+                request.distances.push_back(distance);
+            }
+        }
+    }
+    for (const auto& bus : delta.buses)
+    {
+        ASSERT_WITH_MESSAGE(!names_.buses.findId(bus.name), "the bus " << bus.name << " exists");
+        data.buses.push_back(bus);
     }
 
-    const auto stopsCoordinates = getStopCoordinates(data.stops);
+    // The distance given for one way only is the distance of the way back as well, so it's found
+    // anew for all the stops. Everything is made before the catalog is changed
     const auto routeDistances = getRouteDistances(data.stops);
+    TransportCatalog updated;
+    updated.makeStopsAndBuses(data, getStopCoordinates(data.stops), routeDistances);
+    ASSERT_WITH_MESSAGE(updated.names_.buses.getSize() == data.buses.size(),
+                        "a bus is given twice in the delta");
+
+    router_->setRouteDistances(routeDistances);
+    for (const auto& bus : delta.buses)
+    {
+        router_->addBus(bus, routeDistances);
+    }
+
+    // The names don't move with the tables, so the stops and the buses still refer to them
+    names_ = move(updated.names_);
+    stops_ = move(updated.stops_);
+    buses_ = move(updated.buses_);
+    stopRequests_ = move(updated.stopRequests_);
+    busRequests_ = move(updated.busRequests_);
+}
+
+void TransportCatalog::makeStopsAndBuses(const BaseRequests::ParsedRequests& data,
+                                         const PointsMap& stopsCoordinates,
+                                         const RouteDistancesMap& routeDistances)
+{
+    vector<string> stopNames;
+    stopNames.reserve(data.stops.size());
+    for (const auto& stop : data.stops)
+    {
+        stopNames.push_back(stop.name);
+    }
+    vector<string> busNames;
+    busNames.reserve(data.buses.size());
     for (const auto& bus : data.buses)
     {
-        buses_[bus.name] = Bus{
+        busNames.push_back(bus.name);
+    }
+    names_.stops = NameTable(move(stopNames));
+    names_.buses = NameTable(move(busNames));
+    stopRequests_ = sortStopRequests(data.stops, names_.stops);
+    busRequests_ = sortBusRequests(data.buses, names_.buses);
+
+    for (const string& name : names_.stops.getNames())
+    {
+        stops_.insert({name, {}});
+    }
+
+    for (const auto& bus : data.buses)
+    {
+        const string_view busName = names_.buses.getName(names_.buses.getId(bus.name));
+        buses_[busName] = Bus{
             .stopCount = bus.stops.size(),
             .uniqueStopCount = calculateUniqueItemsCount(asRange(bus.stops)),
             .roadRouteLength = calculateRoadRouteLength(bus.stops, routeDistances),
@@ -25,28 +297,44 @@ TransportCatalog::TransportCatalog(const BaseRequests::ParsedRequests& data,
 
         for (const string& stopName : bus.stops)
         {
-            stops_.at(stopName).busNames.insert(bus.name);
+            stops_.at(stopName).busNames.insert(busName);
         }
     }
-
-    router_ = make_unique<TransportRouter>(data.buses, routeDistances, routingSettings);
 }
 
 const Responses::Stop* TransportCatalog::getStop(const string& name) const
 {
-    return getValuePointer(stops_, name);
+    loadStops();
+    return getValuePointer(stops_, string_view(name));
 }
 
 const Responses::Bus* TransportCatalog::getBus(const string& name) const
 {
-    return getValuePointer(buses_, name);
+    loadBuses();
+    return getValuePointer(buses_, string_view(name));
 }
 
 Responses::Route TransportCatalog::findRoute(const string& from, const string& to) const
 {
+    loadRouter();
     return router_->findRoute(from, to);
 }
 
+bool TransportCatalog::findRoute(const string& from,
+                                 const string& to,
+                                 TransportRouter::RouteStats& route) const
+{
+    loadRouter();
+    return router_->findRoute(from, to, route);
+}
+
+vector<vector<optional<double>>> TransportCatalog::findRouteTimes(const vector<string>& from,
+                                                                  const vector<string>& to) const
+{
+    loadRouter();
+    return router_->findRouteTimes(from, to);
+}
+
 TransportCatalog::PointsMap TransportCatalog::getStopCoordinates(
     const BaseRequests::ParsedStops& stops)
 {
@@ -61,61 +349,468 @@ TransportCatalog::PointsMap TransportCatalog::getStopCoordinates(
 
 string TransportCatalog::serialize() const
 {
-    TCProto::TransportCatalog proto;
+    string data;
+    google::protobuf::io::StringOutputStream stream(&data);
+    write(stream);
+    return data;
+}
+
+void TransportCatalog::save(const string& fileName) const
+{
+    const int descriptor = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ASSERT_WITH_MESSAGE(descriptor >= 0, "can't open the file " << fileName);
+    google::protobuf::io::FileOutputStream stream(descriptor);
+    write(stream);
+    ASSERT_WITH_MESSAGE(stream.Close(), "can't write the file " << fileName);
+}
+
+void TransportCatalog::saveMapped(const string& fileName) const
+{
+    loadStops();
+    loadBuses();
+    loadRouter();
+
+    SectionedFile::Writer writer(
+        fileName, MappedBaseMagic, MappedBaseVersion, MappedBaseSectionCount);
+    {
+        google::protobuf::io::CodedOutputStream output(&writer.startSection(NamesSection));
+        writeNames(output, TCProto::NameTables::kStopNamesFieldNumber, names_.stops);
+        writeNames(output, TCProto::NameTables::kBusNamesFieldNumber, names_.buses);
+    }
+    {
+        google::protobuf::io::CodedOutputStream output(&writer.startSection(StopsSection));
+        writeStops(output, TCProto::Stops::kStopsFieldNumber);
+    }
+    {
+        google::protobuf::io::CodedOutputStream output(&writer.startSection(BusesSection));
+        writeBuses(output, TCProto::Buses::kBusesFieldNumber);
+    }
+
+    // The routes matrix is written while the router message is made, so it goes first
+    TCProto::TransportRouter routerProto;
+    router_->serialize(routerProto, &names_, &writer.startSection(RoutesSection));
+    ASSERT_WITH_MESSAGE(routerProto.SerializeToZeroCopyStream(&writer.startSection(RouterSection)),
+                        "can't write the router to the file " << fileName);
+    writer.finish();
+}
+
+void TransportCatalog::write(google::protobuf::io::ZeroCopyOutputStream& stream) const
+{
+    loadStops();
+    loadBuses();
+    loadRouter();
 
-    for (const auto& [name, stop] : stops_)
+    google::protobuf::io::CodedOutputStream output(&stream);
+    writeStops(output, TCProto::TransportCatalog::kStopsFieldNumber);
+    writeBuses(output, TCProto::TransportCatalog::kBusesFieldNumber);
     {
-        TCProto::Stop& stopProto = *proto.add_stops();
-        stopProto.set_name(name);
-        for (const string& busName : stop.busNames)
+        TCProto::TransportRouter routerProto;
+        router_->serialize(routerProto, &names_);
+        writeMessage(output, TCProto::TransportCatalog::kRouterFieldNumber, routerProto);
+    }
+    writeNames(output, TCProto::TransportCatalog::kStopNamesFieldNumber, names_.stops);
+    writeNames(output, TCProto::TransportCatalog::kBusNamesFieldNumber, names_.buses);
+}
+
+void TransportCatalog::writeStops(google::protobuf::io::CodedOutputStream& output,
+                                  int fieldNumber) const
+{
+    TCProto::Stop stopProto;
+    for (size_t id = 0; id < names_.stops.getSize(); ++id)
+    {
+        stopProto.Clear();
+        for (const string_view busName : stops_.at(names_.stops.getName(id)).busNames)
         {
-            stopProto.add_bus_names(busName);
+            stopProto.add_bus_ids(names_.buses.getId(busName));
         }
+        if (stopRequests_)
+        {
+            const auto& request = (*stopRequests_)[id];
+            stopProto.set_has_request(true);
+            stopProto.set_latitude(request.position.latitude);
+            stopProto.set_longitude(request.position.longitude);
+            for (const auto& distance : request.distances)
+            {
+                auto& distanceProto = *stopProto.add_road_distances();
+                if (const auto stopId = names_.stops.findId(distance.destination))
+                {
+                    distanceProto.set_stop_id(*stopId);
+                }
+                else
+                {
+                    distanceProto.set_stop_name(distance.destination);
+                }
+                distanceProto.set_length(distance.length);
+            }
+        }
+        writeMessage(output, fieldNumber, stopProto);
     }
+}
 
-    for (const auto& [name, bus] : buses_)
+void TransportCatalog::writeBuses(google::protobuf::io::CodedOutputStream& output,
+                                  int fieldNumber) const
+{
+    TCProto::Bus busProto;
+    for (size_t id = 0; id < names_.buses.getSize(); ++id)
     {
-        TCProto::Bus& busProto = *proto.add_buses();
-        busProto.set_name(name);
+        const Bus& bus = buses_.at(names_.buses.getName(id));
+        busProto.Clear();
         busProto.set_stop_count(bus.stopCount);
         busProto.set_unique_stop_count(bus.uniqueStopCount);
         busProto.set_road_route_length(bus.roadRouteLength);
         busProto.set_orthodromic_route_length(bus.orthodromicRouteLength);
+        if (busRequests_)
+        {
+            busProto.set_has_request(true);
+            for (const string& stopName : (*busRequests_)[id].stops)
+            {
+                busProto.add_stop_ids(names_.stops.getId(stopName));
+            }
+        }
+        writeMessage(output, fieldNumber, busProto);
+    }
+}
+
+bool TransportCatalog::hasRoutesOfCells(const char* data, size_t size)
+{
+    constexpr uint32_t VarintWireType = 0;
+    constexpr uint32_t Fixed64WireType = 1;
+    constexpr uint32_t LengthDelimitedWireType = 2;
+    constexpr uint32_t Fixed32WireType = 5;
+    constexpr int WireTypeBitCount = 3;
+    if (size > static_cast<size_t>(numeric_limits<int>::max()))
+    {
+        return false;
     }
 
-    router_->serialize(*proto.mutable_router());
+    google::protobuf::io::CodedInputStream input(reinterpret_cast<const uint8_t*>(data),
+                                                 static_cast<int>(size));
+    // Calls visit(fieldNumber, wireType) for every field of the message up to its end or until
+    // visit returns false. Fields which visit doesn't read are skipped
+    const auto forEachField = [&input](const auto& visit) {
+        for (uint32_t tag = input.ReadTag(); tag != 0; tag = input.ReadTag())
+        {
+            const int fieldNumber = static_cast<int>(tag >> WireTypeBitCount);
+            const uint32_t wireType = tag & ((1u << WireTypeBitCount) - 1);
+            const int position = input.CurrentPosition();
+            if (!visit(fieldNumber, wireType))
+            {
+                return;
+            }
+            if (input.CurrentPosition() != position)
+            {
+                continue;
+            }
+            uint64_t value = 0;
+            uint32_t length = 0;
+            const bool isSkipped =
+                (wireType == VarintWireType && input.ReadVarint64(&value)) ||
+                (wireType == Fixed64WireType && input.Skip(sizeof(uint64_t))) ||
+                (wireType == LengthDelimitedWireType && input.ReadVarint32(&length) &&
+                 input.Skip(static_cast<int>(length))) ||
+                (wireType == Fixed32WireType && input.Skip(sizeof(uint32_t)));
+            if (!isSkipped)
+            {
+                return;
+            }
+        }
+    };
+    // Enters the message of the first field of the numbers, false if there is none
+    const auto enterMessage = [&input, &forEachField](initializer_list<int> fieldNumbers) {
+        bool isEntered = false;
+        forEachField([&](int fieldNumber, uint32_t wireType) {
+            uint32_t length = 0;
+            isEntered = wireType == LengthDelimitedWireType &&
+                        find(fieldNumbers.begin(), fieldNumbers.end(), fieldNumber) !=
+                            fieldNumbers.end() &&
+                        input.ReadVarint32(&length);
+            if (isEntered)
+            {
+                input.PushLimit(static_cast<int>(length));
+            }
+            return !isEntered;
+        });
+        return isEntered;
+    };
 
-    return proto.SerializeAsString();
+    // TCProto::TransportCatalog::router, then the router, float_router or fixed_point_router of
+    // TCProto::TransportRouter, the other routers have no routes matrix
+    if (!enterMessage({3}) || !enterMessage({2, 11, 12}))
+    {
+        return false;
+    }
+    // GraphProto::Router: routes_data, components and encoding_version
+    bool hasRoutes = false;
+    uint64_t encodingVersion = 0;
+    forEachField([&](int fieldNumber, uint32_t wireType) {
+        hasRoutes = hasRoutes || fieldNumber == 1 || fieldNumber == 2;
+        if (fieldNumber == 3 && wireType == VarintWireType)
+        {
+            input.ReadVarint64(&encodingVersion);
+        }
+        return true;
+    });
+    return hasRoutes && encodingVersion == 0;
 }
 
 TransportCatalog TransportCatalog::deserialize(const string& data)
 {
-    TCProto::TransportCatalog proto;
-    assert(proto.ParseFromString(data));
+    const ParsedMessage<TCProto::TransportCatalog> proto(
+        data.data(), data.size(), "catalog", hasRoutesOfCells(data.data(), data.size()));
+    return deserialize(proto.get(), nullptr);
+}
+
+TransportCatalog TransportCatalog::load(const string& fileName)
+{
+    auto file = make_shared<const MappedFile>(fileName);
+    const auto version = SectionedFile::readVersion(*file, MappedBaseMagic);
+    ASSERT_WITH_MESSAGE(!version || *version <= MappedBaseVersion,
+                        "unsupported version " << *version << " of the base " << fileName);
+    if (version == MappedBaseVersion)
+    {
+        return loadSections(*SectionedFile::read(file, MappedBaseMagic, MappedBaseVersion));
+    }
+
+    auto sections =
+        version ? SectionedFile::read(file, MappedBaseMagic, CatalogMessageVersion) : nullopt;
+    ASSERT_WITH_MESSAGE(!sections || sections->size() == CatalogMessageRoutesSection + 1,
+                        "wrong sections of the base " << fileName);
+    MappedSection catalogSection =
+        sections ? sections->at(CatalogMessageSection) : MappedSection(file, 0, file->getSize());
+    const ParsedMessage<TCProto::TransportCatalog> proto(
+        catalogSection,
+        "catalog",
+        hasRoutesOfCells(catalogSection.getData(), catalogSection.getSize()));
+    optional<MappedSection> routesSection;
+    if (sections)
+    {
+        routesSection = move(sections->at(CatalogMessageRoutesSection));
+    }
+    // The message keeps everything it needs, so the pages of the file are released before the
+    // catalog is made. Only the routes of the first version of the mapped base stay mapped
+    catalogSection = MappedSection();
+    sections.reset();
+    file.reset();
+    return deserialize(proto.get(), routesSection ? &*routesSection : nullptr);
+}
+
+TransportCatalog TransportCatalog::deserialize(const TCProto::TransportCatalog& proto,
+                                               const MappedSection* mappedRoutes)
+{
+    TransportCatalog catalog;
+    auto& names = catalog.names_;
+
+    // Bases made before the name tables have the names in the messages
+    const bool hasNameTables = proto.stop_names_size() > 0 || proto.bus_names_size() > 0;
+    if (hasNameTables)
+    {
+        names.stops = readNameTable(proto.stop_names());
+        names.buses = readNameTable(proto.bus_names());
+    }
+    else
+    {
+        names.stops = NameTable(collectNames(proto.stops()));
+        names.buses = NameTable(collectNames(proto.buses()));
+    }
+
+    catalog.stops_ = readStops(proto.stops(), names, hasNameTables, catalog.stopRequests_);
+    catalog.buses_ = readBuses(proto.buses(), names, hasNameTables, catalog.busRequests_);
+    catalog.router_ = TransportRouter::deserialize(
+        proto.router(), hasNameTables ? &names : nullptr, mappedRoutes);
+
+    return catalog;
+}
+
+TransportCatalog TransportCatalog::loadSections(vector<MappedSection> sections)
+{
+    ASSERT_WITH_MESSAGE(sections.size() == MappedBaseSectionCount, "wrong sections of the base");
 
     TransportCatalog catalog;
+    catalog.sections_ = make_unique<LazySections>();
+    LazySections& lazySections = *catalog.sections_;
+
+    SectionStats& namesStats = lazySections.names;
+    namesStats.name = "names";
+    namesStats.fileSize = sections[NamesSection].getSize();
+    const size_t heapSize = getAllocatedHeapSize();
+    const auto startTime = chrono::steady_clock::now();
+    {
+        const ParsedMessage<TCProto::NameTables> namesProto(sections[NamesSection], "names", true);
+        catalog.names_.stops = readNameTable(namesProto.get().stop_names());
+        catalog.names_.buses = readNameTable(namesProto.get().bus_names());
+    }
+    namesStats.loadTime = chrono::steady_clock::now() - startTime;
+    namesStats.heapSize = max(getAllocatedHeapSize(), heapSize) - heapSize;
+    namesStats.isLoaded = true;
+
+    const auto initSection = [&sections](LazySection& section, size_t index, string name) {
+        section.data = move(sections[index]);
+        section.stats.name = move(name);
+        section.stats.fileSize = section.data.getSize();
+    };
+    initSection(lazySections.stops, StopsSection, "stops");
+    initSection(lazySections.buses, BusesSection, "buses");
+    initSection(lazySections.router, RouterSection, "router");
+    lazySections.routes = move(sections[RoutesSection]);
+    lazySections.router.stats.fileSize += lazySections.routes.getSize();
+
+    return catalog;
+}
+
+void TransportCatalog::loadSection(LazySection& section,
+                                   const function<void(const MappedSection&)>& read)
+{
+    call_once(section.onceFlag, [&section, &read] {
+        const size_t heapSize = getAllocatedHeapSize();
+        const auto startTime = chrono::steady_clock::now();
+        read(section.data);
+        section.stats.loadTime = chrono::steady_clock::now() - startTime;
+        section.stats.heapSize = max(getAllocatedHeapSize(), heapSize) - heapSize;
+        section.stats.isLoaded = true;
+        // The file stays mapped while the other sections refer to it
+        section.data = {};
+    });
+}
+
+void TransportCatalog::loadStops() const
+{
+    if (!sections_)
+    {
+        return;
+    }
+    loadSection(sections_->stops, [this](const MappedSection& data) {
+        const ParsedMessage<TCProto::Stops> proto(data, "stops", true);
+        stops_ = readStops(proto.get().stops(), names_, true, stopRequests_);
+    });
+}
+
+void TransportCatalog::loadBuses() const
+{
+    if (!sections_)
+    {
+        return;
+    }
+    loadSection(sections_->buses, [this](const MappedSection& data) {
+        const ParsedMessage<TCProto::Buses> proto(data, "buses", true);
+        buses_ = readBuses(proto.get().buses(), names_, true, busRequests_);
+    });
+}
+
+void TransportCatalog::loadRouter() const
+{
+    if (!sections_)
+    {
+        return;
+    }
+    loadSection(sections_->router, [this](const MappedSection& data) {
+        // The routes of the mapped base are in their own section, the router has the packed graph
+        const ParsedMessage<TCProto::TransportRouter> proto(data, "router", false);
+        router_ = TransportRouter::deserialize(proto.get(), &names_, &sections_->routes);
+    });
+}
 
-    for (const TCProto::Stop& stopProto : proto.stops())
+vector<TransportCatalog::SectionStats> TransportCatalog::getSectionStats() const
+{
+    if (!sections_)
+    {
+        return {};
+    }
+    return {sections_->names,
+            sections_->stops.stats,
+            sections_->buses.stats,
+            sections_->router.stats};
+}
+
+unordered_map<string_view, Responses::Stop> TransportCatalog::readStops(
+    const google::protobuf::RepeatedPtrField<TCProto::Stop>& proto,
+    const BaseNames& names,
+    bool hasNameTables,
+    optional<BaseRequests::ParsedStops>& requests)
+{
+    ASSERT_WITH_MESSAGE(!hasNameTables ||
+                            names.stops.getSize() == static_cast<size_t>(proto.size()),
+                        "names of the base don't match its stops");
+
+    unordered_map<string_view, Stop> stops;
+    stops.reserve(static_cast<size_t>(proto.size()));
+    requests.emplace(names.stops.getSize());
+    for (int index = 0; index < proto.size(); ++index)
     {
-        Stop& stop = catalog.stops_[stopProto.name()];
+        const TCProto::Stop& stopProto = proto.Get(index);
+        const size_t id = hasNameTables ? static_cast<size_t>(index)
+                                        : names.stops.getId(stopProto.name());
+        Stop& stop = stops[names.stops.getName(id)];
+        for (const uint64_t busId : stopProto.bus_ids())
+        {
+            stop.busNames.insert(names.buses.getName(busId));
+        }
         for (const string& busName : stopProto.bus_names())
         {
-            stop.busNames.insert(busName);
+            stop.busNames.insert(names.buses.getName(names.buses.getId(busName)));
+        }
+
+        if (!stopProto.has_request())
+        {
+            requests.reset();
+        }
+        if (!requests)
+        {
+            continue;
+        }
+        auto& request = (*requests)[id];
+        request.name = names.stops.getName(id);
+        request.position = {stopProto.latitude(), stopProto.longitude()};
+        for (const auto& distanceProto : stopProto.road_distances())
+        {
+            request.distances.push_back(
+                {distanceProto.stop_name().empty() ? names.stops.getName(distanceProto.stop_id())
+                                                   : distanceProto.stop_name(),
+                 distanceProto.length()});
         }
     }
+    return stops;
+}
+
+unordered_map<string_view, Responses::Bus> TransportCatalog::readBuses(
+    const google::protobuf::RepeatedPtrField<TCProto::Bus>& proto,
+    const BaseNames& names,
+    bool hasNameTables,
+    optional<BaseRequests::ParsedBuses>& requests)
+{
+    ASSERT_WITH_MESSAGE(!hasNameTables ||
+                            names.buses.getSize() == static_cast<size_t>(proto.size()),
+                        "names of the base don't match its buses");
 
-    for (const TCProto::Bus& busProto : proto.buses())
+    unordered_map<string_view, Bus> buses;
+    buses.reserve(static_cast<size_t>(proto.size()));
+    requests.emplace(names.buses.getSize());
+    for (int index = 0; index < proto.size(); ++index)
     {
-        Bus& bus = catalog.buses_[busProto.name()];
+        const TCProto::Bus& busProto = proto.Get(index);
+        const size_t id = hasNameTables ? static_cast<size_t>(index)
+                                        : names.buses.getId(busProto.name());
+        Bus& bus = buses[names.buses.getName(id)];
         bus.stopCount = busProto.stop_count();
         bus.uniqueStopCount = busProto.unique_stop_count();
         bus.roadRouteLength = busProto.road_route_length();
         bus.orthodromicRouteLength = busProto.orthodromic_route_length();
-    }
-
-    catalog.router_ = TransportRouter::deserialize(proto.router());
 
-    return catalog;
+        if (!busProto.has_request())
+        {
+            requests.reset();
+        }
+        if (!requests)
+        {
+            continue;
+        }
+        auto& request = (*requests)[id];
+        request.name = names.buses.getName(id);
+        for (const uint64_t stopId : busProto.stop_ids())
+        {
+            request.stops.push_back(names.stops.getName(stopId));
+        }
+    }
+    return buses;
 }
 
 RouteDistancesMap TransportCatalog::getRouteDistances(const BaseRequests::ParsedStops& stops)
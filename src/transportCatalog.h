@@ -1,18 +1,35 @@
 #pragma once
 
 #include "baseRequests.h"
+#include "mappedFile.h"
+#include "nameTable.h"
 #include "routeDistancesDict.h"
 #include "sphere.h"
 #include "transportRouter.h"
 
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
+namespace TCProto
+{
+class Bus;
+class Stop;
+class TransportCatalog;
+} // namespace TCProto
+
 namespace Responses
 {
+// Names are the ones of the catalog, so they are valid as long as it is
 struct Stop
 {
-    std::set<std::string> busNames;
+    std::set<std::string_view> busNames;
 };
 
 struct Bus
@@ -35,18 +52,109 @@ private:
     using PointsMap = std::unordered_map<std::string, Sphere::Point>;
 
 public:
+    // Section of the mapped base: the size of its data in the file, the time it took to read it and
+    // the heap memory it keeps once it's read
+    struct SectionStats
+    {
+        std::string name;
+        size_t fileSize = 0;
+        bool isLoaded = false;
+        std::chrono::steady_clock::duration loadTime{};
+        size_t heapSize = 0;
+    };
+
     TransportCatalog(const BaseRequests::ParsedRequests& data, const Json::Map& routingSettings);
 
+    // Applies the base requests of the delta to the catalog as if it were made of all of them. A
+    // stop which is already there gets the position and the road distances of the delta, the other
+    // ones are added, the buses have to be new ones. The router has to support the updates
+    void update(const BaseRequests::ParsedRequests& delta);
+
     const Stop* getStop(const std::string& name) const;
     const Bus* getBus(const std::string& name) const;
     Route findRoute(const std::string& from, const std::string& to) const;
+    // Fills the route given by the caller, see TransportRouter::findRoute
+    bool findRoute(const std::string& from,
+                   const std::string& to,
+                   TransportRouter::RouteStats& route) const;
+    // Total times of the routes between all the pairs, see TransportRouter::findRouteTimes
+    std::vector<std::vector<std::optional<double>>> findRouteTimes(
+        const std::vector<std::string>& from, const std::vector<std::string>& to) const;
 
     std::string serialize() const;
+    // Writes the same base to the file as it's made, one stop, bus or router message at a time
+    void save(const std::string& fileName) const;
+    // Writes the base of sections with a directory of them: the name tables, the stops, the buses,
+    // the router and the routes matrix of "all_pairs" algorithm, which is read in place once it's
+    // mapped. Every section is written as it's made
+    void saveMapped(const std::string& fileName) const;
     static TransportCatalog deserialize(const std::string& data);
+    // Maps the file of either base, nothing is read into a string. Only the name tables of the
+    // mapped base are read at once, every other section is read when a request first needs it
+    static TransportCatalog load(const std::string& fileName);
+    // Whether the routes of the catalog message are of the encoding version 0, which keeps
+    // a message for every cell of the matrix. Only the fields on the way to the router are read,
+    // every other one is skipped
+    static bool hasRoutesOfCells(const char* data, size_t size);
+
+    // Sections of the mapped base in the order of the file, the routes matrix is counted in the
+    // router. Empty for the other bases. Not to be called while other threads process requests
+    std::vector<SectionStats> getSectionStats() const;
 
 private:
+    // Section of the mapped base which is read on the first access to it
+    struct LazySection
+    {
+        MappedSection data;
+        std::once_flag onceFlag;
+        SectionStats stats;
+    };
+
+    struct LazySections
+    {
+        SectionStats names;
+        LazySection stops;
+        LazySection buses;
+        LazySection router;
+        MappedSection routes;
+    };
+
     TransportCatalog() = default;
 
+    // Fills the names, the stops and the buses, the router is made apart from them
+    void makeStopsAndBuses(const BaseRequests::ParsedRequests& data,
+                           const PointsMap& stopsCoordinates,
+                           const RouteDistancesMap& routeDistances);
+
+    static TransportCatalog deserialize(const TCProto::TransportCatalog& proto,
+                                        const MappedSection* mappedRoutes);
+    static TransportCatalog loadSections(std::vector<MappedSection> sections);
+
+    // Reads the section once, whichever thread gets to it first, and measures the reading
+    static void loadSection(LazySection& section,
+                            const std::function<void(const MappedSection&)>& read);
+    void loadStops() const;
+    void loadBuses() const;
+    void loadRouter() const;
+
+    // Fields of TCProto::TransportCatalog one after another, the same as the whole message has
+    void write(google::protobuf::io::ZeroCopyOutputStream& stream) const;
+    // Every stop or bus is written as a field of the number of the message being written
+    void writeStops(google::protobuf::io::CodedOutputStream& output, int fieldNumber) const;
+    void writeBuses(google::protobuf::io::CodedOutputStream& output, int fieldNumber) const;
+    // The stops and the buses of the index i have the names of the index i unless the base was made
+    // before the name tables. Their requests are read if every message has one
+    static std::unordered_map<std::string_view, Stop> readStops(
+        const google::protobuf::RepeatedPtrField<TCProto::Stop>& proto,
+        const BaseNames& names,
+        bool hasNameTables,
+        std::optional<BaseRequests::ParsedStops>& requests);
+    static std::unordered_map<std::string_view, Bus> readBuses(
+        const google::protobuf::RepeatedPtrField<TCProto::Bus>& proto,
+        const BaseNames& names,
+        bool hasNameTables,
+        std::optional<BaseRequests::ParsedBuses>& requests);
+
     static PointsMap getStopCoordinates(const BaseRequests::ParsedStops& stops);
     static RouteDistancesMap getRouteDistances(const BaseRequests::ParsedStops& stops);
 
@@ -55,7 +163,16 @@ private:
     static double calculateOrthodromicRouteLength(const std::vector<std::string>& stops,
                                                   const PointsMap& stopsCoordinates);
 
-    std::unique_ptr<TransportRouter> router_;
-    std::unordered_map<std::string, Stop> stops_;
-    std::unordered_map<std::string, Bus> buses_;
+    // Every name is kept once, the stops and the buses refer to the names here
+    BaseNames names_;
+    // Sections of the mapped base which aren't read yet, null for the other bases. The router, the
+    // stops and the buses are filled when their sections are read
+    std::unique_ptr<LazySections> sections_;
+    mutable std::unique_ptr<TransportRouter> router_;
+    mutable std::unordered_map<std::string_view, Stop> stops_;
+    mutable std::unordered_map<std::string_view, Bus> buses_;
+    // Base requests of the stops and the buses in the order of their ids, the update applies the
+    // delta to them. Bases made before the updates have none
+    mutable std::optional<BaseRequests::ParsedStops> stopRequests_;
+    mutable std::optional<BaseRequests::ParsedBuses> busRequests_;
 };
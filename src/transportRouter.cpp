@@ -1,24 +1,128 @@
 #include "transportRouter.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 using namespace std;
 
 namespace
 {
 constexpr double FromKmPerHourToMPerMinute = 1000.0 / 60.0;
+constexpr size_t DefaultDijkstraCacheCapacity = 256;
+// Edges in a shard of the edges info of the base
+constexpr size_t EdgesInfoShardSize = 4096;
+
+vector<double> toDoubleWeights(vector<double> weights)
+{
+    return weights;
 }
 
+template <typename Weight>
+vector<double> toDoubleWeights(const vector<Weight>& weights)
+{
+    vector<double> result;
+    result.reserve(weights.size());
+    for (const Weight weight : weights)
+    {
+        result.push_back(static_cast<double>(weight));
+    }
+    return result;
+}
+} // namespace
+
 TransportRouter::TransportRouter(const BaseRequests::ParsedBuses& buses,
                                  const RouteDistancesMap& routeDistances,
+                                 const StopCoordinates& stopCoordinates,
                                  const Json::Map& routingSettingsMap)
+    : routingSettings_(makeRoutingSettings(routingSettingsMap))
 {
-    createGraph(buses);
-    fillGraphWithEdges(buses, routeDistances, makeRoutingSettings(routingSettingsMap));
-    router_ = make_unique<Router>(*graph_);
+    const auto& routingSettings = routingSettings_;
+    if (routingSettings.algorithm == RoutingAlgorithm::Raptor)
+    {
+        // The graph keeps only the stops, RAPTOR works on the stop sequences of the buses
+        createGraph(buses, GraphModel::StopPairs);
+        router_ = make_unique<RaptorRouter>(buses,
+                                            routeDistances,
+                                            stopToVertex_,
+                                            routingSettings.busWaitTime,
+                                            routingSettings.busVelocity,
+                                            routingSettings.maxTransfers);
+        return;
+    }
+
+    createGraph(buses, routingSettings.graphModel);
+    // In Boarding model the vertexes of the bus routes go first
+    Graph::VertexId busStopVertex = 0;
+    EdgesByVertexes edgesByVertexes;
+    for (const auto& bus : buses)
+    {
+        addBusRoute(bus, routeDistances, busStopVertex, edgesByVertexes, nullptr);
+        busStopVertex += bus.stops.size();
+    }
+    graph_->freeze();
+    if (routingSettings.vertexOrder == VertexOrder::CuthillMcKee)
+    {
+        reorderStopVertexes();
+    }
+
+    switch (routingSettings.algorithm)
+    {
+        case RoutingAlgorithm::AllPairs:
+            switch (routingSettings.weightType)
+            {
+                case WeightType::Double:
+                    router_ = make_unique<Router>(*graph_, routingSettings.threadCount);
+                    if (routingSettings.pathStorage == PathStorage::FirstHops)
+                    {
+                        router_ = make_unique<FirstHopRouter>(*graph_, *get<RouterPtr>(router_));
+                    }
+                    break;
+                case WeightType::Float:
+                    router_ = make_unique<FloatRouter>(*graph_, routingSettings.threadCount);
+                    break;
+                case WeightType::FixedPoint:
+                    router_ = make_unique<FixedPointRouter>(*graph_, routingSettings.threadCount);
+                    break;
+            }
+            break;
+        case RoutingAlgorithm::Dijkstra:
+            router_ = make_unique<DijkstraRouter>(*graph_, routingSettings.dijkstraCacheCapacity);
+            break;
+        case RoutingAlgorithm::ContractionHierarchy:
+            router_ = make_unique<ContractionHierarchyRouter>(*graph_);
+            break;
+        case RoutingAlgorithm::AStar:
+        case RoutingAlgorithm::BidirectionalAStar:
+            router_ = make_unique<AStarRouter>(
+                *graph_,
+                makeVertexPoints(buses, stopCoordinates, routingSettings.graphModel),
+                routingSettings.algorithm == RoutingAlgorithm::BidirectionalAStar);
+            break;
+        case RoutingAlgorithm::HubLabeling:
+            router_ = make_unique<HubLabelingRouter>(*graph_);
+            break;
+        case RoutingAlgorithm::Raptor:
+            UNREACHABLE("RAPTOR doesn't use the graph");
+    }
 }
 
-void TransportRouter::createGraph(const BaseRequests::ParsedBuses& buses)
+void TransportRouter::createGraph(const BaseRequests::ParsedBuses& buses, GraphModel graphModel)
 {
-    Graph::VertexId currentVertexId = 0;
+    size_t busStopCount = 0;
+    if (graphModel == GraphModel::Boarding)
+    {
+        for (const auto& bus : buses)
+        {
+            busStopCount += bus.stops.size();
+        }
+    }
+
+    Graph::VertexId currentVertexId = busStopCount;
     for (const auto& [busName, goingThroughStops] : buses)
     {
         for (const auto& currentStop : goingThroughStops)
@@ -30,138 +134,1122 @@ void TransportRouter::createGraph(const BaseRequests::ParsedBuses& buses)
             }
         }
     }
+
     graph_ = make_unique<RoutesGraph>(currentVertexId);
+    fillVertexStopNames();
 }
 
-void TransportRouter::fillGraphWithEdges(const BaseRequests::ParsedBuses& buses,
-                                         const RouteDistancesMap& routeDistances,
-                                         const TransportRouter::RoutingSettings& routingSettings)
+void TransportRouter::fillVertexStopNames()
 {
-    for (const auto& [busName, goingThroughStops] : buses)
+    vertexStopNames_.assign(graph_->getVertexCount(), {});
+    for (const auto& [stopName, vertexId] : stopToVertex_)
+    {
+        vertexStopNames_[vertexId] = stopName;
+    }
+}
+
+// Stops take the vertexes of the stops in the reverse Cuthill-McKee order of the whole graph. In
+// Boarding model the vertexes of a bus route have to go one after another, so they stay as they are
+void TransportRouter::reorderStopVertexes()
+{
+    const auto order = Graph::findReverseCuthillMcKeeOrder(*graph_);
+    vector<Graph::VertexId> stops;
+    stops.reserve(stopToVertex_.size());
+    for (const auto& [stopName, vertex] : stopToVertex_)
+    {
+        stops.push_back(vertex);
+    }
+    vector<Graph::VertexId> stopVertexes = stops;
+    sort(begin(stopVertexes), end(stopVertexes));
+    sort(begin(stops), end(stops), [&order](Graph::VertexId lhs, Graph::VertexId rhs) {
+        return order[lhs] < order[rhs];
+    });
+
+    vector<Graph::VertexId> newVertexIds(graph_->getVertexCount());
+    for (Graph::VertexId vertex = 0; vertex < newVertexIds.size(); vertex++)
+    {
+        newVertexIds[vertex] = vertex;
+    }
+    for (size_t index = 0; index < stops.size(); index++)
+    {
+        newVertexIds[stops[index]] = stopVertexes[index];
+    }
+
+    graph_->renumberVertexes(newVertexIds);
+    graph_->freeze();
+    for (auto& [stopName, vertex] : stopToVertex_)
+    {
+        vertex = newVertexIds[vertex];
+    }
+    for (auto& busRoute : busRoutes_)
+    {
+        for (auto& stop : busRoute.stops)
+        {
+            stop = newVertexIds[stop];
+        }
+    }
+    fillVertexStopNames();
+}
+
+// In Boarding model the vertexes of the bus route go one after another from busStopVertex
+void TransportRouter::addBusRoute(const BaseRequests::Bus& bus,
+                                  const RouteDistancesMap& routeDistances,
+                                  Graph::VertexId busStopVertex,
+                                  EdgesByVertexes& edgesByVertexes,
+                                  vector<Router::EdgeChange>* changes)
+{
+    auto& busRoute = busRoutes_.emplace_back();
+    busRoute.busName = addBusName(bus.name);
+    busRoute.firstBusStopVertex = busStopVertex;
+    busRoute.stops.reserve(bus.stops.size());
+    for (auto stopIt = bus.stops.begin(); stopIt < bus.stops.end(); stopIt++)
+    {
+        busRoute.stops.push_back(stopToVertex_.at(*stopIt));
+        if (next(stopIt) != bus.stops.end())
+        {
+            busRoute.distances.push_back(routeDistances.at({*stopIt, *next(stopIt)}));
+        }
+    }
+
+    forEachBusEdge(busRoute,
+                   [this, &edgesByVertexes, changes](const Graph::Edge<double>& edge,
+                                                     const RouteElement* routeElement) {
+                       addBusEdge(edge, routeElement, edgesByVertexes, changes);
+                   });
+}
+
+// Of the parallel edges only the lightest one can be in a shortest route, so only it is kept. Among
+// the equal ones it's the earliest one as the routers choose it too
+void TransportRouter::addBusEdge(const Graph::Edge<double>& edge,
+                                 const RouteElement* routeElement,
+                                 EdgesByVertexes& edgesByVertexes,
+                                 vector<Router::EdgeChange>* changes)
+{
+    const auto [it, isAdded] = edgesByVertexes.emplace(VertexPair{edge.from, edge.to}, 0);
+    if (isAdded)
     {
-        for (auto departureIt = goingThroughStops.begin(); departureIt < goingThroughStops.end();
-             departureIt++)
+        it->second = graph_->addEdge(edge);
+        setRouteElement(it->second, routeElement);
+        if (changes)
         {
-            size_t summaryDistance = 0;
-            for (auto destinationIt = next(departureIt); destinationIt < goingThroughStops.end();
-                 destinationIt++)
+            changes->push_back({it->second, numeric_limits<double>::infinity()});
+        }
+        return;
+    }
+
+    droppedEdgeCount_++;
+    const double oldWeight = graph_->getEdge(it->second).weight;
+    if (edge.weight < oldWeight)
+    {
+        graph_->setEdgeWeight(it->second, edge.weight);
+        setRouteElement(it->second, routeElement);
+        if (changes)
+        {
+            changes->push_back({it->second, oldWeight});
+        }
+    }
+}
+
+TransportRouter::EdgesByVertexes TransportRouter::makeEdgesByVertexes() const
+{
+    EdgesByVertexes edgesByVertexes;
+    edgesByVertexes.reserve(graph_->getEdgeCount());
+    for (Graph::EdgeId edgeId = 0; edgeId < graph_->getEdgeCount(); edgeId++)
+    {
+        const auto& edge = graph_->getEdge(edgeId);
+        edgesByVertexes.emplace(VertexPair{edge.from, edge.to}, edgeId);
+    }
+    return edgesByVertexes;
+}
+
+void TransportRouter::setRouteElement(Graph::EdgeId edgeId, const RouteElement* routeElement)
+{
+    if (routeElement)
+    {
+        edgeToRouteElement_.insert_or_assign(edgeId, *routeElement);
+    }
+    else
+    {
+        edgeToRouteElement_.erase(edgeId);
+    }
+}
+
+size_t TransportRouter::VertexPairHasher::operator()(const VertexPair& vertexes) const
+{
+    const auto hashFrom = hash<Graph::VertexId>{}(vertexes.first);
+    const auto hashTo = hash<Graph::VertexId>{}(vertexes.second);
+    constexpr auto primeNumber = 37;
+    return hashFrom * primeNumber + hashTo;
+}
+
+// Edges go in the order they are added to the graph. The route element is given for the edges
+// which start one: rides in StopPairs model, boardings in Boarding model
+template <typename Callback>
+void TransportRouter::forEachBusEdge(const BusRoute& busRoute, Callback callback) const
+{
+    const int busWaitTime = routingSettings_.busWaitTime;
+    const double busVelocity = routingSettings_.busVelocity;
+    const auto& stops = busRoute.stops;
+    switch (routingSettings_.graphModel)
+    {
+        case GraphModel::StopPairs:
+            for (size_t departure = 0; departure < stops.size(); departure++)
             {
-                if (*departureIt == *destinationIt)
+                size_t summaryDistance = 0;
+                for (size_t destination = departure + 1; destination < stops.size(); destination++)
+                {
+                    if (stops[departure] == stops[destination])
+                    {
+                        continue;
+                    }
+
+                    summaryDistance += busRoute.distances[destination - 1];
+                    const double transitTime = static_cast<double>(summaryDistance) / busVelocity;
+                    const RouteElement routeElement = {.waitTime = busWaitTime,
+                                                       .bus = busRoute.busName,
+                                                       .from = vertexStopNames_[stops[departure]],
+                                                       .spanCount = destination - departure,
+                                                       .transitTime = transitTime};
+                    callback({stops[departure], stops[destination], transitTime + busWaitTime},
+                             &routeElement);
+                }
+            }
+            break;
+        case GraphModel::Boarding:
+            for (size_t stopIndex = 0; stopIndex < stops.size(); stopIndex++)
+            {
+                const auto stopVertex = stops[stopIndex];
+                const auto busStopVertex = busRoute.firstBusStopVertex + stopIndex;
+                if (stopIndex > 0)
+                {
+                    callback({busStopVertex, stopVertex, 0}, nullptr);
+                }
+                if (stopIndex + 1 == stops.size())
                 {
                     continue;
                 }
 
-                summaryDistance += routeDistances.at({*prev(destinationIt), *destinationIt});
-                const double transitTime = static_cast<double>(summaryDistance) / routingSettings.busVelocity;
-                const size_t spanCount = static_cast<size_t>(std::distance(departureIt, destinationIt));
-                RouteElement routeElement = {.waitTime = routingSettings.busWaitTime,
-                                             .bus = busName,
-                                             .from = *departureIt,
-                                             .spanCount = spanCount,
-                                             .transitTime = transitTime};
-
-                const auto totalTime = transitTime + routingSettings.busWaitTime;
-                const auto edgeId = graph_->addEdge(
-                    {stopToVertex_.at(*departureIt), stopToVertex_.at(*destinationIt), totalTime});
-                edgeToRouteElement_.emplace(edgeId, move(routeElement));
+                const RouteElement routeElement = {.waitTime = busWaitTime,
+                                                   .bus = busRoute.busName,
+                                                   .from = vertexStopNames_[stopVertex],
+                                                   .spanCount = 0,
+                                                   .transitTime = 0};
+                callback({stopVertex, busStopVertex, static_cast<double>(busWaitTime)},
+                         &routeElement);
+                // The ride takes the sum of the times of its spans, which may round otherwise than
+                // the time of its whole distance in StopPairs model and break a tie another way
+                callback({busStopVertex,
+                          busStopVertex + 1,
+                          static_cast<double>(busRoute.distances[stopIndex]) / busVelocity},
+                         nullptr);
             }
+            break;
+    }
+}
+
+void TransportRouter::addBus(const BaseRequests::Bus& bus, const RouteDistancesMap& routeDistances)
+{
+    checkUpdatesSupported();
+    ASSERT_WITH_MESSAGE(busNames_.count(bus.name) == 0,
+                        "the bus " << bus.name << " already exists");
+
+    for (const auto& stop : bus.stops)
+    {
+        if (stopToVertex_.count(stop) == 0)
+        {
+            stopToVertex_.emplace(stop, graph_->addVertex());
+        }
+    }
+    const Graph::VertexId busStopVertex = graph_->getVertexCount();
+    if (routingSettings_.graphModel == GraphModel::Boarding)
+    {
+        for (size_t stopIndex = 0; stopIndex < bus.stops.size(); stopIndex++)
+        {
+            graph_->addVertex();
         }
     }
+    fillVertexStopNames();
+
+    auto edgesByVertexes = makeEdgesByVertexes();
+    vector<Router::EdgeChange> edgeChanges;
+    addBusRoute(bus, routeDistances, busStopVertex, edgesByVertexes, &edgeChanges);
+    graph_->freeze();
+
+    // The bus may go between the same stops more than once, the first change of an edge keeps its
+    // weight before the bus
+    vector<Router::EdgeChange> changes;
+    unordered_set<Graph::EdgeId> changedEdges;
+    for (const auto& change : edgeChanges)
+    {
+        if (changedEdges.insert(change.edgeId).second)
+        {
+            changes.push_back(change);
+        }
+    }
+    updateRouter(changes);
+}
+
+void TransportRouter::setRouteDistances(const RouteDistancesMap& routeDistances)
+{
+    checkUpdatesSupported();
+
+    // The edges of the changed buses may be lighter or heavier than the parallel edges of the other
+    // buses now, so the lightest one is chosen anew for each of their vertex pairs
+    struct LightestEdge
+    {
+        double weight = numeric_limits<double>::infinity();
+        optional<RouteElement> routeElement;
+    };
+    unordered_map<VertexPair, LightestEdge, VertexPairHasher> lightestEdges;
+    for (auto& busRoute : busRoutes_)
+    {
+        bool isChanged = false;
+        for (size_t stopIndex = 0; stopIndex + 1 < busRoute.stops.size(); stopIndex++)
+        {
+            const size_t distance =
+                routeDistances.at({string(vertexStopNames_[busRoute.stops[stopIndex]]),
+                                   string(vertexStopNames_[busRoute.stops[stopIndex + 1]])});
+            if (busRoute.distances[stopIndex] != distance)
+            {
+                busRoute.distances[stopIndex] = distance;
+                isChanged = true;
+            }
+        }
+        if (!isChanged)
+        {
+            continue;
+        }
+
+        forEachBusEdge(busRoute,
+                       [&lightestEdges](const Graph::Edge<double>& edge, const RouteElement*) {
+                           lightestEdges.emplace(VertexPair{edge.from, edge.to}, LightestEdge{});
+                       });
+    }
+    if (lightestEdges.empty())
+    {
+        return;
+    }
+
+    for (const auto& busRoute : busRoutes_)
+    {
+        forEachBusEdge(busRoute,
+                       [&lightestEdges](const Graph::Edge<double>& edge,
+                                        const RouteElement* routeElement) {
+                           const auto it = lightestEdges.find({edge.from, edge.to});
+                           if (it != lightestEdges.end() && edge.weight < it->second.weight)
+                           {
+                               it->second.weight = edge.weight;
+                               it->second.routeElement =
+                                   routeElement ? optional(*routeElement) : nullopt;
+                           }
+                       });
+    }
+
+    // Edges are changed in the order of their ids, so the updated router doesn't depend on the
+    // order of the hash map
+    const auto edgesByVertexes = makeEdgesByVertexes();
+    vector<pair<Graph::EdgeId, const LightestEdge*>> changedEdges;
+    changedEdges.reserve(lightestEdges.size());
+    for (const auto& [vertexes, lightestEdge] : lightestEdges)
+    {
+        changedEdges.emplace_back(edgesByVertexes.at(vertexes), &lightestEdge);
+    }
+    sort(begin(changedEdges), end(changedEdges));
+
+    vector<Router::EdgeChange> changes;
+    for (const auto& [edgeId, lightestEdge] : changedEdges)
+    {
+        const double oldWeight = graph_->getEdge(edgeId).weight;
+        if (oldWeight < lightestEdge->weight || lightestEdge->weight < oldWeight)
+        {
+            graph_->setEdgeWeight(edgeId, lightestEdge->weight);
+            changes.push_back({edgeId, oldWeight});
+        }
+        const auto& routeElement = lightestEdge->routeElement;
+        setRouteElement(edgeId, routeElement ? &*routeElement : nullptr);
+    }
+    updateRouter(changes);
+}
+
+void TransportRouter::checkUpdatesSupported() const
+{
+    ASSERT_WITH_MESSAGE(holds_alternative<RouterPtr>(router_) ||
+                            holds_alternative<FloatRouterPtr>(router_) ||
+                            holds_alternative<FixedPointRouterPtr>(router_) ||
+                            holds_alternative<DijkstraRouterPtr>(router_),
+                        "only all_pairs and dijkstra routing algorithms can be updated");
+    ASSERT_WITH_MESSAGE(routingSettings_.busVelocity > 0,
+                        "the base was made without the data for the updates");
+}
+
+void TransportRouter::updateRouter(const vector<Router::EdgeChange>& changes)
+{
+    visit(Overloaded{[this, &changes](const RouterPtr& router) {
+                         router->update(changes, routingSettings_.threadCount);
+                     },
+                     [this, &changes](const FloatRouterPtr& router) {
+                         router->update(changes, routingSettings_.threadCount);
+                     },
+                     [this, &changes](const FixedPointRouterPtr& router) {
+                         router->update(changes, routingSettings_.threadCount);
+                     },
+                     [](const DijkstraRouterPtr& router) { router->clearCache(); },
+                     [](const auto&) {
+                         UNREACHABLE("the routing algorithm can't be updated");
+                     }},
+          router_);
+}
+
+// Vertexes of a bus route are at the points of its stops
+vector<Sphere::Point> TransportRouter::makeVertexPoints(const BaseRequests::ParsedBuses& buses,
+                                                        const StopCoordinates& stopCoordinates,
+                                                        GraphModel graphModel) const
+{
+    const auto getStopPoint = [&stopCoordinates](const string& stop) {
+        const auto* point = getValuePointer(stopCoordinates, stop);
+        ASSERT_WITH_MESSAGE(point, "coordinates of the stop " << stop << " are missing");
+        return *point;
+    };
+
+    vector<Sphere::Point> vertexPoints(graph_->getVertexCount());
+    for (const auto& [stop, vertex] : stopToVertex_)
+    {
+        vertexPoints[vertex] = getStopPoint(stop);
+    }
+    if (graphModel == GraphModel::Boarding)
+    {
+        Graph::VertexId busStopVertex = 0;
+        for (const auto& [busName, goingThroughStops] : buses)
+        {
+            for (const auto& stop : goingThroughStops)
+            {
+                vertexPoints[busStopVertex++] = getStopPoint(stop);
+            }
+        }
+    }
+    return vertexPoints;
 }
 
 TransportRouter::RoutingSettings TransportRouter::makeRoutingSettings(
     const Json::Map& routingSettingsMap)
 {
-    return {routingSettingsMap.at("bus_wait_time").asInt(),
-            routingSettingsMap.at("bus_velocity").asDouble() * FromKmPerHourToMPerMinute};
+    RoutingSettings result;
+    result.busWaitTime = routingSettingsMap.at("bus_wait_time").asInt();
+    result.busVelocity =
+        routingSettingsMap.at("bus_velocity").asDouble() * FromKmPerHourToMPerMinute;
+    result.threadCount = getHardwareThreadCount();
+    result.dijkstraCacheCapacity = DefaultDijkstraCacheCapacity;
+
+    if (const auto it = routingSettingsMap.find("graph_model"); it != routingSettingsMap.end())
+    {
+        result.graphModel = makeGraphModel(it->second.asString());
+    }
+
+    if (const auto it = routingSettingsMap.find("routing_algorithm");
+        it != routingSettingsMap.end())
+    {
+        result.algorithm = makeRoutingAlgorithm(it->second.asString());
+    }
+
+    if (const auto it = routingSettingsMap.find("thread_count"); it != routingSettingsMap.end())
+    {
+        const int threadCount = it->second.asInt();
+        ASSERT_WITH_MESSAGE(threadCount > 0, "thread_count has to be positive");
+        result.threadCount = static_cast<size_t>(threadCount);
+    }
+
+    if (const auto it = routingSettingsMap.find("max_transfers"); it != routingSettingsMap.end())
+    {
+        const int maxTransfers = it->second.asInt();
+        ASSERT_WITH_MESSAGE(maxTransfers >= 0, "max_transfers can't be negative");
+        ASSERT_WITH_MESSAGE(result.algorithm == RoutingAlgorithm::Raptor,
+                            "only raptor routing algorithm limits transfers");
+        result.maxTransfers = static_cast<size_t>(maxTransfers);
+    }
+
+    if (const auto it = routingSettingsMap.find("dijkstra_cache_size");
+        it != routingSettingsMap.end())
+    {
+        const int cacheCapacity = it->second.asInt();
+        ASSERT_WITH_MESSAGE(cacheCapacity > 0, "dijkstra_cache_size has to be positive");
+        result.dijkstraCacheCapacity = static_cast<size_t>(cacheCapacity);
+    }
+
+    if (const auto it = routingSettingsMap.find("weight_type"); it != routingSettingsMap.end())
+    {
+        result.weightType = makeWeightType(it->second.asString());
+        ASSERT_WITH_MESSAGE(result.weightType == WeightType::Double ||
+                                result.algorithm == RoutingAlgorithm::AllPairs,
+                            "only all_pairs routing algorithm supports narrower weights");
+    }
+
+    if (const auto it = routingSettingsMap.find("path_storage"); it != routingSettingsMap.end())
+    {
+        result.pathStorage = makePathStorage(it->second.asString());
+        ASSERT_WITH_MESSAGE(result.pathStorage == PathStorage::PreviousEdges ||
+                                (result.algorithm == RoutingAlgorithm::AllPairs &&
+                                 result.weightType == WeightType::Double),
+                            "only all_pairs algorithm with double weights keeps first hops");
+    }
+
+    if (const auto it = routingSettingsMap.find("vertex_order"); it != routingSettingsMap.end())
+    {
+        result.vertexOrder = makeVertexOrder(it->second.asString());
+    }
+
+    return result;
+}
+
+TransportRouter::GraphModel TransportRouter::makeGraphModel(const string& name)
+{
+    if (name == "stop_pairs")
+    {
+        return GraphModel::StopPairs;
+    }
+    else if (name == "boarding")
+    {
+        return GraphModel::Boarding;
+    }
+    UNREACHABLE("unknown graph model: "s + name);
+}
+
+TransportRouter::RoutingAlgorithm TransportRouter::makeRoutingAlgorithm(const string& name)
+{
+    if (name == "all_pairs")
+    {
+        return RoutingAlgorithm::AllPairs;
+    }
+    else if (name == "dijkstra")
+    {
+        return RoutingAlgorithm::Dijkstra;
+    }
+    else if (name == "contraction_hierarchy")
+    {
+        return RoutingAlgorithm::ContractionHierarchy;
+    }
+    else if (name == "a_star")
+    {
+        return RoutingAlgorithm::AStar;
+    }
+    else if (name == "bidirectional_a_star")
+    {
+        return RoutingAlgorithm::BidirectionalAStar;
+    }
+    else if (name == "hub_labeling")
+    {
+        return RoutingAlgorithm::HubLabeling;
+    }
+    else if (name == "raptor")
+    {
+        return RoutingAlgorithm::Raptor;
+    }
+    UNREACHABLE("unknown routing algorithm: "s + name);
+}
+
+TransportRouter::WeightType TransportRouter::makeWeightType(const string& name)
+{
+    if (name == "double")
+    {
+        return WeightType::Double;
+    }
+    else if (name == "float")
+    {
+        return WeightType::Float;
+    }
+    else if (name == "fixed_point")
+    {
+        return WeightType::FixedPoint;
+    }
+    UNREACHABLE("unknown weight type: "s + name);
+}
+
+TransportRouter::PathStorage TransportRouter::makePathStorage(const string& name)
+{
+    if (name == "previous_edges")
+    {
+        return PathStorage::PreviousEdges;
+    }
+    else if (name == "first_hops")
+    {
+        return PathStorage::FirstHops;
+    }
+    UNREACHABLE("unknown path storage: "s + name);
+}
+
+TransportRouter::VertexOrder TransportRouter::makeVertexOrder(const string& name)
+{
+    if (name == "appearance")
+    {
+        return VertexOrder::Appearance;
+    }
+    else if (name == "cuthill_mckee")
+    {
+        return VertexOrder::CuthillMcKee;
+    }
+    UNREACHABLE("unknown vertex order: "s + name);
 }
 
 optional<TransportRouter::RouteStats> TransportRouter::findRoute(const string& from,
                                                                  const string& to) const
+{
+    RouteStats route;
+    if (!findRoute(from, to, route))
+    {
+        return nullopt;
+    }
+    return route;
+}
+
+bool TransportRouter::findRoute(const string& from, const string& to, RouteStats& route) const
 {
     if (from == to)
     {
-        return RouteStats{};
+        route.totalTime = 0;
+        route.routeElements.clear();
+        return true;
     }
 
     if (stopToVertex_.count(from) == 0 || stopToVertex_.count(to) == 0)
     {
-        return nullopt;
+        return false;
     }
 
+    const auto fromVertex = stopToVertex_.at(from);
+    const auto toVertex = stopToVertex_.at(to);
+    return visit(Overloaded{[this, fromVertex, toVertex, &route](const RouterPtr& router) {
+                                return fillRouteStats(*router, fromVertex, toVertex, route);
+                            },
+                            [this, fromVertex, toVertex, &route](const FloatRouterPtr& router) {
+                                return fillRouteStats(*router, fromVertex, toVertex, route);
+                            },
+                            [this, fromVertex, toVertex, &route](
+                                const FixedPointRouterPtr& router) {
+                                return fillRouteStats(*router, fromVertex, toVertex, route);
+                            },
+                            [this, fromVertex, toVertex, &route](
+                                const FirstHopRouterPtr& router) {
+                                return fillForwardRouteStats(*router, fromVertex, toVertex, route);
+                            },
+                            [this, fromVertex, toVertex, &route](
+                                const HubLabelingRouterPtr& router) {
+                                return fillForwardRouteStats(*router, fromVertex, toVertex, route);
+                            },
+                            [this, fromVertex, toVertex, &route](const MappedRouterPtr& router) {
+                                return fillMappedRouteStats(*router, fromVertex, toVertex, route);
+                            },
+                            [this, fromVertex, toVertex, &route](const RaptorRouterPtr& router) {
+                                return fillJourneyStats(*router, fromVertex, toVertex, route);
+                            },
+                            [this, fromVertex, toVertex, &route](const auto& router) {
+                                return fillExpandedRouteStats(*router, fromVertex, toVertex, route);
+                            }},
+                 router_);
+}
+
+vector<vector<optional<double>>> TransportRouter::findRouteTimes(const vector<string>& from,
+                                                                 const vector<string>& to) const
+{
+    // Every known stop gets an index in the list of the distinct vertexes to search
+    const auto collectVertexes = [this](const vector<string>& stops,
+                                        vector<Graph::VertexId>& vertexes) {
+        vector<optional<size_t>> vertexIndexes(stops.size());
+        unordered_map<Graph::VertexId, size_t> vertexToIndex;
+        for (size_t stopIndex = 0; stopIndex < stops.size(); stopIndex++)
+        {
+            if (const auto* vertex = getValuePointer(stopToVertex_, stops[stopIndex]))
+            {
+                const auto [it, isInserted] = vertexToIndex.emplace(*vertex, vertexes.size());
+                if (isInserted)
+                {
+                    vertexes.push_back(*vertex);
+                }
+                vertexIndexes[stopIndex] = it->second;
+            }
+        }
+        return vertexIndexes;
+    };
+    vector<Graph::VertexId> sources;
+    vector<Graph::VertexId> targets;
+    const auto sourceIndexes = collectVertexes(from, sources);
+    const auto targetIndexes = collectVertexes(to, targets);
+
+    const auto weights =
+        visit(Overloaded{[&sources, &targets](const RaptorRouterPtr& router) {
+                             return router->findJourneyTimes(sources, targets);
+                         },
+                         [&sources, &targets](const auto& router) {
+                             return toDoubleWeights(router->findRouteWeights(sources, targets));
+                         }},
+              router_);
+
+    vector<vector<optional<double>>> times(from.size(), vector<optional<double>>(to.size()));
+    for (size_t fromIndex = 0; fromIndex < from.size(); fromIndex++)
+    {
+        for (size_t toIndex = 0; toIndex < to.size(); toIndex++)
+        {
+            auto& time = times[fromIndex][toIndex];
+            if (from[fromIndex] == to[toIndex])
+            {
+                time = 0;
+            }
+            else if (sourceIndexes[fromIndex] && targetIndexes[toIndex])
+            {
+                const double weight =
+                    weights[*sourceIndexes[fromIndex] * targets.size() + *targetIndexes[toIndex]];
+                if (weight < numeric_limits<double>::infinity())
+                {
+                    time = weight;
+                }
+            }
+        }
+    }
+    return times;
+}
+
+string_view TransportRouter::getStopName(const string& name) const
+{
+    const auto it = stopToVertex_.find(name);
+    ASSERT_WITH_MESSAGE(it != stopToVertex_.end(), "unknown stop " << name);
+    return it->first;
+}
+
+string_view TransportRouter::addBusName(const string& name)
+{
+    return *busNames_.insert(name).first;
+}
+
+// Edges are taken from the last one to the first one. Span edges of Boarding model go before the
+// boarding edge which starts their route element, so their spans are summed up until it's met
+void TransportRouter::addRouteEdgeBackwards(Graph::EdgeId edgeId,
+                                            RouteElement& spans,
+                                            vector<RouteElement>& routeElements) const
+{
+    if (const auto* routeElement = getValuePointer(edgeToRouteElement_, edgeId))
+    {
+        auto& element = routeElements.emplace_back(*routeElement);
+        element.spanCount += spans.spanCount;
+        element.transitTime += spans.transitTime;
+        spans = {};
+        return;
+    }
+
+    // Edges of Boarding model which don't start a route element. Span edges go between vertexes of
+    // a bus route, alighting ones go back to the stops and add nothing
+    const auto& edge = graph_->getEdge(edgeId);
+    if (vertexStopNames_[edge.to].empty())
+    {
+        spans.spanCount++;
+        spans.transitTime += edge.weight;
+    }
+}
+
+void TransportRouter::addRouteEdgeForwards(Graph::EdgeId edgeId,
+                                           vector<RouteElement>& routeElements) const
+{
+    if (const auto* routeElement = getValuePointer(edgeToRouteElement_, edgeId))
+    {
+        routeElements.push_back(*routeElement);
+        return;
+    }
+
+    const auto& edge = graph_->getEdge(edgeId);
+    if (vertexStopNames_[edge.to].empty() && !routeElements.empty())
+    {
+        auto& element = routeElements.back();
+        element.spanCount++;
+        element.transitTime += edge.weight;
+    }
+}
+
+// The total time is summed up over the edges of the graph, so it's exact whatever weights the
+// routes matrix keeps
+template <typename Weight>
+bool TransportRouter::fillRouteStats(const Graph::Router<Weight, double>& router,
+                                     Graph::VertexId from,
+                                     Graph::VertexId to,
+                                     RouteStats& route) const
+{
+    const auto routeView = router.getRoute(from, to);
+    if (!routeView)
+    {
+        return false;
+    }
+
+    route.totalTime = 0;
+    route.routeElements.clear();
+    RouteElement spans = {};
+    for (const Graph::EdgeId edgeId : *routeView)
+    {
+        route.totalTime += graph_->getEdge(edgeId).weight;
+        addRouteEdgeBackwards(edgeId, spans, route.routeElements);
+    }
+    reverse(begin(route.routeElements), end(route.routeElements));
+    return true;
+}
+
+template <typename AnyRouter>
+bool TransportRouter::fillExpandedRouteStats(AnyRouter& router,
+                                             Graph::VertexId from,
+                                             Graph::VertexId to,
+                                             RouteStats& route) const
+{
     // NOTE: It would be better to implement RAII wrapper around the route to be sure that it will be
     // released, but we don't expect exceptions in normal workflow here, so we leave it as is by now
-    const auto route = router_->buildRoute(stopToVertex_.at(from), stopToVertex_.at(to));
-    if (!route)
+    const auto routeInfo = router.buildRoute(from, to);
+    if (!routeInfo)
     {
-        return nullopt;
+        return false;
     }
 
-    RouteStats result;
-    result.totalTime = route->weight;
+    route.totalTime = routeInfo->weight;
+    route.routeElements.clear();
+    RouteElement spans = {};
+    for (size_t edgeIndex = routeInfo->edgeCount; edgeIndex > 0; edgeIndex--)
+    {
+        addRouteEdgeBackwards(
+            router.getRouteEdge(routeInfo->id, edgeIndex - 1), spans, route.routeElements);
+    }
+    router.releaseRoute(routeInfo->id);
+    reverse(begin(route.routeElements), end(route.routeElements));
+    return true;
+}
+
+// Edges go from the first one, so span edges of Boarding model add up to the route element of the
+// boarding edge before them
+template <typename AnyRouter>
+bool TransportRouter::fillForwardRouteStats(const AnyRouter& router,
+                                            Graph::VertexId from,
+                                            Graph::VertexId to,
+                                            RouteStats& route) const
+{
+    route.totalTime = 0;
+    route.routeElements.clear();
+    return router.forEachRouteEdge(from, to, [this, &route](Graph::EdgeId edgeId) {
+        route.totalTime += graph_->getEdge(edgeId).weight;
+        addRouteEdgeForwards(edgeId, route.routeElements);
+    });
+}
 
-    const auto edgeCount = route->edgeCount;
-    for (size_t edgeIndex = 0; edgeIndex < edgeCount; edgeIndex++)
+bool TransportRouter::fillMappedRouteStats(const MappedRouter& router,
+                                           Graph::VertexId from,
+                                           Graph::VertexId to,
+                                           RouteStats& route) const
+{
+    route.totalTime = 0;
+    route.routeElements.clear();
+    RouteElement spans = {};
+    const bool isFound =
+        router.forEachRouteEdgeBackwards(from, to, [this, &route, &spans](Graph::EdgeId edgeId) {
+            route.totalTime += graph_->getEdge(edgeId).weight;
+            addRouteEdgeBackwards(edgeId, spans, route.routeElements);
+        });
+    reverse(begin(route.routeElements), end(route.routeElements));
+    return isFound;
+}
+
+bool TransportRouter::fillJourneyStats(const RaptorRouter& router,
+                                       Graph::VertexId from,
+                                       Graph::VertexId to,
+                                       RouteStats& route) const
+{
+    const auto journey = router.findJourney(from, to);
+    if (!journey)
     {
-        const auto edgeId = router_->getRouteEdge(route->id, edgeIndex);
-        result.routeElements.emplace_back(edgeToRouteElement_.at(edgeId));
+        return false;
     }
-    router_->releaseRoute(route->id);
 
-    return result;
+    route.totalTime = journey->totalTime;
+    route.routeElements.clear();
+    for (const auto& ride : journey->rides)
+    {
+        route.routeElements.push_back({.waitTime = router.getBusWaitTime(),
+                                       .bus = router.getBusName(ride.busIndex),
+                                       .from = router.getStopName(ride.from),
+                                       .spanCount = ride.spanCount,
+                                       .transitTime = ride.transitTime});
+    }
+    return true;
+}
+
+size_t TransportRouter::getDroppedEdgeCount() const
+{
+    return droppedEdgeCount_;
 }
 
-void TransportRouter::serialize(TCProto::TransportRouter& proto) const
+void TransportRouter::serialize(TCProto::TransportRouter& proto,
+                                const BaseNames* names,
+                                google::protobuf::io::ZeroCopyOutputStream* mappedRoutes) const
 {
     graph_->serialize(*proto.mutable_graph());
-    router_->serialize(*proto.mutable_router());
+    visit(Overloaded{[this, &proto, mappedRoutes](const RouterPtr& router) {
+                         if (mappedRoutes)
+                         {
+                             MappedRouter::write(*graph_, *router, *mappedRoutes);
+                             proto.mutable_mapped_router();
+                         }
+                         else
+                         {
+                             router->serialize(*proto.mutable_router(),
+                                               routingSettings_.threadCount);
+                         }
+                     },
+                     [this, &proto](const FloatRouterPtr& router) {
+                         router->serialize(*proto.mutable_float_router(),
+                                           routingSettings_.threadCount);
+                     },
+                     [this, &proto](const FixedPointRouterPtr& router) {
+                         router->serialize(*proto.mutable_fixed_point_router(),
+                                           routingSettings_.threadCount);
+                     },
+                     [&proto](const FirstHopRouterPtr& router) {
+                         router->serialize(*proto.mutable_first_hop_router());
+                     },
+                     [&proto, mappedRoutes](const MappedRouterPtr& router) {
+                         ASSERT_WITH_MESSAGE(mappedRoutes,
+                                             "mapped routes can be written to a mapped base only");
+                         const auto& section = router->getSection();
+                         google::protobuf::io::CodedOutputStream output(mappedRoutes);
+                         constexpr size_t MaxChunkSize = numeric_limits<int>::max();
+                         for (size_t offset = 0; offset < section.getSize(); offset += MaxChunkSize)
+                         {
+                             output.WriteRaw(
+                                 section.getData() + offset,
+                                 static_cast<int>(min(MaxChunkSize, section.getSize() - offset)));
+                         }
+                         proto.mutable_mapped_router();
+                     },
+                     [&proto](const DijkstraRouterPtr& router) {
+                         router->serialize(*proto.mutable_dijkstra_router());
+                     },
+                     [&proto](const ContractionHierarchyRouterPtr& router) {
+                         router->serialize(*proto.mutable_contraction_hierarchy_router());
+                     },
+                     [&proto](const AStarRouterPtr& router) {
+                         router->serialize(*proto.mutable_a_star_router());
+                     },
+                     [&proto](const HubLabelingRouterPtr& router) {
+                         router->serialize(*proto.mutable_hub_labeling_router());
+                     },
+                     [&proto](const RaptorRouterPtr& router) {
+                         router->serialize(*proto.mutable_raptor_router());
+                     }},
+          router_);
+
+    auto& routingSettingsProto = *proto.mutable_routing_settings();
+    routingSettingsProto.set_bus_wait_time(routingSettings_.busWaitTime);
+    routingSettingsProto.set_bus_velocity(routingSettings_.busVelocity);
+    routingSettingsProto.set_is_boarding_model(routingSettings_.graphModel == GraphModel::Boarding);
 
-    proto.mutable_vertexes_info()->Reserve(static_cast<int>(stopToVertex_.size()));
+    proto.mutable_bus_routes()->Reserve(static_cast<int>(busRoutes_.size()));
+    for (const auto& busRoute : busRoutes_)
+    {
+        auto& busRouteProto = *proto.add_bus_routes();
+        if (names)
+        {
+            busRouteProto.set_bus_id(names->buses.getId(busRoute.busName));
+        }
+        else
+        {
+            busRouteProto.set_bus_name(string(busRoute.busName));
+        }
+        *busRouteProto.mutable_stops() = {busRoute.stops.begin(), busRoute.stops.end()};
+        *busRouteProto.mutable_distances() = {busRoute.distances.begin(),
+                                              busRoute.distances.end()};
+        busRouteProto.set_first_bus_stop_vertex(busRoute.firstBusStopVertex);
+    }
+
+    // Vertexes and edges go in the order of their ids, so the base doesn't depend on the order of
+    // the maps
+    vector<pair<Graph::VertexId, const string*>> vertexStops;
+    vertexStops.reserve(stopToVertex_.size());
     for (const auto& [stopName, vertexId] : stopToVertex_)
+    {
+        vertexStops.emplace_back(vertexId, &stopName);
+    }
+    sort(vertexStops.begin(), vertexStops.end());
+    proto.mutable_vertexes_info()->Reserve(static_cast<int>(vertexStops.size()));
+    for (const auto& [vertexId, stopName] : vertexStops)
     {
         auto& vertexInfoProto = *proto.add_vertexes_info();
-        vertexInfoProto.set_stop_name(stopName);
+        if (names)
+        {
+            vertexInfoProto.set_stop_id(names->stops.getId(*stopName));
+        }
+        else
+        {
+            vertexInfoProto.set_stop_name(*stopName);
+        }
         vertexInfoProto.set_vertex_id(vertexId);
     }
 
-    proto.mutable_edges_info()->Reserve(static_cast<int>(edgeToRouteElement_.size()));
-    for (const auto& [edgeId, routeElement] : edgeToRouteElement_)
+    vector<const pair<const Graph::EdgeId, RouteElement>*> edges;
+    edges.reserve(edgeToRouteElement_.size());
+    for (const auto& edge : edgeToRouteElement_)
+    {
+        edges.push_back(&edge);
+    }
+    sort(edges.begin(), edges.end(), [](const auto* lhs, const auto* rhs) {
+        return lhs->first < rhs->first;
+    });
+
+    // Every EdgesInfoShardSize edges are a shard, which is encoded on its own
+    const size_t shardCount = (edges.size() + EdgesInfoShardSize - 1) / EdgesInfoShardSize;
+    vector<TCProto::EdgesInfoShard*> shardProtos;
+    shardProtos.reserve(shardCount);
+    proto.mutable_edges_info_shards()->Reserve(static_cast<int>(shardCount));
+    for (size_t shardIndex = 0; shardIndex < shardCount; ++shardIndex)
     {
-        auto& edgeInfoProto = *proto.add_edges_info();
-        edgeInfoProto.set_edge_id(edgeId);
-        edgeInfoProto.set_wait_time(routeElement.waitTime);
-        edgeInfoProto.set_bus_name(routeElement.bus);
-        edgeInfoProto.set_departure_stop_name(routeElement.from);
-        edgeInfoProto.set_span_count(routeElement.spanCount);
-        edgeInfoProto.set_transit_time(routeElement.transitTime);
+        shardProtos.push_back(proto.add_edges_info_shards());
     }
+    parallelFor(shardCount, routingSettings_.threadCount, [&](size_t shardIndex) {
+        auto& shardProto = *shardProtos[shardIndex];
+        const size_t firstEdge = shardIndex * EdgesInfoShardSize;
+        const size_t edgeCount = min(EdgesInfoShardSize, edges.size() - firstEdge);
+        shardProto.mutable_edges_info()->Reserve(static_cast<int>(edgeCount));
+        for (size_t edgeIndex = firstEdge; edgeIndex < firstEdge + edgeCount; ++edgeIndex)
+        {
+            const auto& [edgeId, routeElement] = *edges[edgeIndex];
+            auto& edgeInfoProto = *shardProto.add_edges_info();
+            edgeInfoProto.set_edge_id(edgeId);
+            edgeInfoProto.set_wait_time(routeElement.waitTime);
+            if (names)
+            {
+                edgeInfoProto.set_bus_id(names->buses.getId(routeElement.bus));
+                edgeInfoProto.set_departure_stop_id(names->stops.getId(routeElement.from));
+            }
+            else
+            {
+                edgeInfoProto.set_bus_name(string(routeElement.bus));
+                edgeInfoProto.set_departure_stop_name(string(routeElement.from));
+            }
+            edgeInfoProto.set_span_count(routeElement.spanCount);
+            edgeInfoProto.set_transit_time(routeElement.transitTime);
+        }
+    });
+
+    proto.set_dropped_edge_count(droppedEdgeCount_);
 }
 
-unique_ptr<TransportRouter> TransportRouter::deserialize(const TCProto::TransportRouter& proto)
+unique_ptr<TransportRouter> TransportRouter::deserialize(const TCProto::TransportRouter& proto,
+                                                         const BaseNames* names,
+                                                         const MappedSection* mappedRoutes)
 {
+    const auto readStopName = [names](const string& name, uint64_t id) -> const string& {
+        return names ? names->stops.getName(id) : name;
+    };
+    const auto readBusName = [names](const string& name, uint64_t id) -> const string& {
+        return names ? names->buses.getName(id) : name;
+    };
+
     unique_ptr<TransportRouter> transportRouterPtr(
         new TransportRouter); // Ctor is private, so can't use make_unique
 
+    // The shards of the routes are read on all the threads
+    const size_t threadCount = getHardwareThreadCount();
     transportRouterPtr->graph_ = make_unique<RoutesGraph>(RoutesGraph::deserialize(proto.graph()));
-    transportRouterPtr->router_ = Router::deserialize(proto.router(), *transportRouterPtr->graph_);
+    switch (proto.router_data_case())
+    {
+        case TCProto::TransportRouter::kRouter:
+            transportRouterPtr->router_ =
+                Router::deserialize(proto.router(), *transportRouterPtr->graph_, threadCount);
+            break;
+        case TCProto::TransportRouter::kFloatRouter:
+            transportRouterPtr->router_ = FloatRouter::deserialize(
+                proto.float_router(), *transportRouterPtr->graph_, threadCount);
+            break;
+        case TCProto::TransportRouter::kFixedPointRouter:
+            transportRouterPtr->router_ = FixedPointRouter::deserialize(
+                proto.fixed_point_router(), *transportRouterPtr->graph_, threadCount);
+            break;
+        case TCProto::TransportRouter::kFirstHopRouter:
+            transportRouterPtr->router_ = FirstHopRouter::deserialize(
+                proto.first_hop_router(), *transportRouterPtr->graph_);
+            break;
+        case TCProto::TransportRouter::kMappedRouter:
+            ASSERT_WITH_MESSAGE(mappedRoutes, "routes of the mapped base are missing");
+            transportRouterPtr->router_ =
+                make_unique<MappedRouter>(*transportRouterPtr->graph_, *mappedRoutes);
+            break;
+        case TCProto::TransportRouter::kDijkstraRouter:
+            transportRouterPtr->router_ =
+                DijkstraRouter::deserialize(proto.dijkstra_router(), *transportRouterPtr->graph_);
+            break;
+        case TCProto::TransportRouter::kContractionHierarchyRouter:
+            transportRouterPtr->router_ = ContractionHierarchyRouter::deserialize(
+                proto.contraction_hierarchy_router(), *transportRouterPtr->graph_);
+            break;
+        case TCProto::TransportRouter::kAStarRouter:
+            transportRouterPtr->router_ =
+                AStarRouter::deserialize(proto.a_star_router(), *transportRouterPtr->graph_);
+            break;
+        case TCProto::TransportRouter::kHubLabelingRouter:
+            transportRouterPtr->router_ = HubLabelingRouter::deserialize(
+                proto.hub_labeling_router(), *transportRouterPtr->graph_);
+            break;
+        case TCProto::TransportRouter::kRaptorRouter:
+            transportRouterPtr->router_ = RaptorRouter::deserialize(proto.raptor_router());
+            break;
+        case TCProto::TransportRouter::ROUTER_DATA_NOT_SET:
+            UNREACHABLE("router data is missing");
+    }
 
     transportRouterPtr->stopToVertex_.reserve(static_cast<size_t>(proto.vertexes_info().size()));
     for (const auto& vertexInfoProto : proto.vertexes_info())
     {
-        transportRouterPtr->stopToVertex_[vertexInfoProto.stop_name()] =
+        transportRouterPtr->stopToVertex_[readStopName(vertexInfoProto.stop_name(),
+                                                       vertexInfoProto.stop_id())] =
             vertexInfoProto.vertex_id();
     }
 
-    transportRouterPtr->edgeToRouteElement_.reserve(static_cast<size_t>(proto.edges_info().size()));
-    for (const auto& edgeInfoProto : proto.edges_info())
+    transportRouterPtr->fillVertexStopNames();
+
+    // Bases made before the updates were supported have no routing settings, they can't be updated
+    auto& routingSettings = transportRouterPtr->routingSettings_;
+    routingSettings.busWaitTime = proto.routing_settings().bus_wait_time();
+    routingSettings.busVelocity = proto.routing_settings().bus_velocity();
+    routingSettings.graphModel = proto.routing_settings().is_boarding_model()
+                                     ? GraphModel::Boarding
+                                     : GraphModel::StopPairs;
+    routingSettings.threadCount = threadCount;
+
+    transportRouterPtr->busRoutes_.reserve(static_cast<size_t>(proto.bus_routes().size()));
+    for (const auto& busRouteProto : proto.bus_routes())
+    {
+        transportRouterPtr->busRoutes_.push_back(
+            {.busName = transportRouterPtr->addBusName(
+                 readBusName(busRouteProto.bus_name(), busRouteProto.bus_id())),
+             .stops = {busRouteProto.stops().begin(), busRouteProto.stops().end()},
+             .distances = {busRouteProto.distances().begin(), busRouteProto.distances().end()},
+             .firstBusStopVertex = busRouteProto.first_bus_stop_vertex()});
+    }
+
+    // The shards are parsed along with the message, their edges are taken one after another
+    size_t edgeCount = static_cast<size_t>(proto.edges_info().size());
+    for (const auto& shardProto : proto.edges_info_shards())
     {
-        transportRouterPtr->edgeToRouteElement_[edgeInfoProto.edge_id()] = {
-            .waitTime = edgeInfoProto.wait_time(),
-            .bus = edgeInfoProto.bus_name(),
-            .from = edgeInfoProto.departure_stop_name(),
-            .spanCount = edgeInfoProto.span_count(),
-            .transitTime = edgeInfoProto.transit_time()};
+        edgeCount += static_cast<size_t>(shardProto.edges_info().size());
     }
+    transportRouterPtr->edgeToRouteElement_.reserve(edgeCount);
+    const auto readEdgesInfo = [&](const auto& edgesInfoProto) {
+        for (const auto& edgeInfoProto : edgesInfoProto)
+        {
+            transportRouterPtr->edgeToRouteElement_[edgeInfoProto.edge_id()] = {
+                .waitTime = edgeInfoProto.wait_time(),
+                .bus = transportRouterPtr->addBusName(
+                    readBusName(edgeInfoProto.bus_name(), edgeInfoProto.bus_id())),
+                .from = transportRouterPtr->getStopName(readStopName(
+                    edgeInfoProto.departure_stop_name(), edgeInfoProto.departure_stop_id())),
+                .spanCount = edgeInfoProto.span_count(),
+                .transitTime = edgeInfoProto.transit_time()};
+        }
+    };
+    readEdgesInfo(proto.edges_info());
+    for (const auto& shardProto : proto.edges_info_shards())
+    {
+        readEdgesInfo(shardProto.edges_info());
+    }
+
+    transportRouterPtr->droppedEdgeCount_ = proto.dropped_edge_count();
 
     return transportRouterPtr;
 }
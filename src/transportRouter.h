@@ -1,25 +1,40 @@
 #pragma once
 
+#include "aStarRouter.h"
 #include "baseRequests.h"
+#include "contractionHierarchyRouter.h"
+#include "dijkstraRouter.h"
+#include "firstHopRouter.h"
 #include "graph.h"
+#include "hubLabelingRouter.h"
 #include "json.h"
+#include "mappedFile.h"
+#include "mappedRouter.h"
+#include "nameTable.h"
+#include "raptorRouter.h"
 #include "routeDistancesDict.h"
 #include "router.h"
+#include "sphere.h"
 
 #include "transport_router.pb.h"
 
 #include <memory>
+#include <optional>
+#include <string_view>
 #include <unordered_map>
+#include <unordered_set>
+#include <variant>
 #include <vector>
 
 class TransportRouter
 {
 public:
+    // Names refer to the router, so they are valid as long as it is
     struct RouteElement
     {
         int waitTime;
-        std::string bus;
-        std::string from;
+        std::string_view bus;
+        std::string_view from;
         size_t spanCount;
         double transitTime;
     };
@@ -30,42 +45,262 @@ public:
         std::vector<RouteElement> routeElements;
     };
 
+    using StopCoordinates = std::unordered_map<std::string, Sphere::Point>;
+
 private:
     using RoutesGraph = Graph::DirectedWeightedGraph<double>;
     using RoutesGraphPtr = std::unique_ptr<RoutesGraph>;
     using Router = Graph::Router<double>;
     using RouterPtr = std::unique_ptr<Router>;
+    // Routes matrices of narrower weights over the same graph
+    using FloatRouter = Graph::Router<float, double>;
+    using FloatRouterPtr = std::unique_ptr<FloatRouter>;
+    using FixedPointRouter = Graph::Router<Graph::FixedPointWeight, double>;
+    using FixedPointRouterPtr = std::unique_ptr<FixedPointRouter>;
+    // Routes matrix with the first edges of the routes instead of the previous ones
+    using FirstHopRouter = Graph::FirstHopRouter<double>;
+    using FirstHopRouterPtr = std::unique_ptr<FirstHopRouter>;
+    // Routes matrix read in place from a mapped base
+    using MappedRouter = Graph::MappedRouter<double>;
+    using MappedRouterPtr = std::unique_ptr<MappedRouter>;
+    using DijkstraRouter = Graph::DijkstraRouter<double>;
+    using DijkstraRouterPtr = std::unique_ptr<DijkstraRouter>;
+    using ContractionHierarchyRouter = Graph::ContractionHierarchyRouter<double>;
+    using ContractionHierarchyRouterPtr = std::unique_ptr<ContractionHierarchyRouter>;
+    using AStarRouter = Graph::AStarRouter<double>;
+    using AStarRouterPtr = std::unique_ptr<AStarRouter>;
+    using HubLabelingRouter = Graph::HubLabelingRouter<double>;
+    using HubLabelingRouterPtr = std::unique_ptr<HubLabelingRouter>;
+    using RaptorRouterPtr = std::unique_ptr<RaptorRouter>;
+    using AnyRouterPtr = std::variant<RouterPtr,
+                                      FloatRouterPtr,
+                                      FixedPointRouterPtr,
+                                      FirstHopRouterPtr,
+                                      MappedRouterPtr,
+                                      DijkstraRouterPtr,
+                                      ContractionHierarchyRouterPtr,
+                                      AStarRouterPtr,
+                                      HubLabelingRouterPtr,
+                                      RaptorRouterPtr>;
+
+    enum class RoutingAlgorithm
+    {
+        // Precalculate routes between all pairs of stops
+        AllPairs,
+        // Search routes on demand, caching shortest path trees of recent departure stops
+        Dijkstra,
+        // Precalculate shortcuts of contraction hierarchies, search routes on demand with them
+        ContractionHierarchy,
+        // Search every route on demand guided by the great-circle distance to the destination
+        AStar,
+        // The same from both ends of the route
+        BidirectionalAStar,
+        // Precalculate hub labels of every stop, find a route by merging the labels of its ends
+        HubLabeling,
+        // Search routes on demand by rounds over the stop sequences of the buses, no graph is used
+        Raptor
+    };
+
+    enum class GraphModel
+    {
+        // Vertexes are stops, an edge for every pair of stops of a bus ride, quadratic in the route
+        // length
+        StopPairs,
+        // Vertexes are stops and stops of every bus route. A boarding edge goes from a stop to the
+        // bus route one, span edges go along the bus route, alighting edges go back to the stops.
+        // Linear in the route length
+        Boarding
+    };
+
+    // Weights of the routes matrix of AllPairs algorithm
+    enum class WeightType
+    {
+        Double,
+        // Half the memory, about seven significant digits
+        Float,
+        // Half the memory, four decimal digits
+        FixedPoint
+    };
+
+    // Edges of the routes kept by AllPairs algorithm
+    enum class PathStorage
+    {
+        // The previous edge of every route, the route is walked from its last edge
+        PreviousEdges,
+        // The first edge of every route in 16 or 32 bits, the route is walked from its first edge
+        FirstHops
+    };
+
+    // Order of the stop vertexes in the graph
+    enum class VertexOrder
+    {
+        // The order the stops first appear in the buses
+        Appearance,
+        // Reverse Cuthill-McKee order, neighbouring stops get close vertexes
+        CuthillMcKee
+    };
+
+    // Stop vertexes of a bus with the road distances between the neighbouring ones, so the edges
+    // of the bus can be found anew when a distance changes. In Boarding model the vertexes of the
+    // bus route go one after another from firstBusStopVertex
+    struct BusRoute
+    {
+        std::string_view busName;
+        std::vector<Graph::VertexId> stops;
+        std::vector<size_t> distances;
+        Graph::VertexId firstBusStopVertex = 0;
+    };
+
+    using VertexPair = std::pair<Graph::VertexId, Graph::VertexId>;
+
+    struct VertexPairHasher
+    {
+        size_t operator()(const VertexPair& vertexes) const;
+    };
+
+    // The graph has one edge at most from one vertex to another one
+    using EdgesByVertexes = std::unordered_map<VertexPair, Graph::EdgeId, VertexPairHasher>;
 
     struct RoutingSettings
     {
         int busWaitTime = 0;
         double busVelocity = 0;
+        GraphModel graphModel = GraphModel::StopPairs;
+        RoutingAlgorithm algorithm = RoutingAlgorithm::AllPairs;
+        WeightType weightType = WeightType::Double;
+        PathStorage pathStorage = PathStorage::PreviousEdges;
+        VertexOrder vertexOrder = VertexOrder::Appearance;
+        size_t threadCount = 1;
+        size_t dijkstraCacheCapacity = 0;
+        std::optional<size_t> maxTransfers;
     };
 
 public:
     TransportRouter(const BaseRequests::ParsedBuses& buses,
                     const RouteDistancesMap& routeDistances,
+                    const StopCoordinates& stopCoordinates,
                     const Json::Map& routingSettings);
 
+    // Route elements refer to the names kept in the router, so it can't be copied
+    TransportRouter(const TransportRouter&) = delete;
+    TransportRouter& operator=(const TransportRouter&) = delete;
+
     std::optional<RouteStats> findRoute(const std::string& from, const std::string& to) const;
+    // Fills the route given by the caller, reusing its memory, so nothing is allocated once it's
+    // big enough. Returns false if there is no route. Safe to call from several threads at once
+    // unless the routes are found by "dijkstra" or "contraction_hierarchy" algorithm
+    bool findRoute(const std::string& from, const std::string& to, RouteStats& route) const;
+    // Total times of the routes from every stop of from to every stop of to, nullopt where there is
+    // no route. The routes themselves aren't built, every distinct stop is searched once
+    std::vector<std::vector<std::optional<double>>> findRouteTimes(
+        const std::vector<std::string>& from, const std::vector<std::string>& to) const;
+
+    // Incremental updates of the base instead of making it anew, only "all_pairs" and "dijkstra"
+    // routing algorithms support them. The distances have to contain the ones between the stops of
+    // the bus. New stops get vertexes at the end of the graph
+    void addBus(const BaseRequests::Bus& bus, const RouteDistancesMap& routeDistances);
+    // Changes the road distances of the buses to the given ones. The distances are given the same
+    // way as to the constructor, both ways between the stops of every bus, so a distance given for
+    // one way only has to be given for the way back as well
+    void setRouteDistances(const RouteDistancesMap& routeDistances);
 
-    void serialize(TCProto::TransportRouter& proto) const;
-    static std::unique_ptr<TransportRouter> deserialize(const TCProto::TransportRouter& proto);
+    // Edges of the buses which weren't added to the graph since a lighter one or an earlier one of
+    // the same weight goes between the same vertexes. Many buses share the same stops, so in
+    // StopPairs model it's a big part of all the edges
+    size_t getDroppedEdgeCount() const;
+
+    // If names are given, the proto refers to the names by their ids in them. If mappedRoutes is
+    // given, the routes matrix of "all_pairs" algorithm with "double" weights and "previous_edges"
+    // storage is written there instead of the proto, see Graph::MappedRouter
+    void serialize(TCProto::TransportRouter& proto,
+                   const BaseNames* names = nullptr,
+                   google::protobuf::io::ZeroCopyOutputStream* mappedRoutes = nullptr) const;
+    // The names and the mapped routes have to be given if the proto refers to them
+    static std::unique_ptr<TransportRouter> deserialize(
+        const TCProto::TransportRouter& proto,
+        const BaseNames* names = nullptr,
+        const MappedSection* mappedRoutes = nullptr);
 
 private:
     TransportRouter() = default;
 
-    void createGraph(const BaseRequests::ParsedBuses& buses);
-    void fillGraphWithEdges(const BaseRequests::ParsedBuses& buses,
-                            const RouteDistancesMap& routeDistances,
-                            const RoutingSettings& routingSettings);
+    void createGraph(const BaseRequests::ParsedBuses& buses, GraphModel graphModel);
+    void fillVertexStopNames();
+    void reorderStopVertexes();
+    // Changes of the existing edges are collected if they are asked for
+    void addBusRoute(const BaseRequests::Bus& bus,
+                     const RouteDistancesMap& routeDistances,
+                     Graph::VertexId busStopVertex,
+                     EdgesByVertexes& edgesByVertexes,
+                     std::vector<Router::EdgeChange>* changes);
+    void addBusEdge(const Graph::Edge<double>& edge,
+                    const RouteElement* routeElement,
+                    EdgesByVertexes& edgesByVertexes,
+                    std::vector<Router::EdgeChange>* changes);
+    EdgesByVertexes makeEdgesByVertexes() const;
+    void setRouteElement(Graph::EdgeId edgeId, const RouteElement* routeElement);
+    template <typename Callback>
+    void forEachBusEdge(const BusRoute& busRoute, Callback callback) const;
+    void checkUpdatesSupported() const;
+    void updateRouter(const std::vector<Router::EdgeChange>& changes);
+    std::vector<Sphere::Point> makeVertexPoints(const BaseRequests::ParsedBuses& buses,
+                                                const StopCoordinates& stopCoordinates,
+                                                GraphModel graphModel) const;
 
     static RoutingSettings makeRoutingSettings(const Json::Map& routingSettingsMap);
+    static GraphModel makeGraphModel(const std::string& name);
+    static RoutingAlgorithm makeRoutingAlgorithm(const std::string& name);
+    static WeightType makeWeightType(const std::string& name);
+    static PathStorage makePathStorage(const std::string& name);
+    static VertexOrder makeVertexOrder(const std::string& name);
+
+    std::string_view getStopName(const std::string& name) const;
+    std::string_view addBusName(const std::string& name);
+
+    template <typename Weight>
+    bool fillRouteStats(const Graph::Router<Weight, double>& router,
+                        Graph::VertexId from,
+                        Graph::VertexId to,
+                        RouteStats& route) const;
+    template <typename AnyRouter>
+    bool fillExpandedRouteStats(AnyRouter& router,
+                                Graph::VertexId from,
+                                Graph::VertexId to,
+                                RouteStats& route) const;
+    template <typename AnyRouter>
+    bool fillForwardRouteStats(const AnyRouter& router,
+                               Graph::VertexId from,
+                               Graph::VertexId to,
+                               RouteStats& route) const;
+    bool fillMappedRouteStats(const MappedRouter& router,
+                              Graph::VertexId from,
+                              Graph::VertexId to,
+                              RouteStats& route) const;
+    bool fillJourneyStats(const RaptorRouter& router,
+                          Graph::VertexId from,
+                          Graph::VertexId to,
+                          RouteStats& route) const;
+    void addRouteEdgeBackwards(Graph::EdgeId edgeId,
+                               RouteElement& spans,
+                               std::vector<RouteElement>& routeElements) const;
+    void addRouteEdgeForwards(Graph::EdgeId edgeId,
+                              std::vector<RouteElement>& routeElements) const;
 
 private:
+    RoutingSettings routingSettings_;
     RoutesGraphPtr graph_;
-    RouterPtr router_;
+    AnyRouterPtr router_;
 
+    // Stops are the vertexes of StopPairs graph. In Boarding graph the vertexes of the bus routes
+    // go first and the stops after them, so that routes of equal time are chosen by their transfer
+    // stops as in StopPairs graph. Stops and buses added by an update go after all of them
     std::unordered_map<std::string, Graph::VertexId> stopToVertex_;
+    // Stop names of the vertexes, empty for the vertexes of the bus routes
+    std::vector<std::string_view> vertexStopNames_;
+    std::vector<BusRoute> busRoutes_;
+    // Names of the buses the route elements refer to, stop names are the keys of stopToVertex_
+    std::unordered_set<std::string> busNames_;
+    // Edges which start a route element: rides in StopPairs model, boardings in Boarding model
     std::unordered_map<Graph::EdgeId, RouteElement> edgeToRouteElement_;
+    size_t droppedEdgeCount_ = 0;
 };
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// Cache line size on most of the modern processors
+constexpr size_t CacheLineSize = 64;
+
+template <typename T, size_t Alignment = CacheLineSize>
+class AlignedAllocator
+{
+public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() = default;
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&)
+    {
+    }
+
+    T* allocate(size_t count)
+    {
+        return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T* pointer, size_t)
+    {
+        ::operator delete(pointer, std::align_val_t(Alignment));
+    }
+};
+
+template <typename T, typename U, size_t Alignment>
+bool operator==(const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&)
+{
+    return true;
+}
+
+template <typename T, typename U, size_t Alignment>
+bool operator!=(const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&)
+{
+    return false;
+}
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
@@ -0,0 +1,213 @@
+#include "mappedFile.h"
+#include "alignedAllocator.h"
+
+#include <google/protobuf/io/coded_stream.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace
+{
+size_t alignUp(size_t offset)
+{
+    return (offset + CacheLineSize - 1) / CacheLineSize * CacheLineSize;
+}
+
+void appendUint64(string& data, uint64_t value)
+{
+    data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void writeZeros(google::protobuf::io::ZeroCopyOutputStream& stream, size_t count)
+{
+    google::protobuf::io::CodedOutputStream output(&stream);
+    const string zeros(CacheLineSize, '\0');
+    for (; count > 0; count -= min(count, zeros.size()))
+    {
+        output.WriteRaw(zeros.data(), static_cast<int>(min(count, zeros.size())));
+    }
+}
+
+uint64_t readUint64(const MappedFile& file, size_t offset)
+{
+    ASSERT_WITH_MESSAGE(offset + sizeof(uint64_t) <= file.getSize(), "the file is truncated");
+    uint64_t value = 0;
+    memcpy(&value, file.getData() + offset, sizeof(value));
+    return value;
+}
+} // namespace
+
+MappedFile::MappedFile(const string& fileName)
+{
+    const int descriptor = open(fileName.c_str(), O_RDONLY);
+    ASSERT_WITH_MESSAGE(descriptor >= 0, "can't open the file " + fileName);
+
+    struct stat fileStat = {};
+    const bool isStatRead = fstat(descriptor, &fileStat) == 0;
+    size_ = isStatRead ? static_cast<size_t>(fileStat.st_size) : 0;
+    void* data = size_ > 0 ? mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, descriptor, 0) : nullptr;
+    // The mapping stays valid after the file is closed
+    close(descriptor);
+    ASSERT_WITH_MESSAGE(isStatRead && data != MAP_FAILED, "can't map the file " + fileName);
+    data_ = static_cast<const char*>(data);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_ != nullptr)
+    {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+const char* MappedFile::getData() const
+{
+    return data_;
+}
+
+size_t MappedFile::getSize() const
+{
+    return size_;
+}
+
+MappedSection::MappedSection(shared_ptr<const MappedFile> file, size_t offset, size_t size)
+    : file_(move(file))
+{
+    ASSERT_WITH_MESSAGE(offset <= file_->getSize() && size <= file_->getSize() - offset,
+                        "section is out of the mapped file");
+    data_ = file_->getData() + offset;
+    size_ = size;
+}
+
+const char* MappedSection::getData() const
+{
+    return data_;
+}
+
+size_t MappedSection::getSize() const
+{
+    return size_;
+}
+
+SectionedFile::Writer::Writer(const string& fileName,
+                              string_view magic,
+                              uint32_t version,
+                              size_t sectionCount)
+    : fileName_(fileName)
+    , magic_(magic)
+    , version_(version)
+    , sections_(sectionCount)
+{
+    ASSERT_WITH_MESSAGE(magic.size() == MagicSize, "magic has to be " << MagicSize << " bytes");
+    descriptor_ = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ASSERT_WITH_MESSAGE(descriptor_ >= 0, "can't open the file " + fileName);
+    stream_ = make_unique<google::protobuf::io::FileOutputStream>(descriptor_);
+
+    // The header is filled in when the sections are written
+    writeZeros(*stream_, MagicSize + (2 + 2 * sectionCount) * sizeof(uint64_t));
+}
+
+SectionedFile::Writer::~Writer()
+{
+    if (descriptor_ >= 0)
+    {
+        stream_.reset();
+        close(descriptor_);
+    }
+}
+
+google::protobuf::io::ZeroCopyOutputStream& SectionedFile::Writer::startSection(size_t index)
+{
+    ASSERT_WITH_MESSAGE(stream_ && index < sections_.size() && !sections_[index],
+                        "section " << index << " can't be written");
+    endSection();
+
+    const auto offset = static_cast<size_t>(stream_->ByteCount());
+    writeZeros(*stream_, alignUp(offset) - offset);
+    currentSection_ = index;
+    sections_[index] = pair{static_cast<uint64_t>(alignUp(offset)), uint64_t{0}};
+    return *stream_;
+}
+
+void SectionedFile::Writer::endSection()
+{
+    if (currentSection_)
+    {
+        auto& [offset, size] = *sections_[*currentSection_];
+        size = static_cast<uint64_t>(stream_->ByteCount()) - offset;
+        currentSection_.reset();
+    }
+}
+
+void SectionedFile::Writer::finish()
+{
+    ASSERT_WITH_MESSAGE(stream_, "the file " << fileName_ << " is finished already");
+    endSection();
+    string header(magic_);
+    appendUint64(header, version_);
+    appendUint64(header, sections_.size());
+    for (const auto& section : sections_)
+    {
+        ASSERT_WITH_MESSAGE(section,
+                            "not every section of the file " << fileName_ << " is written");
+        appendUint64(header, section->first);
+        appendUint64(header, section->second);
+    }
+
+    const bool isWritten = stream_->Flush() &&
+                           pwrite(descriptor_, header.data(), header.size(), 0) ==
+                               static_cast<ssize_t>(header.size());
+    stream_.reset();
+    const bool isClosed = close(descriptor_) == 0;
+    descriptor_ = -1;
+    ASSERT_WITH_MESSAGE(isWritten && isClosed, "can't write the file " << fileName_);
+}
+
+optional<uint32_t> SectionedFile::readVersion(const MappedFile& file, string_view magic)
+{
+    if (file.getSize() < MagicSize || string_view(file.getData(), MagicSize) != magic)
+    {
+        return nullopt;
+    }
+
+    const uint64_t version = readUint64(file, MagicSize);
+    ASSERT_WITH_MESSAGE(version <= numeric_limits<uint32_t>::max(),
+                        "wrong version " << version << " of the file");
+    return static_cast<uint32_t>(version);
+}
+
+optional<vector<MappedSection>> SectionedFile::read(const shared_ptr<const MappedFile>& file,
+                                                    string_view magic,
+                                                    uint32_t version)
+{
+    const auto fileVersion = readVersion(*file, magic);
+    if (!fileVersion)
+    {
+        return nullopt;
+    }
+
+    ASSERT_WITH_MESSAGE(*fileVersion == version,
+                        "unsupported version " << *fileVersion << " of the file, " << version
+                                               << " is expected");
+
+    const uint64_t sectionCount = readUint64(*file, MagicSize + sizeof(uint64_t));
+    ASSERT_WITH_MESSAGE(sectionCount <= file->getSize(), "the file is truncated");
+    vector<MappedSection> sections;
+    sections.reserve(sectionCount);
+    for (size_t index = 0; index < sectionCount; ++index)
+    {
+        const size_t tableOffset = MagicSize + (2 + 2 * index) * sizeof(uint64_t);
+        sections.emplace_back(file,
+                              readUint64(*file, tableOffset),
+                              readUint64(*file, tableOffset + sizeof(uint64_t)));
+    }
+    return sections;
+}
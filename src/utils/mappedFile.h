@@ -0,0 +1,113 @@
+#pragma once
+
+#include "utils.h"
+
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Whole file mapped into memory for reading. Its pages are read from the disk on the first access,
+// so mapping a file takes the same time whatever its size
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& fileName);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* getData() const;
+    size_t getSize() const;
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Part of a mapped file, which stays mapped as long as any of its sections is kept
+class MappedSection
+{
+public:
+    MappedSection() = default;
+    MappedSection(std::shared_ptr<const MappedFile> file, size_t offset, size_t size);
+
+    const char* getData() const;
+    size_t getSize() const;
+
+    // Array of count items of trivially copyable T at the offset from the beginning of the section,
+    // it has to lie inside the section and be aligned for T
+    template <typename T>
+    const T* getArray(size_t offset, size_t count) const;
+
+private:
+    std::shared_ptr<const MappedFile> file_;
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// File of sections which can be used in place once the file is mapped. The header is the magic,
+// the version, the count of the sections and the offset and the size of every one of them, all
+// 64-bit in the byte order of the machine. Every section is aligned to CacheLineSize
+namespace SectionedFile
+{
+constexpr size_t MagicSize = 8;
+
+// Writes the sections to the file as they are made, so none of them is kept in memory. The header
+// is written last, when all the sections are known
+class Writer
+{
+public:
+    Writer(const std::string& fileName,
+           std::string_view magic,
+           uint32_t version,
+           size_t sectionCount);
+    ~Writer();
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    // Stream of the section of the index, valid until the next section is started. The sections
+    // may be written in any order, every one of them once
+    google::protobuf::io::ZeroCopyOutputStream& startSection(size_t index);
+    // Every section has to be written
+    void finish();
+
+private:
+    void endSection();
+
+    std::string fileName_;
+    std::string magic_;
+    uint32_t version_ = 0;
+    int descriptor_ = -1;
+    std::unique_ptr<google::protobuf::io::FileOutputStream> stream_;
+    // Offset and size of every section written
+    std::vector<std::optional<std::pair<uint64_t, uint64_t>>> sections_;
+    std::optional<size_t> currentSection_;
+};
+
+// Version of the file, nullopt if it doesn't start with the magic
+std::optional<uint32_t> readVersion(const MappedFile& file, std::string_view magic);
+// Sections of the file, nullopt if it doesn't start with the magic. The version has to match
+std::optional<std::vector<MappedSection>> read(const std::shared_ptr<const MappedFile>& file,
+                                                std::string_view magic,
+                                                uint32_t version);
+} // namespace SectionedFile
+
+template <typename T>
+const T* MappedSection::getArray(size_t offset, size_t count) const
+{
+    ASSERT_WITH_MESSAGE(offset <= size_ && count <= (size_ - offset) / sizeof(T),
+                        "array is out of the mapped section");
+    const char* array = data_ + offset;
+    ASSERT_WITH_MESSAGE(reinterpret_cast<uintptr_t>(array) % alignof(T) == 0,
+                        "array of the mapped section isn't aligned");
+    return reinterpret_cast<const T*>(array);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+inline size_t getHardwareThreadCount()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Calls task(taskIndex) for every taskIndex in [0, taskCount) using up to threadCount threads, the
+// calling one included. Tasks are handed out one by one, so they are not required to be of equal size
+template <typename Task>
+void parallelFor(size_t taskCount, size_t threadCount, const Task& task)
+{
+    const size_t workerCount = std::min(threadCount, taskCount);
+    if (workerCount <= 1)
+    {
+        for (size_t taskIndex = 0; taskIndex < taskCount; ++taskIndex)
+        {
+            task(taskIndex);
+        }
+        return;
+    }
+
+    std::atomic<size_t> nextTaskIndex = 0;
+    const auto worker = [&]() {
+        for (size_t taskIndex = nextTaskIndex++; taskIndex < taskCount; taskIndex = nextTaskIndex++)
+        {
+            task(taskIndex);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(workerCount - 1);
+    for (size_t threadIndex = 1; threadIndex < workerCount; ++threadIndex)
+    {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
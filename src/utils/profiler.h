@@ -4,6 +4,10 @@
 #include <iostream>
 #include <string>
 
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
 class LogDuration
 {
 public:
@@ -26,6 +30,18 @@ private:
     std::chrono::steady_clock::time_point startTimePoint;
 };
 
+// Bytes taken from the heap by now, 0 where the C library doesn't tell it. The difference before
+// and after some code is the memory it keeps if no other thread allocates meanwhile
+inline size_t getAllocatedHeapSize()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    const auto info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
 #define UNIQ_ID_IMPL(lineno) _a_local_var_##lineno
 #define UNIQ_ID(lineno) UNIQ_ID_IMPL(lineno)
 
@@ -93,6 +93,15 @@ const V* getValuePointer(const std::unordered_map<K, V>& map, const K& key)
     }
 }
 
+// Makes a visitor for std::visit out of several lambdas
+template <typename... Ts>
+struct Overloaded : Ts...
+{
+    using Ts::operator()...;
+};
+template <typename... Ts>
+Overloaded(Ts...) -> Overloaded<Ts...>;
+
 std::string_view strip(std::string_view line);
 
 bool belongsToRange(double n, double lowerBound, double upperBound);
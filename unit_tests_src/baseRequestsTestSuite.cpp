@@ -7,7 +7,7 @@
 
 using namespace std;
 
-namespace
+namespace BaseRequests
 {
 bool operator==(const BaseRequests::Bus& lhs, const BaseRequests::Bus& rhs)
 {
@@ -65,7 +65,7 @@ ostream& operator<<(ostream& os, const BaseRequests::Stop& stop)
     os << "} latitude: " << stop.position.latitude << " longitude: " << stop.position.longitude;
     return os;
 }
-} // namespace
+} // namespace BaseRequests
 
 namespace BaseRequests
 {
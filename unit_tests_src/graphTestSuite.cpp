@@ -3,9 +3,11 @@
 #include "testRunner.h"
 #include "utils.h"
 
+#include <vector>
+
 using namespace std;
 
-namespace
+namespace Graph
 {
 template <typename Weight>
 bool operator==(const Graph::Edge<Weight>& lhs, const Graph::Edge<Weight>& rhs)
@@ -18,12 +20,55 @@ ostream& operator<<(ostream& stream, const Graph::Edge<Weight>& edge)
 {
     return stream << "from: " << edge.from << " to: " << edge.to << " weight: " << edge.weight;
 }
-}
+} // namespace Graph
 
 namespace Graph
 {
 namespace Tests
 {
+namespace
+{
+template <typename Weight>
+vector<EdgeId> getOutEdgeIds(const DirectedWeightedGraph<Weight>& graph, VertexId vertex)
+{
+    vector<EdgeId> edgeIds;
+    for (const auto& outEdge : graph.getEdgesWhichStartFrom(vertex))
+    {
+        ASSERT_EQUAL(graph.getEdge(outEdge.id),
+                     Edge<Weight>({.from = vertex, .to = outEdge.to, .weight = outEdge.weight}));
+        edgeIds.push_back(outEdge.id);
+    }
+    return edgeIds;
+}
+
+DirectedWeightedGraph<double> makeGraph()
+{
+    DirectedWeightedGraph<double> graph(4);
+    graph.addEdge({.from = 2, .to = 1, .weight = 3.5});
+    graph.addEdge({.from = 0, .to = 2, .weight = 1.25});
+    graph.addEdge({.from = 2, .to = 3, .weight = 7});
+    graph.addEdge({.from = 0, .to = 1, .weight = 2});
+    graph.freeze();
+    return graph;
+}
+
+void assertGraphsAreEqual(const DirectedWeightedGraph<double>& graph,
+                          const DirectedWeightedGraph<double>& expectedGraph)
+{
+    ASSERT(graph.isFrozen());
+    ASSERT_EQUAL(graph.getVertexCount(), expectedGraph.getVertexCount());
+    ASSERT_EQUAL(graph.getEdgeCount(), expectedGraph.getEdgeCount());
+    for (EdgeId edgeId = 0; edgeId < graph.getEdgeCount(); edgeId++)
+    {
+        ASSERT_EQUAL(graph.getEdge(edgeId), expectedGraph.getEdge(edgeId));
+    }
+    for (VertexId vertex = 0; vertex < graph.getVertexCount(); vertex++)
+    {
+        ASSERT_EQUAL(getOutEdgeIds(graph, vertex), getOutEdgeIds(expectedGraph, vertex));
+    }
+}
+} // namespace
+
 void testEmptyGraph()
 {
     DirectedWeightedGraph<double> graph;
@@ -36,12 +81,13 @@ void testDifferentWeightDependingOnDirection()
     DirectedWeightedGraph<int> graph(2);
     graph.addEdge({.from = 0, .to = 1, .weight = -3124});
     graph.addEdge({.from = 1, .to = 0, .weight = 4951335});
+    graph.freeze();
 
     ASSERT_EQUAL(graph.getEdge(0), Edge<int>({.from = 0, .to = 1, .weight = -3124}));
     ASSERT_EQUAL(graph.getEdge(1), Edge<int>({.from = 1, .to = 0, .weight = 4951335}));
 
-    ASSERT_EQUAL(graph.getEdgesWhichStartFrom(0), asRange(vector<EdgeId>{0}));
-    ASSERT_EQUAL(graph.getEdgesWhichStartFrom(1), asRange(vector<EdgeId>{1}));
+    ASSERT_EQUAL(getOutEdgeIds(graph, 0), vector<EdgeId>({0}));
+    ASSERT_EQUAL(getOutEdgeIds(graph, 1), vector<EdgeId>({1}));
 
     ASSERT_EQUAL(graph.getVertexCount(), 2u);
     ASSERT_EQUAL(graph.getEdgeCount(), 2u);
@@ -56,6 +102,7 @@ void testGraphWithSeveralVertexesAndEdges()
     graph.addEdge({.from = 1, .to = 0, .weight = -8.5f});
     graph.addEdge({.from = 0, .to = 3, .weight = 6.8465f});
     graph.addEdge({.from = 3, .to = 0, .weight = 6.2873f});
+    graph.freeze();
 
     ASSERT_EQUAL(graph.getEdge(0), Edge<float>({.from = 3, .to = 4, .weight = 941.334f}));
     ASSERT_EQUAL(graph.getEdge(1), Edge<float>({.from = 4, .to = 3, .weight = -6453.465f}));
@@ -64,23 +111,114 @@ void testGraphWithSeveralVertexesAndEdges()
     ASSERT_EQUAL(graph.getEdge(4), Edge<float>({.from = 0, .to = 3, .weight = 6.8465f}));
     ASSERT_EQUAL(graph.getEdge(5), Edge<float>({.from = 3, .to = 0, .weight = 6.2873f}));
 
-    ASSERT_EQUAL(graph.getEdgesWhichStartFrom(0), asRange(vector<EdgeId>{4}));
-    ASSERT_EQUAL(graph.getEdgesWhichStartFrom(1), asRange(vector<EdgeId>{3}));
-    ASSERT_EQUAL(graph.getEdgesWhichStartFrom(2), asRange(vector<EdgeId>{2}));
-    ASSERT_EQUAL(graph.getEdgesWhichStartFrom(3), asRange(vector<EdgeId>{0, 5}));
-    ASSERT_EQUAL(graph.getEdgesWhichStartFrom(4), asRange(vector<EdgeId>{1}));
-    ASSERT_EQUAL(graph.getEdgesWhichStartFrom(5), asRange(vector<EdgeId>{}));
+    ASSERT_EQUAL(getOutEdgeIds(graph, 0), vector<EdgeId>({4}));
+    ASSERT_EQUAL(getOutEdgeIds(graph, 1), vector<EdgeId>({3}));
+    ASSERT_EQUAL(getOutEdgeIds(graph, 2), vector<EdgeId>({2}));
+    ASSERT_EQUAL(getOutEdgeIds(graph, 3), vector<EdgeId>({0, 5}));
+    ASSERT_EQUAL(getOutEdgeIds(graph, 4), vector<EdgeId>({1}));
+    ASSERT_EQUAL(getOutEdgeIds(graph, 5), vector<EdgeId>({}));
 
     ASSERT_EQUAL(graph.getVertexCount(), 6u);
     ASSERT_EQUAL(graph.getEdgeCount(), 6u);
 }
 
+void testChangesOfFrozenGraph()
+{
+    auto graph = makeGraph();
+    graph.setEdgeWeight(2, 4.5);
+    ASSERT(graph.isFrozen());
+    ASSERT_EQUAL(getOutEdgeIds(graph, 2), vector<EdgeId>({0, 2}));
+    ASSERT_EQUAL(graph.getEdge(2), Edge<double>({.from = 2, .to = 3, .weight = 4.5}));
+
+    ASSERT_EQUAL(graph.addVertex(), 4u);
+    ASSERT_EQUAL(graph.addEdge({.from = 4, .to = 0, .weight = 1}), 4u);
+    ASSERT_EQUAL(graph.addEdge({.from = 0, .to = 4, .weight = 1}), 5u);
+    ASSERT(!graph.isFrozen());
+    graph.freeze();
+    ASSERT_EQUAL(getOutEdgeIds(graph, 0), vector<EdgeId>({1, 3, 5}));
+    ASSERT_EQUAL(getOutEdgeIds(graph, 4), vector<EdgeId>({4}));
+    ASSERT_EQUAL(getOutEdgeIds(graph, 3), vector<EdgeId>({}));
+}
+
+void testSerialization()
+{
+    const auto graph = makeGraph();
+    GraphProto::DirectedWeightedGraph proto;
+    graph.serialize(proto);
+    ASSERT_EQUAL(proto.edges_size(), 0);
+    assertGraphsAreEqual(DirectedWeightedGraph<double>::deserialize(proto), graph);
+
+    // Offsets of the vertexes are 0, 2, 2, 4, 4
+    auto shiftedProto = proto;
+    shiftedProto.set_out_edge_offsets(0, 1);
+    ASSERT_EXCEPTION_THROWN(DirectedWeightedGraph<double>::deserialize(shiftedProto),
+                            runtime_error);
+    auto unsortedProto = proto;
+    unsortedProto.set_out_edge_offsets(2, proto.out_edge_offsets(3));
+    unsortedProto.set_out_edge_offsets(3, proto.out_edge_offsets(2));
+    ASSERT_EXCEPTION_THROWN(DirectedWeightedGraph<double>::deserialize(unsortedProto),
+                            runtime_error);
+    auto duplicateProto = proto;
+    duplicateProto.set_out_edge_ids(1, proto.out_edge_ids(0));
+    ASSERT_EXCEPTION_THROWN(DirectedWeightedGraph<double>::deserialize(duplicateProto),
+                            runtime_error);
+
+    // Bases made before the compressed sparse rows are read too
+    GraphProto::DirectedWeightedGraph legacyProto;
+    for (VertexId vertex = 0; vertex < graph.getVertexCount(); vertex++)
+    {
+        auto& incidenceListProto = *legacyProto.add_incidence_lists();
+        for (const auto& outEdge : graph.getEdgesWhichStartFrom(vertex))
+        {
+            incidenceListProto.add_edge_ids(outEdge.id);
+        }
+    }
+    for (EdgeId edgeId = 0; edgeId < graph.getEdgeCount(); edgeId++)
+    {
+        const auto& edge = graph.getEdge(edgeId);
+        auto& edgeProto = *legacyProto.add_edges();
+        edgeProto.set_from(edge.from);
+        edgeProto.set_to(edge.to);
+        edgeProto.set_weight(edge.weight);
+    }
+    assertGraphsAreEqual(DirectedWeightedGraph<double>::deserialize(legacyProto), graph);
+}
+
+void testReverseCuthillMcKeeOrder()
+{
+    // The path 3 - 0 - 4 - 1 - 2 and the isolated vertex 5. The order goes from 5, then from 2,
+    // the least of the path ends, and is reversed
+    DirectedWeightedGraph<double> graph(6);
+    graph.addEdge({.from = 3, .to = 0, .weight = 1});
+    graph.addEdge({.from = 0, .to = 4, .weight = 2});
+    graph.addEdge({.from = 1, .to = 4, .weight = 3});
+    graph.addEdge({.from = 1, .to = 2, .weight = 4});
+    graph.freeze();
+
+    const auto newVertexIds = findReverseCuthillMcKeeOrder(graph);
+    ASSERT_EQUAL(newVertexIds, vector<VertexId>({1, 3, 4, 0, 2, 5}));
+
+    graph.renumberVertexes(newVertexIds);
+    ASSERT(!graph.isFrozen());
+    graph.freeze();
+    ASSERT_EQUAL(graph.getEdge(0), Edge<double>({.from = 0, .to = 1, .weight = 1}));
+    ASSERT_EQUAL(graph.getEdge(2), Edge<double>({.from = 3, .to = 2, .weight = 3}));
+    ASSERT_EQUAL(getOutEdgeIds(graph, 3), vector<EdgeId>({2, 3}));
+    ASSERT_EQUAL(getOutEdgeIds(graph, 5), vector<EdgeId>({}));
+
+    ASSERT_EXCEPTION_THROWN(graph.renumberVertexes({0, 1, 2, 3, 4, 4}), runtime_error);
+    ASSERT_EXCEPTION_THROWN(graph.renumberVertexes({0, 1}), runtime_error);
+}
+
 void runGraphTests()
 {
     TestRunner tr;
     RUN_TEST(tr, testEmptyGraph);
     RUN_TEST(tr, testDifferentWeightDependingOnDirection);
     RUN_TEST(tr, testGraphWithSeveralVertexesAndEdges);
+    RUN_TEST(tr, testChangesOfFrozenGraph);
+    RUN_TEST(tr, testSerialization);
+    RUN_TEST(tr, testReverseCuthillMcKeeOrder);
 }
 } // namespace Tests
 } // namespace Graph
@@ -4,7 +4,7 @@
 
 using namespace std;
 
-namespace
+namespace Json
 {
 bool operator==(const Json::Node& lhs, const Json::Node& rhs)
 {
@@ -51,7 +51,10 @@ bool operator==(const Json::Array& lhs, const Json::Array& rhs)
     }
     return true;
 }
+} // namespace Json
 
+namespace
+{
 void assertIsNotAllTypesExcept(const Json::Node& node,
                                const string& exceptedType,
                                const string& anotherExceptedType = "")
@@ -84,6 +87,10 @@ void assertIsNotAllTypesExcept(const Json::Node& node,
     {
         ASSERT(!node.isBool());
     };
+    if (exceptedType != "null" && anotherExceptedType != "null")
+    {
+        ASSERT(!node.isNull());
+    }
 }
 } // namespace
 
@@ -220,6 +227,13 @@ void testSingleElementLoading()
         assertIsNotAllTypesExcept(trueBoolRoot, "bool");
         ASSERT_EQUAL(trueBoolRoot.asBool(), Node(true));
     }
+
+    {
+        istringstream null("null");
+        const auto nullRoot = load(null).getRoot();
+        ASSERT(nullRoot.isNull());
+        assertIsNotAllTypesExcept(nullRoot, "null");
+    }
 }
 
 void testNestedElementsLoading()
@@ -267,11 +281,13 @@ void testPrint()
     const auto rootNode = Map{{"doublesArray", doublesArray},
                               {"booleansArray", booleansArray},
                               {"stringToIntMap", stringToIntMap},
-                              {"arrayOfMaps", arrayOfMaps}};
+                              {"arrayOfMaps", arrayOfMaps},
+                              {"null", Node(nullptr)}};
     string expected(
         "{\"arrayOfMaps\": [{\"falseKey\": false, \"trueKey\": true}, {\"another key\": \"another "
         "value\", \"key\": \"value\"}], \"booleansArray\": [true, false, false, true], "
-        "\"doublesArray\": [1.1, 2.2, 3.3], \"stringToIntMap\": {\"one\": 1, \"ten\": 10}}");
+        "\"doublesArray\": [1.1, 2.2, 3.3], \"null\": null, \"stringToIntMap\": {\"one\": 1, "
+        "\"ten\": 10}}");
 
     ostringstream actual;
     print(Tree(rootNode), actual);
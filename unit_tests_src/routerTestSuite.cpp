@@ -1,7 +1,23 @@
+#include "aStarRouter.h"
+#include "contractionHierarchyRouter.h"
+#include "dijkstraRouter.h"
+#include "firstHopRouter.h"
+#include "hubLabelingRouter.h"
+#include "mappedFile.h"
+#include "mappedRouter.h"
+#include "minPlusKernels.h"
+#include "parallel.h"
 #include "router.h"
 #include "routerTestSuite.h"
 #include "testRunner.h"
 
+#include <atomic>
+#include <cmath>
+#include <filesystem>
+#include <limits>
+#include <numeric>
+#include <random>
+
 using namespace std;
 
 namespace Graph
@@ -12,8 +28,8 @@ using RouteInfo = Router<double>::RouteInfo;
 
 namespace
 {
-template <typename Weight>
-void assertEdgesInRouteAreEqualTo(const Router<Weight>& router,
+template <typename AnyRouter>
+void assertEdgesInRouteAreEqualTo(const AnyRouter& router,
                                   const optional<RouteInfo>& routeInfo,
                                   const vector<Graph::EdgeId>& expectedEdges)
 {
@@ -27,12 +43,74 @@ void assertEdgesInRouteAreEqualTo(const Router<Weight>& router,
 }
 constexpr auto EmptyRouteInfo = optional<RouteInfo>();
 
+DirectedWeightedGraph<double> makeRandomGraph(size_t vertexCount, size_t edgeCount)
+{
+    mt19937 generator(42);
+    uniform_int_distribution<VertexId> vertexDistribution(0, vertexCount - 1);
+    // Integer weights make a lot of routes of equal weight, so the choice between them is tested too
+    uniform_int_distribution<int> weightDistribution(1, 20);
+
+    DirectedWeightedGraph<double> graph(vertexCount);
+    for (size_t i = 0; i < edgeCount; i++)
+    {
+        graph.addEdge({vertexDistribution(generator),
+                       vertexDistribution(generator),
+                       weightDistribution(generator) / 4.0});
+    }
+    graph.freeze();
+    return graph;
+}
+
+// Classic Floyd-Warshall algorithm, the way the router calculated routes before it was tiled
+vector<vector<optional<pair<double, optional<EdgeId>>>>> calculateRoutesClassically(
+    const DirectedWeightedGraph<double>& graph)
+{
+    const size_t vertexCount = graph.getVertexCount();
+    vector<vector<optional<pair<double, optional<EdgeId>>>>> routes(
+        vertexCount, vector<optional<pair<double, optional<EdgeId>>>>(vertexCount));
+    for (VertexId vertex = 0; vertex < vertexCount; vertex++)
+    {
+        routes[vertex][vertex] = pair{0.0, nullopt};
+        for (const auto& edge : graph.getEdgesWhichStartFrom(vertex))
+        {
+            auto& route = routes[vertex][edge.to];
+            if (!route || route->first > edge.weight)
+            {
+                route = pair{edge.weight, edge.id};
+            }
+        }
+    }
+
+    for (VertexId through = 0; through < vertexCount; through++)
+    {
+        for (VertexId from = 0; from < vertexCount; from++)
+        {
+            if (const auto routeFrom = routes[from][through])
+            {
+                for (VertexId to = 0; to < vertexCount; to++)
+                {
+                    if (const auto& routeTo = routes[through][to])
+                    {
+                        auto& route = routes[from][to];
+                        const double weight = routeFrom->first + routeTo->first;
+                        if (!route || weight < route->first)
+                        {
+                            route = pair{weight, routeTo->second ? routeTo->second : routeFrom->second};
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return routes;
+}
 } // namespace
 
 void testBuildNonExistingRoute()
 {
     DirectedWeightedGraph<double> graph(2);
     graph.addEdge({1, 0, 23.44});
+    graph.freeze();
     Router<double> router(graph);
     ASSERT_EQUAL(router.buildRoute(0, 1), EmptyRouteInfo);
 }
@@ -42,6 +120,7 @@ void testTwoDifferentEdgesBetweenOnePairOfVertexes()
     DirectedWeightedGraph<double> graph(2);
     graph.addEdge({0, 1, 4541222.345});
     graph.addEdge({0, 1, 9442.44});
+    graph.freeze();
     Router<double> router(graph);
 
     constexpr auto expected = RouteInfo({.id = 0, .weight = 9442.44, .edgeCount = 1});
@@ -56,6 +135,7 @@ void testBuildRouteFromTheVertexToTheSameVertex()
     DirectedWeightedGraph<double> graph(2);
     graph.addEdge({0, 1, 2});
     graph.addEdge({1, 0, 456});
+    graph.freeze();
     Router<double> router(graph);
     ASSERT_EQUAL(router.buildRoute(0, 0), RouteInfo({.id = 0, .weight = 0, .edgeCount = 0}));
     ASSERT_EQUAL(router.buildRoute(1, 1), RouteInfo({.id = 1, .weight = 0, .edgeCount = 0}));
@@ -68,6 +148,7 @@ void testRouteThroughThreeEdgesIsShortedThanThroughOne()
     graph.addEdge({2, 1, 31.4545});
     graph.addEdge({3, 2, 14.852});
     graph.addEdge({0, 3, 17.32});
+    graph.freeze();
     Router<double> router(graph);
 
     const auto route = router.buildRoute(0, 1);
@@ -82,6 +163,7 @@ void testCircleGraph()
     graph.addEdge({1, 2, 77});
     graph.addEdge({2, 0, 12});
     graph.addEdge({2, 1, 114.886});
+    graph.freeze();
     Router<double> router(graph);
 
     {
@@ -112,6 +194,7 @@ void testGraphWithSeveralVetexesAndEdges()
     graph.addEdge({6, 3, 744.5});
     graph.addEdge({3, 6, 0.114});
     graph.addEdge({5, 3, 9.221});
+    graph.freeze();
     Router<double> router(graph);
 
     ASSERT_EQUAL(router.buildRoute(0, 1), RouteInfo({.id = 0, .weight = 114.7, .edgeCount = 1}));
@@ -194,6 +277,7 @@ void testReleaseRoute()
     DirectedWeightedGraph<double> graph(2);
     graph.addEdge({0, 1, 9442.44});
     graph.addEdge({1, 0, 4541222.345});
+    graph.freeze();
     Router<double> router(graph);
 
     const auto routeIdFirst = router.buildRoute(0, 1)->id;
@@ -214,6 +298,1026 @@ void testReleaseRoute()
     ASSERT_EQUAL(routeIdAfterReleasingRoutes, 2u);
 }
 
+void testRoutesDontDependOnTilesAndThreads()
+{
+    // Several tiles in a row, the last one is incomplete
+    const auto graph = makeRandomGraph(150, 900);
+    const auto expectedRoutes = calculateRoutesClassically(graph);
+
+    for (const size_t threadCount : {1u, 4u})
+    {
+        Router<double> router(graph, threadCount);
+        for (VertexId from = 0; from < graph.getVertexCount(); from++)
+        {
+            for (VertexId to = 0; to < graph.getVertexCount(); to++)
+            {
+                const auto& expectedRoute = expectedRoutes[from][to];
+                const auto route = router.buildRoute(from, to);
+                ASSERT_EQUAL(bool(route), bool(expectedRoute));
+                if (!route)
+                {
+                    continue;
+                }
+
+                // Weights have to be exactly the same, not just fuzzy equal
+                ASSERT(!(route->weight < expectedRoute->first) &&
+                       !(expectedRoute->first < route->weight));
+
+                vector<EdgeId> expectedEdges;
+                for (auto edgeId = expectedRoute->second; edgeId;
+                     edgeId = expectedRoutes[from][graph.getEdge(*edgeId).from]->second)
+                {
+                    expectedEdges.push_back(*edgeId);
+                }
+                reverse(begin(expectedEdges), end(expectedEdges));
+                assertEdgesInRouteAreEqualTo(router, route, expectedEdges);
+                router.releaseRoute(route->id);
+            }
+        }
+    }
+}
+
+void testRouteViewFromSeveralThreads()
+{
+    const auto graph = makeRandomGraph(100, 500);
+    const Router<double> router(graph);
+
+    vector<vector<optional<vector<EdgeId>>>> expectedRoutes(graph.getVertexCount());
+    for (VertexId from = 0; from < graph.getVertexCount(); from++)
+    {
+        for (VertexId to = 0; to < graph.getVertexCount(); to++)
+        {
+            auto& expectedRoute = expectedRoutes[from].emplace_back();
+            if (const auto route = router.buildRoute(from, to))
+            {
+                expectedRoute.emplace();
+                for (size_t i = 0; i < route->edgeCount; i++)
+                {
+                    expectedRoute->push_back(router.getRouteEdge(route->id, i));
+                }
+            }
+        }
+    }
+
+    // Assertions can't be thrown from the worker threads, so mismatches are only counted
+    atomic<size_t> mismatchCount = 0;
+    parallelFor(graph.getVertexCount(), 4, [&](size_t from) {
+        vector<EdgeId> edges;
+        for (VertexId to = 0; to < graph.getVertexCount(); to++)
+        {
+            const auto& expectedRoute = expectedRoutes[from][to];
+            const auto route = router.getRoute(from, to);
+            if (bool(route) != bool(expectedRoute))
+            {
+                mismatchCount++;
+                continue;
+            }
+            if (!route)
+            {
+                continue;
+            }
+
+            edges.assign(route->begin(), route->end());
+            reverse(begin(edges), end(edges));
+            if (edges != *expectedRoute)
+            {
+                mismatchCount++;
+            }
+        }
+    });
+    ASSERT_EQUAL(mismatchCount.load(), 0u);
+
+    const auto route = router.getRoute(0, 0);
+    ASSERT(route.has_value());
+    ASSERT(route->begin() == route->end());
+}
+
+template <typename Weight>
+void checkMinPlusKernelsGiveTheSameResult(MinPlus::Kernel bestKernel)
+{
+    constexpr double Inf = numeric_limits<double>::infinity();
+    const auto toWeights = [](const vector<double>& values) {
+        vector<Weight> weights;
+        for (const double value : values)
+        {
+            weights.push_back(static_cast<Weight>(value));
+        }
+        return weights;
+    };
+    // Odd count to check the tail which doesn't fill the whole vector
+    const auto weightsThrough = toWeights({1, Inf, 0, 2.5, 4, Inf, 0.5, 7, 3, 1.25, Inf});
+    const vector<CompactEdgeId> prevEdgesThrough = {1, NoEdge, NoEdge, 4, 5, NoEdge,
+                                                    7, 8, 9, 10, NoEdge};
+    const auto initialWeights = toWeights({5, 3, Inf, 3.5, Inf, Inf, 0, 9, 4.5, 3.25, 1});
+    const vector<CompactEdgeId> initialPrevEdges = {20, 21, NoEdge, 23, NoEdge, NoEdge,
+                                                    NoEdge, 27, 28, 29, 30};
+    const auto weightFrom = static_cast<Weight>(2.0);
+
+    auto expectedWeights = initialWeights;
+    auto expectedPrevEdges = initialPrevEdges;
+    MinPlus::relaxRow(MinPlus::Kernel::Scalar, weightFrom, 33, weightsThrough.data(),
+                      prevEdgesThrough.data(), expectedWeights.data(), expectedPrevEdges.data(),
+                      weightsThrough.size());
+
+    auto weights = initialWeights;
+    auto prevEdges = initialPrevEdges;
+    MinPlus::relaxRow(bestKernel, weightFrom, 33, weightsThrough.data(), prevEdgesThrough.data(),
+                      weights.data(), prevEdges.data(), weightsThrough.size());
+
+    ASSERT_EQUAL(prevEdges, expectedPrevEdges);
+    for (size_t i = 0; i < weights.size(); i++)
+    {
+        ASSERT(!(weights[i] < expectedWeights[i]) && !(expectedWeights[i] < weights[i]));
+    }
+    // Shorter route, shorter route without the edge from the through-vertex, routes of equal weight
+    ASSERT_EQUAL(expectedPrevEdges[0], 1u);
+    ASSERT_EQUAL(expectedPrevEdges[2], 33u);
+    ASSERT_EQUAL(expectedPrevEdges[7], 27u);
+    ASSERT_EQUAL(expectedPrevEdges[9], 29u);
+}
+
+void testMinPlusKernelsGiveTheSameResult()
+{
+    const auto bestKernel = MinPlus::getBestSupportedKernel();
+    if (bestKernel == MinPlus::Kernel::Scalar)
+    {
+        return;
+    }
+
+    checkMinPlusKernelsGiveTheSameResult<double>(bestKernel);
+    checkMinPlusKernelsGiveTheSameResult<float>(bestKernel);
+    checkMinPlusKernelsGiveTheSameResult<FixedPointWeight>(bestKernel);
+}
+
+void testFixedPointWeight()
+{
+    constexpr auto Inf = numeric_limits<FixedPointWeight>::infinity();
+    constexpr auto Max = numeric_limits<FixedPointWeight>::max();
+
+    ASSERT_EQUAL(FixedPointWeight(1.23456).getUnits(), 12346u);
+    ASSERT_EQUAL(FixedPointWeight(2.5).getUnits(), 25000u);
+    ASSERT(!(static_cast<double>(FixedPointWeight(2.5)) < 2.5) &&
+           !(2.5 < static_cast<double>(FixedPointWeight(2.5))));
+    ASSERT_EQUAL(FixedPointWeight(numeric_limits<double>::infinity()), Inf);
+    ASSERT_EQUAL(FixedPointWeight(1e10), Inf);
+    ASSERT(isinf(static_cast<double>(Inf)));
+
+    // Sums saturate at infinity instead of wrapping around
+    ASSERT_EQUAL(FixedPointWeight(1.5) + FixedPointWeight(2.25), FixedPointWeight(3.75));
+    ASSERT_EQUAL(Max + FixedPointWeight::fromUnits(1), Inf);
+    ASSERT_EQUAL(Max + Max, Inf);
+    ASSERT_EQUAL(Inf + FixedPointWeight(0.0), Inf);
+    ASSERT(Max < Inf);
+
+    // The kernels saturate the same way, a full vector and a tail
+    const vector<FixedPointWeight> weightsThrough = {
+        Max, FixedPointWeight(0.0), Inf, FixedPointWeight(1.0), Max, Inf, Max, Max, Max};
+    const vector<CompactEdgeId> prevEdgesThrough(weightsThrough.size(), 1);
+    for (const auto kernel : {MinPlus::Kernel::Scalar, MinPlus::getBestSupportedKernel()})
+    {
+        vector<FixedPointWeight> weights(weightsThrough.size(), Inf);
+        weights[3] = Max;
+        vector<CompactEdgeId> prevEdges(weightsThrough.size(), NoEdge);
+        MinPlus::relaxRow(kernel, Max, 2, weightsThrough.data(), prevEdgesThrough.data(),
+                          weights.data(), prevEdges.data(), weights.size());
+
+        vector<FixedPointWeight> expectedWeights(weightsThrough.size(), Inf);
+        expectedWeights[1] = Max;
+        expectedWeights[3] = Max;
+        vector<CompactEdgeId> expectedPrevEdges(weightsThrough.size(), NoEdge);
+        expectedPrevEdges[1] = 1;
+        ASSERT_EQUAL(weights, expectedWeights);
+        ASSERT_EQUAL(prevEdges, expectedPrevEdges);
+    }
+}
+
+template <typename Weight>
+void checkNarrowerWeightsGiveTheSameRoutes()
+{
+    // Weights of the graph are quarters, which every weight type keeps exactly, so the routes are
+    // exactly the same as with double weights
+    const auto graph = makeRandomGraph(150, 900);
+    const Router<double> expectedRouter(graph);
+    Router<Weight, double> router(graph, 4);
+
+    GraphProto::Router proto;
+    router.serialize(proto);
+    const auto deserializedRouter = Router<Weight, double>::deserialize(proto, graph);
+
+    // The weights take 4 bytes instead of 8 in the fields of their own type
+    GraphProto::Router expectedProto;
+    expectedRouter.serialize(expectedProto);
+    ASSERT(proto.ByteSizeLong() < expectedProto.ByteSizeLong() * 3 / 4);
+    // Shards written before keep doubles of the narrower weights, they are read as well
+    auto doubleWeightsProto = proto;
+    for (int componentIndex = 0; componentIndex < proto.components_size(); componentIndex++)
+    {
+        auto& componentProto = *doubleWeightsProto.mutable_components(componentIndex);
+        for (int shardIndex = 0; shardIndex < componentProto.shards_size(); shardIndex++)
+        {
+            auto& shardProto = *componentProto.mutable_shards(shardIndex);
+            ASSERT_EQUAL(shardProto.weights_size(), 0);
+            shardProto.clear_float_weights();
+            shardProto.clear_fixed_point_weights();
+            *shardProto.mutable_weights() =
+                expectedProto.components(componentIndex).shards(shardIndex).weights();
+        }
+    }
+    const auto doubleWeightsRouter =
+        Router<Weight, double>::deserialize(doubleWeightsProto, graph);
+
+    for (VertexId from = 0; from < graph.getVertexCount(); from++)
+    {
+        for (VertexId to = 0; to < graph.getVertexCount(); to++)
+        {
+            const auto expectedRoute = expectedRouter.getRoute(from, to);
+            for (const auto* anyRouter :
+                 {&router, deserializedRouter.get(), doubleWeightsRouter.get()})
+            {
+                const auto route = anyRouter->getRoute(from, to);
+                ASSERT_EQUAL(route.has_value(), expectedRoute.has_value());
+                if (!route)
+                {
+                    continue;
+                }
+                const auto weight = static_cast<double>(route->getWeight());
+                ASSERT(!(weight < expectedRoute->getWeight()) &&
+                       !(expectedRoute->getWeight() < weight));
+                ASSERT_EQUAL(vector<EdgeId>(route->begin(), route->end()),
+                             vector<EdgeId>(expectedRoute->begin(), expectedRoute->end()));
+            }
+        }
+    }
+}
+
+void testNarrowerWeightsGiveTheSameRoutes()
+{
+    checkNarrowerWeightsGiveTheSameRoutes<float>();
+    checkNarrowerWeightsGiveTheSameRoutes<FixedPointWeight>();
+}
+
+void testRouterUpdateGivesTheSameWeights()
+{
+    auto graph = makeRandomGraph(100, 400);
+    Router<double> router(graph);
+
+    mt19937 generator(7);
+    uniform_int_distribution<int> weightDistribution(1, 20);
+    const auto getRandomEdge = [&graph, &generator]() {
+        return uniform_int_distribution<EdgeId>(0, graph.getEdgeCount() - 1)(generator);
+    };
+    const auto getRandomVertex = [&graph, &generator]() {
+        return uniform_int_distribution<VertexId>(0, graph.getVertexCount() - 1)(generator);
+    };
+
+    // Decreases and additions, increases and removals, then all of them with new vertexes
+    for (size_t step = 0; step < 3; step++)
+    {
+        vector<Router<double>::EdgeChange> changes;
+        const auto changeWeight = [&graph, &changes](EdgeId edgeId, double weight) {
+            changes.push_back({edgeId, graph.getEdge(edgeId).weight});
+            graph.setEdgeWeight(edgeId, weight);
+        };
+        if (step == 2)
+        {
+            for (size_t i = 0; i < 5; i++)
+            {
+                graph.addVertex();
+            }
+        }
+        for (size_t i = 0; i < 20; i++)
+        {
+            const EdgeId edgeId = getRandomEdge();
+            const double weight = graph.getEdge(edgeId).weight;
+            if (step != 1)
+            {
+                changeWeight(edgeId, weight / 2);
+                const EdgeId addedEdgeId = graph.addEdge(
+                    {getRandomVertex(), getRandomVertex(), weightDistribution(generator) / 4.0});
+                changes.push_back({addedEdgeId, numeric_limits<double>::infinity()});
+            }
+            if (step != 0)
+            {
+                changeWeight(getRandomEdge(),
+                             i % 4 == 0 ? numeric_limits<double>::infinity() : weight * 2);
+            }
+        }
+        graph.freeze();
+        router.update(changes, step + 1);
+
+        const Router<double> expectedRouter(graph);
+        for (VertexId from = 0; from < graph.getVertexCount(); from++)
+        {
+            for (VertexId to = 0; to < graph.getVertexCount(); to++)
+            {
+                const auto expectedRoute = expectedRouter.getRoute(from, to);
+                const auto route = router.getRoute(from, to);
+                ASSERT_EQUAL(route.has_value(), expectedRoute.has_value());
+                if (!route)
+                {
+                    continue;
+                }
+                ASSERT(!(route->getWeight() < expectedRoute->getWeight()) &&
+                       !(expectedRoute->getWeight() < route->getWeight()));
+
+                // Routes of equal weight may differ, but the route has to be a real one
+                VertexId vertex = to;
+                double weight = 0;
+                for (const EdgeId edgeId : *route)
+                {
+                    const auto& edge = graph.getEdge(edgeId);
+                    ASSERT_EQUAL(edge.to, vertex);
+                    vertex = edge.from;
+                    weight += edge.weight;
+                }
+                ASSERT_EQUAL(vertex, from);
+                ASSERT(!(weight < route->getWeight()) && !(route->getWeight() < weight));
+            }
+        }
+    }
+}
+
+void testDijkstraRouterGivesTheSameRoutes()
+{
+    const auto graph = makeRandomGraph(150, 900);
+    const Router<double> router(graph);
+    // Small cache capacity makes trees to be evicted and built again
+    DijkstraRouter<double> dijkstraRouter(graph, 3);
+
+    for (const VertexId fromShift : {0u, 2u, 1u, 3u})
+    {
+        for (VertexId from = fromShift; from < graph.getVertexCount(); from += 4)
+        {
+            for (VertexId to = 0; to < graph.getVertexCount(); to++)
+            {
+                const auto expectedRoute = router.buildRoute(from, to);
+                const auto route = dijkstraRouter.buildRoute(from, to);
+                ASSERT_EQUAL(bool(route), bool(expectedRoute));
+                if (!route)
+                {
+                    continue;
+                }
+
+                ASSERT(!(route->weight < expectedRoute->weight) &&
+                       !(expectedRoute->weight < route->weight));
+                vector<EdgeId> expectedEdges;
+                for (size_t i = 0; i < expectedRoute->edgeCount; i++)
+                {
+                    expectedEdges.push_back(router.getRouteEdge(expectedRoute->id, i));
+                }
+                // Routes of equal weight are chosen the same way as Floyd-Warshall algorithm does
+                assertEdgesInRouteAreEqualTo(dijkstraRouter, route, expectedEdges);
+                dijkstraRouter.releaseRoute(route->id);
+            }
+        }
+    }
+}
+
+void testDijkstraRouterCache()
+{
+    DirectedWeightedGraph<double> graph(3);
+    graph.addEdge({0, 1, 2});
+    graph.addEdge({1, 2, 3});
+    graph.addEdge({2, 0, 4});
+    graph.freeze();
+    DijkstraRouter<double> router(graph, 1);
+
+    ASSERT_EQUAL(router.buildRoute(0, 2), RouteInfo({.id = 0, .weight = 5, .edgeCount = 2}));
+    ASSERT_EQUAL(router.buildRoute(1, 0), RouteInfo({.id = 1, .weight = 7, .edgeCount = 2}));
+    // The tree from the vertex 0 was evicted from the cache, but the routes are still available
+    ASSERT_EQUAL(router.getRouteEdge(0, 1), 1u);
+    ASSERT_EQUAL(router.buildRoute(0, 1), RouteInfo({.id = 2, .weight = 2, .edgeCount = 1}));
+    ASSERT_EQUAL(router.buildRoute(2, 2), RouteInfo({.id = 3, .weight = 0, .edgeCount = 0}));
+
+    ASSERT_EXCEPTION_THROWN(DijkstraRouter<double>(graph, 0), runtime_error);
+}
+
+void testContractionHierarchyRouterGivesTheSameRoutes()
+{
+    const auto graph = makeRandomGraph(150, 900);
+    const Router<double> router(graph);
+    const ContractionHierarchyRouter<double> builtRouter(graph);
+    ASSERT(builtRouter.getShortcutCount() > 0);
+
+    GraphProto::ContractionHierarchyRouter proto;
+    builtRouter.serialize(proto);
+    const unique_ptr<const ContractionHierarchyRouter<double>> deserializedRouter =
+        ContractionHierarchyRouter<double>::deserialize(proto, graph);
+
+    for (const auto* contractionHierarchyRouter : {&builtRouter, deserializedRouter.get()})
+    {
+        for (VertexId from = 0; from < graph.getVertexCount(); from++)
+        {
+            for (VertexId to = 0; to < graph.getVertexCount(); to++)
+            {
+                const auto expectedRoute = router.buildRoute(from, to);
+                const auto route = contractionHierarchyRouter->buildRoute(from, to);
+                ASSERT_EQUAL(bool(route), bool(expectedRoute));
+                if (!route)
+                {
+                    continue;
+                }
+                ASSERT(fuzzyCompare(route->weight, expectedRoute->weight));
+
+                vector<EdgeId> expectedEdges;
+                for (size_t i = 0; i < expectedRoute->edgeCount; i++)
+                {
+                    expectedEdges.push_back(router.getRouteEdge(expectedRoute->id, i));
+                }
+                // Routes of equal weight are chosen the same way as Floyd-Warshall algorithm does
+                assertEdgesInRouteAreEqualTo(*contractionHierarchyRouter, route, expectedEdges);
+            }
+        }
+    }
+}
+
+void testContractionHierarchyRouterUnpacksShortcuts()
+{
+    // The middle vertexes of the line have the least ids and are contracted first, so the route
+    // goes through shortcuts
+    DirectedWeightedGraph<double> graph(5);
+    graph.addEdge({3, 0, 1});
+    graph.addEdge({0, 1, 2});
+    graph.addEdge({1, 2, 3});
+    graph.addEdge({2, 4, 4});
+    graph.addEdge({3, 4, 11});
+    graph.addEdge({4, 3, 1});
+    graph.freeze();
+    ContractionHierarchyRouter<double> router(graph);
+    ASSERT_EQUAL(router.getShortcutCount(), 3u);
+
+    const auto route = router.buildRoute(3, 4);
+    ASSERT_EQUAL(route, RouteInfo({.id = 0, .weight = 10, .edgeCount = 4}));
+    assertEdgesInRouteAreEqualTo(router, route, {0, 1, 2, 3});
+
+    const auto routeBack = router.buildRoute(2, 0);
+    ASSERT_EQUAL(routeBack, RouteInfo({.id = 1, .weight = 6, .edgeCount = 3}));
+    assertEdgesInRouteAreEqualTo(router, routeBack, {3, 5, 0});
+
+    ASSERT_EQUAL(router.buildRoute(2, 2), RouteInfo({.id = 2, .weight = 0, .edgeCount = 0}));
+
+    router.releaseRoute(route->id);
+    ASSERT_EXCEPTION_THROWN(router.getRouteEdge(route->id, 0), out_of_range);
+
+    GraphProto::ContractionHierarchyRouter proto;
+    router.serialize(proto);
+    // Unpacking a shortcut made of itself or of a later one would never come to the edges
+    for (const auto& [firstArc, secondArc] : {pair<uint64_t, uint64_t>{6, 1}, {0, 7}})
+    {
+        auto corruptProto = proto;
+        corruptProto.mutable_shortcuts(0)->set_first_arc(firstArc);
+        corruptProto.mutable_shortcuts(0)->set_second_arc(secondArc);
+        ASSERT_EXCEPTION_THROWN(
+            ContractionHierarchyRouter<double>::deserialize(corruptProto, graph), runtime_error);
+    }
+    auto corruptProto = proto;
+    corruptProto.mutable_shortcuts(0)->set_to(5);
+    ASSERT_EXCEPTION_THROWN(ContractionHierarchyRouter<double>::deserialize(corruptProto, graph),
+                            runtime_error);
+    // A search going down could come back to the vertexes it passed
+    corruptProto = proto;
+    corruptProto.mutable_upward_arcs(0)->set_out_arc_ids(0, 0);
+    ASSERT_EXCEPTION_THROWN(ContractionHierarchyRouter<double>::deserialize(corruptProto, graph),
+                            runtime_error);
+}
+
+void testAStarRouterGivesTheSameWeights()
+{
+    const auto graph = makeRandomGraph(150, 900);
+    const Router<double> router(graph);
+
+    // Edge weights don't depend on the points, the router has to find the bound itself
+    mt19937 generator(42);
+    uniform_real_distribution<double> latitudeDistribution(55.5, 55.7);
+    uniform_real_distribution<double> longitudeDistribution(37.5, 37.7);
+    vector<Sphere::Point> vertexPoints;
+    for (VertexId vertex = 0; vertex < graph.getVertexCount(); vertex++)
+    {
+        vertexPoints.push_back({latitudeDistribution(generator), longitudeDistribution(generator)});
+    }
+
+    for (const bool isBidirectional : {false, true})
+    {
+        const AStarRouter<double> builtRouter(graph, vertexPoints, isBidirectional);
+        GraphProto::AStarRouter proto;
+        builtRouter.serialize(proto);
+        const unique_ptr<const AStarRouter<double>> deserializedRouter =
+            AStarRouter<double>::deserialize(proto, graph);
+
+        for (const auto* aStarRouter : {&builtRouter, deserializedRouter.get()})
+        {
+            for (VertexId from = 0; from < graph.getVertexCount(); from++)
+            {
+                for (VertexId to = 0; to < graph.getVertexCount(); to++)
+                {
+                    const auto expectedRoute = router.buildRoute(from, to);
+                    const auto route = aStarRouter->buildRoute(from, to);
+                    ASSERT_EQUAL(bool(route), bool(expectedRoute));
+                    if (!route)
+                    {
+                        continue;
+                    }
+                    ASSERT(fuzzyCompare(route->weight, expectedRoute->weight));
+
+                    // Routes of equal weight may differ, but the route has to be a real one
+                    VertexId vertex = from;
+                    double weight = 0;
+                    for (size_t i = 0; i < route->edgeCount; i++)
+                    {
+                        const auto& edge = graph.getEdge(aStarRouter->getRouteEdge(route->id, i));
+                        ASSERT_EQUAL(edge.from, vertex);
+                        vertex = edge.to;
+                        weight += edge.weight;
+                    }
+                    ASSERT_EQUAL(vertex, to);
+                    ASSERT(fuzzyCompare(weight, route->weight));
+                }
+            }
+        }
+    }
+}
+
+void testAStarRouterSettlesLessVertexes()
+{
+    // Grid of 20 x 20 vertexes about 100 meters from each other, edges go both ways between the
+    // neighbours and are a bit longer than the straight line
+    constexpr size_t Side = 20;
+    vector<Sphere::Point> vertexPoints;
+    for (size_t row = 0; row < Side; row++)
+    {
+        for (size_t column = 0; column < Side; column++)
+        {
+            vertexPoints.push_back({55.6 + 0.0009 * static_cast<double>(row),
+                                    37.6 + 0.0016 * static_cast<double>(column)});
+        }
+    }
+    DirectedWeightedGraph<double> graph(Side * Side);
+    const auto addEdges = [&graph, &vertexPoints](VertexId from, VertexId to) {
+        const double weight = Sphere::distance(vertexPoints[from], vertexPoints[to]) * 1.2;
+        graph.addEdge({from, to, weight});
+        graph.addEdge({to, from, weight});
+    };
+    for (VertexId vertex = 0; vertex < Side * Side; vertex++)
+    {
+        if (vertex % Side + 1 < Side)
+        {
+            addEdges(vertex, vertex + 1);
+        }
+        if (vertex + Side < Side * Side)
+        {
+            addEdges(vertex, vertex + Side);
+        }
+    }
+    graph.freeze();
+
+    // With the same point for all the vertexes the bound is zero, that is plain Dijkstra's search
+    const AStarRouter<double> dijkstraRouter(
+        graph, vector<Sphere::Point>(Side * Side, vertexPoints.front()), false);
+    const AStarRouter<double> aStarRouter(graph, vertexPoints, false);
+    const AStarRouter<double> bidirectionalRouter(graph, vertexPoints, true);
+
+    // Along the middle row
+    const VertexId from = Side / 2 * Side;
+    const VertexId to = from + Side - 1;
+    const auto expectedRoute = dijkstraRouter.buildRoute(from, to);
+    ASSERT(expectedRoute.has_value());
+    for (const auto* router : {&aStarRouter, &bidirectionalRouter})
+    {
+        const auto route = router->buildRoute(from, to);
+        ASSERT(route.has_value());
+        ASSERT(fuzzyCompare(route->weight, expectedRoute->weight));
+        ASSERT(router->getSettledVertexCount() * 4 < dijkstraRouter.getSettledVertexCount());
+    }
+}
+
+void testHubLabelingRouterGivesTheSameWeights()
+{
+    // Zero weight edges make routes of equal weight through different hubs
+    auto graph = makeRandomGraph(150, 900);
+    for (VertexId vertex = 0; vertex + 10 < graph.getVertexCount(); vertex += 10)
+    {
+        graph.addEdge({vertex, vertex + 10, 0});
+    }
+    graph.freeze();
+
+    const Router<double> router(graph);
+    const HubLabelingRouter<double> builtRouter(graph);
+    const size_t vertexCount = graph.getVertexCount();
+    ASSERT(builtRouter.getLabelEntryCount() < vertexCount * vertexCount);
+
+    GraphProto::HubLabelingRouter proto;
+    builtRouter.serialize(proto);
+    const unique_ptr<const HubLabelingRouter<double>> deserializedRouter =
+        HubLabelingRouter<double>::deserialize(proto, graph);
+    ASSERT_EQUAL(deserializedRouter->getLabelEntryCount(), builtRouter.getLabelEntryCount());
+
+    vector<VertexId> vertexes(vertexCount);
+    for (VertexId vertex = 0; vertex < vertexCount; vertex++)
+    {
+        vertexes[vertex] = vertex;
+    }
+    const auto expectedWeights = router.findRouteWeights(vertexes, vertexes);
+
+    for (const auto* hubLabelingRouter : {&builtRouter, deserializedRouter.get()})
+    {
+        const auto weights = hubLabelingRouter->findRouteWeights(vertexes, vertexes);
+        for (VertexId from = 0; from < vertexCount; from++)
+        {
+            for (VertexId to = 0; to < vertexCount; to++)
+            {
+                const double expectedWeight = expectedWeights[from * vertexCount + to];
+                ASSERT(!(weights[from * vertexCount + to] < expectedWeight) &&
+                       !(expectedWeight < weights[from * vertexCount + to]));
+
+                const auto routeWeight = hubLabelingRouter->findRouteWeight(from, to);
+                ASSERT_EQUAL(bool(routeWeight),
+                             expectedWeight < numeric_limits<double>::infinity());
+
+                // Routes of equal weight may differ, but the walked route has to be a real one
+                VertexId vertex = from;
+                double weight = 0;
+                const bool isFound = hubLabelingRouter->forEachRouteEdge(
+                    from, to, [&graph, &vertex, &weight](EdgeId edgeId) {
+                        const auto& edge = graph.getEdge(edgeId);
+                        ASSERT_EQUAL(edge.from, vertex);
+                        vertex = edge.to;
+                        weight += edge.weight;
+                    });
+                ASSERT_EQUAL(isFound, bool(routeWeight));
+                if (!isFound)
+                {
+                    continue;
+                }
+                ASSERT_EQUAL(vertex, to);
+                ASSERT(fuzzyCompare(weight, *routeWeight));
+            }
+        }
+    }
+
+    proto.mutable_forward_labels()->set_hubs(0, static_cast<uint32_t>(vertexCount));
+    ASSERT_EXCEPTION_THROWN(HubLabelingRouter<double>::deserialize(proto, graph), runtime_error);
+}
+
+void testRoutesAreSplitByComponents()
+{
+    // Even and odd vertexes make two components, the last vertex is isolated
+    const size_t vertexCount = 121;
+    mt19937 generator(11);
+    uniform_int_distribution<VertexId> halfDistribution(0, vertexCount / 2 - 1);
+    uniform_int_distribution<int> weightDistribution(1, 20);
+    DirectedWeightedGraph<double> graph(vertexCount);
+    for (size_t i = 0; i < 500; i++)
+    {
+        const VertexId parity = i % 2;
+        graph.addEdge({halfDistribution(generator) * 2 + parity,
+                       halfDistribution(generator) * 2 + parity,
+                       weightDistribution(generator) / 4.0});
+    }
+    graph.freeze();
+    const auto expectedRoutes = calculateRoutesClassically(graph);
+
+    const auto assertRoutesAreExpected = [&graph, &expectedRoutes](const Router<double>& router) {
+        for (VertexId from = 0; from < graph.getVertexCount(); from++)
+        {
+            for (VertexId to = 0; to < graph.getVertexCount(); to++)
+            {
+                const auto& expectedRoute = expectedRoutes[from][to];
+                const auto route = router.getRoute(from, to);
+                ASSERT_EQUAL(route.has_value(), expectedRoute.has_value());
+                if (!route)
+                {
+                    continue;
+                }
+                ASSERT(!(route->getWeight() < expectedRoute->first) &&
+                       !(expectedRoute->first < route->getWeight()));
+                ASSERT_EQUAL(route->begin() == route->end(), !expectedRoute->second);
+                if (expectedRoute->second)
+                {
+                    ASSERT_EQUAL(*route->begin(), *expectedRoute->second);
+                }
+            }
+        }
+    };
+
+    Router<double> router(graph);
+    ASSERT_EQUAL(router.getComponentCount(), 3u);
+    ASSERT_EQUAL(router.getCellCount(), 60u * 60u + 60u * 60u + 1u);
+    ASSERT(!router.getRoute(0, 1));
+    ASSERT(!router.getRoute(vertexCount - 1, 0));
+    ASSERT(isinf(router.findRouteWeights({0, 1}, {1})[0]));
+    assertRoutesAreExpected(router);
+
+    GraphProto::Router proto;
+    router.serialize(proto);
+    ASSERT_EQUAL(proto.components_size(), 3);
+    ASSERT_EQUAL(proto.encoding_version(), 2u);
+    ASSERT_EQUAL(proto.components(0).shards_size(), 1);
+    const auto deserializedRouter = Router<double>::deserialize(proto, graph);
+    ASSERT_EQUAL(deserializedRouter->getCellCount(), router.getCellCount());
+    assertRoutesAreExpected(*deserializedRouter);
+
+    // Routes of the packed encoding, the only shard of every component is the whole matrix
+    GraphProto::Router packedProto;
+    packedProto.set_encoding_version(1);
+    for (const auto& componentProto : proto.components())
+    {
+        const auto& shardProto = componentProto.shards(0);
+        auto& packedComponentProto = *packedProto.add_components();
+        *packedComponentProto.mutable_vertexes() = componentProto.vertexes();
+        *packedComponentProto.mutable_route_bitmap() = shardProto.route_bitmap();
+        *packedComponentProto.mutable_weights() = shardProto.weights();
+        *packedComponentProto.mutable_prev_edges() = shardProto.prev_edges();
+    }
+    ASSERT_EQUAL(packedProto.components(0).route_bitmap_size(), (60 * 60 + 63) / 64);
+    assertRoutesAreExpected(*Router<double>::deserialize(packedProto, graph));
+
+    // Routes of the earlier encodings, a message for every cell
+    const auto addRoutesData = [&expectedRoutes](const vector<VertexId>& vertexes,
+                                                 auto& routesDataProtos) {
+        for (const VertexId from : vertexes)
+        {
+            auto& routesDataProto = *routesDataProtos.Add();
+            for (const VertexId to : vertexes)
+            {
+                auto& routeDataProto = *routesDataProto.add_routes_data_for_one_vertex();
+                if (const auto& route = expectedRoutes[from][to])
+                {
+                    routeDataProto.set_exists(true);
+                    routeDataProto.set_weight(route->first);
+                    if (route->second)
+                    {
+                        routeDataProto.set_has_prev_edge(true);
+                        routeDataProto.set_prev_edge(*route->second);
+                    }
+                }
+            }
+        }
+    };
+    GraphProto::Router perCellProto;
+    for (const auto& componentProto : proto.components())
+    {
+        auto& perCellComponentProto = *perCellProto.add_components();
+        *perCellComponentProto.mutable_vertexes() = componentProto.vertexes();
+        addRoutesData({componentProto.vertexes().begin(), componentProto.vertexes().end()},
+                      *perCellComponentProto.mutable_routes_data());
+    }
+    assertRoutesAreExpected(*Router<double>::deserialize(perCellProto, graph));
+
+    // Bases made before the components keep the routes matrix of the whole graph
+    GraphProto::Router legacyProto;
+    vector<VertexId> vertexes(graph.getVertexCount());
+    iota(begin(vertexes), end(vertexes), 0);
+    addRoutesData(vertexes, *legacyProto.mutable_routes_data());
+    const auto legacyRouter = Router<double>::deserialize(legacyProto, graph);
+    ASSERT_EQUAL(legacyRouter->getComponentCount(), 3u);
+    assertRoutesAreExpected(*legacyRouter);
+
+    auto wrongBitmapProto = packedProto;
+    wrongBitmapProto.mutable_components(0)->set_route_bitmap(0, 0);
+    ASSERT_EXCEPTION_THROWN(Router<double>::deserialize(wrongBitmapProto, graph), runtime_error);
+    auto wrongShardProto = proto;
+    wrongShardProto.mutable_components(0)->mutable_shards(0)->clear_prev_edges();
+    ASSERT_EXCEPTION_THROWN(Router<double>::deserialize(wrongShardProto, graph, 4),
+                            runtime_error);
+    auto missingShardProto = proto;
+    missingShardProto.mutable_components(0)->set_shard_row_count(30);
+    ASSERT_EXCEPTION_THROWN(Router<double>::deserialize(missingShardProto, graph), runtime_error);
+    auto unknownVersionProto = proto;
+    unknownVersionProto.set_encoding_version(3);
+    ASSERT_EXCEPTION_THROWN(Router<double>::deserialize(unknownVersionProto, graph),
+                            runtime_error);
+    proto.mutable_components(0)->set_vertexes(0, 1);
+    ASSERT_EXCEPTION_THROWN(Router<double>::deserialize(proto, graph), runtime_error);
+}
+
+void testRoutesAreEncodedByShards()
+{
+    // A component of a few hundred vertexes is split into several shards of rows
+    const size_t vertexCount = 300;
+    mt19937 generator(17);
+    uniform_int_distribution<VertexId> vertexDistribution(0, vertexCount - 1);
+    uniform_int_distribution<int> weightDistribution(1, 20);
+    DirectedWeightedGraph<double> graph(vertexCount);
+    for (VertexId vertex = 0; vertex < vertexCount; vertex++)
+    {
+        graph.addEdge({vertex, (vertex + 1) % vertexCount, weightDistribution(generator) / 4.0});
+    }
+    for (size_t i = 0; i < 300; i++)
+    {
+        graph.addEdge({vertexDistribution(generator),
+                       vertexDistribution(generator),
+                       weightDistribution(generator) / 4.0});
+    }
+    graph.freeze();
+    const Router<double> router(graph, 4);
+
+    // The shards don't depend on the count of threads encoding them
+    GraphProto::Router proto;
+    router.serialize(proto);
+    ASSERT_EQUAL(proto.components_size(), 1);
+    ASSERT_EQUAL(proto.components(0).shards_size(), 2);
+    for (const size_t threadCount : {2u, 3u, 8u})
+    {
+        GraphProto::Router parallelProto;
+        router.serialize(parallelProto, threadCount);
+        ASSERT(parallelProto.SerializeAsString() == proto.SerializeAsString());
+    }
+
+    const auto deserializedRouter = Router<double>::deserialize(proto, graph, 4);
+    for (VertexId from = 0; from < vertexCount; from++)
+    {
+        for (VertexId to = 0; to < vertexCount; to++)
+        {
+            const auto route = router.getRoute(from, to);
+            const auto deserializedRoute = deserializedRouter->getRoute(from, to);
+            ASSERT(route && deserializedRoute);
+            ASSERT(!(deserializedRoute->getWeight() < route->getWeight()) &&
+                   !(route->getWeight() < deserializedRoute->getWeight()));
+            ASSERT_EQUAL(deserializedRoute->begin() == deserializedRoute->end(),
+                         route->begin() == route->end());
+            if (route->begin() != route->end())
+            {
+                ASSERT_EQUAL(*deserializedRoute->begin(), *route->begin());
+            }
+        }
+    }
+}
+
+void testRouterUpdateMergesComponents()
+{
+    DirectedWeightedGraph<double> graph(6);
+    graph.addEdge({0, 2, 1});
+    graph.addEdge({2, 4, 1});
+    graph.addEdge({1, 3, 1});
+    graph.addEdge({3, 5, 1});
+    graph.freeze();
+    Router<double> router(graph);
+    ASSERT_EQUAL(router.getComponentCount(), 2u);
+    ASSERT(!router.getRoute(0, 5));
+
+    const EdgeId edgeId = graph.addEdge({4, 1, 1});
+    const VertexId vertex = graph.addVertex();
+    graph.addEdge({5, vertex, 1});
+    graph.freeze();
+    router.update({{edgeId, numeric_limits<double>::infinity()},
+                   {edgeId + 1, numeric_limits<double>::infinity()}});
+    ASSERT_EQUAL(router.getComponentCount(), 1u);
+    ASSERT_EQUAL(router.getCellCount(), 7u * 7u);
+
+    const auto route = router.getRoute(0, vertex);
+    ASSERT(route.has_value());
+    ASSERT(fuzzyCompare(route->getWeight(), 6.0));
+    ASSERT(!router.getRoute(vertex, 0));
+    ASSERT(fuzzyCompare(router.getRoute(1, 5)->getWeight(), 2.0));
+}
+
+void checkFirstHopRouterGivesTheSameWeights(const DirectedWeightedGraph<double>& graph,
+                                             size_t firstHopSize)
+{
+    const Router<double> expectedRouter(graph);
+    const FirstHopRouter<double> builtRouter(graph, expectedRouter);
+    ASSERT_EQUAL(builtRouter.getFirstHopSize(), firstHopSize);
+
+    GraphProto::FirstHopRouter proto;
+    builtRouter.serialize(proto);
+    ASSERT_EQUAL(proto.first_hops().size(),
+                 static_cast<size_t>(proto.weights_size()) * firstHopSize);
+    const auto router = FirstHopRouter<double>::deserialize(proto, graph);
+
+    for (VertexId from = 0; from < graph.getVertexCount(); from++)
+    {
+        for (VertexId to = 0; to < graph.getVertexCount(); to++)
+        {
+            const auto expectedRoute = expectedRouter.getRoute(from, to);
+            const auto weight = router->findRouteWeight(from, to);
+            ASSERT_EQUAL(weight.has_value(), expectedRoute.has_value());
+
+            // The route goes from its first edge, its edges are summed up in the same order
+            VertexId vertex = from;
+            double routeWeight = 0;
+            size_t edgeCount = 0;
+            const bool isFound = router->forEachRouteEdge(from, to, [&](EdgeId edgeId) {
+                const auto& edge = graph.getEdge(edgeId);
+                ASSERT_EQUAL(edge.from, vertex);
+                vertex = edge.to;
+                routeWeight += edge.weight;
+                edgeCount++;
+            });
+            ASSERT_EQUAL(isFound, expectedRoute.has_value());
+            if (!isFound)
+            {
+                continue;
+            }
+            ASSERT(!(*weight < expectedRoute->getWeight()) &&
+                   !(expectedRoute->getWeight() < *weight));
+            ASSERT_EQUAL(vertex, to);
+            ASSERT(edgeCount < graph.getVertexCount());
+            ASSERT(fuzzyCompare(routeWeight, *weight));
+        }
+    }
+}
+
+void testFirstHopRouterGivesTheSameWeights()
+{
+    checkFirstHopRouterGivesTheSameWeights(makeRandomGraph(100, 400), 2);
+    // Ids of so many edges take 32 bits
+    checkFirstHopRouterGivesTheSameWeights(makeRandomGraph(30, 70000), 4);
+
+    // A zero weight cycle, walking the first edges mustn't go round it
+    DirectedWeightedGraph<double> graph(4);
+    graph.addEdge({0, 1, 0});
+    graph.addEdge({1, 0, 0});
+    graph.addEdge({1, 2, 1});
+    graph.addEdge({0, 2, 1});
+    graph.freeze();
+    checkFirstHopRouterGivesTheSameWeights(graph, 2);
+
+    const Router<double> router(graph);
+    GraphProto::FirstHopRouter proto;
+    FirstHopRouter<double>(graph, router).serialize(proto);
+    ASSERT_EQUAL(proto.component_sizes_size(), 2);
+    proto.mutable_first_hops()->front() = 7;
+    ASSERT_EXCEPTION_THROWN(FirstHopRouter<double>::deserialize(proto, graph), runtime_error);
+}
+
+shared_ptr<const MappedFile> mapFile(const string& fileName)
+{
+    auto file = make_shared<const MappedFile>(fileName);
+    // The mapping outlives the file
+    filesystem::remove(fileName);
+    return file;
+}
+
+void testMappedRouterGivesTheSameRoutes()
+{
+    const auto graph = makeRandomGraph(100, 300);
+    const Router<double> expectedRouter(graph);
+    const string magic = "TESTFILE";
+    const auto fileName = (filesystem::temp_directory_path() / "mappedRouterTest.bin").string();
+    {
+        SectionedFile::Writer writer(fileName, magic, 1, 2);
+        // The sections may be written in any order
+        MappedRouter<double>::write(graph, expectedRouter, writer.startSection(1));
+        google::protobuf::io::CodedOutputStream(&writer.startSection(0)).WriteString("catalog");
+        ASSERT_EXCEPTION_THROWN(writer.startSection(1), runtime_error);
+        writer.finish();
+    }
+    {
+        SectionedFile::Writer writer(fileName + ".unfinished", magic, 1, 2);
+        writer.startSection(0);
+        ASSERT_EXCEPTION_THROWN(writer.finish(), runtime_error);
+        filesystem::remove(fileName + ".unfinished");
+    }
+    const auto file = mapFile(fileName);
+
+    const auto sections = SectionedFile::read(file, magic, 1);
+    ASSERT(sections.has_value());
+    ASSERT_EQUAL(sections->size(), 2u);
+    ASSERT_EQUAL(string(sections->front().getData(), sections->front().getSize()), "catalog");
+    ASSERT_EQUAL(reinterpret_cast<uintptr_t>(sections->front().getData()) % CacheLineSize, 0u);
+    ASSERT_EQUAL(reinterpret_cast<uintptr_t>(sections->back().getData()) % CacheLineSize, 0u);
+    ASSERT(!SectionedFile::read(file, "OTHERMAG", 1).has_value());
+    ASSERT_EQUAL(SectionedFile::readVersion(*file, magic), optional<uint32_t>(1));
+    ASSERT(!SectionedFile::readVersion(*file, "OTHERMAG").has_value());
+    ASSERT_EXCEPTION_THROWN(SectionedFile::read(file, magic, 2), runtime_error);
+
+    const MappedRouter<double> router(graph, sections->back());
+    for (VertexId from = 0; from < graph.getVertexCount(); from++)
+    {
+        for (VertexId to = 0; to < graph.getVertexCount(); to++)
+        {
+            const auto expectedRoute = expectedRouter.getRoute(from, to);
+            const auto weight = router.findRouteWeight(from, to);
+            ASSERT_EQUAL(weight.has_value(), expectedRoute.has_value());
+
+            // The same previous edges are walked
+            vector<EdgeId> edges;
+            const bool isFound = router.forEachRouteEdgeBackwards(
+                from, to, [&edges](EdgeId edgeId) { edges.push_back(edgeId); });
+            ASSERT_EQUAL(isFound, expectedRoute.has_value());
+            if (isFound)
+            {
+                ASSERT(!(*weight < expectedRoute->getWeight()) &&
+                       !(expectedRoute->getWeight() < *weight));
+                ASSERT_EQUAL(edges, vector<EdgeId>(expectedRoute->begin(), expectedRoute->end()));
+            }
+        }
+    }
+    const vector<VertexId> sources = {0, 1};
+    const vector<VertexId> targets = {2, 3};
+    ASSERT_EQUAL(router.findRouteWeights(sources, targets),
+                 expectedRouter.findRouteWeights(sources, targets));
+
+    // Routes of another graph or a truncated section aren't taken
+    const auto otherGraph = makeRandomGraph(100, 301);
+    ASSERT_EXCEPTION_THROWN(MappedRouter<double>(otherGraph, sections->back()), runtime_error);
+    const MappedSection truncatedSection(file,
+                                         static_cast<size_t>(sections->back().getData() -
+                                                             file->getData()),
+                                         sections->back().getSize() - 1);
+    ASSERT_EXCEPTION_THROWN(MappedRouter<double>(graph, truncatedSection), runtime_error);
+}
+
 void runRouterTests()
 {
     TestRunner tr;
@@ -224,6 +1328,24 @@ void runRouterTests()
     RUN_TEST(tr, testCircleGraph);
     RUN_TEST(tr, testGraphWithSeveralVetexesAndEdges);
     RUN_TEST(tr, testReleaseRoute);
+    RUN_TEST(tr, testRoutesDontDependOnTilesAndThreads);
+    RUN_TEST(tr, testRouteViewFromSeveralThreads);
+    RUN_TEST(tr, testMinPlusKernelsGiveTheSameResult);
+    RUN_TEST(tr, testFixedPointWeight);
+    RUN_TEST(tr, testNarrowerWeightsGiveTheSameRoutes);
+    RUN_TEST(tr, testRouterUpdateGivesTheSameWeights);
+    RUN_TEST(tr, testRoutesAreSplitByComponents);
+    RUN_TEST(tr, testRoutesAreEncodedByShards);
+    RUN_TEST(tr, testRouterUpdateMergesComponents);
+    RUN_TEST(tr, testFirstHopRouterGivesTheSameWeights);
+    RUN_TEST(tr, testMappedRouterGivesTheSameRoutes);
+    RUN_TEST(tr, testDijkstraRouterGivesTheSameRoutes);
+    RUN_TEST(tr, testDijkstraRouterCache);
+    RUN_TEST(tr, testContractionHierarchyRouterGivesTheSameRoutes);
+    RUN_TEST(tr, testContractionHierarchyRouterUnpacksShortcuts);
+    RUN_TEST(tr, testAStarRouterGivesTheSameWeights);
+    RUN_TEST(tr, testAStarRouterSettlesLessVertexes);
+    RUN_TEST(tr, testHubLabelingRouterGivesTheSameWeights);
 }
 } // namespace Tests
 } // namespace Graph
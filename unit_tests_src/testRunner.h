@@ -6,6 +6,7 @@
 #include <iostream>
 #include <list>
 #include <map>
+#include <optional>
 #include <math.h>
 #include <set>
 #include <sstream>
@@ -1,7 +1,14 @@
 #include "transportRouterTestSuite.h"
 #include "testRunner.h"
+#include "transportCatalog.h"
 #include "transportRouter.h"
 
+#include "transport_catalog.pb.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+
 using namespace std;
 
 using RouteStats = TransportRouter::RouteStats;
@@ -10,7 +17,19 @@ using RouteElement = TransportRouter::RouteElement;
 namespace
 {
 const auto EmptyRouteOptional = optional<RouteStats>();
+
+// Edges of all the shards of the router one after another
+vector<TCProto::EdgeInfo> readEdgesInfo(const TCProto::TransportRouter& proto)
+{
+    vector<TCProto::EdgeInfo> edgesInfo;
+    for (const auto& shardProto : proto.edges_info_shards())
+    {
+        edgesInfo.insert(
+            edgesInfo.end(), shardProto.edges_info().begin(), shardProto.edges_info().end());
+    }
+    return edgesInfo;
 }
+} // namespace
 
 bool operator==(const TransportRouter::RouteElement& lhs, const TransportRouter::RouteElement& rhs)
 {
@@ -50,7 +69,35 @@ ostream& operator<<(ostream& stream, const TransportRouter::RouteStats& stats)
 // TODO: split into two functions
 namespace Tests
 {
-void testFindRoute()
+namespace
+{
+// Two buses between four stops of Biryulyovo, most of the tests search their routes
+BaseRequests::ParsedBuses makeBuses()
+{
+    return {{.name = "297",
+             .stops = {"Biryulyovo Zapadnoye",
+                       "Biryulyovo Tovarnaya",
+                       "Universam",
+                       "Biryulyovo Zapadnoye"}},
+            {.name = "635",
+             .stops = {"Biryulyovo Tovarnaya",
+                       "Universam",
+                       "Prazhskaya",
+                       "Universam",
+                       "Biryulyovo Tovarnaya"}}};
+}
+
+RouteDistancesMap makeRouteDistances()
+{
+    return {{{"Biryulyovo Zapadnoye", "Biryulyovo Tovarnaya"}, 2600},
+            {{"Biryulyovo Tovarnaya", "Universam"}, 890},
+            {{"Universam", "Biryulyovo Tovarnaya"}, 1380},
+            {{"Universam", "Biryulyovo Zapadnoye"}, 2500},
+            {{"Universam", "Prazhskaya"}, 4650},
+            {{"Prazhskaya", "Universam"}, 4650}};
+}
+
+void checkFindRoute(const string& graphModel, const string& routingAlgorithm)
 {
     {
         // Test regular cases
@@ -75,9 +122,19 @@ void testFindRoute()
                                          {{"Universam", "Prazhskaya"}, 4650},
                                          {{"Prazhskaya", "Universam"}, 4650}};
 
-        Json::Map routingSetting{{"bus_wait_time", 6}, {"bus_velocity", 40.0}};
+        TransportRouter::StopCoordinates stopCoordinates{
+            {"Biryulyovo Zapadnoye", {55.574371, 37.6517}},
+            {"Biryulyovo Tovarnaya", {55.592028, 37.653656}},
+            {"Universam", {55.587655, 37.645687}},
+            {"Prazhskaya", {55.611717, 37.603938}}};
+
+        Json::Map routingSetting{{"bus_wait_time", 6},
+                                 {"bus_velocity", 40.0},
+                                 {"graph_model", graphModel},
+                                 {"routing_algorithm", routingAlgorithm}};
 
-        const auto transportRouter = TransportRouter(buses, routeDistances, routingSetting);
+        const auto transportRouter =
+            TransportRouter(buses, routeDistances, stopCoordinates, routingSetting);
 
         {
             const auto expectedOneWay =
@@ -114,8 +171,32 @@ void testFindRoute()
                                               .from = "Biryulyovo Tovarnaya",
                                               .spanCount = 2,
                                               .transitTime = 8.31}}};
-            ASSERT_EQUAL(transportRouter.findRoute("Biryulyovo Zapadnoye", "Prazhskaya"),
-                         expectedOneWay);
+            // Routers which find the routes of Floyd-Warshall algorithm choose this one in both
+            // graph models. The others may choose another route of the same time
+            const auto expectedOtherWay =
+                RouteStats{.totalTime = 24.21,
+                           .routeElements = {{.waitTime = 6,
+                                              .bus = "297",
+                                              .from = "Biryulyovo Zapadnoye",
+                                              .spanCount = 2,
+                                              .transitTime = 5.235},
+                                             {.waitTime = 6,
+                                              .bus = "635",
+                                              .from = "Universam",
+                                              .spanCount = 1,
+                                              .transitTime = 6.975}}};
+            const bool mayChooseOtherWay = routingAlgorithm != "all_pairs" &&
+                                           routingAlgorithm != "dijkstra" &&
+                                           routingAlgorithm != "contraction_hierarchy";
+            const auto route = transportRouter.findRoute("Biryulyovo Zapadnoye", "Prazhskaya");
+            if (mayChooseOtherWay)
+            {
+                ASSERT(route == expectedOneWay || route == expectedOtherWay);
+            }
+            else
+            {
+                ASSERT_EQUAL(route, expectedOneWay);
+            }
 
             const auto expectedWayBack =
                 RouteStats{.totalTime = 24.21,
@@ -129,8 +210,15 @@ void testFindRoute()
                                               .from = "Biryulyovo Tovarnaya",
                                               .spanCount = 2,
                                               .transitTime = 8.31}}};
-            ASSERT_EQUAL(transportRouter.findRoute("Biryulyovo Zapadnoye", "Prazhskaya"),
-                         expectedWayBack);
+            const auto routeBack = transportRouter.findRoute("Biryulyovo Zapadnoye", "Prazhskaya");
+            if (mayChooseOtherWay)
+            {
+                ASSERT(routeBack == expectedWayBack || routeBack == expectedOtherWay);
+            }
+            else
+            {
+                ASSERT_EQUAL(routeBack, expectedWayBack);
+            }
         }
 
         {
@@ -173,9 +261,20 @@ void testFindRoute()
                                          {{"Lipetskaya ulitsa 40", "Lipetskaya ulitsa 46"}, 380},
                                          {{"Moskvorechye", "Zagorye"}, 10000}};
 
-        Json::Map routingSetting{{"bus_wait_time", 2}, {"bus_velocity", 48.561}};
+        // Road distances are much shorter than the real ones, the router must not rely on them
+        TransportRouter::StopCoordinates stopCoordinates{
+            {"Zagorye", {55.579909, 37.68372}},
+            {"Lipetskaya ulitsa 46", {55.581065, 37.64839}},
+            {"Lipetskaya ulitsa 40", {55.579271, 37.664411}},
+            {"Moskvorechye", {55.638433, 37.638433}}};
+
+        Json::Map routingSetting{{"bus_wait_time", 2},
+                                 {"bus_velocity", 48.561},
+                                 {"graph_model", graphModel},
+                                 {"routing_algorithm", routingAlgorithm}};
 
-        const auto transportRouter = TransportRouter(buses, routeDistances, routingSetting);
+        const auto transportRouter =
+            TransportRouter(buses, routeDistances, stopCoordinates, routingSetting);
 
         // Get off at the bus stop and transfer to the same bus going in the other direction is
         // the fastest way
@@ -209,10 +308,783 @@ void testFindRoute()
                      EmptyRouteOptional);
     }
 }
+} // namespace
+
+void testFindRoute()
+{
+    for (const string graphModel : {"stop_pairs", "boarding"})
+    {
+        for (const string routingAlgorithm :
+             {"all_pairs",
+              "dijkstra",
+              "contraction_hierarchy",
+              "a_star",
+              "bidirectional_a_star",
+              "hub_labeling",
+              "raptor"})
+        {
+            checkFindRoute(graphModel, routingAlgorithm);
+        }
+    }
+}
+
+void testFindRouteWithMaxTransfers()
+{
+    const auto buses = makeBuses();
+
+    const auto routeDistances = makeRouteDistances();
+
+    Json::Map routingSetting{{"bus_wait_time", 6},
+                             {"bus_velocity", 40.0},
+                             {"routing_algorithm", "raptor"s},
+                             {"max_transfers", 0}};
+    {
+        const auto transportRouter = TransportRouter(buses, routeDistances, {}, routingSetting);
+        // Prazhskaya can be reached only with a transfer
+        ASSERT_EQUAL(transportRouter.findRoute("Biryulyovo Zapadnoye", "Prazhskaya"),
+                     EmptyRouteOptional);
+
+        const auto expected = RouteStats{.totalTime = 11.235,
+                                         .routeElements = {{.waitTime = 6,
+                                                            .bus = "297",
+                                                            .from = "Biryulyovo Zapadnoye",
+                                                            .spanCount = 2,
+                                                            .transitTime = 5.235}}};
+        ASSERT_EQUAL(transportRouter.findRoute("Biryulyovo Zapadnoye", "Universam"), expected);
+    }
+
+    routingSetting["max_transfers"] = 1;
+    {
+        const auto transportRouter = TransportRouter(buses, routeDistances, {}, routingSetting);
+        const auto route = transportRouter.findRoute("Biryulyovo Zapadnoye", "Prazhskaya");
+        ASSERT(route.has_value());
+        ASSERT_EQUAL(route->routeElements.size(), 2u);
+        ASSERT(fuzzyCompare(route->totalTime, 24.21));
+    }
+
+    routingSetting["routing_algorithm"] = "dijkstra"s;
+    ASSERT_EXCEPTION_THROWN((TransportRouter(buses, routeDistances, {}, routingSetting)),
+                            runtime_error);
+}
+
+void testFindRouteTimes()
+{
+    auto buses = makeBuses();
+    buses.push_back({.name = "828", .stops = {"Rossoshanskaya ulitsa", "Prazhskaya"}});
+    auto routeDistances = makeRouteDistances();
+    routeDistances[{"Rossoshanskaya ulitsa", "Prazhskaya"}] = 3000;
+
+    TransportRouter::StopCoordinates stopCoordinates{
+        {"Biryulyovo Zapadnoye", {55.574371, 37.6517}},
+        {"Biryulyovo Tovarnaya", {55.592028, 37.653656}},
+        {"Universam", {55.587655, 37.645687}},
+        {"Prazhskaya", {55.611717, 37.603938}},
+        {"Rossoshanskaya ulitsa", {55.595579, 37.605757}}};
+
+    // Rossoshanskaya ulitsa can't be reached from anywhere, the stops may repeat or be unknown
+    const vector<string> from = {
+        "Biryulyovo Zapadnoye", "Rossoshanskaya ulitsa", "NonExistingStop", "Prazhskaya"};
+    const vector<string> to = {"Universam",
+                               "Rossoshanskaya ulitsa",
+                               "Prazhskaya",
+                               "Biryulyovo Zapadnoye",
+                               "NonExistingStop",
+                               "Universam"};
+
+    for (const string graphModel : {"stop_pairs", "boarding"})
+    {
+        for (const string routingAlgorithm :
+             {"all_pairs",
+              "dijkstra",
+              "contraction_hierarchy",
+              "a_star",
+              "bidirectional_a_star",
+              "hub_labeling",
+              "raptor"})
+        {
+            Json::Map routingSetting{{"bus_wait_time", 6},
+                                     {"bus_velocity", 40.0},
+                                     {"graph_model", graphModel},
+                                     {"routing_algorithm", routingAlgorithm}};
+            const auto transportRouter =
+                TransportRouter(buses, routeDistances, stopCoordinates, routingSetting);
+
+            const auto times = transportRouter.findRouteTimes(from, to);
+            ASSERT_EQUAL(times.size(), from.size());
+            for (size_t fromIndex = 0; fromIndex < from.size(); fromIndex++)
+            {
+                ASSERT_EQUAL(times[fromIndex].size(), to.size());
+                for (size_t toIndex = 0; toIndex < to.size(); toIndex++)
+                {
+                    const auto route = transportRouter.findRoute(from[fromIndex], to[toIndex]);
+                    const auto& time = times[fromIndex][toIndex];
+                    ASSERT_EQUAL(time.has_value(), route.has_value());
+                    ASSERT(!time || fuzzyCompare(*time, route->totalTime));
+                }
+            }
+            ASSERT(times[0][0].has_value());
+            ASSERT(!times[0][1].has_value());
+            ASSERT(fuzzyCompare(*times[1][1], 0));
+        }
+    }
+}
+
+void testUpdates()
+{
+    const BaseRequests::Bus addedBus{
+        .name = "828", .stops = {"Universam", "Rossoshanskaya ulitsa", "Universam"}};
+    const auto buses = makeBuses();
+    auto routeDistances = makeRouteDistances();
+    routeDistances[{"Universam", "Rossoshanskaya ulitsa"}] = 1200;
+    routeDistances[{"Rossoshanskaya ulitsa", "Universam"}] = 1300;
+
+    const vector<string> stops = {"Biryulyovo Zapadnoye",
+                                  "Biryulyovo Tovarnaya",
+                                  "Universam",
+                                  "Prazhskaya",
+                                  "Rossoshanskaya ulitsa"};
+
+    for (const string graphModel : {"stop_pairs", "boarding"})
+    {
+        for (const string routingAlgorithm : {"all_pairs", "dijkstra"})
+        {
+            Json::Map routingSetting{{"bus_wait_time", 6},
+                                     {"bus_velocity", 40.0},
+                                     {"graph_model", graphModel},
+                                     {"routing_algorithm", routingAlgorithm}};
+
+            // The base is made without the added bus and with the old distances, the updates are
+            // applied to the deserialized one
+            TCProto::TransportRouter proto;
+            TransportRouter(buses, routeDistances, {}, routingSetting).serialize(proto);
+            const auto transportRouter = TransportRouter::deserialize(proto);
+            transportRouter->addBus(addedBus, routeDistances);
+            auto newRouteDistances = routeDistances;
+            newRouteDistances[{"Biryulyovo Zapadnoye", "Biryulyovo Tovarnaya"}] = 1000;
+            newRouteDistances[{"Universam", "Prazhskaya"}] = 6000;
+            newRouteDistances[{"Rossoshanskaya ulitsa", "Universam"}] = 700;
+            transportRouter->setRouteDistances(newRouteDistances);
+
+            auto allBuses = buses;
+            allBuses.push_back(addedBus);
+            const auto expectedRouter =
+                TransportRouter(allBuses, newRouteDistances, {}, routingSetting);
+
+            for (const auto& from : stops)
+            {
+                for (const auto& to : stops)
+                {
+                    const auto route = transportRouter->findRoute(from, to);
+                    const auto expectedRoute = expectedRouter.findRoute(from, to);
+                    ASSERT_EQUAL(route.has_value(), expectedRoute.has_value());
+                    if (!route)
+                    {
+                        continue;
+                    }
+                    ASSERT(fuzzyCompare(route->totalTime, expectedRoute->totalTime));
+
+                    double totalTime = 0;
+                    for (const auto& element : route->routeElements)
+                    {
+                        totalTime += element.waitTime + element.transitTime;
+                    }
+                    ASSERT(fuzzyCompare(totalTime, route->totalTime));
+                }
+            }
+        }
+    }
+}
+
+void testNarrowerWeights()
+{
+    const auto buses = makeBuses();
+
+    // Odd distances and velocity, so the times aren't exact in any weight type
+    RouteDistancesMap routeDistances{{{"Biryulyovo Zapadnoye", "Biryulyovo Tovarnaya"}, 2617},
+                                     {{"Biryulyovo Tovarnaya", "Universam"}, 893},
+                                     {{"Universam", "Biryulyovo Tovarnaya"}, 1381},
+                                     {{"Universam", "Biryulyovo Zapadnoye"}, 2503},
+                                     {{"Universam", "Prazhskaya"}, 4651},
+                                     {{"Prazhskaya", "Universam"}, 4649}};
+
+    const vector<string> stops = {
+        "Biryulyovo Zapadnoye", "Biryulyovo Tovarnaya", "Universam", "Prazhskaya"};
+
+    for (const string graphModel : {"stop_pairs", "boarding"})
+    {
+        Json::Map routingSetting{{"bus_wait_time", 6},
+                                 {"bus_velocity", 41.3},
+                                 {"graph_model", graphModel},
+                                 {"routing_algorithm", "all_pairs"s}};
+        const auto expectedRouter = TransportRouter(buses, routeDistances, {}, routingSetting);
+        const auto expectedTimes = expectedRouter.findRouteTimes(stops, stops);
+
+        for (const string weightType : {"float", "fixed_point"})
+        {
+            routingSetting["weight_type"] = weightType;
+            TCProto::TransportRouter proto;
+            TransportRouter(buses, routeDistances, {}, routingSetting).serialize(proto);
+            const auto transportRouter = TransportRouter::deserialize(proto);
+
+            const auto times = transportRouter->findRouteTimes(stops, stops);
+            for (size_t fromIndex = 0; fromIndex < stops.size(); fromIndex++)
+            {
+                for (size_t toIndex = 0; toIndex < stops.size(); toIndex++)
+                {
+                    const auto route =
+                        transportRouter->findRoute(stops[fromIndex], stops[toIndex]);
+                    const auto expectedRoute =
+                        expectedRouter.findRoute(stops[fromIndex], stops[toIndex]);
+                    ASSERT_EQUAL(route.has_value(), expectedRoute.has_value());
+                    ASSERT_EQUAL(times[fromIndex][toIndex].has_value(), route.has_value());
+                    if (!route)
+                    {
+                        continue;
+                    }
+                    ASSERT(fuzzyCompare(route->totalTime, expectedRoute->totalTime));
+                    ASSERT(fuzzyCompare(*times[fromIndex][toIndex],
+                                        *expectedTimes[fromIndex][toIndex]));
+                }
+            }
+
+            auto changedRouteDistances = routeDistances;
+            changedRouteDistances[{"Universam", "Prazhskaya"}] = 6011;
+            transportRouter->setRouteDistances(changedRouteDistances);
+            ASSERT(fuzzyCompare(transportRouter->findRoute("Universam", "Prazhskaya")->totalTime,
+                                6 + 6011 / (41.3 * 1000 / 60)));
+        }
+    }
+
+    Json::Map routingSetting{{"bus_wait_time", 6},
+                             {"bus_velocity", 40.0},
+                             {"routing_algorithm", "dijkstra"s},
+                             {"weight_type", "float"s}};
+    ASSERT_EXCEPTION_THROWN((TransportRouter(buses, routeDistances, {}, routingSetting)),
+                            runtime_error);
+}
+
+void testParallelEdgePruning()
+{
+    // 828 rides from Universam to Prazhskaya faster than 635, 297 rides from Biryulyovo Tovarnaya
+    // to Universam as fast as 635 does
+    BaseRequests::ParsedBuses buses{
+        {.name = "635", .stops = {"Biryulyovo Tovarnaya", "Universam", "Prazhskaya"}},
+        {.name = "828", .stops = {"Biryulyovo Tovarnaya", "Prazhskaya"}},
+        {.name = "297", .stops = {"Biryulyovo Tovarnaya", "Universam"}}};
+
+    RouteDistancesMap routeDistances{{{"Biryulyovo Tovarnaya", "Universam"}, 1000},
+                                     {{"Universam", "Prazhskaya"}, 1000},
+                                     {{"Biryulyovo Tovarnaya", "Prazhskaya"}, 1500}};
+
+    for (const string routingAlgorithm : {"all_pairs", "dijkstra"})
+    {
+        Json::Map routingSetting{{"bus_wait_time", 6},
+                                 {"bus_velocity", 40.0},
+                                 {"routing_algorithm", routingAlgorithm}};
+        TCProto::TransportRouter proto;
+        const auto builtRouter = TransportRouter(buses, routeDistances, {}, routingSetting);
+        ASSERT_EQUAL(builtRouter.getDroppedEdgeCount(), 2u);
+        builtRouter.serialize(proto);
+        ASSERT_EQUAL(proto.graph().out_edge_ids_size(), 3);
+        ASSERT_EQUAL(readEdgesInfo(proto).size(), 3u);
+
+        const auto transportRouter = TransportRouter::deserialize(proto);
+        ASSERT_EQUAL(transportRouter->getDroppedEdgeCount(), 2u);
+        ASSERT_EQUAL(*transportRouter->findRoute("Biryulyovo Tovarnaya", "Prazhskaya"),
+                     (RouteStats{8.25, {{6, "828", "Biryulyovo Tovarnaya", 1, 2.25}}}));
+        ASSERT_EQUAL(*transportRouter->findRoute("Biryulyovo Tovarnaya", "Universam"),
+                     (RouteStats{7.5, {{6, "635", "Biryulyovo Tovarnaya", 1, 1.5}}}));
+
+        // Now 635 is faster, so its edge takes the place of the one of 828
+        auto newRouteDistances = routeDistances;
+        newRouteDistances[{"Biryulyovo Tovarnaya", "Prazhskaya"}] = 3000;
+        transportRouter->setRouteDistances(newRouteDistances);
+        ASSERT_EQUAL(*transportRouter->findRoute("Biryulyovo Tovarnaya", "Prazhskaya"),
+                     (RouteStats{9, {{6, "635", "Biryulyovo Tovarnaya", 2, 3}}}));
+
+        const BaseRequests::Bus addedBus{.name = "14",
+                                         .stops = {"Biryulyovo Tovarnaya", "Prazhskaya"}};
+        newRouteDistances[{"Biryulyovo Tovarnaya", "Prazhskaya"}] = 750;
+        transportRouter->addBus(addedBus, newRouteDistances);
+        ASSERT_EQUAL(transportRouter->getDroppedEdgeCount(), 3u);
+        ASSERT_EQUAL(*transportRouter->findRoute("Biryulyovo Tovarnaya", "Prazhskaya"),
+                     (RouteStats{7.125, {{6, "14", "Biryulyovo Tovarnaya", 1, 1.125}}}));
+    }
+
+    Json::Map routingSetting{{"bus_wait_time", 6},
+                             {"bus_velocity", 40.0},
+                             {"graph_model", "boarding"s}};
+    ASSERT_EQUAL(TransportRouter(buses, routeDistances, {}, routingSetting).getDroppedEdgeCount(),
+                 0u);
+}
+
+void testVertexOrder()
+{
+    auto buses = makeBuses();
+    buses.push_back({.name = "828", .stops = {"Universam", "Tsaritsyno"}});
+    buses.push_back({.name = "840", .stops = {"Tsaritsyno", "Moskvorechye"}});
+    auto routeDistances = makeRouteDistances();
+    routeDistances[{"Universam", "Tsaritsyno"}] = 1380;
+    routeDistances[{"Tsaritsyno", "Moskvorechye"}] = 1200;
+
+    const vector<string> stops = {"Biryulyovo Zapadnoye",
+                                  "Biryulyovo Tovarnaya",
+                                  "Universam",
+                                  "Prazhskaya",
+                                  "Tsaritsyno",
+                                  "Moskvorechye"};
+
+    for (const string graphModel : {"stop_pairs", "boarding"})
+    {
+        for (const string routingAlgorithm : {"all_pairs", "dijkstra", "hub_labeling"})
+        {
+            Json::Map routingSetting{{"bus_wait_time", 6},
+                                     {"bus_velocity", 40.0},
+                                     {"graph_model", graphModel},
+                                     {"routing_algorithm", routingAlgorithm}};
+            const auto expectedRouter = TransportRouter(buses, routeDistances, {}, routingSetting);
+
+            routingSetting["vertex_order"] = "cuthill_mckee"s;
+            TCProto::TransportRouter proto;
+            TransportRouter(buses, routeDistances, {}, routingSetting).serialize(proto);
+            const auto transportRouter = TransportRouter::deserialize(proto);
+
+            // Stops keep their vertexes, the last ones in Boarding model. In StopPairs model the
+            // order starts from Moskvorechye, the only stop with one neighbour, and is reversed
+            const size_t vertexCount =
+                static_cast<size_t>(proto.graph().out_edge_offsets_size() - 1);
+            const size_t firstStopVertex =
+                graphModel == "boarding" ? vertexCount - stops.size() : 0;
+            unordered_map<string, Graph::VertexId> stopVertexes;
+            for (const auto& vertexInfoProto : proto.vertexes_info())
+            {
+                ASSERT(vertexInfoProto.vertex_id() >= firstStopVertex &&
+                       vertexInfoProto.vertex_id() < firstStopVertex + stops.size());
+                stopVertexes[vertexInfoProto.stop_name()] = vertexInfoProto.vertex_id();
+            }
+            ASSERT_EQUAL(stopVertexes.size(), stops.size());
+            if (graphModel == "stop_pairs")
+            {
+                ASSERT_EQUAL(stopVertexes["Moskvorechye"], stops.size() - 1);
+                ASSERT_EQUAL(stopVertexes["Tsaritsyno"], stops.size() - 2);
+            }
+
+            for (const auto& from : stops)
+            {
+                for (const auto& to : stops)
+                {
+                    const auto route = transportRouter->findRoute(from, to);
+                    const auto expectedRoute = expectedRouter.findRoute(from, to);
+                    ASSERT_EQUAL(route.has_value(), expectedRoute.has_value());
+                    if (route)
+                    {
+                        ASSERT(fuzzyCompare(route->totalTime, expectedRoute->totalTime));
+                    }
+                }
+            }
+        }
+    }
+
+    Json::Map routingSetting{
+        {"bus_wait_time", 6}, {"bus_velocity", 40.0}, {"vertex_order", "by_name"s}};
+    ASSERT_EXCEPTION_THROWN((TransportRouter(buses, routeDistances, {}, routingSetting)),
+                            runtime_error);
+}
+
+void testFirstHops()
+{
+    const auto buses = makeBuses();
+
+    const auto routeDistances = makeRouteDistances();
+
+    const vector<string> stops = {
+        "Biryulyovo Zapadnoye", "Biryulyovo Tovarnaya", "Universam", "Prazhskaya"};
+
+    for (const string graphModel : {"stop_pairs", "boarding"})
+    {
+        Json::Map routingSetting{{"bus_wait_time", 6},
+                                 {"bus_velocity", 40.0},
+                                 {"graph_model", graphModel}};
+        const auto expectedRouter = TransportRouter(buses, routeDistances, {}, routingSetting);
+
+        routingSetting["path_storage"] = "first_hops"s;
+        TCProto::TransportRouter proto;
+        TransportRouter(buses, routeDistances, {}, routingSetting).serialize(proto);
+        ASSERT(proto.has_first_hop_router());
+        const auto transportRouter = TransportRouter::deserialize(proto);
+
+        RouteStats route;
+        for (const auto& from : stops)
+        {
+            for (const auto& to : stops)
+            {
+                const auto expectedRoute = expectedRouter.findRoute(from, to);
+                ASSERT_EQUAL(transportRouter->findRoute(from, to, route),
+                             expectedRoute.has_value());
+                if (expectedRoute)
+                {
+                    ASSERT_EQUAL(route, *expectedRoute);
+                }
+            }
+        }
+        ASSERT_EQUAL(transportRouter->findRouteTimes(stops, stops),
+                     expectedRouter.findRouteTimes(stops, stops));
+        ASSERT_EXCEPTION_THROWN(transportRouter->setRouteDistances(routeDistances), runtime_error);
+    }
+
+    Json::Map routingSetting{{"bus_wait_time", 6},
+                             {"bus_velocity", 40.0},
+                             {"routing_algorithm", "dijkstra"s},
+                             {"path_storage", "first_hops"s}};
+    ASSERT_EXCEPTION_THROWN((TransportRouter(buses, routeDistances, {}, routingSetting)),
+                            runtime_error);
+}
+
+void testNameIds()
+{
+    const auto buses = makeBuses();
+
+    const auto routeDistances = makeRouteDistances();
+
+    const vector<string> stops = {
+        "Biryulyovo Zapadnoye", "Biryulyovo Tovarnaya", "Universam", "Prazhskaya"};
+
+    const BaseNames names{NameTable({"Universam", "Prazhskaya", "Biryulyovo Zapadnoye",
+                                     "Biryulyovo Tovarnaya", "Universam"}),
+                          NameTable({"635", "297"})};
+    ASSERT_EQUAL(names.stops.getSize(), 4u);
+    ASSERT_EQUAL(names.stops.getName(0), "Biryulyovo Tovarnaya"s);
+    ASSERT_EQUAL(names.buses.getId("635"), 1u);
+    ASSERT(!names.buses.findId("000"));
+    ASSERT_EXCEPTION_THROWN(names.stops.getName(4), runtime_error);
+
+    for (const string graphModel : {"stop_pairs", "boarding"})
+    {
+        const Json::Map routingSetting{{"bus_wait_time", 6},
+                                       {"bus_velocity", 40.0},
+                                       {"graph_model", graphModel}};
+        const auto expectedRouter = TransportRouter(buses, routeDistances, {}, routingSetting);
+
+        TCProto::TransportRouter proto;
+        expectedRouter.serialize(proto, &names);
+        for (const auto& edgeInfoProto : readEdgesInfo(proto))
+        {
+            ASSERT(edgeInfoProto.bus_name().empty() && edgeInfoProto.departure_stop_name().empty());
+        }
+        for (const auto& vertexInfoProto : proto.vertexes_info())
+        {
+            ASSERT(vertexInfoProto.stop_name().empty());
+        }
+        const auto transportRouter = TransportRouter::deserialize(proto, &names);
+
+        for (const auto& from : stops)
+        {
+            for (const auto& to : stops)
+            {
+                ASSERT_EQUAL(transportRouter->findRoute(from, to),
+                             expectedRouter.findRoute(from, to));
+            }
+        }
+    }
+}
+
+void testShardedBase()
+{
+    const auto buses = makeBuses();
+
+    const auto routeDistances = makeRouteDistances();
+
+    // The base doesn't depend on the count of threads encoding it, nor on the order of the maps
+    // of the router read from another base
+    for (const string weightType : {"double", "float"})
+    {
+        string expectedData;
+        for (const int threadCount : {1, 4})
+        {
+            const Json::Map routingSetting{{"bus_wait_time", 6},
+                                           {"bus_velocity", 40.0},
+                                           {"graph_model", "boarding"s},
+                                           {"weight_type", weightType},
+                                           {"thread_count", threadCount}};
+            TCProto::TransportRouter proto;
+            TransportRouter(buses, routeDistances, {}, routingSetting).serialize(proto);
+            const string data = proto.SerializeAsString();
+            ASSERT(expectedData.empty() || data == expectedData);
+            expectedData = data;
+
+            const auto edgesInfo = readEdgesInfo(proto);
+            ASSERT(!edgesInfo.empty() && proto.edges_info().empty());
+            ASSERT(is_sorted(
+                edgesInfo.begin(), edgesInfo.end(), [](const auto& lhs, const auto& rhs) {
+                    return lhs.edge_id() < rhs.edge_id();
+                }));
+
+            TCProto::TransportRouter deserializedProto;
+            TransportRouter::deserialize(proto)->serialize(deserializedProto);
+            ASSERT(deserializedProto.SerializeAsString() == data);
+        }
+    }
+}
+
+BaseRequests::ParsedRequests makeBaseRequests()
+{
+    return {
+        .stops = {{.name = "Tolstopaltsevo",
+                   .position = {55.611087, 37.20829},
+                   .distances = {{"Marushkino", 3900}}},
+                  {.name = "Marushkino",
+                   .position = {55.595884, 37.209755},
+                   .distances = {{"Rasskazovka", 9900}}},
+                  {.name = "Rasskazovka", .position = {55.632761, 37.333324}, .distances = {}}},
+        .buses = {{.name = "750", .stops = {"Tolstopaltsevo", "Marushkino", "Tolstopaltsevo"}},
+                  {.name = "256", .stops = {"Marushkino", "Rasskazovka", "Marushkino"}}}};
+}
+
+Json::Map makeCatalogRoutingSettings(const string& routingAlgorithm)
+{
+    return {{"bus_wait_time", 6}, {"bus_velocity", 40.0}, {"routing_algorithm", routingAlgorithm}};
+}
+
+TransportCatalog makeCatalog(const string& routingAlgorithm = "all_pairs")
+{
+    return TransportCatalog(makeBaseRequests(), makeCatalogRoutingSettings(routingAlgorithm));
+}
+
+void testCatalogUpdates()
+{
+    // Marushkino gives a new distance to Rasskazovka, the way back has no distance of its own, so
+    // it changes too. A new stop comes with a new bus
+    const BaseRequests::ParsedRequests delta{
+        .stops = {{.name = "Marushkino",
+                   .position = {55.595884, 37.209755},
+                   .distances = {{"Rasskazovka", 9000}}},
+                  {.name = "Lesnaya",
+                   .position = {55.622102, 37.301046},
+                   .distances = {{"Rasskazovka", 1000}}}},
+        .buses = {{.name = "828", .stops = {"Rasskazovka", "Lesnaya", "Rasskazovka"}}}};
+    auto requests = makeBaseRequests();
+    requests.stops[1].distances[0].length = 9000;
+    requests.stops.push_back(delta.stops[1]);
+    requests.buses.push_back(delta.buses[0]);
+    const vector<string> stops = {"Tolstopaltsevo", "Marushkino", "Rasskazovka", "Lesnaya"};
+    const vector<string> buses = {"750", "256", "828"};
+
+    const auto checkCatalog = [&](const TransportCatalog& catalog,
+                                  const TransportCatalog& expectedCatalog) {
+        for (const auto& bus : buses)
+        {
+            ASSERT_EQUAL(catalog.getBus(bus)->stopCount, expectedCatalog.getBus(bus)->stopCount);
+            ASSERT_EQUAL(catalog.getBus(bus)->roadRouteLength,
+                         expectedCatalog.getBus(bus)->roadRouteLength);
+            ASSERT(fuzzyCompare(catalog.getBus(bus)->orthodromicRouteLength,
+                                expectedCatalog.getBus(bus)->orthodromicRouteLength));
+        }
+        for (const auto& from : stops)
+        {
+            ASSERT_EQUAL(catalog.getStop(from)->busNames, expectedCatalog.getStop(from)->busNames);
+            for (const auto& to : stops)
+            {
+                ASSERT_EQUAL(catalog.findRoute(from, to), expectedCatalog.findRoute(from, to));
+            }
+        }
+    };
+
+    for (const string routingAlgorithm : {"all_pairs", "dijkstra"})
+    {
+        const TransportCatalog expectedCatalog(requests,
+                                               makeCatalogRoutingSettings(routingAlgorithm));
+        // The base requests are kept in the base
+        auto catalog = TransportCatalog::deserialize(makeCatalog(routingAlgorithm).serialize());
+        catalog.update(delta);
+        checkCatalog(catalog, expectedCatalog);
+        ASSERT_EQUAL(catalog.getBus("256")->roadRouteLength, 18000u);
+        checkCatalog(TransportCatalog::deserialize(catalog.serialize()), expectedCatalog);
+
+        ASSERT_EXCEPTION_THROWN(catalog.update({.stops = {}, .buses = {delta.buses[0]}}),
+                                runtime_error);
+    }
+
+    ASSERT_EXCEPTION_THROWN(makeCatalog("raptor").update(delta), runtime_error);
+
+    TCProto::TransportCatalog proto;
+    ASSERT(proto.ParseFromString(makeCatalog().serialize()));
+    for (auto& stopProto : *proto.mutable_stops())
+    {
+        stopProto.clear_has_request();
+    }
+    ASSERT_EXCEPTION_THROWN(TransportCatalog::deserialize(proto.SerializeAsString()).update(delta),
+                            runtime_error);
+}
+
+void testStreamedBase()
+{
+    const auto expectedCatalog = makeCatalog();
+    const string data = expectedCatalog.serialize();
+    // The fields written one by one make the same bytes as the whole message
+    TCProto::TransportCatalog proto;
+    ASSERT(proto.ParseFromString(data));
+    ASSERT(proto.SerializeAsString() == data);
+
+    const auto fileName = (filesystem::temp_directory_path() / "streamedBaseTest.bin").string();
+    expectedCatalog.save(fileName);
+    {
+        const MappedFile file(fileName);
+        ASSERT(string(file.getData(), file.getSize()) == data);
+    }
+    const auto catalog = TransportCatalog::load(fileName);
+    filesystem::remove(fileName);
+    ASSERT_EQUAL(catalog.getBus("256")->stopCount, 3u);
+    ASSERT_EQUAL(catalog.findRoute("Tolstopaltsevo", "Rasskazovka"),
+                 expectedCatalog.findRoute("Tolstopaltsevo", "Rasskazovka"));
+}
+
+void testLazyMappedBase()
+{
+    const auto expectedCatalog = makeCatalog();
+    ASSERT(expectedCatalog.getSectionStats().empty());
+
+    const auto fileName = (filesystem::temp_directory_path() / "lazyMappedBaseTest.bin").string();
+    expectedCatalog.saveMapped(fileName);
+    const auto catalog = TransportCatalog::load(fileName);
+    // The file stays mapped
+    filesystem::remove(fileName);
+
+    const auto getLoadedSections = [&catalog] {
+        vector<string> names;
+        for (const auto& stats : catalog.getSectionStats())
+        {
+            ASSERT(stats.fileSize > 0);
+            if (stats.isLoaded)
+            {
+                names.push_back(stats.name);
+            }
+        }
+        return names;
+    };
+    vector<string> expectedSections = {"names"};
+    ASSERT_EQUAL(getLoadedSections(), expectedSections);
+
+    ASSERT_EQUAL(catalog.getBus("750")->roadRouteLength, 7800u);
+    ASSERT(!catalog.getBus("751"));
+    expectedSections = {"names", "buses"};
+    ASSERT_EQUAL(getLoadedSections(), expectedSections);
+
+    ASSERT_EQUAL(catalog.getStop("Marushkino")->busNames,
+                 expectedCatalog.getStop("Marushkino")->busNames);
+    expectedSections = {"names", "stops", "buses"};
+    ASSERT_EQUAL(getLoadedSections(), expectedSections);
+
+    ASSERT_EQUAL(catalog.findRoute("Tolstopaltsevo", "Rasskazovka"),
+                 expectedCatalog.findRoute("Tolstopaltsevo", "Rasskazovka"));
+    expectedSections = {"names", "stops", "buses", "router"};
+    ASSERT_EQUAL(getLoadedSections(), expectedSections);
+}
+
+void testCellRoutesBase()
+{
+    const auto hasRoutesOfCells = [](const string& data) {
+        return TransportCatalog::hasRoutesOfCells(data.data(), data.size());
+    };
+    ASSERT(!hasRoutesOfCells(makeCatalog("dijkstra").serialize()));
+
+    const auto expectedCatalog = makeCatalog();
+    TCProto::TransportCatalog proto;
+    ASSERT(proto.ParseFromString(expectedCatalog.serialize()));
+    ASSERT(proto.router().has_router());
+    ASSERT(!hasRoutesOfCells(proto.SerializeAsString()));
+
+    // The packed routes of the encoding version 1 are the ones of the only shard of a component
+    TCProto::TransportCatalog packedProto = proto;
+    GraphProto::Router& packedRouterProto = *packedProto.mutable_router()->mutable_router();
+    packedRouterProto.set_encoding_version(1);
+    for (auto& componentProto : *packedRouterProto.mutable_components())
+    {
+        ASSERT_EQUAL(componentProto.shards_size(), 1);
+        const auto& shardProto = componentProto.shards(0);
+        *componentProto.mutable_route_bitmap() = shardProto.route_bitmap();
+        *componentProto.mutable_weights() = shardProto.weights();
+        *componentProto.mutable_prev_edges() = shardProto.prev_edges();
+        componentProto.clear_shard_row_count();
+        componentProto.clear_shards();
+    }
+    const string packedData = packedProto.SerializeAsString();
+    ASSERT(!hasRoutesOfCells(packedData));
+
+    // Routes of the encoding version 0, a message for every cell, are parsed on an arena
+    GraphProto::Router& routerProto = *proto.mutable_router()->mutable_router();
+    ASSERT_EQUAL(routerProto.encoding_version(), 2u);
+    routerProto.set_encoding_version(0);
+    for (auto& componentProto : *routerProto.mutable_components())
+    {
+        // Every shard is of whole rows, the last one may be shorter
+        const auto vertexCount = static_cast<size_t>(componentProto.vertexes_size());
+        const size_t shardRowCount = componentProto.shard_row_count();
+        for (size_t row = 0; row < vertexCount; row += shardRowCount)
+        {
+            const auto& shardProto = componentProto.shards(static_cast<int>(row / shardRowCount));
+            const size_t cellCount = min(shardRowCount, vertexCount - row) * vertexCount;
+            int routeIndex = 0;
+            for (size_t cell = 0; cell < cellCount; ++cell)
+            {
+                if (cell % vertexCount == 0)
+                {
+                    componentProto.add_routes_data();
+                }
+                auto& routeDataProto = *componentProto.mutable_routes_data()
+                                            ->rbegin()
+                                            ->add_routes_data_for_one_vertex();
+                if ((shardProto.route_bitmap(static_cast<int>(cell / 64)) >> (cell % 64) & 1) ==
+                    0)
+                {
+                    continue;
+                }
+                routeDataProto.set_exists(true);
+                routeDataProto.set_weight(shardProto.weights(routeIndex));
+                if (shardProto.prev_edges(routeIndex) != numeric_limits<uint32_t>::max())
+                {
+                    routeDataProto.set_has_prev_edge(true);
+                    routeDataProto.set_prev_edge(shardProto.prev_edges(routeIndex));
+                }
+                ++routeIndex;
+            }
+        }
+        componentProto.clear_shard_row_count();
+        componentProto.clear_shards();
+    }
+
+    const string data = proto.SerializeAsString();
+    ASSERT(hasRoutesOfCells(data));
+
+    for (const auto* catalogData : {&data, &packedData})
+    {
+        const auto catalog = TransportCatalog::deserialize(*catalogData);
+        for (const string from : {"Tolstopaltsevo", "Marushkino", "Rasskazovka"})
+        {
+            for (const string to : {"Tolstopaltsevo", "Marushkino", "Rasskazovka"})
+            {
+                ASSERT_EQUAL(catalog.findRoute(from, to), expectedCatalog.findRoute(from, to));
+            }
+        }
+        ASSERT_EQUAL(catalog.getBus("256")->roadRouteLength, 19800u);
+    }
+}
 
 void runTransportRouterTests()
 {
     TestRunner tr;
     RUN_TEST(tr, testFindRoute);
+    RUN_TEST(tr, testFindRouteWithMaxTransfers);
+    RUN_TEST(tr, testFindRouteTimes);
+    RUN_TEST(tr, testUpdates);
+    RUN_TEST(tr, testNarrowerWeights);
+    RUN_TEST(tr, testParallelEdgePruning);
+    RUN_TEST(tr, testVertexOrder);
+    RUN_TEST(tr, testFirstHops);
+    RUN_TEST(tr, testNameIds);
+    RUN_TEST(tr, testShardedBase);
+    RUN_TEST(tr, testStreamedBase);
+    RUN_TEST(tr, testLazyMappedBase);
+    RUN_TEST(tr, testCellRoutesBase);
+    RUN_TEST(tr, testCatalogUpdates);
 }
 } // namespace Tests